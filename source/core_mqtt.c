@@ -90,10 +90,49 @@
  */
 #define CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH    ( 2U )
 
+/**
+ * @brief A size_t with the value 0x01 in every byte, used to check all the
+ * bytes of a machine word at once when matching topics.
+ */
+#define CORE_MQTT_WORD_ONES                              ( ( ( size_t ) ~( size_t ) 0U ) / 0xFFU )
+
+/**
+ * @brief A size_t with the value 0x80 in every byte.
+ */
+#define CORE_MQTT_WORD_HIGH_BITS                         ( CORE_MQTT_WORD_ONES * 0x80U )
+
+/**
+ * @brief A size_t with the '/' level separator in every byte.
+ */
+#define CORE_MQTT_WORD_SEPARATORS                        ( CORE_MQTT_WORD_ONES * ( size_t ) '/' )
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+
+/**
+ * @brief Most vectors of a publish in a batch: the header, topic, packet ID,
+ * frozen MQTT 5 properties and payload.
+ */
+    #define CORE_MQTT_BATCH_PUBLISH_VECTORS                  ( 5U )
+
+/**
+ * @brief Most vectors of the MQTT 5 property block of a packet.
+ */
+    #define CORE_MQTT_PROPERTY_VECTORS                       MQTT5_PROPERTY_MAX_VECTORS
+#else
+    #define CORE_MQTT_BATCH_PUBLISH_VECTORS                  ( 4U )
+    #define CORE_MQTT_PROPERTY_VECTORS                       ( 0U )
+#endif
+
+/* A batch of publishes must have room for at least one publish. */
+#if ( MQTT_PUBLISH_MAX_VECTORS < CORE_MQTT_BATCH_PUBLISH_VECTORS )
+    #error "MQTT_PUBLISH_MAX_VECTORS must be at least the vectors of one publish"
+#endif
+
 struct MQTTVec
 {
-    TransportOutVector_t * pVector; /**< Pointer to transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
-    size_t vectorLen;               /**< Length of the transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    TransportOutVector_t * pVector;         /**< Pointer to transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    size_t vectorLen;                       /**< Length of the transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    const MQTTPublishInfo_t * pPublishInfo; /**< Publish whose topic name and payload the vector refers to. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
 };
 
 /*-----------------------------------------------------------*/
@@ -258,6 +297,7 @@ static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType );
  * @brief Receive bytes into the network buffer.
  *
  * @param[in] pContext Initialized MQTT Context.
+ * @param[in] offset Offset in the network buffer to receive the bytes at.
  * @param[in] bytesToRecv Number of bytes to receive.
  *
  * @note This operation calls the transport receive function
@@ -273,6 +313,7 @@ static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType );
  * @return Number of bytes received, or negative number on network error.
  */
 static int32_t recvExact( MQTTContext_t * pContext,
+                          size_t offset,
                           size_t bytesToRecv );
 
 /**
@@ -299,6 +340,42 @@ static MQTTStatus_t discardPacket( MQTTContext_t * pContext,
 static MQTTStatus_t discardStoredPacket( MQTTContext_t * pContext,
                                          const MQTTPacketInfo_t * pPacketInfo );
 
+/**
+ * @brief Hand the payload of a PUBLISH packet larger than the network buffer
+ * to the stream callback as it is received.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pPacketInfo Information struct of the packet, whose first bytes
+ * are at the read position of the network buffer.
+ *
+ * @return #MQTTSuccess, #MQTTNoDataAvailable if the packet was discarded,
+ * #MQTTRecvFailed, #MQTTIllegalState or #MQTTSendFailed.
+ */
+static MQTTStatus_t streamIncomingPublish( MQTTContext_t * pContext,
+                                           const MQTTPacketInfo_t * pPacketInfo );
+
+/**
+ * @brief Stream or discard a packet larger than the network buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pPacketInfo Information struct of the packet.
+ *
+ * @return #MQTTNoDataAvailable once the packet was streamed or discarded, or
+ * the error of #streamIncomingPublish or #discardStoredPacket.
+ */
+static MQTTStatus_t handleOversizedPacket( MQTTContext_t * pContext,
+                                          const MQTTPacketInfo_t * pPacketInfo );
+
+/**
+ * @brief Move the unprocessed bytes of the network buffer to its start.
+ *
+ * Only used in ring receive mode, where it is called when the space left
+ * after a partially received packet cannot hold the rest of it.
+ *
+ * @param[in] pContext MQTT Connection context.
+ */
+static void compactNetworkBuffer( MQTTContext_t * pContext );
+
 /**
  * @brief Receive a packet from the transport interface.
  *
@@ -345,6 +422,25 @@ static MQTTStatus_t sendPublishAcks( MQTTContext_t * pContext,
  */
 static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext );
 
+/**
+ * @brief Record an incoming QoS 1 or QoS 2 publish in the state engine.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetIdentifier Packet ID of the publish.
+ * @param[in] pPublishInfo Deserialized publish.
+ * @param[out] pPublishRecordState State of the publish record.
+ * @param[out] pDuplicatePublish Whether the publish was received before, in
+ * which case it is not given to the application.
+ *
+ * @return #MQTTSuccess, #MQTTRecvFailed if there are no incoming publish
+ * records, or the state engine error.
+ */
+static MQTTStatus_t recordIncomingPublish( MQTTContext_t * pContext,
+                                           uint16_t packetIdentifier,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           MQTTPublishState_t * pPublishRecordState,
+                                           bool * pDuplicatePublish );
+
 /**
  * @brief Handle received MQTT PUBLISH packet.
  *
@@ -399,6 +495,50 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
 static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
                                             bool manageKeepAlive );
 
+/**
+ * @brief Read as many bytes as possible from the transport interface into the
+ * free space at the end of the network buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return Number of bytes received; negative value if the receive failed, in
+ * which case the connection is marked as pending disconnect.
+ */
+static int32_t recvIntoNetworkBuffer( MQTTContext_t * pContext );
+
+/**
+ * @brief Hand a complete packet at the read position of the network buffer
+ * to the application and consume it from the buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Type and length of the packet.
+ * @param[in] manageKeepAlive Flag indicating if keep alive should be handled.
+ *
+ * @return Status of handling the incoming PUBLISH or ack.
+ */
+static MQTTStatus_t handleBufferedPacket( MQTTContext_t * pContext,
+                                          MQTTPacketInfo_t * pIncomingPacket,
+                                          bool manageKeepAlive );
+
+/**
+ * @brief Handle every complete packet already in the network buffer without
+ * reading from the transport interface.
+ *
+ * A packet larger than the network buffer is discarded, which requires
+ * reading the rest of it from the transport interface.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] maxPackets Maximum number of packets to handle.
+ * @param[in,out] pProcessedCount Number of packets handled so far; incremented
+ * for every packet handed to the application.
+ *
+ * @return #MQTTSuccess if every complete packet up to @p maxPackets was handled;
+ * an error status from handling a packet otherwise.
+ */
+static MQTTStatus_t processBufferedPackets( MQTTContext_t * pContext,
+                                            size_t maxPackets,
+                                            size_t * pProcessedCount );
+
 /**
  * @brief Validates parameters of #MQTT_Subscribe or #MQTT_Unsubscribe.
  *
@@ -436,6 +576,173 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
                                     MQTTPacketInfo_t * pIncomingPacket,
                                     bool * pSessionPresent );
 
+#if MQTT_VERSION == MQTT_VERSION_5_0
+
+/**
+ * @brief Size the send window from the Receive Maximum of a CONNACK.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pConnack Deserialized CONNACK packet.
+ *
+ * @return #MQTTBadResponse if the CONNACK properties are malformed or the
+ * Receive Maximum is 0;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t setReceiveMaximum( MQTTContext_t * pContext,
+                                       const MQTTPacketInfo_t * pConnack );
+
+/**
+ * @brief Forget the outgoing topic aliases of the previous connection and
+ * bound them by the Topic Alias Maximum of a CONNACK.
+ *
+ * @param[in] pAliases Outgoing topic aliases of the context.
+ * @param[in] pConnack Deserialized CONNACK packet.
+ *
+ * @return #MQTTBadResponse if the CONNACK properties are malformed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t resetTopicAliases( MQTTTopicAliases_t * pAliases,
+                                       const MQTTPacketInfo_t * pConnack );
+
+/**
+ * @brief Check whether #MQTT_Publish may replace the topic name of a publish
+ * by a topic alias.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ *
+ * @return true if the topic aliases are enabled, the publish is neither
+ * stored for retransmission nor carries properties, and its topic name fits
+ * the arena; false otherwise.
+ */
+static bool topicAliasAllowed( const MQTTContext_t * pContext,
+                               const MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Give a publish the topic alias of its topic name, or else the alias
+ * to map to it.
+ *
+ * An alias already mapped to the topic replaces the topic name. Otherwise the
+ * publish keeps its topic name, with an unused alias or the least recently
+ * used one.
+ *
+ * @param[in] pAliases Outgoing topic aliases of the context.
+ * @param[in,out] pPublishInfo Copy of the MQTT PUBLISH packet parameters.
+ */
+static void chooseTopicAlias( const MQTTTopicAliases_t * pAliases,
+                              MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Record that a topic alias was sent for a topic name, copying the
+ * topic name into the arena.
+ *
+ * @param[in] pAliases Outgoing topic aliases of the context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters with the topic name.
+ * @param[in] topicAlias The alias sent with the publish.
+ */
+static void recordTopicAlias( MQTTTopicAliases_t * pAliases,
+                              const MQTTPublishInfo_t * pPublishInfo,
+                              uint16_t topicAlias );
+
+/**
+ * @brief Check that the broker may not send more incoming topic aliases than
+ * the context can resolve.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pConnectInfo MQTT CONNECT packet parameters.
+ *
+ * @return #MQTTBadParameter if the Topic Alias Maximum of the CONNECT exceeds
+ * the number of incoming topic aliases;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t validateIncomingTopicAliases( const MQTTContext_t * pContext,
+                                                  const MQTTConnectInfo_t * pConnectInfo );
+
+/**
+ * @brief Map the Topic Alias of an incoming publish to its topic name, or
+ * replace its empty topic name by the topic name mapped to the alias.
+ *
+ * @param[in] pAliases Incoming topic aliases of the context.
+ * @param[in,out] pPublishInfo Deserialized MQTT PUBLISH packet parameters.
+ *
+ * @return #MQTTBadResponse if the alias exceeds the Topic Alias Maximum or
+ * replaces the topic name without being mapped;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t resolveTopicAlias( const MQTTIncomingTopicAliases_t * pAliases,
+                                       MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Add the vectors of an MQTT 5 property block, sending its string and
+ * binary values from application memory.
+ *
+ * A block frozen by #MQTT5_FreezeProperties takes a single vector. Otherwise
+ * the properties length, identifiers, value lengths and integers are encoded
+ * into @p pScratch, between the vectors of the values.
+ *
+ * @param[in] pProperties Properties to send.
+ * @param[out] pScratch #MQTT5_PROPERTY_SCRATCH_SIZE bytes for the encoded
+ * parts, or NULL if the properties must be frozen.
+ * @param[out] pIoVector Array with room for #MQTT5_PROPERTY_MAX_VECTORS
+ * vectors.
+ * @param[out] pVectorCount The number of vectors added.
+ *
+ * @return #MQTTNoMemory if the block needs more vectors or scratch bytes than
+ * configured;
+ * #MQTTBadParameter if it must be frozen and is not, or has an unknown
+ * property;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t addPropertyVectors( const MQTT5Properties_t * pProperties,
+                                        uint8_t * pScratch,
+                                        TransportOutVector_t * pIoVector,
+                                        size_t * pVectorCount );
+
+/**
+ * @brief Add the scratch bytes encoded since the previous vector, then a value
+ * from application memory, to the vectors of a property block.
+ *
+ * @param[in] pScratch Scratch buffer of the property block.
+ * @param[in,out] pRunStart Index in @p pScratch of the first byte not yet in
+ * a vector.
+ * @param[in] used Number of bytes encoded into @p pScratch.
+ * @param[in] pValue Value to send. Nothing is added if its length is 0.
+ * @param[in] valueLength Length of @p pValue.
+ * @param[out] pIoVector Vectors of the property block.
+ * @param[in,out] pVectorCount Number of vectors in @p pIoVector.
+ *
+ * @return #MQTTNoMemory if there is no room for the vectors;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t addPropertyValue( const uint8_t * pScratch,
+                                      size_t * pRunStart,
+                                      size_t used,
+                                      const void * pValue,
+                                      size_t valueLength,
+                                      TransportOutVector_t * pIoVector,
+                                      size_t * pVectorCount );
+
+/**
+ * @brief Check that the properties of a publish that is batched, queued or
+ * prepared are frozen, as they are sent without scratch space.
+ *
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ *
+ * @return #MQTTBadParameter if the publish has properties that are not
+ * frozen;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t validateFrozenProperties( const MQTTPublishInfo_t * pPublishInfo );
+
+#endif
+
+/**
+ * @brief Forget the incoming topic aliases of the previous connection.
+ *
+ * @param[in] pAliases Incoming topic aliases of the context.
+ */
+static void clearIncomingTopicAliases( const MQTTIncomingTopicAliases_t * pAliases );
+
 /**
  * @brief Resends pending acks for a re-established MQTT session
  *
@@ -446,6 +753,39 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
  */
 static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext );
 
+/**
+ * @brief Start resending the packets of a re-established MQTT session from
+ * later calls of #MQTT_ProcessLoop.
+ *
+ * @param[in] pContext Initialized MQTT context with a session resumption.
+ */
+static void startSessionResumption( MQTTContext_t * pContext );
+
+/**
+ * @brief Resend the next packets of a re-established MQTT session, up to the
+ * number allowed for each call of #MQTT_ProcessLoop.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return #MQTTSendFailed if transport send during resend failed;
+ * #MQTTPublishRetrieveFailed if a PUBLISH could not be retrieved, which is
+ * then skipped; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t continueSessionResumption( MQTTContext_t * pContext );
+
+/**
+ * @brief Resend a PUBLISH retrieved from the retransmit callbacks.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ *
+ * @return #MQTTPublishRetrieveFailed if the retrieve callback failed;
+ * #MQTTSendFailed if transport send failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t resendPublish( MQTTContext_t * pContext,
+                                   uint16_t packetId );
+
 /**
  * @brief Clears existing state records for a clean session.
  *
@@ -455,6 +795,177 @@ static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext );
  */
 static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext );
 
+/**
+ * @brief Clear a packet ID index along with the occupancy it tracks.
+ *
+ * @param[in] pIndex Packet ID index to clear.
+ */
+static void clearPublishIndex( MQTTPubAckIndex_t * pIndex );
+
+/**
+ * @brief Check that a packet ID index can cover a state record array.
+ *
+ * @param[in] pIndex Packet ID index, or NULL if the records are not indexed.
+ * @param[in] recordCount Number of records covered by the index.
+ *
+ * @return `true` if the index is NULL or usable, else `false`.
+ */
+static bool validatePublishIndex( const MQTTPubAckIndex_t * pIndex,
+                                  size_t recordCount );
+
+/**
+ * @brief Add the vectors of a publish packet to an array of vectors.
+ *
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] pMqttHeader The serialized header including the topic length.
+ * @param[in] headerSize Size of the serialized PUBLISH header.
+ * @param[out] pSerializedPacketId #MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE bytes
+ * to encode the packet ID and, with MQTT 5, the property block into.
+ * @param[in] packetId Packet Id of the publish packet.
+ * @param[in] pPropertyVectors Vectors of the MQTT 5 property block, sent after
+ * the packet ID.
+ * @param[in] propertyVectorCount Number of vectors in @p pPropertyVectors.
+ * @param[out] pIoVector Array with room for at least 4 vectors plus
+ * @p propertyVectorCount.
+ * @param[in,out] pTotalMessageLength Incremented by the size of the packet.
+ *
+ * @return The number of vectors added.
+ */
+static size_t addPublishVectors( const MQTTPublishInfo_t * pPublishInfo,
+                                 uint8_t * pMqttHeader,
+                                 size_t headerSize,
+                                 uint8_t * pSerializedPacketId,
+                                 uint16_t packetId,
+                                 const TransportOutVector_t * pPropertyVectors,
+                                 size_t propertyVectorCount,
+                                 TransportOutVector_t * pIoVector,
+                                 size_t * pTotalMessageLength );
+
+/**
+ * @brief Give a QoS 1 or QoS 2 publish packet to the store callback, with the
+ * DUP flag set, before it is sent.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] pMqttHeader The serialized header, as referenced by @p pIoVector.
+ * @param[in] packetId Packet Id of the publish packet.
+ * @param[in] pIoVector Vectors of the publish packet.
+ * @param[in] ioVectorLength Number of vectors in @p pIoVector.
+ *
+ * @return #MQTTPublishStoreFailed if the store callback failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t storePublishForRetransmit( MQTTContext_t * pContext,
+                                               const MQTTPublishInfo_t * pPublishInfo,
+                                               uint8_t * pMqttHeader,
+                                               uint16_t packetId,
+                                               TransportOutVector_t * pIoVector,
+                                               size_t ioVectorLength );
+
+/**
+ * @brief Get the next packet ID of a context, without taking the mutex.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return The packet ID.
+ */
+static uint16_t nextPacketId( MQTTContext_t * pContext );
+
+/**
+ * @brief Add a publish to a batch of publishes sent with one vectored write,
+ * after reserving its state record.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] pMqttHeader The serialized header including the topic length.
+ * @param[in] headerSize Size of the serialized PUBLISH header.
+ * @param[out] pSerializedPacketId #MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE bytes
+ * to encode the packet ID and, with MQTT 5, the property block into.
+ * @param[in,out] pPacketId Packet ID of a QoS 1 or QoS 2 publish. A packet ID
+ * of 0 is replaced with the next packet ID of the context.
+ * @param[out] pIoVector Array with room for at least
+ * #CORE_MQTT_BATCH_PUBLISH_VECTORS vectors.
+ * @param[in,out] pTotalMessageLength Incremented by the size of the packet.
+ * @param[out] pVectorCount The number of vectors added.
+ *
+ * A state record reserved here is removed again if the publish cannot be
+ * added.
+ *
+ * @return #MQTTNoMemory if there is no free outgoing publish record;
+ * #MQTTBadParameter if QoS 1 and QoS 2 publishes are not enabled, or the
+ * MQTT 5 properties are not frozen;
+ * #MQTTStateCollision if the packet ID is in use;
+ * #MQTTPublishStoreFailed if the store callback failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t addPublishToBatch( MQTTContext_t * pContext,
+                                       const MQTTPublishInfo_t * pPublishInfo,
+                                       uint8_t * pMqttHeader,
+                                       size_t headerSize,
+                                       uint8_t * pSerializedPacketId,
+                                       uint16_t * pPacketId,
+                                       TransportOutVector_t * pIoVector,
+                                       size_t * pTotalMessageLength,
+                                       size_t * pVectorCount );
+
+#if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 )
+
+/**
+ * @brief Send a batch of queued publishes, then update their state and release
+ * their queue entries.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIoVector Vectors of the batch.
+ * @param[in] ioVectorLength Number of vectors in @p pIoVector.
+ * @param[in] totalMessageLength Number of bytes in the batch.
+ * @param[in] pFirstQueue The first queue with publishes in the batch.
+ * @param[in] pLastQueue The last queue with publishes in the batch, or NULL
+ * for the end of the list.
+ *
+ * If the write fails, the publishes of the batch are dropped: their queue
+ * entries are released, and their state records and retransmit copies are
+ * removed.
+ *
+ * @return #MQTTSendFailed if transport write failed; the status of the
+ * state update otherwise.
+ */
+static MQTTStatus_t sendQueuedPublishes( MQTTContext_t * pContext,
+                                         TransportOutVector_t * pIoVector,
+                                         size_t ioVectorLength,
+                                         size_t totalMessageLength,
+                                         MQTTPublishQueue_t * pFirstQueue,
+                                         const MQTTPublishQueue_t * pLastQueue );
+
+#endif /* if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 ) */
+
+/**
+ * @brief Send a batch of publishes built by #MQTT_PublishMany and update the
+ * state of the QoS 1 and QoS 2 publishes in it.
+ *
+ * If the write fails, the state records and retransmit copies of the
+ * publishes in the batch are removed, so that they can be published again
+ * with the same packet IDs.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pIoVector Vectors of the batch.
+ * @param[in] ioVectorLength Number of vectors in @p pIoVector.
+ * @param[in] totalMessageLength Number of bytes in the batch.
+ * @param[in] pPublishInfo The publishes in the batch.
+ * @param[in] pPacketIds Packet IDs of the publishes in the batch, or NULL if
+ * they are all QoS 0.
+ * @param[in] publishCount Number of publishes in the batch.
+ *
+ * @return #MQTTSendFailed if transport write failed; the status of the
+ * state update otherwise.
+ */
+static MQTTStatus_t sendPublishBatch( MQTTContext_t * pContext,
+                                      TransportOutVector_t * pIoVector,
+                                      size_t ioVectorLength,
+                                      size_t totalMessageLength,
+                                      const MQTTPublishInfo_t * pPublishInfo,
+                                      const uint16_t * pPacketIds,
+                                      size_t publishCount );
+
 /**
  * @brief Send the publish packet without copying the topic string and payload in
  * the buffer.
@@ -465,6 +976,9 @@ static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext );
  * the encoded length of the packet; and the encoded length of the topic string.
  * @brief param[in] headerSize Size of the serialized PUBLISH header.
  * @brief param[in] packetId Packet Id of the publish packet.
+ * @brief param[in] pPropertyVectors Vectors of the MQTT 5 property block.
+ * @brief param[in] propertyVectorCount Number of vectors in @p pPropertyVectors,
+ * at most #MQTT5_PROPERTY_MAX_VECTORS.
  *
  * @return #MQTTSendFailed if transport send during resend failed;
  * #MQTTSuccess otherwise.
@@ -473,7 +987,9 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
                                             const MQTTPublishInfo_t * pPublishInfo,
                                             uint8_t * pMqttHeader,
                                             size_t headerSize,
-                                            uint16_t packetId );
+                                            uint16_t packetId,
+                                            const TransportOutVector_t * pPropertyVectors,
+                                            size_t propertyVectorCount );
 
 /**
  * @brief Function to validate #MQTT_Publish parameters.
@@ -489,6 +1005,32 @@ static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
                                            const MQTTPublishInfo_t * pPublishInfo,
                                            uint16_t packetId );
 
+/**
+ * @brief Send a publish with a serialized header and update its state.
+ *
+ * The caller takes the mutex with #MQTT_PRE_STATE_UPDATE_HOOK so that the
+ * state is updated before the receive loop processes the acks of the publish.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] pMqttHeader The serialized header including the topic length.
+ * @param[in] headerSize Size of the serialized PUBLISH header.
+ * @param[in] packetId Packet Id of the publish packet.
+ * @param[in] pPropertyVectors Vectors of the MQTT 5 property block.
+ * @param[in] propertyVectorCount Number of vectors in @p pPropertyVectors.
+ *
+ * @return #MQTTStatusNotConnected or #MQTTStatusDisconnectPending if not
+ * connected; the status of the state reservation, send or state update
+ * otherwise.
+ */
+static MQTTStatus_t sendSerializedPublish( MQTTContext_t * pContext,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           uint8_t * pMqttHeader,
+                                           size_t headerSize,
+                                           uint16_t packetId,
+                                           const TransportOutVector_t * pPropertyVectors,
+                                           size_t propertyVectorCount );
+
 /**
  * @brief Performs matching for special cases when a topic filter ends
  * with a wildcard character.
@@ -514,6 +1056,37 @@ static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
                                            uint16_t topicFilterLength,
                                            uint16_t filterIndex );
 
+/**
+ * @brief Count the leading characters two strings have in common, comparing a
+ * machine word at a time.
+ *
+ * Only whole words are compared, so the count is a multiple of the word size
+ * and the characters after it are left for byte by byte matching.
+ *
+ * @param[in] pFirst The first string.
+ * @param[in] pSecond The second string.
+ * @param[in] length Number of characters available in both strings.
+ *
+ * @return Number of leading characters found equal.
+ */
+static uint16_t matchingPrefixLength( const char * pFirst,
+                                      const char * pSecond,
+                                      uint16_t length );
+
+/**
+ * @brief Find the next '/' level separator in a topic name, checking a machine
+ * word at a time.
+ *
+ * @param[in] pTopicName The topic name.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[in] nameIndex Index to start searching from.
+ *
+ * @return Index of the next '/', or @p topicNameLength if there is none.
+ */
+static uint16_t findLevelSeparator( const char * pTopicName,
+                                    uint16_t topicNameLength,
+                                    uint16_t nameIndex );
+
 /**
  * @brief Attempt to match topic name with a topic filter starting with a wildcard.
  *
@@ -558,6 +1131,19 @@ static bool matchTopicFilter( const char * pTopicName,
                               const char * pTopicFilter,
                               uint16_t topicFilterLength );
 
+/**
+ * @brief Check whether a vector of an #MQTTVec refers to a buffer of the
+ * application rather than to bytes serialized by the library.
+ *
+ * @param[in] pVec The #MQTTVec the vector belongs to.
+ * @param[in] pTransportVec The vector to check.
+ *
+ * @return `true` if the vector refers to the topic name or payload of the
+ * PUBLISH; `false` otherwise.
+ */
+static bool isApplicationVector( const MQTTVec_t * pVec,
+                                 const TransportOutVector_t * pTransportVec );
+
 /*-----------------------------------------------------------*/
 
 static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
@@ -601,53 +1187,109 @@ static bool matchEndWildcardsSpecialCases( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
-static bool matchWildcards( const char * pTopicName,
-                            uint16_t topicNameLength,
-                            const char * pTopicFilter,
-                            uint16_t topicFilterLength,
-                            uint16_t * pNameIndex,
-                            uint16_t * pFilterIndex,
-                            bool * pMatch )
+static uint16_t matchingPrefixLength( const char * pFirst,
+                                      const char * pSecond,
+                                      uint16_t length )
 {
-    bool shouldStopMatching = false;
-    bool locationIsValidForWildcard;
-    uint16_t nameIndex;
-
-    assert( pTopicName != NULL );
-    assert( topicNameLength != 0U );
-    assert( pTopicFilter != NULL );
-    assert( topicFilterLength != 0U );
-    assert( pNameIndex != NULL );
-    assert( pFilterIndex != NULL );
-    assert( pMatch != NULL );
-
-    nameIndex = *pNameIndex;
+    uint16_t index = 0U;
+    size_t firstWord = 0U;
+    size_t secondWord = 0U;
 
-    /* Wild card in a topic filter is only valid either at the starting position
-     * or when it is preceded by a '/'.*/
-    locationIsValidForWildcard = ( *pFilterIndex == 0u ) ||
-                                 ( pTopicFilter[ *pFilterIndex - 1U ] == '/' );
+    assert( pFirst != NULL );
+    assert( pSecond != NULL );
 
-    if( ( pTopicFilter[ *pFilterIndex ] == '+' ) && ( locationIsValidForWildcard == true ) )
+    /* The words are copied because the strings need not be word aligned. */
+    while( ( ( size_t ) length - ( size_t ) index ) >= sizeof( size_t ) )
     {
-        bool nextLevelExistsInTopicName = false;
-        bool nextLevelExistsinTopicFilter = false;
+        ( void ) memcpy( &firstWord, &pFirst[ index ], sizeof( size_t ) );
+        ( void ) memcpy( &secondWord, &pSecond[ index ], sizeof( size_t ) );
 
-        /* Move topic name index to the end of the current level. The end of the
-         * current level is identified by the last character before the next level
-         * separator '/'. */
-        while( nameIndex < topicNameLength )
+        if( firstWord != secondWord )
         {
-            /* Exit the loop if we hit the level separator. */
-            if( pTopicName[ nameIndex ] == '/' )
-            {
-                nextLevelExistsInTopicName = true;
-                break;
-            }
+            break;
+        }
+
+        index += ( uint16_t ) sizeof( size_t );
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findLevelSeparator( const char * pTopicName,
+                                    uint16_t topicNameLength,
+                                    uint16_t nameIndex )
+{
+    uint16_t index = nameIndex;
+    size_t word = 0U;
+
+    assert( pTopicName != NULL );
+
+    /* XOR with a word of separators turns every '/' into a zero byte. The
+     * classic zero byte test then checks all the bytes of the word at once. */
+    while( ( ( size_t ) topicNameLength - ( size_t ) index ) >= sizeof( size_t ) )
+    {
+        ( void ) memcpy( &word, &pTopicName[ index ], sizeof( size_t ) );
+        word ^= CORE_MQTT_WORD_SEPARATORS;
 
-            nameIndex += 1;
+        if( ( ( word - CORE_MQTT_WORD_ONES ) & ~word & CORE_MQTT_WORD_HIGH_BITS ) != 0U )
+        {
+            break;
         }
 
+        index += ( uint16_t ) sizeof( size_t );
+    }
+
+    /* Locate the separator within the last word byte by byte. */
+    while( ( index < topicNameLength ) && ( pTopicName[ index ] != '/' ) )
+    {
+        index++;
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool matchWildcards( const char * pTopicName,
+                            uint16_t topicNameLength,
+                            const char * pTopicFilter,
+                            uint16_t topicFilterLength,
+                            uint16_t * pNameIndex,
+                            uint16_t * pFilterIndex,
+                            bool * pMatch )
+{
+    bool shouldStopMatching = false;
+    bool locationIsValidForWildcard;
+    uint16_t nameIndex;
+
+    assert( pTopicName != NULL );
+    assert( topicNameLength != 0U );
+    assert( pTopicFilter != NULL );
+    assert( topicFilterLength != 0U );
+    assert( pNameIndex != NULL );
+    assert( pFilterIndex != NULL );
+    assert( pMatch != NULL );
+
+    nameIndex = *pNameIndex;
+
+    /* Wild card in a topic filter is only valid either at the starting position
+     * or when it is preceded by a '/'.*/
+    locationIsValidForWildcard = ( *pFilterIndex == 0u ) ||
+                                 ( pTopicFilter[ *pFilterIndex - 1U ] == '/' );
+
+    if( ( pTopicFilter[ *pFilterIndex ] == '+' ) && ( locationIsValidForWildcard == true ) )
+    {
+        bool nextLevelExistsInTopicName = false;
+        bool nextLevelExistsinTopicFilter = false;
+
+        /* Move topic name index to the end of the current level. The end of the
+         * current level is identified by the last character before the next level
+         * separator '/'. */
+        nameIndex = findLevelSeparator( pTopicName, topicNameLength, nameIndex );
+        nextLevelExistsInTopicName = ( nameIndex < topicNameLength );
+
         /* Determine if the topic filter contains a child level after the current level
          * represented by the '+' wildcard. */
         if( ( *pFilterIndex < ( topicFilterLength - 1U ) ) &&
@@ -718,6 +1360,7 @@ static bool matchTopicFilter( const char * pTopicName,
 {
     bool matchFound = false, shouldStopMatching = false;
     uint16_t nameIndex = 0, filterIndex = 0;
+    uint16_t remainingLength = 0, skipLength = 0;
 
     assert( pTopicName != NULL );
     assert( topicNameLength != 0 );
@@ -726,6 +1369,18 @@ static bool matchTopicFilter( const char * pTopicName,
 
     while( ( nameIndex < topicNameLength ) && ( filterIndex < topicFilterLength ) )
     {
+        /* Skip the characters both topics have in common a word at a time. The
+         * last character of each topic is left for the checks below, as it
+         * may need the special cases for the end of the topic name. */
+        remainingLength = ( ( topicNameLength - nameIndex ) < ( topicFilterLength - filterIndex ) ) ?
+                          ( uint16_t ) ( topicNameLength - nameIndex - 1U ) :
+                          ( uint16_t ) ( topicFilterLength - filterIndex - 1U );
+        skipLength = matchingPrefixLength( &pTopicName[ nameIndex ],
+                                           &pTopicFilter[ filterIndex ],
+                                           remainingLength );
+        nameIndex += skipLength;
+        filterIndex += skipLength;
+
         /* Check if the character in the topic name matches the corresponding
          * character in the topic filter string. */
         if( pTopicName[ nameIndex ] == pTopicFilter[ filterIndex ] )
@@ -994,6 +1649,7 @@ static MQTTPubAckType_t getAckFromPacketType( uint8_t packetType )
 /*-----------------------------------------------------------*/
 
 static int32_t recvExact( MQTTContext_t * pContext,
+                          size_t offset,
                           size_t bytesToRecv )
 {
     uint8_t * pIndex = NULL;
@@ -1005,12 +1661,13 @@ static int32_t recvExact( MQTTContext_t * pContext,
     bool receiveError = false;
 
     assert( pContext != NULL );
-    assert( bytesToRecv <= pContext->networkBuffer.size );
+    assert( offset <= pContext->networkBuffer.size );
+    assert( bytesToRecv <= ( pContext->networkBuffer.size - offset ) );
     assert( pContext->getTime != NULL );
     assert( pContext->transportInterface.recv != NULL );
     assert( pContext->networkBuffer.pBuffer != NULL );
 
-    pIndex = pContext->networkBuffer.pBuffer;
+    pIndex = &pContext->networkBuffer.pBuffer[ offset ];
     recvFunc = pContext->transportInterface.recv;
     getTimeStampMs = pContext->getTime;
 
@@ -1107,7 +1764,7 @@ static MQTTStatus_t discardPacket( MQTTContext_t * pContext,
             bytesToReceive = remainingLength - totalBytesReceived;
         }
 
-        bytesReceived = recvExact( pContext, bytesToReceive );
+        bytesReceived = recvExact( pContext, 0U, bytesToReceive );
 
         if( bytesReceived != ( int32_t ) bytesToReceive )
         {
@@ -1168,8 +1825,8 @@ static MQTTStatus_t discardStoredPacket( MQTTContext_t * pContext,
     /* Discard these many bytes at a time. */
     bytesToReceive = pContext->networkBuffer.size;
 
-    /* Number of bytes depicted by 'index' have already been received. */
-    remainingLength = mqttPacketSize - pContext->index;
+    /* Number of bytes between 'readIndex' and 'index' have already been received. */
+    remainingLength = mqttPacketSize - ( pContext->index - pContext->readIndex );
 
     while( ( totalBytesReceived < remainingLength ) && ( receiveError == false ) )
     {
@@ -1178,7 +1835,7 @@ static MQTTStatus_t discardStoredPacket( MQTTContext_t * pContext,
             bytesToReceive = remainingLength - totalBytesReceived;
         }
 
-        bytesReceived = recvExact( pContext, bytesToReceive );
+        bytesReceived = recvExact( pContext, 0U, bytesToReceive );
 
         if( bytesReceived != ( int32_t ) bytesToReceive )
         {
@@ -1209,12 +1866,207 @@ static MQTTStatus_t discardStoredPacket( MQTTContext_t * pContext,
 
     /* Reset the index. */
     pContext->index = 0;
+    pContext->readIndex = 0;
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t streamIncomingPublish( MQTTContext_t * pContext,
+                                           const MQTTPacketInfo_t * pPacketInfo )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t bufferedPacket;
+    MQTTPublishInfo_t publishInfo;
+    MQTTPublishState_t publishRecordState = MQTTStateNull;
+    uint16_t packetIdentifier = 0U;
+    bool duplicatePublish = false;
+    int32_t bytesReceived = 0;
+    size_t bufferSize = 0U;
+    size_t payloadStart = 0U;
+    size_t payloadOffset = 0U;
+    size_t fragmentLength = 0U;
+
+    assert( pContext != NULL );
+    assert( pPacketInfo != NULL );
+    assert( pContext->streamCallback != NULL );
+
+    bufferSize = pContext->networkBuffer.size;
+
+    /* Move the start of the packet to the start of the buffer, and fill the
+     * rest of the buffer with the packet. Everything in the buffer belongs to
+     * this packet, as it is larger than the buffer. */
+    if( pContext->readIndex > 0U )
+    {
+        compactNetworkBuffer( pContext );
+    }
+
+    bytesReceived = recvExact( pContext, pContext->index, bufferSize - pContext->index );
+
+    if( bytesReceived != ( int32_t ) ( bufferSize - pContext->index ) )
+    {
+        status = MQTTRecvFailed;
+    }
+    else
+    {
+        pContext->index = bufferSize;
+
+        /* Parse the buffered part of the packet as if it were the whole
+         * packet. This fails if the variable header does not fit. */
+        bufferedPacket = *pPacketInfo;
+        bufferedPacket.pRemainingData = &pContext->networkBuffer.pBuffer[ pPacketInfo->headerLength ];
+        bufferedPacket.remainingLength = bufferSize - pPacketInfo->headerLength;
+
+        status = MQTT_DeserializePublish( &bufferedPacket, &packetIdentifier, &publishInfo
+#if MQTT_VERSION == MQTT_VERSION_5_0
+                                          , NULL
+#endif
+                                          );
+
+        if( ( status != MQTTSuccess ) || ( publishInfo.payloadLength == 0U ) ||
+            ( publishInfo.payloadLength > bufferedPacket.remainingLength ) )
+        {
+            LogError( ( "Incoming publish will be dumped: "
+                        "Variable header does not fit in the network buffer." ) );
+            status = discardStoredPacket( pContext, pPacketInfo );
+        }
+        else
+        {
+            payloadStart = bufferSize - publishInfo.payloadLength;
+            fragmentLength = publishInfo.payloadLength;
+            publishInfo.payloadLength = pPacketInfo->remainingLength -
+                                        ( payloadStart - pPacketInfo->headerLength );
+            publishInfo.pPayload = NULL;
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+            if( pContext->pIncomingTopicAliases != NULL )
+            {
+                status = resolveTopicAlias( pContext->pIncomingTopicAliases, &publishInfo );
+            }
+
+            if( status == MQTTSuccess )
+#endif
+            {
+                status = recordIncomingPublish( pContext,
+                                                packetIdentifier,
+                                                &publishInfo,
+                                                &publishRecordState,
+                                                &duplicatePublish );
+            }
+        }
+    }
+
+    while( ( status == MQTTSuccess ) && ( fragmentLength > 0U ) )
+    {
+        if( duplicatePublish == false )
+        {
+            pContext->streamCallback( pContext,
+                                      &publishInfo,
+                                      packetIdentifier,
+                                      payloadOffset,
+                                      &pContext->networkBuffer.pBuffer[ payloadStart ],
+                                      fragmentLength );
+        }
+
+        payloadOffset += fragmentLength;
+        fragmentLength = publishInfo.payloadLength - payloadOffset;
+
+        if( fragmentLength > ( bufferSize - payloadStart ) )
+        {
+            fragmentLength = bufferSize - payloadStart;
+        }
+
+        if( fragmentLength > 0U )
+        {
+            bytesReceived = recvExact( pContext, payloadStart, fragmentLength );
+
+            if( bytesReceived != ( int32_t ) fragmentLength )
+            {
+                LogError( ( "Receive error while streaming publish payload. "
+                            "ReceivedBytes=%ld, ExpectedBytes=%lu.",
+                            ( long int ) bytesReceived,
+                            ( unsigned long ) fragmentLength ) );
+                status = MQTTRecvFailed;
+
+                /* Let the broker deliver the publish again after a reconnect. */
+                if( ( duplicatePublish == false ) && ( publishInfo.qos > MQTTQoS0 ) )
+                {
+                    MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+                    ( void ) MQTT_RemoveIncomingStateRecord( pContext, packetIdentifier );
+                    MQTT_POST_STATE_UPDATE_HOOK( pContext );
+                }
+            }
+        }
+    }
+
+    /* The buffer only held this packet. */
+    pContext->index = 0U;
+    pContext->readIndex = 0U;
+
+    if( status == MQTTSuccess )
+    {
+        pContext->lastPacketRxTime = pContext->getTime();
+
+        /* Send PUBACK or PUBREC if necessary. */
+        status = sendPublishAcks( pContext,
+                                  packetIdentifier,
+                                  publishRecordState );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleOversizedPacket( MQTTContext_t * pContext,
+                                          const MQTTPacketInfo_t * pPacketInfo )
+{
+    MQTTStatus_t status;
+
+    assert( pContext != NULL );
+    assert( pPacketInfo != NULL );
+
+    if( ( pContext->streamCallback != NULL ) &&
+        ( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH ) )
+    {
+        status = streamIncomingPublish( pContext, pPacketInfo );
+
+        /* Like a discarded packet, a streamed one leaves nothing in the
+         * buffer to handle. */
+        if( status == MQTTSuccess )
+        {
+            status = MQTTNoDataAvailable;
+        }
+    }
+    else
+    {
+        /* Discard the packet from the receive buffer and drain the pending
+         * data from the socket buffer. */
+        status = discardStoredPacket( pContext, pPacketInfo );
+    }
 
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
+static void compactNetworkBuffer( MQTTContext_t * pContext )
+{
+    assert( pContext != NULL );
+    assert( pContext->readIndex <= pContext->index );
+
+    pContext->index -= pContext->readIndex;
+
+    ( void ) memmove( pContext->networkBuffer.pBuffer,
+                      &( pContext->networkBuffer.pBuffer[ pContext->readIndex ] ),
+                      pContext->index );
+
+    pContext->readIndex = 0;
+}
+
+/*-----------------------------------------------------------*/
+
 static MQTTStatus_t receivePacket( MQTTContext_t * pContext,
                                    MQTTPacketInfo_t incomingPacket,
                                    uint32_t remainingTimeMs )
@@ -1240,7 +2092,7 @@ static MQTTStatus_t receivePacket( MQTTContext_t * pContext,
     else
     {
         bytesToReceive = incomingPacket.remainingLength;
-        bytesReceived = recvExact( pContext, bytesToReceive );
+        bytesReceived = recvExact( pContext, 0U, bytesToReceive );
 
         if( bytesReceived == ( int32_t ) bytesToReceive )
         {
@@ -1440,31 +2292,23 @@ static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext )
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
-                                           MQTTPacketInfo_t * pIncomingPacket )
+static MQTTStatus_t recordIncomingPublish( MQTTContext_t * pContext,
+                                           uint16_t packetIdentifier,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           MQTTPublishState_t * pPublishRecordState,
+                                           bool * pDuplicatePublish )
 {
-    MQTTStatus_t status;
-    MQTTPublishState_t publishRecordState = MQTTStateNull;
-    uint16_t packetIdentifier = 0U;
-    MQTTPublishInfo_t publishInfo;
-    MQTTDeserializedInfo_t deserializedInfo;
-    bool duplicatePublish = false;
+    MQTTStatus_t status = MQTTSuccess;
 
     assert( pContext != NULL );
-    assert( pIncomingPacket != NULL );
-    assert( pContext->appCallback != NULL );
+    assert( pPublishInfo != NULL );
+    assert( pPublishRecordState != NULL );
+    assert( pDuplicatePublish != NULL );
 
-    status = MQTT_DeserializePublish( pIncomingPacket, &packetIdentifier, &publishInfo
-#if MQTT_VERSION == MQTT_VERSION_5_0
-                                      , NULL
-#endif
-                                      );
-    LogInfo( ( "De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
-               MQTT_Status_strerror( status ) ) );
+    *pDuplicatePublish = false;
 
-    if( ( status == MQTTSuccess ) &&
-        ( pContext->incomingPublishRecords == NULL ) &&
-        ( publishInfo.qos > MQTTQoS0 ) )
+    if( ( pContext->incomingPublishRecords == NULL ) &&
+        ( pPublishInfo->qos > MQTTQoS0 ) )
     {
         LogError( ( "Incoming publish has QoS > MQTTQoS0 but incoming "
                     "publish records have not been initialized. Dropping the "
@@ -1480,15 +2324,15 @@ static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
         status = MQTT_UpdateStatePublish( pContext,
                                           packetIdentifier,
                                           MQTT_RECEIVE,
-                                          publishInfo.qos,
-                                          &publishRecordState );
+                                          pPublishInfo->qos,
+                                          pPublishRecordState );
 
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
 
         if( status == MQTTSuccess )
         {
             LogInfo( ( "State record updated. New state=%s.",
-                       MQTT_State_strerror( publishRecordState ) ) );
+                       MQTT_State_strerror( *pPublishRecordState ) ) );
         }
 
         /* Different cases in which an incoming publish with duplicate flag is
@@ -1520,17 +2364,17 @@ static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
         else if( status == MQTTStateCollision )
         {
             status = MQTTSuccess;
-            duplicatePublish = true;
+            *pDuplicatePublish = true;
 
             /* Calculate the state for the ack packet that needs to be sent out
              * for the duplicate incoming publish. */
-            publishRecordState = MQTT_CalculateStatePublish( MQTT_RECEIVE,
-                                                             publishInfo.qos );
+            *pPublishRecordState = MQTT_CalculateStatePublish( MQTT_RECEIVE,
+                                                              pPublishInfo->qos );
 
             LogDebug( ( "Incoming publish packet with packet id %hu already exists.",
                         ( unsigned short ) packetIdentifier ) );
 
-            if( publishInfo.dup == false )
+            if( pPublishInfo->dup == false )
             {
                 LogError( ( "DUP flag is 0 for duplicate packet (MQTT-3.3.1.-1)." ) );
             }
@@ -1544,6 +2388,49 @@ static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
         }
     }
 
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleIncomingPublish( MQTTContext_t * pContext,
+                                           MQTTPacketInfo_t * pIncomingPacket )
+{
+    MQTTStatus_t status;
+    MQTTPublishState_t publishRecordState = MQTTStateNull;
+    uint16_t packetIdentifier = 0U;
+    MQTTPublishInfo_t publishInfo;
+    MQTTDeserializedInfo_t deserializedInfo;
+    bool duplicatePublish = false;
+
+    assert( pContext != NULL );
+    assert( pIncomingPacket != NULL );
+    assert( pContext->appCallback != NULL );
+
+    status = MQTT_DeserializePublish( pIncomingPacket, &packetIdentifier, &publishInfo
+#if MQTT_VERSION == MQTT_VERSION_5_0
+                                      , NULL
+#endif
+                                      );
+    LogInfo( ( "De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
+               MQTT_Status_strerror( status ) ) );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( ( status == MQTTSuccess ) && ( pContext->pIncomingTopicAliases != NULL ) )
+    {
+        status = resolveTopicAlias( pContext->pIncomingTopicAliases, &publishInfo );
+    }
+#endif
+
+    if( status == MQTTSuccess )
+    {
+        status = recordIncomingPublish( pContext,
+                                        packetIdentifier,
+                                        &publishInfo,
+                                        &publishRecordState,
+                                        &duplicatePublish );
+    }
+
     if( status == MQTTSuccess )
     {
         /* Set fields of deserialized struct. */
@@ -1650,6 +2537,22 @@ static MQTTStatus_t handlePublishAcks( MQTTContext_t * pContext,
                                   publishRecordState );
     }
 
+#if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 )
+    if( ( status == MQTTSuccess ) && ( pContext->drainOnAck == true ) &&
+        ( ( ackType == MQTTPuback ) || ( ackType == MQTTPubcomp ) ) &&
+        ( publishRecordState == MQTTPublishDone ) )
+    {
+        /* The acknowledged publish freed a place in the send window. */
+        status = MQTT_DrainPublishQueues( pContext, NULL );
+
+        if( status == MQTTNoMemory )
+        {
+            /* The rest waits for the next acknowledgment. */
+            status = MQTTSuccess;
+        }
+    }
+#endif /* if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 ) */
+
     return status;
 }
 
@@ -1748,28 +2651,18 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
     MQTTPacketInfo_t incomingPacket = { 0 };
     int32_t recvBytes;
     size_t totalMQTTPacketLength = 0;
+    size_t bytesAvailable = 0;
 
     assert( pContext != NULL );
     assert( pContext->networkBuffer.pBuffer != NULL );
 
     /* Read as many bytes as possible into the network buffer. */
-    recvBytes = pContext->transportInterface.recv( pContext->transportInterface.pNetworkContext,
-                                                   &( pContext->networkBuffer.pBuffer[ pContext->index ] ),
-                                                   pContext->networkBuffer.size - pContext->index );
+    recvBytes = recvIntoNetworkBuffer( pContext );
 
     if( recvBytes < 0 )
     {
         /* The receive function has failed. Bubble up the error up to the user. */
         status = MQTTRecvFailed;
-
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        if( pContext->connectStatus == MQTTConnected )
-        {
-            pContext->connectStatus = MQTTDisconnectPending;
-        }
-
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
     else if( ( recvBytes == 0 ) && ( pContext->index == 0U ) )
     {
@@ -1782,11 +2675,10 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
      * buffer, or both. */
     else
     {
-        /* Update the number of bytes in the MQTT fixed buffer. */
-        pContext->index += ( size_t ) recvBytes;
+        bytesAvailable = pContext->index - pContext->readIndex;
 
-        status = MQTT_ProcessIncomingPacketTypeAndLength( pContext->networkBuffer.pBuffer,
-                                                          &( pContext->index ),
+        status = MQTT_ProcessIncomingPacketTypeAndLength( &( pContext->networkBuffer.pBuffer[ pContext->readIndex ] ),
+                                                          &bytesAvailable,
                                                           &incomingPacket );
 
         totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
@@ -1832,16 +2724,21 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
     /* If the MQTT Packet size is bigger than the buffer itself. */
     else if( totalMQTTPacketLength > pContext->networkBuffer.size )
     {
-        /* Discard the packet from the receive buffer and drain the pending
-         * data from the socket buffer. */
-        status = discardStoredPacket( pContext,
-                                      &incomingPacket );
+        /* Stream the packet to the application, or discard it. */
+        status = handleOversizedPacket( pContext, &incomingPacket );
     }
     /* If the total packet is of more length than the bytes we have available. */
-    else if( totalMQTTPacketLength > pContext->index )
+    else if( totalMQTTPacketLength > bytesAvailable )
     {
         status = MQTTNeedMoreBytes;
-    }
+
+        /* In ring receive mode, linearise the packet at the start of the
+         * buffer only if the rest of it cannot be received in place. */
+        if( ( pContext->readIndex + totalMQTTPacketLength ) > pContext->networkBuffer.size )
+        {
+            compactNetworkBuffer( pContext );
+        }
+    }
     else
     {
         /* MISRA else. */
@@ -1850,19 +2747,103 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
     /* Handle received packet. If incomplete data was read then this will not execute. */
     if( status == MQTTSuccess )
     {
-        incomingPacket.pRemainingData = &pContext->networkBuffer.pBuffer[ incomingPacket.headerLength ];
+        status = handleBufferedPacket( pContext, &incomingPacket, manageKeepAlive );
+    }
+
+    if( status == MQTTNoDataAvailable )
+    {
+        /* No data available is not an error. Reset to MQTTSuccess so the
+         * return code will indicate success. */
+        status = MQTTSuccess;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t recvIntoNetworkBuffer( MQTTContext_t * pContext )
+{
+    int32_t recvBytes;
+
+    assert( pContext != NULL );
+    assert( pContext->networkBuffer.pBuffer != NULL );
+
+    /* In ring receive mode, make room at the end of the buffer if all of it
+     * is taken up by a partially received packet header. */
+    if( ( pContext->readIndex > 0U ) &&
+        ( pContext->index == pContext->networkBuffer.size ) )
+    {
+        compactNetworkBuffer( pContext );
+    }
+
+    recvBytes = pContext->transportInterface.recv( pContext->transportInterface.pNetworkContext,
+                                                   &( pContext->networkBuffer.pBuffer[ pContext->index ] ),
+                                                   pContext->networkBuffer.size - pContext->index );
+
+    if( recvBytes < 0 )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-        /* PUBLISH packets allow flags in the lower four bits. For other
-         * packet types, they are reserved. */
-        if( ( incomingPacket.type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+        if( pContext->connectStatus == MQTTConnected )
         {
-            status = handleIncomingPublish( pContext, &incomingPacket );
+            pContext->connectStatus = MQTTDisconnectPending;
         }
-        else
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+    else
+    {
+        /* Update the number of bytes in the MQTT fixed buffer. */
+        pContext->index += ( size_t ) recvBytes;
+    }
+
+    return recvBytes;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleBufferedPacket( MQTTContext_t * pContext,
+                                          MQTTPacketInfo_t * pIncomingPacket,
+                                          bool manageKeepAlive )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t totalMQTTPacketLength = 0;
+
+    assert( pContext != NULL );
+    assert( pIncomingPacket != NULL );
+
+    totalMQTTPacketLength = pIncomingPacket->remainingLength + pIncomingPacket->headerLength;
+
+    assert( totalMQTTPacketLength <= ( pContext->index - pContext->readIndex ) );
+
+    pIncomingPacket->pRemainingData = &pContext->networkBuffer.pBuffer[ pContext->readIndex + pIncomingPacket->headerLength ];
+
+    /* PUBLISH packets allow flags in the lower four bits. For other
+     * packet types, they are reserved. */
+    if( ( pIncomingPacket->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        status = handleIncomingPublish( pContext, pIncomingPacket );
+    }
+    else
+    {
+        status = handleIncomingAck( pContext, pIncomingPacket, manageKeepAlive );
+    }
+
+    if( pContext->ringReceive == true )
+    {
+        /* Consume the packet in place. Wrap back to the start of the
+         * buffer once everything received has been processed. */
+        pContext->readIndex += totalMQTTPacketLength;
+
+        if( pContext->readIndex == pContext->index )
         {
-            status = handleIncomingAck( pContext, &incomingPacket, manageKeepAlive );
+            pContext->readIndex = 0;
+            pContext->index = 0;
         }
-
+    }
+    else
+    {
         /* Update the index to reflect the remaining bytes in the buffer.  */
         pContext->index -= totalMQTTPacketLength;
 
@@ -1870,17 +2851,71 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
         ( void ) memmove( pContext->networkBuffer.pBuffer,
                           &( pContext->networkBuffer.pBuffer[ totalMQTTPacketLength ] ),
                           pContext->index );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pContext->lastPacketRxTime = pContext->getTime();
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t processBufferedPackets( MQTTContext_t * pContext,
+                                            size_t maxPackets,
+                                            size_t * pProcessedCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    size_t totalMQTTPacketLength = 0;
+    size_t bytesAvailable = 0;
+
+    assert( pContext != NULL );
+    assert( pProcessedCount != NULL );
+
+    while( ( status == MQTTSuccess ) &&
+           ( *pProcessedCount < maxPackets ) &&
+           ( pContext->index > pContext->readIndex ) )
+    {
+        bytesAvailable = pContext->index - pContext->readIndex;
+
+        status = MQTT_ProcessIncomingPacketTypeAndLength( &( pContext->networkBuffer.pBuffer[ pContext->readIndex ] ),
+                                                          &bytesAvailable,
+                                                          &incomingPacket );
 
         if( status == MQTTSuccess )
         {
-            pContext->lastPacketRxTime = pContext->getTime();
+            totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
+
+            if( totalMQTTPacketLength > pContext->networkBuffer.size )
+            {
+                /* Stream the packet to the application, or discard it. */
+                status = handleOversizedPacket( pContext, &incomingPacket );
+            }
+            else if( totalMQTTPacketLength > bytesAvailable )
+            {
+                status = MQTTNeedMoreBytes;
+
+                /* In ring receive mode, linearise the packet at the start of the
+                 * buffer only if the rest of it cannot be received in place. */
+                if( ( pContext->readIndex + totalMQTTPacketLength ) > pContext->networkBuffer.size )
+                {
+                    compactNetworkBuffer( pContext );
+                }
+            }
+            else
+            {
+                ( *pProcessedCount )++;
+                status = handleBufferedPacket( pContext, &incomingPacket, true );
+            }
         }
     }
 
-    if( status == MQTTNoDataAvailable )
+    /* A partially received packet, or a discarded one, is not an error. */
+    if( ( status == MQTTNeedMoreBytes ) || ( status == MQTTNoDataAvailable ) )
     {
-        /* No data available is not an error. Reset to MQTTSuccess so the
-         * return code will indicate success. */
         status = MQTTSuccess;
     }
 
@@ -2175,54 +3210,82 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
-                                            const MQTTPublishInfo_t * pPublishInfo,
-                                            uint8_t * pMqttHeader,
-                                            size_t headerSize,
-                                            uint16_t packetId )
+static size_t addPublishVectors( const MQTTPublishInfo_t * pPublishInfo,
+                                 uint8_t * pMqttHeader,
+                                 size_t headerSize,
+                                 uint8_t * pSerializedPacketId,
+                                 uint16_t packetId,
+                                 const TransportOutVector_t * pPropertyVectors,
+                                 size_t propertyVectorCount,
+                                 TransportOutVector_t * pIoVector,
+                                 size_t * pTotalMessageLength )
 {
-    MQTTStatus_t status = MQTTSuccess;
     size_t ioVectorLength;
     size_t totalMessageLength;
-    bool dupFlagChanged = false;
-
-    /* Bytes required to encode the packet ID in an MQTT header according to
-     * the MQTT specification. */
-    uint8_t serializedPacketID[ 2U ];
-
-    /* Maximum number of vectors required to encode and send a publish
-     * packet. The breakdown is shown below.
-     * Fixed header (including topic string length)      0 + 1 = 1
-     * Topic string                                        + 1 = 2
-     * Packet ID (only when QoS > QoS0)                    + 1 = 3
-     * Payload                                             + 1 = 4  */
-    TransportOutVector_t pIoVector[ 4U ];
+    size_t serializedSize = 0U;
+    size_t i;
 
     /* The header is sent first. */
     pIoVector[ 0U ].iov_base = pMqttHeader;
     pIoVector[ 0U ].iov_len = headerSize;
     totalMessageLength = headerSize;
+    ioVectorLength = 1U;
 
-    /* Then the topic name has to be sent. */
-    pIoVector[ 1U ].iov_base = pPublishInfo->pTopicName;
-    pIoVector[ 1U ].iov_len = pPublishInfo->topicNameLength;
-    totalMessageLength += pPublishInfo->topicNameLength;
-
-    /* The next field's index should be 2 as the first two fields
-     * have been filled in. */
-    ioVectorLength = 2U;
+    /* Then the topic name has to be sent, unless a topic alias replaces it. */
+    if( pPublishInfo->topicNameLength > 0U )
+    {
+        pIoVector[ 1U ].iov_base = pPublishInfo->pTopicName;
+        pIoVector[ 1U ].iov_len = pPublishInfo->topicNameLength;
+        totalMessageLength += pPublishInfo->topicNameLength;
+        ioVectorLength++;
+    }
 
     if( pPublishInfo->qos > MQTTQoS0 )
     {
         /* Encode the packet ID. */
-        serializedPacketID[ 0 ] = ( ( uint8_t ) ( ( packetId ) >> 8 ) );
-        serializedPacketID[ 1 ] = ( ( uint8_t ) ( ( packetId ) & 0x00ffU ) );
+        pSerializedPacketId[ 0 ] = ( ( uint8_t ) ( ( packetId ) >> 8 ) );
+        pSerializedPacketId[ 1 ] = ( ( uint8_t ) ( ( packetId ) & 0x00ffU ) );
+        serializedSize = 2U;
+    }
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    /* Properties given in pProperties are in pPropertyVectors. */
+    if( pPublishInfo->pProperties != NULL )
+    {
+        /* MISRA Empty body */
+    }
+    else if( pPublishInfo->topicAlias != 0U )
+    {
+        /* A property block holding only the Topic Alias. */
+        pSerializedPacketId[ serializedSize ] = 3U;
+        pSerializedPacketId[ serializedSize + 1U ] = ( uint8_t ) MQTT5_PROPERTY_TOPIC_ALIAS;
+        pSerializedPacketId[ serializedSize + 2U ] = ( ( uint8_t ) ( ( pPublishInfo->topicAlias ) >> 8 ) );
+        pSerializedPacketId[ serializedSize + 3U ] = ( ( uint8_t ) ( ( pPublishInfo->topicAlias ) & 0x00ffU ) );
+        serializedSize += 4U;
+    }
+    else
+    {
+        /* An empty property block. */
+        pSerializedPacketId[ serializedSize ] = 0U;
+        serializedSize++;
+    }
+#endif
 
-        pIoVector[ ioVectorLength ].iov_base = serializedPacketID;
-        pIoVector[ ioVectorLength ].iov_len = sizeof( serializedPacketID );
+    if( serializedSize > 0U )
+    {
+        pIoVector[ ioVectorLength ].iov_base = pSerializedPacketId;
+        pIoVector[ ioVectorLength ].iov_len = serializedSize;
+
+        ioVectorLength++;
+        totalMessageLength += serializedSize;
+    }
+
+    for( i = 0U; i < propertyVectorCount; i++ )
+    {
+        pIoVector[ ioVectorLength ] = pPropertyVectors[ i ];
 
         ioVectorLength++;
-        totalMessageLength += sizeof( serializedPacketID );
+        totalMessageLength += pPropertyVectors[ i ].iov_len;
     }
 
     /* Publish packets are allowed to contain no payload. */
@@ -2235,6 +3298,23 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
         totalMessageLength += pPublishInfo->payloadLength;
     }
 
+    *pTotalMessageLength += totalMessageLength;
+
+    return ioVectorLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t storePublishForRetransmit( MQTTContext_t * pContext,
+                                               const MQTTPublishInfo_t * pPublishInfo,
+                                               uint8_t * pMqttHeader,
+                                               uint16_t packetId,
+                                               TransportOutVector_t * pIoVector,
+                                               size_t ioVectorLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    bool dupFlagChanged = false;
+
     /* store a copy of the publish for retransmission purposes */
     if( ( pPublishInfo->qos > MQTTQoS0 ) &&
         ( pContext->storeFunction != NULL ) )
@@ -2256,6 +3336,7 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
 
             mqttVec.pVector = pIoVector;
             mqttVec.vectorLen = ioVectorLength;
+            mqttVec.pPublishInfo = pPublishInfo;
 
             if( pContext->storeFunction( pContext, packetId, &mqttVec ) != true )
             {
@@ -2270,6 +3351,55 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
         }
     }
 
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
+                                            const MQTTPublishInfo_t * pPublishInfo,
+                                            uint8_t * pMqttHeader,
+                                            size_t headerSize,
+                                            uint16_t packetId,
+                                            const TransportOutVector_t * pPropertyVectors,
+                                            size_t propertyVectorCount )
+{
+    MQTTStatus_t status;
+    size_t ioVectorLength;
+    size_t totalMessageLength = 0U;
+
+    /* Bytes required to encode the packet ID, and with MQTT 5 the property
+     * block, in an MQTT header according to the MQTT specification. */
+    uint8_t serializedPacketID[ MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE ];
+
+    /* Maximum number of vectors required to encode and send a publish
+     * packet. The breakdown is shown below.
+     * Fixed header (including topic string length)      0 + 1 = 1
+     * Topic string (unless replaced by a topic alias)     + 1 = 2
+     * Packet ID and properties                            + 1 = 3
+     * Properties given in pProperties (MQTT 5)            + P
+     * Payload                                             + 1 = 4 + P */
+    TransportOutVector_t pIoVector[ 4U + CORE_MQTT_PROPERTY_VECTORS ];
+
+    assert( propertyVectorCount <= CORE_MQTT_PROPERTY_VECTORS );
+
+    ioVectorLength = addPublishVectors( pPublishInfo,
+                                        pMqttHeader,
+                                        headerSize,
+                                        serializedPacketID,
+                                        packetId,
+                                        pPropertyVectors,
+                                        propertyVectorCount,
+                                        pIoVector,
+                                        &totalMessageLength );
+
+    status = storePublishForRetransmit( pContext,
+                                        pPublishInfo,
+                                        pMqttHeader,
+                                        packetId,
+                                        pIoVector,
+                                        ioVectorLength );
+
     if( ( status == MQTTSuccess ) &&
         ( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength ) )
     {
@@ -2281,97 +3411,422 @@ static MQTTStatus_t sendPublishWithoutCopy( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
-                                            const MQTTConnectInfo_t * pConnectInfo,
-                                            const MQTTPublishInfo_t * pWillInfo,
-                                            size_t remainingLength )
+static uint16_t nextPacketId( MQTTContext_t * pContext )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    TransportOutVector_t * iterator;
-    size_t ioVectorLength = 0U;
-    size_t totalMessageLength = 0U;
-    int32_t bytesSentOrError;
-    uint8_t * pIndex;
-    uint8_t serializedClientIDLength[ 2 ];
-    uint8_t serializedTopicLength[ 2 ];
-    uint8_t serializedPayloadLength[ 2 ];
-    uint8_t serializedUsernameLength[ 2 ];
-    uint8_t serializedPasswordLength[ 2 ];
-    size_t vectorsAdded;
-
-    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Protocol Name Length     + 2 = 7
-     * Protocol Name (MQTT)     + 4 = 11
-     * Protocol level           + 1 = 12
-     * Connect flags            + 1 = 13
-     * Keep alive               + 2 = 15 */
-    uint8_t connectPacketHeader[ 15U ];
-
-    /* The maximum vectors required to encode and send a connect packet. The
-     * breakdown is shown below.
-     * Fixed header      0 + 1 = 1
-     * Client ID           + 2 = 3
-     * Will topic          + 2 = 5
-     * Will payload        + 2 = 7
-     * Username            + 2 = 9
-     * Password            + 2 = 11 */
-    TransportOutVector_t pIoVector[ 11U ];
-
-    iterator = pIoVector;
-    pIndex = connectPacketHeader;
+    uint16_t packetId = pContext->nextPacketId;
 
-    /* Validate arguments. */
-    if( ( pWillInfo != NULL ) && ( pWillInfo->pTopicName == NULL ) )
+    /* A packet ID of zero is not a valid packet ID. When the max ID
+     * is reached the next one should start at 1. */
+    if( pContext->nextPacketId == ( uint16_t ) UINT16_MAX )
     {
-        LogError( ( "pWillInfo->pTopicName cannot be NULL if Will is present." ) );
-        status = MQTTBadParameter;
+        pContext->nextPacketId = 1;
     }
     else
     {
-        pIndex = MQTT_SerializeConnectFixedHeader( pIndex,
-                                                   pConnectInfo,
-                                                   pWillInfo,
-                                                   remainingLength );
+        pContext->nextPacketId++;
+    }
 
-        assert( ( ( size_t ) ( pIndex - connectPacketHeader ) ) <= sizeof( connectPacketHeader ) );
+    return packetId;
+}
 
-        /* The header gets sent first. */
-        iterator->iov_base = connectPacketHeader;
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-        /* coverity[misra_c_2012_rule_18_2_violation] */
-        /* coverity[misra_c_2012_rule_10_8_violation] */
-        iterator->iov_len = ( size_t ) ( pIndex - connectPacketHeader );
-        totalMessageLength += iterator->iov_len;
-        iterator++;
-        ioVectorLength++;
+/*-----------------------------------------------------------*/
 
-        /* Serialize the client ID. */
-        vectorsAdded = addEncodedStringToVector( serializedClientIDLength,
-                                                 pConnectInfo->pClientIdentifier,
-                                                 pConnectInfo->clientIdentifierLength,
-                                                 iterator,
-                                                 &totalMessageLength );
+static MQTTStatus_t addPublishToBatch( MQTTContext_t * pContext,
+                                       const MQTTPublishInfo_t * pPublishInfo,
+                                       uint8_t * pMqttHeader,
+                                       size_t headerSize,
+                                       uint8_t * pSerializedPacketId,
+                                       uint16_t * pPacketId,
+                                       TransportOutVector_t * pIoVector,
+                                       size_t * pTotalMessageLength,
+                                       size_t * pVectorCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t packetLength = 0U;
+    size_t vectorCount;
+    TransportOutVector_t propertyVector;
+    size_t propertyVectorCount = 0U;
+    bool recordReserved = false;
 
-        /* Update the iterator to point to the next empty slot. */
-        iterator = &iterator[ vectorsAdded ];
-        ioVectorLength += vectorsAdded;
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    /* Frozen properties take one vector, and need no scratch space. */
+    if( pPublishInfo->pProperties != NULL )
+    {
+        status = addPropertyVectors( pPublishInfo->pProperties,
+                                     NULL,
+                                     &propertyVector,
+                                     &propertyVectorCount );
+    }
+#endif
 
-        if( pWillInfo != NULL )
+    if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+    {
+        if( pContext->outgoingPublishRecords == NULL )
         {
-            /* Serialize the topic. */
-            vectorsAdded = addEncodedStringToVector( serializedTopicLength,
-                                                     pWillInfo->pTopicName,
-                                                     pWillInfo->topicNameLength,
-                                                     iterator,
-                                                     &totalMessageLength );
-
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[ vectorsAdded ];
-            ioVectorLength += vectorsAdded;
+            LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
+                        "for QoS1/QoS2 have not been enabled." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            /* The assigned packet ID is kept by the caller, so that a publish
+             * left for lack of records keeps it on the next attempt. */
+            if( *pPacketId == 0U )
+            {
+                *pPacketId = nextPacketId( pContext );
+            }
+
+            status = MQTT_ReserveState( pContext,
+                                        *pPacketId,
+                                        pPublishInfo->qos );
+
+            recordReserved = ( status == MQTTSuccess );
+
+            if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+            {
+                status = MQTTSuccess;
+            }
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        vectorCount = addPublishVectors( pPublishInfo,
+                                         pMqttHeader,
+                                         headerSize,
+                                         pSerializedPacketId,
+                                         *pPacketId,
+                                         &propertyVector,
+                                         propertyVectorCount,
+                                         pIoVector,
+                                         &packetLength );
+
+        status = storePublishForRetransmit( pContext,
+                                            pPublishInfo,
+                                            pMqttHeader,
+                                            *pPacketId,
+                                            pIoVector,
+                                            vectorCount );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        *pTotalMessageLength += packetLength;
+        *pVectorCount = vectorCount;
+    }
+    else if( recordReserved == true )
+    {
+        /* The publish is not sent, so it must not hold a record. */
+        ( void ) MQTT_RemoveStateRecord( pContext, *pPacketId );
+    }
+    else
+    {
+        /* MISRA Empty body */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 )
+
+static MQTTStatus_t sendQueuedPublishes( MQTTContext_t * pContext,
+                                         TransportOutVector_t * pIoVector,
+                                         size_t ioVectorLength,
+                                         size_t totalMessageLength,
+                                         MQTTPublishQueue_t * pFirstQueue,
+                                         const MQTTPublishQueue_t * pLastQueue )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t updateStatus;
+    MQTTPublishQueue_t * pQueue = pFirstQueue;
+    const MQTTPublishQueueEntry_t * pEntry;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    size_t entryIndex;
+    bool lastQueue = false;
+
+    if( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength )
+    {
+        status = MQTTSendFailed;
+    }
+
+    while( ( pQueue != NULL ) && ( lastQueue == false ) )
+    {
+        for( entryIndex = pQueue->tail; entryIndex != pQueue->drainIndex; entryIndex++ )
+        {
+            pEntry = &( pQueue->pEntries[ entryIndex & ( pQueue->entryCount - 1U ) ] );
+
+            if( pEntry->publishInfo.qos == MQTTQoS0 )
+            {
+                /* QoS 0 publishes have no state. */
+            }
+            else if( status == MQTTSendFailed )
+            {
+                /* The publish is dropped along with its queue entry, so its
+                 * record would never be completed. */
+                ( void ) MQTT_RemoveStateRecord( pContext, pEntry->packetId );
+
+                if( pContext->clearFunction != NULL )
+                {
+                    pContext->clearFunction( pContext, pEntry->packetId );
+                }
+            }
+            else
+            {
+                /* Update state machine after PUBLISH is sent.
+                 * Only to be done for QoS1 or QoS2. */
+                updateStatus = MQTT_UpdateStatePublish( pContext,
+                                                        pEntry->packetId,
+                                                        MQTT_SEND,
+                                                        pEntry->publishInfo.qos,
+                                                        &publishStatus );
+
+                if( updateStatus != MQTTSuccess )
+                {
+                    LogError( ( "Update state for queued publish %hu failed with status %s.",
+                                ( unsigned short ) pEntry->packetId,
+                                MQTT_Status_strerror( updateStatus ) ) );
+                    status = updateStatus;
+                }
+            }
+        }
+
+        /* The entries are not read after this point, so the producer may reuse
+         * them once the new tail is visible. */
+        MQTT_PUBLISH_QUEUE_BARRIER();
+        pQueue->tail = pQueue->drainIndex;
+
+        lastQueue = ( pQueue == pLastQueue );
+        pQueue = pQueue->pNext;
+    }
+
+    return status;
+}
+
+#endif /* if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 ) */
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishBatch( MQTTContext_t * pContext,
+                                      TransportOutVector_t * pIoVector,
+                                      size_t ioVectorLength,
+                                      size_t totalMessageLength,
+                                      const MQTTPublishInfo_t * pPublishInfo,
+                                      const uint16_t * pPacketIds,
+                                      size_t publishCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t updateStatus;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    size_t publishIndex;
+
+    if( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength )
+    {
+        status = MQTTSendFailed;
+    }
+
+    for( publishIndex = 0U; publishIndex < publishCount; publishIndex++ )
+    {
+        if( pPublishInfo[ publishIndex ].qos == MQTTQoS0 )
+        {
+            /* QoS 0 publishes have no state. */
+        }
+        else if( status == MQTTSendFailed )
+        {
+            /* The publish was not sent, so it must not hold a record. */
+            ( void ) MQTT_RemoveStateRecord( pContext, pPacketIds[ publishIndex ] );
+
+            if( pContext->clearFunction != NULL )
+            {
+                pContext->clearFunction( pContext, pPacketIds[ publishIndex ] );
+            }
+        }
+        else
+        {
+            /* Update state machine after PUBLISH is sent.
+             * Only to be done for QoS1 or QoS2. */
+            updateStatus = MQTT_UpdateStatePublish( pContext,
+                                                    pPacketIds[ publishIndex ],
+                                                    MQTT_SEND,
+                                                    pPublishInfo[ publishIndex ].qos,
+                                                    &publishStatus );
+
+            if( updateStatus != MQTTSuccess )
+            {
+                LogError( ( "Update state for publish %hu failed with status %s.",
+                            ( unsigned short ) pPacketIds[ publishIndex ],
+                            MQTT_Status_strerror( updateStatus ) ) );
+                status = updateStatus;
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
+                                            const MQTTConnectInfo_t * pConnectInfo,
+                                            const MQTTPublishInfo_t * pWillInfo,
+                                            size_t remainingLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    TransportOutVector_t * iterator;
+    size_t ioVectorLength = 0U;
+    size_t totalMessageLength = 0U;
+    int32_t bytesSentOrError;
+    uint8_t * pIndex;
+    uint8_t serializedClientIDLength[ 2 ];
+    uint8_t serializedTopicLength[ 2 ];
+    uint8_t serializedPayloadLength[ 2 ];
+    uint8_t serializedUsernameLength[ 2 ];
+    uint8_t serializedPasswordLength[ 2 ];
+    size_t vectorsAdded;
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    uint8_t connectPropertyScratch[ MQTT5_PROPERTY_SCRATCH_SIZE ];
+    uint8_t willPropertyScratch[ MQTT5_PROPERTY_SCRATCH_SIZE ];
+    const uint8_t emptyProperties = 0U;
+    size_t i;
+#endif
+
+    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Protocol Name Length     + 2 = 7
+     * Protocol Name (MQTT)     + 4 = 11
+     * Protocol level           + 1 = 12
+     * Connect flags            + 1 = 13
+     * Keep alive               + 2 = 15
+     * No properties (MQTT 5)   + 1 = 16 */
+    uint8_t connectPacketHeader[ 16U ];
+
+    /* The maximum vectors required to encode and send a connect packet. The
+     * breakdown is shown below.
+     * Fixed header      0 + 1 = 1
+     * Properties (MQTT 5) + P
+     * Client ID           + 2 = 3 + P
+     * Will properties     + P
+     * Will topic          + 2 = 5 + 2P
+     * Will payload        + 2 = 7 + 2P
+     * Username            + 2 = 9 + 2P
+     * Password            + 2 = 11 + 2P */
+    TransportOutVector_t pIoVector[ 11U + ( 2U * CORE_MQTT_PROPERTY_VECTORS ) ];
+
+    iterator = pIoVector;
+    pIndex = connectPacketHeader;
+
+    /* Validate arguments. */
+    if( ( pWillInfo != NULL ) && ( pWillInfo->pTopicName == NULL ) )
+    {
+        LogError( ( "pWillInfo->pTopicName cannot be NULL if Will is present." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pIndex = MQTT_SerializeConnectFixedHeader( pIndex,
+                                                   pConnectInfo,
+                                                   pWillInfo,
+                                                   remainingLength );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        /* An empty property block ends the header. */
+        if( pConnectInfo->pProperties == NULL )
+        {
+            *pIndex = emptyProperties;
+            pIndex++;
+        }
+#endif
+
+        assert( ( ( size_t ) ( pIndex - connectPacketHeader ) ) <= sizeof( connectPacketHeader ) );
+
+        /* The header gets sent first. */
+        iterator->iov_base = connectPacketHeader;
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+        /* coverity[misra_c_2012_rule_18_2_violation] */
+        /* coverity[misra_c_2012_rule_10_8_violation] */
+        iterator->iov_len = ( size_t ) ( pIndex - connectPacketHeader );
+        totalMessageLength += iterator->iov_len;
+        iterator++;
+        ioVectorLength++;
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        /* The properties are sent from application memory. */
+        if( pConnectInfo->pProperties != NULL )
+        {
+            status = addPropertyVectors( pConnectInfo->pProperties,
+                                         connectPropertyScratch,
+                                         iterator,
+                                         &vectorsAdded );
+
+            for( i = 0U; ( status == MQTTSuccess ) && ( i < vectorsAdded ); i++ )
+            {
+                totalMessageLength += iterator[ i ].iov_len;
+            }
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
+        }
+#endif
+
+        /* Serialize the client ID. */
+        vectorsAdded = addEncodedStringToVector( serializedClientIDLength,
+                                                 pConnectInfo->pClientIdentifier,
+                                                 pConnectInfo->clientIdentifierLength,
+                                                 iterator,
+                                                 &totalMessageLength );
+
+        /* Update the iterator to point to the next empty slot. */
+        iterator = &iterator[ vectorsAdded ];
+        ioVectorLength += vectorsAdded;
+
+        if( pWillInfo != NULL )
+        {
+#if MQTT_VERSION == MQTT_VERSION_5_0
+            /* The will properties come before the will topic. */
+            if( pWillInfo->pProperties == NULL )
+            {
+                iterator->iov_base = &emptyProperties;
+                iterator->iov_len = 1U;
+                vectorsAdded = 1U;
+            }
+            else if( status == MQTTSuccess )
+            {
+                status = addPropertyVectors( pWillInfo->pProperties,
+                                             willPropertyScratch,
+                                             iterator,
+                                             &vectorsAdded );
+            }
+            else
+            {
+                vectorsAdded = 0U;
+            }
+
+            for( i = 0U; ( status == MQTTSuccess ) && ( i < vectorsAdded ); i++ )
+            {
+                totalMessageLength += iterator[ i ].iov_len;
+            }
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
+#endif
+
+            /* Serialize the topic. */
+            vectorsAdded = addEncodedStringToVector( serializedTopicLength,
+                                                     pWillInfo->pTopicName,
+                                                     pWillInfo->topicNameLength,
+                                                     iterator,
+                                                     &totalMessageLength );
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[ vectorsAdded ];
+            ioVectorLength += vectorsAdded;
 
 
             /* Serialize the payload. Payload of last will and testament can be NULL. */
@@ -2414,11 +3869,14 @@ static MQTTStatus_t sendConnectWithoutCopy( MQTTContext_t * pContext,
             ioVectorLength += vectorsAdded;
         }
 
-        bytesSentOrError = sendMessageVector( pContext, pIoVector, ioVectorLength );
-
-        if( bytesSentOrError != ( int32_t ) totalMessageLength )
+        if( status == MQTTSuccess )
         {
-            status = MQTTSendFailed;
+            bytesSentOrError = sendMessageVector( pContext, pIoVector, ioVectorLength );
+
+            if( bytesSentOrError != ( int32_t ) totalMessageLength )
+            {
+                status = MQTTSendFailed;
+            }
         }
     }
 
@@ -2528,6 +3986,23 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
                                       );
     }
 
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( status == MQTTSuccess )
+    {
+        status = setReceiveMaximum( pContext, pIncomingPacket );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pContext->pTopicAliases != NULL ) )
+    {
+        status = resetTopicAliases( pContext->pTopicAliases, pIncomingPacket );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pContext->pIncomingTopicAliases != NULL ) )
+    {
+        clearIncomingTopicAliases( pContext->pIncomingTopicAliases );
+    }
+#endif
+
     /* If a clean session is requested, a session present should not be set by
      * broker. */
     if( status == MQTTSuccess )
@@ -2555,209 +4030,275 @@ static MQTTStatus_t receiveConnack( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext )
-{
-    MQTTStatus_t status = MQTTSuccess;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetId = MQTT_PACKET_ID_INVALID;
-    MQTTPublishState_t state = MQTTStateNull;
-    size_t totalMessageLength = 0;
-    uint8_t * pMqttPacket = NULL;
+#if MQTT_VERSION == MQTT_VERSION_5_0
 
-    assert( pContext != NULL );
+static MQTTStatus_t setReceiveMaximum( MQTTContext_t * pContext,
+                                       const MQTTPacketInfo_t * pConnack )
+{
+    MQTTStatus_t status = MQTTNoDataAvailable;
+    MQTT5Property_t property;
 
-    /* Get the next packet ID for which a PUBREL need to be resent. */
-    packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+    /* The properties follow the flags and the reason code. */
+    if( pConnack->remainingLength > 2U )
+    {
+        status = MQTT5_FindProperty( &pConnack->pRemainingData[ 2 ],
+                                     pConnack->remainingLength - 2U,
+                                     MQTT5_PROPERTY_RECEIVE_MAXIMUM,
+                                     &property );
+    }
 
-    /* Resend all the PUBREL acks after session is reestablished. */
-    while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
-           ( status == MQTTSuccess ) )
+    if( status == MQTTNoDataAvailable )
     {
-        status = sendPublishAcks( pContext, packetId, state );
-
-        packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+        /* The Receive Maximum defaults to 65,535 when absent. */
+        pContext->receiveMaximum = UINT16_MAX;
+        status = MQTTSuccess;
     }
-
-    if( ( status == MQTTSuccess ) &&
-        ( pContext->retrieveFunction != NULL ) )
+    else if( status != MQTTSuccess )
     {
-        cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        LogError( ( "CONNACK properties are malformed." ) );
+        status = MQTTBadResponse;
+    }
+    else if( property.value.twoByteInteger == 0U )
+    {
+        LogError( ( "CONNACK Receive Maximum of 0 is a protocol error." ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        pContext->receiveMaximum = property.value.twoByteInteger;
+        LogDebug( ( "Send window sized to the Receive Maximum of %hu.",
+                    ( unsigned short ) pContext->receiveMaximum ) );
+    }
 
-        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
-         * after session is reestablished. */
-        do
-        {
-            packetId = MQTT_PublishToResend( pContext, &cursor );
+    return status;
+}
 
-            if( packetId != MQTT_PACKET_ID_INVALID )
-            {
-                if( pContext->retrieveFunction( pContext, packetId, &pMqttPacket, &totalMessageLength ) != true )
-                {
-                    status = MQTTPublishRetrieveFailed;
-                    break;
-                }
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t resetTopicAliases( MQTTTopicAliases_t * pAliases,
+                                       const MQTTPacketInfo_t * pConnack )
+{
+    MQTTStatus_t status = MQTTNoDataAvailable;
+    MQTT5Property_t property;
+    uint16_t i;
 
-                MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+    /* Aliases only last for the connection on which they were sent. */
+    for( i = 0U; i < pAliases->aliasCount; i++ )
+    {
+        pAliases->pAliases[ i ].topicNameLength = 0U;
+        pAliases->pAliases[ i ].lastUsed = 0U;
+    }
 
-                if( sendBuffer( pContext, pMqttPacket, totalMessageLength ) != ( int32_t ) totalMessageLength )
-                {
-                    status = MQTTSendFailed;
-                }
+    pAliases->aliasMaximum = 0U;
+    pAliases->useCount = 0U;
 
-                MQTT_POST_STATE_UPDATE_HOOK( pContext );
-            }
-        } while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
-                 ( status == MQTTSuccess ) );
+    if( pConnack->remainingLength > 2U )
+    {
+        status = MQTT5_FindProperty( &pConnack->pRemainingData[ 2 ],
+                                     pConnack->remainingLength - 2U,
+                                     MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM,
+                                     &property );
+    }
+
+    if( status == MQTTNoDataAvailable )
+    {
+        /* Without a Topic Alias Maximum, the broker accepts no alias. */
+        status = MQTTSuccess;
+    }
+    else if( status != MQTTSuccess )
+    {
+        LogError( ( "CONNACK properties are malformed." ) );
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        pAliases->aliasMaximum = ( property.value.twoByteInteger < pAliases->aliasCount ) ?
+                                 property.value.twoByteInteger : pAliases->aliasCount;
+        LogDebug( ( "Using %hu outgoing topic aliases.",
+                    ( unsigned short ) pAliases->aliasMaximum ) );
     }
 
     return status;
 }
 
-static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext )
+/*-----------------------------------------------------------*/
+
+static bool topicAliasAllowed( const MQTTContext_t * pContext,
+                               const MQTTPublishInfo_t * pPublishInfo )
 {
-    MQTTStatus_t status = MQTTSuccess;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    /* A stored publish may be resent on a later connection, on which the
+     * broker no longer maps its alias. */
+    bool stored = ( pPublishInfo->qos > MQTTQoS0 ) &&
+                  ( pContext->storeFunction != NULL );
+
+    return ( pContext->pTopicAliases != NULL ) &&
+           ( pPublishInfo->topicNameLength <= pContext->pTopicAliases->topicNameMaxLength ) &&
+           ( pPublishInfo->pProperties == NULL ) &&
+           ( pPublishInfo->topicAlias == 0U ) &&
+           ( stored == false );
+}
 
-    assert( pContext != NULL );
+/*-----------------------------------------------------------*/
 
-    /* Reset the index and clear the buffer when a new session is established. */
-    pContext->index = 0;
-    ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
+static void chooseTopicAlias( const MQTTTopicAliases_t * pAliases,
+                              MQTTPublishInfo_t * pPublishInfo )
+{
+    const MQTTTopicAlias_t * pAlias;
+    const uint8_t * pTopicName;
+    uint32_t age;
+    uint32_t oldestAge = 0U;
+    uint16_t i;
+    uint16_t mapped = 0U;
+    uint16_t unused = 0U;
+    uint16_t oldest = 0U;
 
-    if( pContext->clearFunction != NULL )
+    for( i = 0U; ( i < pAliases->aliasMaximum ) && ( mapped == 0U ); i++ )
     {
-        cursor = MQTT_STATE_CURSOR_INITIALIZER;
+        pAlias = &( pAliases->pAliases[ i ] );
+        pTopicName = &( pAliases->pArena[ ( size_t ) i * pAliases->topicNameMaxLength ] );
 
-        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
-         * after session is reestablished. */
-        do
+        if( pAlias->topicNameLength == 0U )
         {
-            packetId = MQTT_PublishToResend( pContext, &cursor );
+            if( unused == 0U )
+            {
+                unused = i + 1U;
+            }
+        }
+        else if( ( pAlias->topicNameLength == pPublishInfo->topicNameLength ) &&
+                 ( memcmp( pTopicName, pPublishInfo->pTopicName,
+                           pPublishInfo->topicNameLength ) == 0 ) )
+        {
+            mapped = i + 1U;
+        }
+        else
+        {
+            /* The difference of use counts stays right after they wrap. */
+            age = pAliases->useCount - pAlias->lastUsed;
 
-            if( packetId != MQTT_PACKET_ID_INVALID )
+            if( ( oldest == 0U ) || ( age > oldestAge ) )
             {
-                pContext->clearFunction( pContext, packetId );
+                oldest = i + 1U;
+                oldestAge = age;
             }
-        } while( packetId != MQTT_PACKET_ID_INVALID );
+        }
     }
 
-    if( pContext->outgoingPublishRecordMaxCount > 0U )
+    if( mapped != 0U )
     {
-        /* Clear any existing records if a new session is established. */
-        ( void ) memset( pContext->outgoingPublishRecords,
-                         0x00,
-                         pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+        /* The broker already knows the topic by its alias. */
+        pPublishInfo->topicAlias = mapped;
+        pPublishInfo->pTopicName = NULL;
+        pPublishInfo->topicNameLength = 0U;
     }
-
-    if( pContext->incomingPublishRecordMaxCount > 0U )
+    else
     {
-        ( void ) memset( pContext->incomingPublishRecords,
-                         0x00,
-                         pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+        /* An unused alias is taken before any mapped one. */
+        pPublishInfo->topicAlias = ( unused != 0U ) ? unused : oldest;
     }
+}
 
-    return status;
+/*-----------------------------------------------------------*/
+
+static void recordTopicAlias( MQTTTopicAliases_t * pAliases,
+                              const MQTTPublishInfo_t * pPublishInfo,
+                              uint16_t topicAlias )
+{
+    MQTTTopicAlias_t * pAlias = &( pAliases->pAliases[ topicAlias - 1U ] );
+
+    pAliases->useCount++;
+
+    /* The caller may reuse the topic name buffer for another topic. */
+    ( void ) memcpy( ( void * ) &( pAliases->pArena[ ( ( size_t ) topicAlias - 1U ) * pAliases->topicNameMaxLength ] ),
+                     ( const void * ) pPublishInfo->pTopicName,
+                     pPublishInfo->topicNameLength );
+    pAlias->topicNameLength = pPublishInfo->topicNameLength;
+    pAlias->lastUsed = pAliases->useCount;
 }
 
-static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
-                                           const MQTTPublishInfo_t * pPublishInfo,
-                                           uint16_t packetId )
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t validateIncomingTopicAliases( const MQTTContext_t * pContext,
+                                                  const MQTTConnectInfo_t * pConnectInfo )
 {
     MQTTStatus_t status = MQTTSuccess;
-
-    /* Validate arguments. */
-    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pPublishInfo=%p.",
-                    ( void * ) pContext,
-                    ( void * ) pPublishInfo ) );
-        status = MQTTBadParameter;
-    }
-    else if( ( pPublishInfo->qos != MQTTQoS0 ) && ( packetId == 0U ) )
-    {
-        LogError( ( "Packet Id is 0 for PUBLISH with QoS=%u.",
-                    ( unsigned int ) pPublishInfo->qos ) );
-        status = MQTTBadParameter;
-    }
-    else if( ( pPublishInfo->payloadLength > 0U ) && ( pPublishInfo->pPayload == NULL ) )
-    {
-        LogError( ( "A nonzero payload length requires a non-NULL payload: "
-                    "payloadLength=%lu, pPayload=%p.",
-                    ( unsigned long ) pPublishInfo->payloadLength,
-                    pPublishInfo->pPayload ) );
+    MQTT5Property_t property;
+
+    if( ( pContext->pIncomingTopicAliases != NULL ) &&
+        ( pConnectInfo->pProperties != NULL ) &&
+        ( MQTT5_GetProperty( pConnectInfo->pProperties,
+                             MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM,
+                             &property ) == MQTTSuccess ) &&
+        ( property.value.twoByteInteger > pContext->pIncomingTopicAliases->aliasCount ) )
+    {
+        LogError( ( "Topic Alias Maximum of %hu exceeds the %hu incoming topic aliases.",
+                    ( unsigned short ) property.value.twoByteInteger,
+                    ( unsigned short ) pContext->pIncomingTopicAliases->aliasCount ) );
         status = MQTTBadParameter;
     }
-    else if( ( pContext->outgoingPublishRecords == NULL ) && ( pPublishInfo->qos > MQTTQoS0 ) )
-    {
-        LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
-                    "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
-                    "to initialize and enable the use of QoS1/QoS2 publishes." ) );
-        status = MQTTBadParameter;
-    }
-    else
-    {
-        /* MISRA else */
-    }
 
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
-                        const TransportInterface_t * pTransportInterface,
-                        MQTTGetCurrentTimeFunc_t getTimeFunction,
-                        MQTTEventCallback_t userCallback,
-                        const MQTTFixedBuffer_t * pNetworkBuffer )
+static MQTTStatus_t resolveTopicAlias( const MQTTIncomingTopicAliases_t * pAliases,
+                                       MQTTPublishInfo_t * pPublishInfo )
 {
     MQTTStatus_t status = MQTTSuccess;
+    uint8_t * pEntry;
+    uint16_t topicNameLength;
 
-    /* Validate arguments. */
-    if( ( pContext == NULL ) || ( pTransportInterface == NULL ) ||
-        ( pNetworkBuffer == NULL ) )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pTransportInterface=%p, "
-                    "pNetworkBuffer=%p",
-                    ( void * ) pContext,
-                    ( void * ) pTransportInterface,
-                    ( void * ) pNetworkBuffer ) );
-        status = MQTTBadParameter;
-    }
-    else if( getTimeFunction == NULL )
-    {
-        LogError( ( "Invalid parameter: getTimeFunction is NULL" ) );
-        status = MQTTBadParameter;
-    }
-    else if( userCallback == NULL )
-    {
-        LogError( ( "Invalid parameter: userCallback is NULL" ) );
-        status = MQTTBadParameter;
-    }
-    else if( pTransportInterface->recv == NULL )
+    if( pPublishInfo->topicAlias == 0U )
     {
-        LogError( ( "Invalid parameter: pTransportInterface->recv is NULL" ) );
-        status = MQTTBadParameter;
+        /* MISRA Empty body */
     }
-    else if( pTransportInterface->send == NULL )
+    else if( pPublishInfo->topicAlias > pAliases->aliasCount )
     {
-        LogError( ( "Invalid parameter: pTransportInterface->send is NULL" ) );
-        status = MQTTBadParameter;
+        LogError( ( "Topic Alias %hu exceeds the Topic Alias Maximum of %hu.",
+                    ( unsigned short ) pPublishInfo->topicAlias,
+                    ( unsigned short ) pAliases->aliasCount ) );
+        status = MQTTBadResponse;
     }
     else
     {
-        ( void ) memset( pContext, 0x00, sizeof( MQTTContext_t ) );
+        pEntry = &( pAliases->pArena[ ( ( size_t ) pPublishInfo->topicAlias - 1U ) *
+                                      ( ( size_t ) pAliases->topicNameMaxLength + 2U ) ] );
 
-        pContext->connectStatus = MQTTNotConnected;
-        pContext->transportInterface = *pTransportInterface;
-        pContext->getTime = getTimeFunction;
-        pContext->appCallback = userCallback;
-        pContext->networkBuffer = *pNetworkBuffer;
+        if( pPublishInfo->topicNameLength == 0U )
+        {
+            topicNameLength = ( uint16_t ) ( ( ( uint16_t ) pEntry[ 0 ] << 8 ) | pEntry[ 1 ] );
 
-        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
-        pContext->nextPacketId = 1;
+            if( topicNameLength == 0U )
+            {
+                LogError( ( "Topic Alias %hu is not mapped to a topic name.",
+                            ( unsigned short ) pPublishInfo->topicAlias ) );
+                status = MQTTBadResponse;
+            }
+            else
+            {
+                /* The topic name is given from the arena, not copied. */
+                pPublishInfo->pTopicName = ( const char * ) &pEntry[ 2 ];
+                pPublishInfo->topicNameLength = topicNameLength;
+            }
+        }
+        else if( pPublishInfo->topicNameLength <= pAliases->topicNameMaxLength )
+        {
+            /* The network buffer is reused by later packets, so the topic
+             * name is kept in the arena. */
+            pEntry[ 0 ] = ( uint8_t ) ( pPublishInfo->topicNameLength >> 8 );
+            pEntry[ 1 ] = ( uint8_t ) ( pPublishInfo->topicNameLength & 0x00ffU );
+            ( void ) memcpy( ( void * ) &pEntry[ 2 ],
+                             ( const void * ) pPublishInfo->pTopicName,
+                             pPublishInfo->topicNameLength );
+        }
+        else
+        {
+            LogWarn( ( "Topic name of %hu bytes is too long for Topic Alias %hu.",
+                       ( unsigned short ) pPublishInfo->topicNameLength,
+                       ( unsigned short ) pPublishInfo->topicAlias ) );
+            pEntry[ 0 ] = 0U;
+            pEntry[ 1 ] = 0U;
+        }
     }
 
     return status;
@@ -2765,56 +4306,33 @@ MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
-                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
-                                   size_t outgoingPublishCount,
-                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
-                                   size_t incomingPublishCount )
+static MQTTStatus_t addPropertyValue( const uint8_t * pScratch,
+                                      size_t * pRunStart,
+                                      size_t used,
+                                      const void * pValue,
+                                      size_t valueLength,
+                                      TransportOutVector_t * pIoVector,
+                                      size_t * pVectorCount )
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    if( pContext == NULL )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p\n",
-                    ( void * ) pContext ) );
-        status = MQTTBadParameter;
-    }
-
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if( ( outgoingPublishCount == 0U ) !=
-             ( pOutgoingPublishRecords == NULL ) )
-    {
-        LogError( ( "Arguments do not match: pOutgoingPublishRecords=%p, "
-                    "outgoingPublishCount=%lu",
-                    ( void * ) pOutgoingPublishRecords,
-                    ( unsigned long ) outgoingPublishCount ) );
-        status = MQTTBadParameter;
-    }
-
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if( ( incomingPublishCount == 0U ) !=
-             ( pIncomingPublishRecords == NULL ) )
+    /* An empty value leaves its length with the next encoded bytes. */
+    if( valueLength == 0U )
     {
-        LogError( ( "Arguments do not match: pIncomingPublishRecords=%p, "
-                    "incomingPublishCount=%lu",
-                    ( void * ) pIncomingPublishRecords,
-                    ( unsigned long ) incomingPublishCount ) );
-        status = MQTTBadParameter;
+        /* MISRA Empty body */
     }
-    else if( pContext->appCallback == NULL )
+    else if( ( MQTT5_PROPERTY_MAX_VECTORS - *pVectorCount ) < 2U )
     {
-        LogError( ( "MQTT_InitStatefulQoS must be called only after MQTT_Init has"
-                    " been called successfully.\n" ) );
-        status = MQTTBadParameter;
+        status = MQTTNoMemory;
     }
     else
     {
-        pContext->incomingPublishRecordMaxCount = incomingPublishCount;
-        pContext->incomingPublishRecords = pIncomingPublishRecords;
-        pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
-        pContext->outgoingPublishRecords = pOutgoingPublishRecords;
+        pIoVector[ *pVectorCount ].iov_base = &pScratch[ *pRunStart ];
+        pIoVector[ *pVectorCount ].iov_len = used - *pRunStart;
+        pIoVector[ *pVectorCount + 1U ].iov_base = pValue;
+        pIoVector[ *pVectorCount + 1U ].iov_len = valueLength;
+        *pVectorCount += 2U;
+        *pRunStart = used;
     }
 
     return status;
@@ -2822,71 +4340,1591 @@ MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
-                                   MQTTStorePacketForRetransmit storeFunction,
-                                   MQTTRetrievePacketForRetransmit retrieveFunction,
-                                   MQTTClearPacketForRetransmit clearFunction )
+static MQTTStatus_t addPropertyVectors( const MQTT5Properties_t * pProperties,
+                                        uint8_t * pScratch,
+                                        TransportOutVector_t * pIoVector,
+                                        size_t * pVectorCount )
 {
     MQTTStatus_t status = MQTTSuccess;
+    const MQTT5Property_t * pProperty;
+    size_t encodedSize = 0U;
+    size_t used = 0U;
+    size_t runStart = 0U;
+    size_t i;
 
-    if( pContext == NULL )
-    {
-        LogError( ( "Argument cannot be NULL: pContext=%p\n",
-                    ( void * ) pContext ) );
-        status = MQTTBadParameter;
-    }
-    else if( storeFunction == NULL )
-    {
-        LogError( ( "Invalid parameter: storeFunction is NULL" ) );
-        status = MQTTBadParameter;
-    }
-    else if( retrieveFunction == NULL )
+    *pVectorCount = 0U;
+
+    if( pProperties->pFrozen != NULL )
     {
-        LogError( ( "Invalid parameter: retrieveFunction is NULL" ) );
-        status = MQTTBadParameter;
+        pIoVector[ 0U ].iov_base = pProperties->pFrozen;
+        pIoVector[ 0U ].iov_len = pProperties->frozenSize;
+        *pVectorCount = 1U;
     }
-    else if( clearFunction == NULL )
+    else if( pScratch == NULL )
     {
-        LogError( ( "Invalid parameter: clearFunction is NULL" ) );
+        LogError( ( "Properties must be frozen with MQTT5_FreezeProperties "
+                    "to be sent without scratch space." ) );
         status = MQTTBadParameter;
     }
     else
     {
-        pContext->storeFunction = storeFunction;
+        /* The properties length comes first. */
+        status = MQTT_SerializeVariableByteInteger( MQTT5_GetPropertiesSize( pProperties ),
+                                                    pScratch,
+                                                    &used );
+
+        for( i = 0U; ( status == MQTTSuccess ) && ( i < pProperties->count ); i++ )
+        {
+            pProperty = &pProperties->pProperties[ i ];
+
+            /* A property encodes at most 5 bytes into the scratch buffer. */
+            if( ( MQTT5_PROPERTY_SCRATCH_SIZE - used ) < 5U )
+            {
+                status = MQTTNoMemory;
+            }
+            else
+            {
+                pScratch[ used ] = ( uint8_t ) pProperty->type;
+                used++;
+
+                switch( pProperty->type )
+                {
+                    case MQTT5_PROPERTY_CONTENT_TYPE:
+                    case MQTT5_PROPERTY_RESPONSE_TOPIC:
+                    case MQTT5_PROPERTY_ASSIGNED_CLIENT_IDENTIFIER:
+                    case MQTT5_PROPERTY_AUTHENTICATION_METHOD:
+                    case MQTT5_PROPERTY_RESPONSE_INFORMATION:
+                    case MQTT5_PROPERTY_SERVER_REFERENCE:
+                    case MQTT5_PROPERTY_REASON_STRING:
+                        pScratch[ used ] = ( uint8_t ) ( pProperty->value.utf8String.length >> 8U );
+                        pScratch[ used + 1U ] = ( uint8_t ) ( pProperty->value.utf8String.length & 0xFFU );
+                        used += 2U;
+                        status = addPropertyValue( pScratch, &runStart, used,
+                                                   pProperty->value.utf8String.pString,
+                                                   pProperty->value.utf8String.length,
+                                                   pIoVector, pVectorCount );
+                        break;
+
+                    case MQTT5_PROPERTY_CORRELATION_DATA:
+                    case MQTT5_PROPERTY_AUTHENTICATION_DATA:
+                        pScratch[ used ] = ( uint8_t ) ( pProperty->value.binaryData.length >> 8U );
+                        pScratch[ used + 1U ] = ( uint8_t ) ( pProperty->value.binaryData.length & 0xFFU );
+                        used += 2U;
+                        status = addPropertyValue( pScratch, &runStart, used,
+                                                   pProperty->value.binaryData.pData,
+                                                   pProperty->value.binaryData.length,
+                                                   pIoVector, pVectorCount );
+                        break;
+
+                    case MQTT5_PROPERTY_USER_PROPERTY:
+                        pScratch[ used ] = ( uint8_t ) ( pProperty->value.userProperty.keyLength >> 8U );
+                        pScratch[ used + 1U ] = ( uint8_t ) ( pProperty->value.userProperty.keyLength & 0xFFU );
+                        used += 2U;
+                        status = addPropertyValue( pScratch, &runStart, used,
+                                                   pProperty->value.userProperty.pKey,
+                                                   pProperty->value.userProperty.keyLength,
+                                                   pIoVector, pVectorCount );
+
+                        if( status == MQTTSuccess )
+                        {
+                            pScratch[ used ] = ( uint8_t ) ( pProperty->value.userProperty.valueLength >> 8U );
+                            pScratch[ used + 1U ] = ( uint8_t ) ( pProperty->value.userProperty.valueLength & 0xFFU );
+                            used += 2U;
+                            status = addPropertyValue( pScratch, &runStart, used,
+                                                       pProperty->value.userProperty.pValue,
+                                                       pProperty->value.userProperty.valueLength,
+                                                       pIoVector, pVectorCount );
+                        }
+
+                        break;
+
+                    case MQTT5_PROPERTY_PAYLOAD_FORMAT_INDICATOR:
+                    case MQTT5_PROPERTY_REQUEST_PROBLEM_INFORMATION:
+                    case MQTT5_PROPERTY_REQUEST_RESPONSE_INFORMATION:
+                    case MQTT5_PROPERTY_MAXIMUM_QOS:
+                    case MQTT5_PROPERTY_RETAIN_AVAILABLE:
+                    case MQTT5_PROPERTY_WILDCARD_SUBSCRIPTION_AVAILABLE:
+                    case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER_AVAILABLE:
+                    case MQTT5_PROPERTY_SHARED_SUBSCRIPTION_AVAILABLE:
+                        pScratch[ used ] = pProperty->value.byte;
+                        used++;
+                        break;
+
+                    case MQTT5_PROPERTY_SERVER_KEEP_ALIVE:
+                    case MQTT5_PROPERTY_RECEIVE_MAXIMUM:
+                    case MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM:
+                    case MQTT5_PROPERTY_TOPIC_ALIAS:
+                        pScratch[ used ] = ( uint8_t ) ( pProperty->value.twoByteInteger >> 8U );
+                        pScratch[ used + 1U ] = ( uint8_t ) ( pProperty->value.twoByteInteger & 0xFFU );
+                        used += 2U;
+                        break;
+
+                    case MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL:
+                    case MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL:
+                    case MQTT5_PROPERTY_WILL_DELAY_INTERVAL:
+                    case MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE:
+                        pScratch[ used ] = ( uint8_t ) ( pProperty->value.fourByteInteger >> 24U );
+                        pScratch[ used + 1U ] = ( uint8_t ) ( ( pProperty->value.fourByteInteger >> 16U ) & 0xFFU );
+                        pScratch[ used + 2U ] = ( uint8_t ) ( ( pProperty->value.fourByteInteger >> 8U ) & 0xFFU );
+                        pScratch[ used + 3U ] = ( uint8_t ) ( pProperty->value.fourByteInteger & 0xFFU );
+                        used += 4U;
+                        break;
+
+                    case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER:
+                        status = MQTT_SerializeVariableByteInteger( pProperty->value.fourByteInteger,
+                                                                    &pScratch[ used ],
+                                                                    &encodedSize );
+                        used += encodedSize;
+                        break;
+
+                    default:
+                        LogError( ( "Unknown MQTT 5 property 0x%02x.",
+                                    ( unsigned int ) pProperty->type ) );
+                        status = MQTTBadParameter;
+                        break;
+                }
+            }
+        }
+
+        /* The encoded bytes after the last value. */
+        if( ( status == MQTTSuccess ) && ( used > runStart ) )
+        {
+            if( *pVectorCount == MQTT5_PROPERTY_MAX_VECTORS )
+            {
+                status = MQTTNoMemory;
+            }
+            else
+            {
+                pIoVector[ *pVectorCount ].iov_base = &pScratch[ runStart ];
+                pIoVector[ *pVectorCount ].iov_len = used - runStart;
+                ( *pVectorCount )++;
+            }
+        }
+
+        if( status == MQTTNoMemory )
+        {
+            LogError( ( "MQTT 5 properties need more than %lu vectors or %lu scratch bytes. "
+                        "Freeze them with MQTT5_FreezeProperties to send them as one vector.",
+                        ( unsigned long ) MQTT5_PROPERTY_MAX_VECTORS,
+                        ( unsigned long ) MQTT5_PROPERTY_SCRATCH_SIZE ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t validateFrozenProperties( const MQTTPublishInfo_t * pPublishInfo )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pPublishInfo->pProperties != NULL ) && ( pPublishInfo->pProperties->pFrozen == NULL ) )
+    {
+        LogError( ( "Properties of batched, queued or prepared publishes must be "
+                    "frozen with MQTT5_FreezeProperties." ) );
+        status = MQTTBadParameter;
+    }
+
+    return status;
+}
+
+#endif /* if MQTT_VERSION == MQTT_VERSION_5_0 */
+
+/*-----------------------------------------------------------*/
+
+static void clearIncomingTopicAliases( const MQTTIncomingTopicAliases_t * pAliases )
+{
+    size_t offset;
+    uint16_t i;
+
+    /* A zero length marks an alias as unmapped. */
+    for( i = 0U; i < pAliases->aliasCount; i++ )
+    {
+        offset = ( size_t ) i * ( ( size_t ) pAliases->topicNameMaxLength + 2U );
+        pAliases->pArena[ offset ] = 0U;
+        pAliases->pArena[ offset + 1U ] = 0U;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t resendPublish( MQTTContext_t * pContext,
+                                   uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t totalMessageLength = 0U;
+    uint8_t * pMqttPacket = NULL;
+    TransportOutVector_t * pIoVector = NULL;
+    size_t ioVectorLength = 0U;
+    size_t i;
+
+    assert( pContext != NULL );
+
+    if( pContext->retrieveVectorFunction != NULL )
+    {
+        if( ( pContext->retrieveVectorFunction( pContext, packetId, &pIoVector, &ioVectorLength ) != true ) ||
+            ( pIoVector == NULL ) || ( ioVectorLength == 0U ) )
+        {
+            status = MQTTPublishRetrieveFailed;
+        }
+        else
+        {
+            for( i = 0U; i < ioVectorLength; i++ )
+            {
+                totalMessageLength += pIoVector[ i ].iov_len;
+            }
+
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+            if( sendMessageVector( pContext, pIoVector, ioVectorLength ) != ( int32_t ) totalMessageLength )
+            {
+                status = MQTTSendFailed;
+            }
+
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        }
+    }
+    else if( pContext->retrieveFunction( pContext, packetId, &pMqttPacket, &totalMessageLength ) != true )
+    {
+        status = MQTTPublishRetrieveFailed;
+    }
+    else
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( sendBuffer( pContext, pMqttPacket, totalMessageLength ) != ( int32_t ) totalMessageLength )
+        {
+            status = MQTTSendFailed;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleUncleanSessionResumption( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    MQTTPublishState_t state = MQTTStateNull;
+
+    assert( pContext != NULL );
+
+    /* Get the next packet ID for which a PUBREL need to be resent. */
+    packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+
+    /* Resend all the PUBREL acks after session is reestablished. */
+    while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
+           ( status == MQTTSuccess ) )
+    {
+        status = sendPublishAcks( pContext, packetId, state );
+
+        packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+    }
+
+    if( ( status == MQTTSuccess ) &&
+        ( ( pContext->retrieveFunction != NULL ) ||
+          ( pContext->retrieveVectorFunction != NULL ) ) )
+    {
+        cursor = MQTT_STATE_CURSOR_INITIALIZER;
+
+        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
+         * after session is reestablished. */
+        do
+        {
+            packetId = MQTT_PublishToResend( pContext, &cursor );
+
+            if( packetId != MQTT_PACKET_ID_INVALID )
+            {
+                status = resendPublish( pContext, packetId );
+            }
+        } while( ( packetId != MQTT_PACKET_ID_INVALID ) &&
+                 ( status == MQTTSuccess ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void startSessionResumption( MQTTContext_t * pContext )
+{
+    MQTTSessionResume_t * pResume = pContext->pSessionResume;
+
+    assert( pResume != NULL );
+
+    /* The resumed session is made of the records present now. Records added
+     * later are sent by the application. */
+    pResume->next = 0U;
+    pResume->end = ( pContext->outgoingPublishIndex != NULL ) ?
+                   pContext->outgoingPublishIndex->usedCount :
+                   pContext->outgoingPublishRecordMaxCount;
+    pResume->resendingPublishes = false;
+    pResume->inProgress = true;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t continueSessionResumption( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTSessionResume_t * pResume = pContext->pSessionResume;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    MQTTPublishState_t state = MQTTStateNull;
+    size_t sentCount = 0U;
+
+    while( ( status == MQTTSuccess ) &&
+           ( pResume != NULL ) &&
+           ( pResume->inProgress == true ) &&
+           ( sentCount < pResume->packetsPerCall ) )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        /* The state engine moves the positions along with the records, so
+         * acknowledgements can be processed between calls. */
+        cursor = pResume->next;
+
+        if( pResume->resendingPublishes == false )
+        {
+            packetId = MQTT_PubrelToResend( pContext, &cursor, &state );
+        }
+        else
+        {
+            packetId = MQTT_PublishToResend( pContext, &cursor );
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        if( ( packetId == MQTT_PACKET_ID_INVALID ) || ( cursor > pResume->end ) )
+        {
+            /* The PUBRELs are resent before the PUBLISH packets. */
+            if( ( pResume->resendingPublishes == false ) &&
+                ( ( pContext->retrieveFunction != NULL ) ||
+                  ( pContext->retrieveVectorFunction != NULL ) ) )
+            {
+                pResume->resendingPublishes = true;
+                pResume->next = 0U;
+            }
+            else
+            {
+                LogInfo( ( "Resent every packet of the resumed session." ) );
+                pResume->inProgress = false;
+            }
+        }
+        else
+        {
+            if( pResume->resendingPublishes == false )
+            {
+                status = sendPublishAcks( pContext, packetId, state );
+            }
+            else
+            {
+                status = resendPublish( pContext, packetId );
+            }
+
+            /* A failed send leaves the connection to be re-established, which
+             * starts the resend again, but a PUBLISH which cannot be retrieved
+             * would fail again. */
+            if( ( status == MQTTSuccess ) || ( status == MQTTPublishRetrieveFailed ) )
+            {
+                pResume->next = cursor;
+                sentCount++;
+            }
+
+            if( status == MQTTPublishRetrieveFailed )
+            {
+                LogError( ( "Skipped resending PUBLISH that could not be retrieved: PacketId=%u.",
+                            ( unsigned int ) packetId ) );
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void clearPublishIndex( MQTTPubAckIndex_t * pIndex )
+{
+    assert( pIndex != NULL );
+
+    ( void ) memset( pIndex->pSlots,
+                     0x00,
+                     pIndex->slotCount * sizeof( *pIndex->pSlots ) );
+    pIndex->head = 0U;
+    pIndex->usedCount = 0U;
+    pIndex->liveCount = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool validatePublishIndex( const MQTTPubAckIndex_t * pIndex,
+                                  size_t recordCount )
+{
+    bool isValid = true;
+
+    /* An index must always keep an empty slot to terminate lookups. */
+    if( pIndex != NULL )
+    {
+        isValid = ( pIndex->pSlots != NULL ) && ( pIndex->slotCount > recordCount );
+    }
+
+    return isValid;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleCleanSession( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+
+    assert( pContext != NULL );
+
+    /* Reset the index and clear the buffer when a new session is established. */
+    pContext->index = 0;
+    pContext->readIndex = 0;
+    ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
+
+    if( pContext->clearFunction != NULL )
+    {
+        cursor = MQTT_STATE_CURSOR_INITIALIZER;
+
+        /* Resend all the PUBLISH for which PUBACK/PUBREC is not received
+         * after session is reestablished. */
+        do
+        {
+            packetId = MQTT_PublishToResend( pContext, &cursor );
+
+            if( packetId != MQTT_PACKET_ID_INVALID )
+            {
+                pContext->clearFunction( pContext, packetId );
+            }
+        } while( packetId != MQTT_PACKET_ID_INVALID );
+    }
+
+    if( pContext->outgoingPublishRecordMaxCount > 0U )
+    {
+        /* Clear any existing records if a new session is established. */
+        ( void ) memset( pContext->outgoingPublishRecords,
+                         0x00,
+                         pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+    }
+
+    if( pContext->incomingPublishRecordMaxCount > 0U )
+    {
+        ( void ) memset( pContext->incomingPublishRecords,
+                         0x00,
+                         pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+    }
+
+    /* The packet ID indexes must match the cleared records. */
+    if( pContext->outgoingPublishIndex != NULL )
+    {
+        clearPublishIndex( pContext->outgoingPublishIndex );
+    }
+
+    if( pContext->incomingPublishIndex != NULL )
+    {
+        clearPublishIndex( pContext->incomingPublishIndex );
+    }
+
+    if( pContext->recordStateFunction != NULL )
+    {
+        pContext->recordStateFunction( pContext, MQTT_PACKET_ID_INVALID, MQTTQoS0, MQTTStateNull, true );
+    }
+
+    /* A new session has nothing to resend. */
+    if( pContext->pSessionResume != NULL )
+    {
+        pContext->pSessionResume->inProgress = false;
+    }
+
+    return status;
+}
+
+static MQTTStatus_t validatePublishParams( const MQTTContext_t * pContext,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* Validate arguments. */
+    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pPublishInfo=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->qos != MQTTQoS0 ) && ( packetId == 0U ) )
+    {
+        LogError( ( "Packet Id is 0 for PUBLISH with QoS=%u.",
+                    ( unsigned int ) pPublishInfo->qos ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->payloadLength > 0U ) && ( pPublishInfo->pPayload == NULL ) )
+    {
+        LogError( ( "A nonzero payload length requires a non-NULL payload: "
+                    "payloadLength=%lu, pPayload=%p.",
+                    ( unsigned long ) pPublishInfo->payloadLength,
+                    pPublishInfo->pPayload ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pContext->outgoingPublishRecords == NULL ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+    {
+        LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
+                    "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
+                    "to initialize and enable the use of QoS1/QoS2 publishes." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* MISRA else */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendSerializedPublish( MQTTContext_t * pContext,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           uint8_t * pMqttHeader,
+                                           size_t headerSize,
+                                           uint16_t packetId,
+                                           const TransportOutVector_t * pPropertyVectors,
+                                           size_t propertyVectorCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    MQTTConnectionStatus_t connectStatus;
+
+    connectStatus = pContext->connectStatus;
+
+    if( connectStatus != MQTTConnected )
+    {
+        status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+    {
+        /* Set the flag so that the corresponding hook can be called later. */
+
+        status = MQTT_ReserveState( pContext,
+                                    packetId,
+                                    pPublishInfo->qos );
+
+        /* State already exists for a duplicate packet.
+         * If a state doesn't exist, it will be handled as a new publish in
+         * state engine. */
+        if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+        {
+            status = MQTTSuccess;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = sendPublishWithoutCopy( pContext,
+                                         pPublishInfo,
+                                         pMqttHeader,
+                                         headerSize,
+                                         packetId,
+                                         pPropertyVectors,
+                                         propertyVectorCount );
+    }
+
+    if( ( status == MQTTSuccess ) &&
+        ( pPublishInfo->qos > MQTTQoS0 ) )
+    {
+        /* Update state machine after PUBLISH is sent.
+         * Only to be done for QoS1 or QoS2. */
+        status = MQTT_UpdateStatePublish( pContext,
+                                          packetId,
+                                          MQTT_SEND,
+                                          pPublishInfo->qos,
+                                          &publishStatus );
+
+        if( status != MQTTSuccess )
+        {
+            LogError( ( "Update state for publish failed with status %s."
+                        " However PUBLISH packet was sent to the broker."
+                        " Any further handling of ACKs for the packet Id"
+                        " will fail.",
+                        MQTT_Status_strerror( status ) ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
+                        const TransportInterface_t * pTransportInterface,
+                        MQTTGetCurrentTimeFunc_t getTimeFunction,
+                        MQTTEventCallback_t userCallback,
+                        const MQTTFixedBuffer_t * pNetworkBuffer )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* Validate arguments. */
+    if( ( pContext == NULL ) || ( pTransportInterface == NULL ) ||
+        ( pNetworkBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pTransportInterface=%p, "
+                    "pNetworkBuffer=%p",
+                    ( void * ) pContext,
+                    ( void * ) pTransportInterface,
+                    ( void * ) pNetworkBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else if( getTimeFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: getTimeFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( userCallback == NULL )
+    {
+        LogError( ( "Invalid parameter: userCallback is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( pTransportInterface->recv == NULL )
+    {
+        LogError( ( "Invalid parameter: pTransportInterface->recv is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( pTransportInterface->send == NULL )
+    {
+        LogError( ( "Invalid parameter: pTransportInterface->send is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pContext, 0x00, sizeof( MQTTContext_t ) );
+
+        pContext->connectStatus = MQTTNotConnected;
+        pContext->transportInterface = *pTransportInterface;
+        pContext->getTime = getTimeFunction;
+        pContext->appCallback = userCallback;
+        pContext->networkBuffer = *pNetworkBuffer;
+
+        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
+        pContext->nextPacketId = 1;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
+                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
+                                   size_t outgoingPublishCount,
+                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
+                                   size_t incomingPublishCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+
+    /* Check whether the arguments make sense. Not equal here behaves
+     * like an exclusive-or operator for boolean values. */
+    else if( ( outgoingPublishCount == 0U ) !=
+             ( pOutgoingPublishRecords == NULL ) )
+    {
+        LogError( ( "Arguments do not match: pOutgoingPublishRecords=%p, "
+                    "outgoingPublishCount=%lu",
+                    ( void * ) pOutgoingPublishRecords,
+                    ( unsigned long ) outgoingPublishCount ) );
+        status = MQTTBadParameter;
+    }
+
+    /* Check whether the arguments make sense. Not equal here behaves
+     * like an exclusive-or operator for boolean values. */
+    else if( ( incomingPublishCount == 0U ) !=
+             ( pIncomingPublishRecords == NULL ) )
+    {
+        LogError( ( "Arguments do not match: pIncomingPublishRecords=%p, "
+                    "incomingPublishCount=%lu",
+                    ( void * ) pIncomingPublishRecords,
+                    ( unsigned long ) incomingPublishCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->appCallback == NULL )
+    {
+        LogError( ( "MQTT_InitStatefulQoS must be called only after MQTT_Init has"
+                    " been called successfully.\n" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->incomingPublishRecordMaxCount = incomingPublishCount;
+        pContext->incomingPublishRecords = pIncomingPublishRecords;
+        pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
+        pContext->outgoingPublishRecords = pOutgoingPublishRecords;
+
+        /* Any index attached earlier refers to the previous records. */
+        pContext->incomingPublishIndex = NULL;
+        pContext->outgoingPublishIndex = NULL;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitStatefulQoSIndex( MQTTContext_t * pContext,
+                                        MQTTPubAckIndex_t * pOutgoingPublishIndex,
+                                        MQTTPubAckIndex_t * pIncomingPublishIndex )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( validatePublishIndex( pOutgoingPublishIndex,
+                                   pContext->outgoingPublishRecordMaxCount ) == false )
+    {
+        LogError( ( "Invalid outgoing publish index: pOutgoingPublishIndex=%p",
+                    ( void * ) pOutgoingPublishIndex ) );
+        status = MQTTBadParameter;
+    }
+    else if( validatePublishIndex( pIncomingPublishIndex,
+                                   pContext->incomingPublishRecordMaxCount ) == false )
+    {
+        LogError( ( "Invalid incoming publish index: pIncomingPublishIndex=%p",
+                    ( void * ) pIncomingPublishIndex ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->appCallback == NULL )
+    {
+        LogError( ( "MQTT_InitStatefulQoSIndex must be called only after MQTT_Init has"
+                    " been called successfully.\n" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->outgoingPublishIndex = pOutgoingPublishIndex;
+        pContext->incomingPublishIndex = pIncomingPublishIndex;
+
+        /* Records may already be present, for example after restoring a session. */
+        MQTT_IndexStateRecords( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitSessionResume( MQTTContext_t * pContext,
+                                     MQTTSessionResume_t * pResume )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pResume != NULL ) && ( pResume->packetsPerCall == 0U ) )
+    {
+        LogError( ( "Invalid session resumption: packetsPerCall must be greater than 0." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->outgoingPublishRecords == NULL )
+    {
+        LogError( ( "MQTT_InitSessionResume must be called only after MQTT_InitStatefulQoS has"
+                    " been called successfully.\n" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pResume != NULL )
+        {
+            pResume->next = 0U;
+            pResume->end = 0U;
+            pResume->resendingPublishes = false;
+            pResume->inProgress = false;
+        }
+
+        pContext->pSessionResume = pResume;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitTopicAliases( MQTTContext_t * pContext,
+                                    MQTTTopicAliases_t * pAliases )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint16_t i;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pAliases != NULL ) &&
+             ( ( pAliases->pAliases == NULL ) || ( pAliases->pArena == NULL ) ||
+               ( pAliases->aliasCount == 0U ) || ( pAliases->topicNameMaxLength == 0U ) ||
+               ( pAliases->arenaSize < MQTT_TOPIC_ALIASES_ARENA_SIZE( pAliases->aliasCount,
+                                                                      pAliases->topicNameMaxLength ) ) ) )
+    {
+        LogError( ( "Invalid topic aliases: pAliases=%p, pArena=%p, arenaSize=%lu, "
+                    "aliasCount=%hu, topicNameMaxLength=%hu.",
+                    ( void * ) pAliases->pAliases,
+                    ( void * ) pAliases->pArena,
+                    ( unsigned long ) pAliases->arenaSize,
+                    ( unsigned short ) pAliases->aliasCount,
+                    ( unsigned short ) pAliases->topicNameMaxLength ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pAliases != NULL )
+        {
+            /* No alias is used until the broker allows them in a CONNACK. */
+            for( i = 0U; i < pAliases->aliasCount; i++ )
+            {
+                pAliases->pAliases[ i ].topicNameLength = 0U;
+                pAliases->pAliases[ i ].lastUsed = 0U;
+            }
+
+            pAliases->aliasMaximum = 0U;
+            pAliases->useCount = 0U;
+        }
+
+        pContext->pTopicAliases = pAliases;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitIncomingTopicAliases( MQTTContext_t * pContext,
+                                            MQTTIncomingTopicAliases_t * pAliases )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pAliases != NULL ) &&
+             ( ( pAliases->pArena == NULL ) || ( pAliases->aliasCount == 0U ) ||
+               ( pAliases->topicNameMaxLength == 0U ) ||
+               ( pAliases->arenaSize < MQTT_INCOMING_TOPIC_ALIASES_ARENA_SIZE( pAliases->aliasCount,
+                                                                               pAliases->topicNameMaxLength ) ) ) )
+    {
+        LogError( ( "Invalid incoming topic aliases: pArena=%p, arenaSize=%lu, "
+                    "aliasCount=%hu, topicNameMaxLength=%hu.",
+                    ( void * ) pAliases->pArena,
+                    ( unsigned long ) pAliases->arenaSize,
+                    ( unsigned short ) pAliases->aliasCount,
+                    ( unsigned short ) pAliases->topicNameMaxLength ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if( pAliases != NULL )
+        {
+            /* No alias is mapped until the broker sends one. */
+            clearIncomingTopicAliases( pAliases );
+        }
+
+        pContext->pIncomingTopicAliases = pAliases;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
+                                   MQTTStorePacketForRetransmit storeFunction,
+                                   MQTTRetrievePacketForRetransmit retrieveFunction,
+                                   MQTTClearPacketForRetransmit clearFunction )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( storeFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: storeFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( retrieveFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: retrieveFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( clearFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: clearFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->storeFunction = storeFunction;
         pContext->retrieveFunction = retrieveFunction;
+        pContext->retrieveVectorFunction = NULL;
+        pContext->clearFunction = clearFunction;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitRetransmitVectors( MQTTContext_t * pContext,
+                                         MQTTStorePacketForRetransmit storeFunction,
+                                         MQTTRetrieveVectorForRetransmit retrieveVectorFunction,
+                                         MQTTClearPacketForRetransmit clearFunction )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( storeFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: storeFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( retrieveVectorFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: retrieveVectorFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else if( clearFunction == NULL )
+    {
+        LogError( ( "Invalid parameter: clearFunction is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->storeFunction = storeFunction;
+        pContext->retrieveFunction = NULL;
+        pContext->retrieveVectorFunction = retrieveVectorFunction;
         pContext->clearFunction = clearFunction;
     }
 
-    return status;
-}
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitRingReceive( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->ringReceive = true;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitPublishStreaming( MQTTContext_t * pContext,
+                                        MQTTPublishStreamCallback_t streamCallback )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else if( streamCallback == NULL )
+    {
+        LogError( ( "Invalid parameter: streamCallback is NULL" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->streamCallback = streamCallback;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
+                                  uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogWarn( ( "pContext is NULL\n" ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->outgoingPublishRecords == NULL )
+    {
+        LogError( ( "QoS1/QoS2 is not initialized for use. Please, "
+                    "call MQTT_InitStatefulQoS to enable QoS1 and QoS2 "
+                    "publishes.\n" ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        status = MQTT_RemoveStateRecord( pContext,
+                                         packetId );
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_CheckConnectStatus( const MQTTContext_t * pContext )
+{
+    MQTTConnectionStatus_t connectStatus;
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        connectStatus = pContext->connectStatus;
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        switch( connectStatus )
+        {
+            case MQTTConnected:
+                status = MQTTStatusConnected;
+                break;
+
+            case MQTTDisconnectPending:
+                status = MQTTStatusDisconnectPending;
+                break;
+
+            default:
+                status = MQTTStatusNotConnected;
+                break;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
+                           const MQTTConnectInfo_t * pConnectInfo,
+                           const MQTTPublishInfo_t * pWillInfo,
+                           uint32_t timeoutMs,
+                           bool * pSessionPresent )
+{
+    size_t remainingLength = 0UL, packetSize = 0UL;
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTConnectionStatus_t connectStatus;
+
+    incomingPacket.type = ( uint8_t ) 0;
+
+    if( ( pContext == NULL ) || ( pConnectInfo == NULL ) || ( pSessionPresent == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pConnectInfo=%p, pSessionPresent=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pConnectInfo,
+                    ( void * ) pSessionPresent ) );
+        status = MQTTBadParameter;
+    }
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( status == MQTTSuccess )
+    {
+        status = validateIncomingTopicAliases( pContext, pConnectInfo );
+    }
+#endif
+
+    if( status == MQTTSuccess )
+    {
+        /* Get MQTT connect packet size and remaining length. */
+        status = MQTT_GetConnectPacketSize( pConnectInfo,
+                                            pWillInfo,
+                                            &remainingLength,
+                                            &packetSize );
+        /* coverity[sensitive_data_leak] */
+        LogDebug( ( "CONNECT packet size is %lu and remaining length is %lu.",
+                    ( unsigned long ) packetSize,
+                    ( unsigned long ) remainingLength ) );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        connectStatus = pContext->connectStatus;
+
+        if( connectStatus != MQTTNotConnected )
+        {
+            status = ( connectStatus == MQTTConnected ) ? MQTTStatusConnected : MQTTStatusDisconnectPending;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            status = sendConnectWithoutCopy( pContext,
+                                             pConnectInfo,
+                                             pWillInfo,
+                                             remainingLength );
+        }
+
+        /* Read CONNACK from transport layer. */
+        if( status == MQTTSuccess )
+        {
+            status = receiveConnack( pContext,
+                                     timeoutMs,
+                                     pConnectInfo->cleanSession,
+                                     &incomingPacket,
+                                     pSessionPresent );
+        }
+
+        if( ( status == MQTTSuccess ) && ( *pSessionPresent != true ) )
+        {
+            status = handleCleanSession( pContext );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            pContext->connectStatus = MQTTConnected;
+            /* Initialize keep-alive fields after a successful connection. */
+            pContext->keepAliveIntervalSec = pConnectInfo->keepAliveSeconds;
+            pContext->waitingForPingResp = false;
+            pContext->pingReqSendTimeMs = 0U;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    if( ( status == MQTTSuccess ) && ( *pSessionPresent == true ) )
+    {
+        if( pContext->pSessionResume != NULL )
+        {
+            /* Resend PUBRELs and PUBLISHES from MQTT_ProcessLoop. */
+            MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+            startSessionResumption( pContext );
+            MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        }
+        else
+        {
+            /* Resend PUBRELs and PUBLISHES when reestablishing a session */
+            status = handleUncleanSessionResumption( pContext );
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        LogInfo( ( "MQTT connection established with the broker." ) );
+    }
+    else if( ( status == MQTTStatusConnected ) || ( status == MQTTStatusDisconnectPending ) )
+    {
+        LogInfo( ( "MQTT Connection is either already established or a disconnect is pending, return status = %s.",
+                   MQTT_Status_strerror( status ) ) );
+    }
+    else if( pContext == NULL )
+    {
+        LogError( ( "MQTT connection failed with status = %s.",
+                    MQTT_Status_strerror( status ) ) );
+    }
+    else
+    {
+        LogError( ( "MQTT connection failed with status = %s.",
+                    MQTT_Status_strerror( status ) ) );
+
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus == MQTTConnected )
+        {
+            /* This will only be executed if after the connack is received
+             * the retransmits fail for some reason on an unclean session
+             * connection. In this case we need to retry the re-transmits
+             * which can only be done using the connect API and that can only
+             * be done once we are disconnected, hence we ask the user to
+             * call disconnect here */
+            pContext->connectStatus = MQTTDisconnectPending;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
+                             const MQTTSubscribeInfo_t * pSubscriptionList,
+                             size_t subscriptionCount,
+                             uint16_t packetId )
+{
+    MQTTConnectionStatus_t connectStatus;
+    size_t remainingLength = 0UL, packetSize = 0UL;
+
+    /* Validate arguments. */
+    MQTTStatus_t status = validateSubscribeUnsubscribeParams( pContext,
+                                                              pSubscriptionList,
+                                                              subscriptionCount,
+                                                              packetId );
+
+    if( status == MQTTSuccess )
+    {
+        /* Get the remaining length and packet size.*/
+        status = MQTT_GetSubscribePacketSize( pSubscriptionList,
+                                              subscriptionCount,
+                                              &remainingLength,
+                                              &packetSize
+#if MQTT_VERSION == MQTT_VERSION_5_0
+                                              , NULL
+#endif
+                                              );
+        LogDebug( ( "SUBSCRIBE packet size is %lu and remaining length is %lu.",
+                    ( unsigned long ) packetSize,
+                    ( unsigned long ) remainingLength ) );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        connectStatus = pContext->connectStatus;
+
+        if( connectStatus != MQTTConnected )
+        {
+            status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* Send MQTT SUBSCRIBE packet. */
+            status = sendSubscribeWithoutCopy( pContext,
+                                               pSubscriptionList,
+                                               subscriptionCount,
+                                               packetId,
+                                               remainingLength );
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
+                           const MQTTPublishInfo_t * pPublishInfo,
+                           uint16_t packetId )
+{
+    size_t headerSize = 0UL;
+    size_t remainingLength = 0UL;
+    size_t packetSize = 0UL;
+    const MQTTPublishInfo_t * pSentInfo = pPublishInfo;
+    const TransportOutVector_t * pPropertyVectors = NULL;
+    size_t propertyVectorCount = 0U;
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    MQTTPublishInfo_t aliasedInfo;
+    TransportOutVector_t propertyVectors[ MQTT5_PROPERTY_MAX_VECTORS ];
+    uint8_t propertyScratch[ MQTT5_PROPERTY_SCRATCH_SIZE ];
+#endif
+
+    /* Maximum number of bytes required by the 'fixed' part of the PUBLISH
+     * packet header according to the MQTT specifications.
+     * Header byte           0 + 1 = 1
+     * Length (max)            + 4 = 5
+     * Topic string length     + 2 = 7
+     *
+     * Note that since publish is one of the most common operations in MQTT
+     * connection, we have moved the topic string length to the 'fixed' part of
+     * the header so efficiency. Otherwise, we would need an extra vector and
+     * an extra call to 'send' (in case writev is not defined) to send the
+     * topic length.    */
+    uint8_t mqttHeader[ 7U ];
+
+    /* Validate arguments. */
+    MQTTStatus_t status = validatePublishParams( pContext, pPublishInfo, packetId );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    /* The properties are laid out before any state is reserved for the
+     * publish, as they may not fit the configured vectors. */
+    if( ( status == MQTTSuccess ) && ( pPublishInfo->pProperties != NULL ) )
+    {
+        status = addPropertyVectors( pPublishInfo->pProperties,
+                                     propertyScratch,
+                                     propertyVectors,
+                                     &propertyVectorCount );
+        pPropertyVectors = propertyVectors;
+    }
+#endif
+
+    if( status == MQTTSuccess )
+    {
+        /* Take the mutex as multiple send calls are required for sending this
+         * packet, and the state, as well as the topic alias chosen for the
+         * packet, has to be updated before it is released. */
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        if( topicAliasAllowed( pContext, pPublishInfo ) == true )
+        {
+            aliasedInfo = *pPublishInfo;
+            chooseTopicAlias( pContext->pTopicAliases, &aliasedInfo );
+            pSentInfo = &aliasedInfo;
+        }
+#endif
+
+        /* Get the remaining length and packet size.*/
+        status = MQTT_GetPublishPacketSize( pSentInfo,
+                                            &remainingLength,
+                                            &packetSize );
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_SerializePublishHeaderWithoutTopic( pSentInfo,
+                                                              remainingLength,
+                                                              mqttHeader,
+                                                              &headerSize );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            status = sendSerializedPublish( pContext,
+                                            pSentInfo,
+                                            mqttHeader,
+                                            headerSize,
+                                            packetId,
+                                            pPropertyVectors,
+                                            propertyVectorCount );
+        }
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        if( ( status == MQTTSuccess ) && ( pSentInfo->topicAlias != 0U ) )
+        {
+            /* The broker now maps the alias to the topic. */
+            recordTopicAlias( pContext->pTopicAliases, pPublishInfo, pSentInfo->topicAlias );
+        }
+#endif
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    if( status != MQTTSuccess )
+    {
+        LogError( ( "MQTT PUBLISH failed with status %s.",
+                    MQTT_Status_strerror( status ) ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_PublishMany( MQTTContext_t * pContext,
+                               const MQTTPublishInfo_t * pPublishInfo,
+                               size_t publishCount,
+                               const uint16_t * pPacketIds,
+                               size_t * pSentCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t sendStatus;
+    TransportOutVector_t pIoVector[ MQTT_PUBLISH_MAX_VECTORS ];
+
+    /* A publish takes at least 2 vectors, so a batch holds at most half as
+     * many publishes as vectors. See MQTT_Publish for the header size. */
+    uint8_t mqttHeaders[ MQTT_PUBLISH_MAX_VECTORS / 2U ][ 7U ];
+    uint8_t serializedPacketIds[ MQTT_PUBLISH_MAX_VECTORS / 2U ][ MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE ];
+    size_t ioVectorLength = 0U;
+    size_t totalMessageLength = 0U;
+    size_t vectorCount = 0U;
+    size_t headerSize = 0U;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    size_t publishIndex = 0U;
+    size_t batchStart = 0U;
+    size_t sentCount = 0U;
+    uint16_t packetId = 0U;
+
+    if( ( pContext == NULL ) || ( pPublishInfo == NULL ) || ( publishCount == 0U ) )
+    {
+        LogError( ( "Argument cannot be NULL or zero: pContext=%p, "
+                    "pPublishInfo=%p, publishCount=%lu.",
+                    ( void * ) pContext,
+                    ( const void * ) pPublishInfo,
+                    ( unsigned long ) publishCount ) );
+        status = MQTTBadParameter;
+    }
+
+    /* Validate all the publishes before any of them is sent. */
+    for( publishIndex = 0U; ( status == MQTTSuccess ) && ( publishIndex < publishCount ); publishIndex++ )
+    {
+        packetId = ( pPacketIds == NULL ) ? 0U : pPacketIds[ publishIndex ];
+        status = validatePublishParams( pContext, &pPublishInfo[ publishIndex ], packetId );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        if( status == MQTTSuccess )
+        {
+            status = validateFrozenProperties( &pPublishInfo[ publishIndex ] );
+        }
+#endif
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* Take the mutex so that the publishes are sent and their state
+         * updated before the receive loop processes their acks. */
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus != MQTTConnected )
+        {
+            status = ( pContext->connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+        }
+
+        publishIndex = 0U;
+
+        while( ( status == MQTTSuccess ) && ( publishIndex < publishCount ) )
+        {
+            if( ( ioVectorLength + CORE_MQTT_BATCH_PUBLISH_VECTORS ) > MQTT_PUBLISH_MAX_VECTORS )
+            {
+                /* The next publish may not fit, so send the batch. */
+                status = sendPublishBatch( pContext, pIoVector, ioVectorLength, totalMessageLength,
+                                           &pPublishInfo[ batchStart ],
+                                           ( pPacketIds == NULL ) ? NULL : &pPacketIds[ batchStart ],
+                                           publishIndex - batchStart );
+
+                if( status != MQTTSendFailed )
+                {
+                    sentCount += publishIndex - batchStart;
+                }
+
+                batchStart = publishIndex;
+                ioVectorLength = 0U;
+                totalMessageLength = 0U;
+            }
+            else
+            {
+                status = MQTT_GetPublishPacketSize( &pPublishInfo[ publishIndex ],
+                                                    &remainingLength,
+                                                    &packetSize );
+
+                if( status == MQTTSuccess )
+                {
+                    status = MQTT_SerializePublishHeaderWithoutTopic( &pPublishInfo[ publishIndex ],
+                                                                      remainingLength,
+                                                                      mqttHeaders[ publishIndex - batchStart ],
+                                                                      &headerSize );
+                }
 
-/*-----------------------------------------------------------*/
+                if( status == MQTTSuccess )
+                {
+                    packetId = ( pPacketIds == NULL ) ? 0U : pPacketIds[ publishIndex ];
+                    status = addPublishToBatch( pContext, &pPublishInfo[ publishIndex ],
+                                                mqttHeaders[ publishIndex - batchStart ], headerSize,
+                                                serializedPacketIds[ publishIndex - batchStart ],
+                                                &packetId, &( pIoVector[ ioVectorLength ] ),
+                                                &totalMessageLength, &vectorCount );
+                }
 
-MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
-                                  uint16_t packetId )
-{
-    MQTTStatus_t status = MQTTSuccess;
+                if( status == MQTTSuccess )
+                {
+                    ioVectorLength += vectorCount;
+                    publishIndex++;
+                }
+            }
+        }
 
-    if( pContext == NULL )
-    {
-        LogWarn( ( "pContext is NULL\n" ) );
-        status = MQTTBadParameter;
+        /* Send the last batch, including the publishes added before an
+         * error. */
+        if( publishIndex > batchStart )
+        {
+            sendStatus = sendPublishBatch( pContext, pIoVector, ioVectorLength, totalMessageLength,
+                                           &pPublishInfo[ batchStart ],
+                                           ( pPacketIds == NULL ) ? NULL : &pPacketIds[ batchStart ],
+                                           publishIndex - batchStart );
+
+            if( sendStatus != MQTTSendFailed )
+            {
+                sentCount += publishIndex - batchStart;
+            }
+
+            if( status == MQTTSuccess )
+            {
+                status = sendStatus;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
-    else if( pContext->outgoingPublishRecords == NULL )
+
+    if( pSentCount != NULL )
     {
-        LogError( ( "QoS1/QoS2 is not initialized for use. Please, "
-                    "call MQTT_InitStatefulQoS to enable QoS1 and QoS2 "
-                    "publishes.\n" ) );
-        status = MQTTBadParameter;
+        *pSentCount = sentCount;
     }
-    else
-    {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        status = MQTT_RemoveStateRecord( pContext,
-                                         packetId );
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    if( status != MQTTSuccess )
+    {
+        LogError( ( "MQTT PUBLISH of %lu publishes failed with status %s.",
+                    ( unsigned long ) publishCount,
+                    MQTT_Status_strerror( status ) ) );
     }
 
     return status;
@@ -2894,40 +5932,67 @@ MQTTStatus_t MQTT_CancelCallback( const MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_CheckConnectStatus( const MQTTContext_t * pContext )
+MQTTStatus_t MQTT_PreparePublish( const MQTTContext_t * pContext,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  MQTTPreparedPublish_t * pPreparedPublish )
 {
-    MQTTConnectionStatus_t connectStatus;
     MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishInfo_t publishInfo;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    size_t headerSize = 0U;
+    uint8_t mqttHeader[ 7U ];
 
-    if( pContext == NULL )
+    if( ( pPublishInfo == NULL ) || ( pPreparedPublish == NULL ) )
     {
-        LogError( ( "Argument cannot be NULL: pContext=%p",
-                    ( void * ) pContext ) );
+        LogError( ( "Argument cannot be NULL: pPublishInfo=%p, "
+                    "pPreparedPublish=%p.",
+                    ( const void * ) pPublishInfo,
+                    ( void * ) pPreparedPublish ) );
         status = MQTTBadParameter;
     }
-
-    if( status == MQTTSuccess )
+    else
     {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        publishInfo = *pPublishInfo;
+        publishInfo.dup = false;
+        publishInfo.pPayload = NULL;
+        publishInfo.payloadLength = 0U;
 
-        connectStatus = pContext->connectStatus;
+        /* The packet ID is checked for each publish. */
+        status = validatePublishParams( pContext, &publishInfo, 1U );
+    }
 
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( status == MQTTSuccess )
+    {
+        status = validateFrozenProperties( &publishInfo );
+    }
+#endif
 
-        switch( connectStatus )
-        {
-            case MQTTConnected:
-                status = MQTTStatusConnected;
-                break;
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_GetPublishPacketSize( &publishInfo,
+                                            &remainingLength,
+                                            &packetSize );
+    }
 
-            case MQTTDisconnectPending:
-                status = MQTTStatusDisconnectPending;
-                break;
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePublishHeaderWithoutTopic( &publishInfo,
+                                                          remainingLength,
+                                                          mqttHeader,
+                                                          &headerSize );
+    }
 
-            default:
-                status = MQTTStatusNotConnected;
-                break;
-        }
+    if( status == MQTTSuccess )
+    {
+        /* Keep the first byte and the topic length, which end the header. The
+         * Remaining Length in between depends on the payload. */
+        pPreparedPublish->publishInfo = publishInfo;
+        pPreparedPublish->variableHeaderLength = remainingLength;
+        pPreparedPublish->headerByte = mqttHeader[ 0 ];
+        pPreparedPublish->serializedTopicLength[ 0 ] = mqttHeader[ headerSize - 2U ];
+        pPreparedPublish->serializedTopicLength[ 1 ] = mqttHeader[ headerSize - 1U ];
     }
 
     return status;
@@ -2935,127 +6000,137 @@ MQTTStatus_t MQTT_CheckConnectStatus( const MQTTContext_t * pContext )
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
-                           const MQTTConnectInfo_t * pConnectInfo,
-                           const MQTTPublishInfo_t * pWillInfo,
-                           uint32_t timeoutMs,
-                           bool * pSessionPresent )
+MQTTStatus_t MQTT_PublishPrepared( MQTTContext_t * pContext,
+                                   const MQTTPreparedPublish_t * pPreparedPublish,
+                                   const void * pPayload,
+                                   size_t payloadLength,
+                                   uint16_t packetId )
 {
-    size_t remainingLength = 0UL, packetSize = 0UL;
     MQTTStatus_t status = MQTTSuccess;
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTConnectionStatus_t connectStatus;
+    MQTTPublishInfo_t publishInfo;
+    size_t remainingLength = 0U;
+    size_t encodedSize = 0U;
+    TransportOutVector_t propertyVector;
+    size_t propertyVectorCount = 0U;
 
-    incomingPacket.type = ( uint8_t ) 0;
+    /* See MQTT_Publish for the header size. */
+    uint8_t mqttHeader[ 7U ];
 
-    if( ( pContext == NULL ) || ( pConnectInfo == NULL ) || ( pSessionPresent == NULL ) )
+    if( ( pContext == NULL ) || ( pPreparedPublish == NULL ) )
     {
         LogError( ( "Argument cannot be NULL: pContext=%p, "
-                    "pConnectInfo=%p, pSessionPresent=%p.",
+                    "pPreparedPublish=%p.",
                     ( void * ) pContext,
-                    ( void * ) pConnectInfo,
-                    ( void * ) pSessionPresent ) );
+                    ( const void * ) pPreparedPublish ) );
         status = MQTTBadParameter;
     }
-
-    if( status == MQTTSuccess )
+    else if( ( pPreparedPublish->publishInfo.qos != MQTTQoS0 ) && ( packetId == 0U ) )
     {
-        /* Get MQTT connect packet size and remaining length. */
-        status = MQTT_GetConnectPacketSize( pConnectInfo,
-                                            pWillInfo,
-                                            &remainingLength,
-                                            &packetSize );
-        /* coverity[sensitive_data_leak] */
-        LogDebug( ( "CONNECT packet size is %lu and remaining length is %lu.",
-                    ( unsigned long ) packetSize,
-                    ( unsigned long ) remainingLength ) );
+        LogError( ( "Packet Id is 0 for PUBLISH with QoS=%u.",
+                    ( unsigned int ) pPreparedPublish->publishInfo.qos ) );
+        status = MQTTBadParameter;
     }
-
-    if( status == MQTTSuccess )
+    else if( ( payloadLength > 0U ) && ( pPayload == NULL ) )
     {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        connectStatus = pContext->connectStatus;
+        LogError( ( "A nonzero payload length requires a non-NULL payload: "
+                    "payloadLength=%lu, pPayload=%p.",
+                    ( unsigned long ) payloadLength,
+                    pPayload ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        remainingLength = pPreparedPublish->variableHeaderLength + payloadLength;
 
-        if( connectStatus != MQTTNotConnected )
+        /* A sum that wraps around is also too long. */
+        if( remainingLength < payloadLength )
         {
-            status = ( connectStatus == MQTTConnected ) ? MQTTStatusConnected : MQTTStatusDisconnectPending;
+            LogError( ( "PUBLISH payload length of %lu is too long.",
+                        ( unsigned long ) payloadLength ) );
+            status = MQTTBadParameter;
         }
+    }
 
-        if( status == MQTTSuccess )
-        {
-            status = sendConnectWithoutCopy( pContext,
-                                             pConnectInfo,
-                                             pWillInfo,
-                                             remainingLength );
-        }
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    /* The properties were checked to be frozen by MQTT_PreparePublish. */
+    if( ( status == MQTTSuccess ) && ( pPreparedPublish->publishInfo.pProperties != NULL ) )
+    {
+        status = addPropertyVectors( pPreparedPublish->publishInfo.pProperties,
+                                     NULL,
+                                     &propertyVector,
+                                     &propertyVectorCount );
+    }
+#endif
 
-        /* Read CONNACK from transport layer. */
-        if( status == MQTTSuccess )
-        {
-            status = receiveConnack( pContext,
-                                     timeoutMs,
-                                     pConnectInfo->cleanSession,
-                                     &incomingPacket,
-                                     pSessionPresent );
-        }
+    if( status == MQTTSuccess )
+    {
+        mqttHeader[ 0 ] = pPreparedPublish->headerByte;
+        status = MQTT_SerializeVariableByteInteger( remainingLength,
+                                                    &mqttHeader[ 1 ],
+                                                    &encodedSize );
+    }
 
-        if( ( status == MQTTSuccess ) && ( *pSessionPresent != true ) )
-        {
-            status = handleCleanSession( pContext );
-        }
+    if( status == MQTTSuccess )
+    {
+        mqttHeader[ 1U + encodedSize ] = pPreparedPublish->serializedTopicLength[ 0 ];
+        mqttHeader[ 2U + encodedSize ] = pPreparedPublish->serializedTopicLength[ 1 ];
 
-        if( status == MQTTSuccess )
-        {
-            pContext->connectStatus = MQTTConnected;
-            /* Initialize keep-alive fields after a successful connection. */
-            pContext->keepAliveIntervalSec = pConnectInfo->keepAliveSeconds;
-            pContext->waitingForPingResp = false;
-            pContext->pingReqSendTimeMs = 0U;
-        }
+        publishInfo = pPreparedPublish->publishInfo;
+        publishInfo.pPayload = pPayload;
+        publishInfo.payloadLength = payloadLength;
+
+        /* Take the mutex as multiple send calls are required for sending
+         * this packet, and the state has to be updated before it is released. */
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        status = sendSerializedPublish( pContext,
+                                        &publishInfo,
+                                        mqttHeader,
+                                        3U + encodedSize,
+                                        packetId,
+                                        &propertyVector,
+                                        propertyVectorCount );
 
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
-    if( ( status == MQTTSuccess ) && ( *pSessionPresent == true ) )
+    if( status != MQTTSuccess )
     {
-        /* Resend PUBRELs and PUBLISHES when reestablishing a session */
-        status = handleUncleanSessionResumption( pContext );
+        LogError( ( "MQTT PUBLISH failed with status %s.",
+                    MQTT_Status_strerror( status ) ) );
     }
 
-    if( status == MQTTSuccess )
-    {
-        LogInfo( ( "MQTT connection established with the broker." ) );
-    }
-    else if( ( status == MQTTStatusConnected ) || ( status == MQTTStatusDisconnectPending ) )
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 )
+
+MQTTStatus_t MQTT_InitPublishQueue( MQTTPublishQueue_t * pQueue,
+                                    MQTTPublishQueueEntry_t * pEntries,
+                                    size_t entryCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pQueue == NULL ) || ( pEntries == NULL ) )
     {
-        LogInfo( ( "MQTT Connection is either already established or a disconnect is pending, return status = %s.",
-                   MQTT_Status_strerror( status ) ) );
+        LogError( ( "Argument cannot be NULL: pQueue=%p, pEntries=%p.",
+                    ( void * ) pQueue,
+                    ( void * ) pEntries ) );
+        status = MQTTBadParameter;
     }
-    else if( pContext == NULL )
+    else if( ( entryCount == 0U ) || ( ( entryCount & ( entryCount - 1U ) ) != 0U ) )
     {
-        LogError( ( "MQTT connection failed with status = %s.",
-                    MQTT_Status_strerror( status ) ) );
+        LogError( ( "The number of queue entries must be a power of two: entryCount=%lu.",
+                    ( unsigned long ) entryCount ) );
+        status = MQTTBadParameter;
     }
     else
     {
-        LogError( ( "MQTT connection failed with status = %s.",
-                    MQTT_Status_strerror( status ) ) );
-
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        if( pContext->connectStatus == MQTTConnected )
-        {
-            /* This will only be executed if after the connack is received
-             * the retransmits fail for some reason on an unclean session
-             * connection. In this case we need to retry the re-transmits
-             * which can only be done using the connect API and that can only
-             * be done once we are disconnected, hence we ask the user to
-             * call disconnect here */
-            pContext->connectStatus = MQTTDisconnectPending;
-        }
-
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+        ( void ) memset( pQueue, 0x00, sizeof( MQTTPublishQueue_t ) );
+        pQueue->pEntries = pEntries;
+        pQueue->entryCount = entryCount;
     }
 
     return status;
@@ -3063,58 +6138,43 @@ MQTTStatus_t MQTT_Connect( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
-                             const MQTTSubscribeInfo_t * pSubscriptionList,
-                             size_t subscriptionCount,
-                             uint16_t packetId )
+MQTTStatus_t MQTT_AttachPublishQueue( MQTTContext_t * pContext,
+                                      MQTTPublishQueue_t * pQueue )
 {
-    MQTTConnectionStatus_t connectStatus;
-    size_t remainingLength = 0UL, packetSize = 0UL;
-
-    /* Validate arguments. */
-    MQTTStatus_t status = validateSubscribeUnsubscribeParams( pContext,
-                                                              pSubscriptionList,
-                                                              subscriptionCount,
-                                                              packetId );
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishQueue_t ** ppLink;
 
-    if( status == MQTTSuccess )
+    if( ( pContext == NULL ) || ( pQueue == NULL ) )
     {
-        /* Get the remaining length and packet size.*/
-        status = MQTT_GetSubscribePacketSize( pSubscriptionList,
-                                              subscriptionCount,
-                                              &remainingLength,
-                                              &packetSize
-#if MQTT_VERSION == MQTT_VERSION_5_0
-                                              , NULL
-#endif
-                                              );
-        LogDebug( ( "SUBSCRIBE packet size is %lu and remaining length is %lu.",
-                    ( unsigned long ) packetSize,
-                    ( unsigned long ) remainingLength ) );
+        LogError( ( "Argument cannot be NULL: pContext=%p, pQueue=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pQueue ) );
+        status = MQTTBadParameter;
     }
-
-    if( status == MQTTSuccess )
+    else if( pQueue->pEntries == NULL )
     {
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
-
-        connectStatus = pContext->connectStatus;
+        LogError( ( "The queue must be initialized with MQTT_InitPublishQueue." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ppLink = &( pContext->pPublishQueues );
 
-        if( connectStatus != MQTTConnected )
+        while( ( *ppLink != NULL ) && ( *ppLink != pQueue ) )
         {
-            status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+            ppLink = &( ( *ppLink )->pNext );
         }
 
-        if( status == MQTTSuccess )
+        if( *ppLink == pQueue )
         {
-            /* Send MQTT SUBSCRIBE packet. */
-            status = sendSubscribeWithoutCopy( pContext,
-                                               pSubscriptionList,
-                                               subscriptionCount,
-                                               packetId,
-                                               remainingLength );
+            LogError( ( "The queue is already attached to the context." ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            pQueue->pNext = NULL;
+            *ppLink = pQueue;
         }
-
-        MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
     return status;
@@ -3122,35 +6182,60 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
-                           const MQTTPublishInfo_t * pPublishInfo,
-                           uint16_t packetId )
+MQTTStatus_t MQTT_EnqueuePublish( MQTTPublishQueue_t * pQueue,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  uint16_t packetId )
 {
-    size_t headerSize = 0UL;
-    size_t remainingLength = 0UL;
-    size_t packetSize = 0UL;
-    MQTTPublishState_t publishStatus = MQTTStateNull;
-    MQTTConnectionStatus_t connectStatus;
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishQueueEntry_t * pEntry = NULL;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    size_t head = 0U;
 
-    /* Maximum number of bytes required by the 'fixed' part of the PUBLISH
-     * packet header according to the MQTT specifications.
-     * Header byte           0 + 1 = 1
-     * Length (max)            + 4 = 5
-     * Topic string length     + 2 = 7
-     *
-     * Note that since publish is one of the most common operations in MQTT
-     * connection, we have moved the topic string length to the 'fixed' part of
-     * the header so efficiency. Otherwise, we would need an extra vector and
-     * an extra call to 'send' (in case writev is not defined) to send the
-     * topic length.    */
-    uint8_t mqttHeader[ 7U ];
+    if( ( pQueue == NULL ) || ( pQueue->pEntries == NULL ) || ( pPublishInfo == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pQueue=%p, pPublishInfo=%p.",
+                    ( void * ) pQueue,
+                    ( const void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->payloadLength > 0U ) && ( pPublishInfo->pPayload == NULL ) )
+    {
+        LogError( ( "A nonzero payload length requires a non-NULL payload: "
+                    "payloadLength=%lu, pPayload=%p.",
+                    ( unsigned long ) pPublishInfo->payloadLength,
+                    pPublishInfo->pPayload ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        head = pQueue->head;
 
-    /* Validate arguments. */
-    MQTTStatus_t status = validatePublishParams( pContext, pPublishInfo, packetId );
+        /* The counters wrap around together, so their difference is the
+         * number of entries in use. */
+        if( ( head - pQueue->tail ) >= pQueue->entryCount )
+        {
+            LogWarn( ( "Publish queue is full: entryCount=%lu.",
+                       ( unsigned long ) pQueue->entryCount ) );
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            /* Read the tail before writing the entry it released, so that
+             * the draining thread has finished reading that entry. */
+            MQTT_PUBLISH_QUEUE_BARRIER();
+        }
+    }
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( status == MQTTSuccess )
+    {
+        status = validateFrozenProperties( pPublishInfo );
+    }
+#endif
 
     if( status == MQTTSuccess )
     {
-        /* Get the remaining length and packet size.*/
         status = MQTT_GetPublishPacketSize( pPublishInfo,
                                             &remainingLength,
                                             &packetSize );
@@ -3158,89 +6243,175 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
 
     if( status == MQTTSuccess )
     {
+        pEntry = &( pQueue->pEntries[ head & ( pQueue->entryCount - 1U ) ] );
+
         status = MQTT_SerializePublishHeaderWithoutTopic( pPublishInfo,
                                                           remainingLength,
-                                                          mqttHeader,
-                                                          &headerSize );
+                                                          pEntry->header,
+                                                          &pEntry->headerSize );
     }
 
     if( status == MQTTSuccess )
     {
-        /* Take the mutex as multiple send calls are required for sending this
-         * packet. */
-        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        pEntry->publishInfo = *pPublishInfo;
+        pEntry->packetId = ( pPublishInfo->qos > MQTTQoS0 ) ? packetId : 0U;
 
-        connectStatus = pContext->connectStatus;
+        /* The entry must be complete before the draining thread can see the
+         * new head. */
+        MQTT_PUBLISH_QUEUE_BARRIER();
+        pQueue->head = head + 1U;
+    }
 
-        if( connectStatus != MQTTConnected )
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DrainPublishQueues( MQTTContext_t * pContext,
+                                      size_t * pDrainedCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t sendStatus;
+    MQTTPublishQueue_t * pQueue = NULL;
+    MQTTPublishQueue_t * pFirstQueue = NULL;
+    MQTTPublishQueueEntry_t * pEntry;
+    TransportOutVector_t pIoVector[ MQTT_PUBLISH_MAX_VECTORS ];
+    size_t ioVectorLength = 0U;
+    size_t totalMessageLength = 0U;
+    size_t vectorCount = 0U;
+    size_t batchCount = 0U;
+    size_t drainedCount = 0U;
+    size_t head;
+    bool dropEntry = false;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p.",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Queued publishes are sent and their state updated without releasing
+         * the mutex in between, as in MQTT_Publish. */
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        if( pContext->connectStatus != MQTTConnected )
         {
-            status = ( connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
+            status = ( pContext->connectStatus == MQTTNotConnected ) ? MQTTStatusNotConnected : MQTTStatusDisconnectPending;
         }
-
-        if( ( status == MQTTSuccess ) && ( pPublishInfo->qos > MQTTQoS0 ) )
+        else
         {
-            /* Set the flag so that the corresponding hook can be called later. */
+            pQueue = pContext->pPublishQueues;
+            pFirstQueue = pQueue;
+        }
 
-            status = MQTT_ReserveState( pContext,
-                                        packetId,
-                                        pPublishInfo->qos );
+        while( ( status == MQTTSuccess ) && ( pQueue != NULL ) )
+        {
+            /* Read the head before any of the entries it covers. */
+            head = pQueue->head;
+            MQTT_PUBLISH_QUEUE_BARRIER();
+            pQueue->drainIndex = pQueue->tail;
 
-            /* State already exists for a duplicate packet.
-             * If a state doesn't exist, it will be handled as a new publish in
-             * state engine. */
-            if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+            while( ( status == MQTTSuccess ) && ( pQueue->drainIndex != head ) )
             {
-                status = MQTTSuccess;
+                if( ( ioVectorLength + CORE_MQTT_BATCH_PUBLISH_VECTORS ) > MQTT_PUBLISH_MAX_VECTORS )
+                {
+                    /* The next publish may not fit, so send the batch. */
+                    status = sendQueuedPublishes( pContext, pIoVector, ioVectorLength,
+                                                  totalMessageLength, pFirstQueue, pQueue );
+                    drainedCount += batchCount;
+                    pFirstQueue = pQueue;
+                    ioVectorLength = 0U;
+                    totalMessageLength = 0U;
+                    batchCount = 0U;
+                }
+                else
+                {
+                    pEntry = &( pQueue->pEntries[ pQueue->drainIndex & ( pQueue->entryCount - 1U ) ] );
+
+                    status = addPublishToBatch( pContext, &pEntry->publishInfo, pEntry->header,
+                                                pEntry->headerSize, pEntry->serializedPacketId,
+                                                &pEntry->packetId, &( pIoVector[ ioVectorLength ] ),
+                                                &totalMessageLength, &vectorCount );
+
+                    if( status == MQTTSuccess )
+                    {
+                        ioVectorLength += vectorCount;
+                        batchCount++;
+                        pQueue->drainIndex++;
+                    }
+                    else
+                    {
+                        /* Without free records the publish can be sent
+                         * later, but other errors would recur. */
+                        dropEntry = ( status != MQTTNoMemory );
+                    }
+                }
             }
-        }
 
-        if( status == MQTTSuccess )
-        {
-            status = sendPublishWithoutCopy( pContext,
-                                             pPublishInfo,
-                                             mqttHeader,
-                                             headerSize,
-                                             packetId );
+            if( status == MQTTSuccess )
+            {
+                pQueue = pQueue->pNext;
+            }
         }
 
-        if( ( status == MQTTSuccess ) &&
-            ( pPublishInfo->qos > MQTTQoS0 ) )
+        /* Send the last batch, including the publishes taken before an
+         * error. If the loop stopped on an error, the current queue is the
+         * last one with publishes in the batch. */
+        if( batchCount > 0U )
         {
-            /* Update state machine after PUBLISH is sent.
-             * Only to be done for QoS1 or QoS2. */
-            status = MQTT_UpdateStatePublish( pContext,
-                                              packetId,
-                                              MQTT_SEND,
-                                              pPublishInfo->qos,
-                                              &publishStatus );
+            sendStatus = sendQueuedPublishes( pContext, pIoVector, ioVectorLength,
+                                              totalMessageLength, pFirstQueue, pQueue );
+            drainedCount += batchCount;
 
-            if( status != MQTTSuccess )
+            if( status == MQTTSuccess )
             {
-                LogError( ( "Update state for publish failed with status %s."
-                            " However PUBLISH packet was sent to the broker."
-                            " Any further handling of ACKs for the packet Id"
-                            " will fail.",
-                            MQTT_Status_strerror( status ) ) );
+                status = sendStatus;
             }
         }
 
-        /* mutex should be released and not before updating the state
-         * because we need to make sure that the state is updated
-         * after sending the publish packet, before the receive
-         * loop receives ack for this and would want to update its state
-         */
+        if( dropEntry == true )
+        {
+            LogError( ( "Dropped a queued publish that failed with status %s.",
+                        MQTT_Status_strerror( status ) ) );
+            MQTT_PUBLISH_QUEUE_BARRIER();
+            pQueue->tail = pQueue->drainIndex + 1U;
+        }
+
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
 
-    if( status != MQTTSuccess )
+    if( pDrainedCount != NULL )
     {
-        LogError( ( "MQTT PUBLISH failed with status %s.",
-                    MQTT_Status_strerror( status ) ) );
+        *pDrainedCount = drainedCount;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitDrainOnAck( MQTTContext_t * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p\n",
+                    ( void * ) pContext ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->drainOnAck = true;
     }
 
     return status;
 }
 
+#endif /* if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 ) */
+
 /*-----------------------------------------------------------*/
 
 MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
@@ -3447,6 +6618,7 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext )
 
             /* Reset the index and clean the buffer on a successful disconnect. */
             pContext->index = 0;
+            pContext->readIndex = 0;
             ( void ) memset( pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size );
 
             LogError( ( "MQTT Connection Disconnected Successfully" ) );
@@ -3497,7 +6669,90 @@ MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext )
     else
     {
         pContext->controlPacketSent = false;
-        status = receiveSingleIteration( pContext, true );
+
+        /* Resend packets of a resumed session before receiving. */
+        if( pContext->connectStatus == MQTTConnected )
+        {
+            status = continueSessionResumption( pContext );
+        }
+        else
+        {
+            status = MQTTSuccess;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            status = receiveSingleIteration( pContext, true );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ProcessLoopBatch( MQTTContext_t * pContext,
+                                    size_t maxPackets,
+                                    size_t * pProcessedCount )
+{
+    MQTTStatus_t status = MQTTBadParameter;
+    int32_t recvBytes = 0;
+
+    if( ( pContext == NULL ) || ( pProcessedCount == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, pProcessedCount=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pProcessedCount ) );
+    }
+    else if( pContext->getTime == NULL )
+    {
+        LogError( ( "Invalid input parameter: MQTT Context must have valid getTime." ) );
+    }
+    else if( pContext->networkBuffer.pBuffer == NULL )
+    {
+        LogError( ( "Invalid input parameter: The MQTT context's networkBuffer must not be NULL." ) );
+    }
+    else if( maxPackets == 0U )
+    {
+        LogError( ( "Invalid input parameter: maxPackets must be greater than 0." ) );
+    }
+    else
+    {
+        pContext->controlPacketSent = false;
+        *pProcessedCount = 0U;
+        status = MQTTSuccess;
+
+        /* Resend packets of a resumed session before receiving. */
+        if( pContext->connectStatus == MQTTConnected )
+        {
+            status = continueSessionResumption( pContext );
+        }
+
+        /* Drain the packets received by earlier calls before reading from
+         * the transport interface again. */
+        if( status == MQTTSuccess )
+        {
+            status = processBufferedPackets( pContext, maxPackets, pProcessedCount );
+        }
+
+        if( ( status == MQTTSuccess ) && ( *pProcessedCount < maxPackets ) )
+        {
+            recvBytes = recvIntoNetworkBuffer( pContext );
+
+            if( recvBytes < 0 )
+            {
+                status = MQTTRecvFailed;
+            }
+            else if( recvBytes == 0 )
+            {
+                /* No data was received, check for keep alive timeout. */
+                status = handleKeepAlive( pContext );
+            }
+            else
+            {
+                status = processBufferedPackets( pContext, maxPackets, pProcessedCount );
+            }
+        }
     }
 
     return status;
@@ -3539,18 +6794,7 @@ uint16_t MQTT_GetPacketId( MQTTContext_t * pContext )
     {
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
 
-        packetId = pContext->nextPacketId;
-
-        /* A packet ID of zero is not a valid packet ID. When the max ID
-         * is reached the next one should start at 1. */
-        if( pContext->nextPacketId == ( uint16_t ) UINT16_MAX )
-        {
-            pContext->nextPacketId = 1;
-        }
-        else
-        {
-            pContext->nextPacketId++;
-        }
+        packetId = nextPacketId( pContext );
 
         MQTT_POST_STATE_UPDATE_HOOK( pContext );
     }
@@ -3805,3 +7049,75 @@ void MQTT_SerializeMQTTVec( uint8_t * pAllocatedMem,
 }
 
 /*-----------------------------------------------------------*/
+
+static bool isApplicationVector( const MQTTVec_t * pVec,
+                                 const TransportOutVector_t * pTransportVec )
+{
+    bool isApplication = false;
+
+    /* The topic name and payload stay in the buffers of the application; every
+     * other vector refers to bytes serialized by the library. */
+    if( ( pVec->pPublishInfo != NULL ) && ( pTransportVec->iov_len > 0U ) )
+    {
+        isApplication = ( pTransportVec->iov_base == ( const void * ) pVec->pPublishInfo->pTopicName ) ||
+                        ( pTransportVec->iov_base == pVec->pPublishInfo->pPayload );
+    }
+
+    return isApplication;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t MQTT_GetVectorCountInMQTTVec( const MQTTVec_t * pVec )
+{
+    return pVec->vectorLen;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t MQTT_GetHeaderBytesInMQTTVec( const MQTTVec_t * pVec )
+{
+    size_t memoryRequired = 0;
+    size_t i;
+    const TransportOutVector_t * pTransportVec = pVec->pVector;
+    size_t vecLen = pVec->vectorLen;
+
+    for( i = 0; i < vecLen; i++ )
+    {
+        if( isApplicationVector( pVec, &pTransportVec[ i ] ) == false )
+        {
+            memoryRequired += pTransportVec[ i ].iov_len;
+        }
+    }
+
+    return memoryRequired;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTT_SerializeMQTTVecHeaders( uint8_t * pAllocatedMem,
+                                   const MQTTVec_t * pVec,
+                                   TransportOutVector_t * pVectors )
+{
+    const TransportOutVector_t * pTransportVec = pVec->pVector;
+    const size_t vecLen = pVec->vectorLen;
+    size_t index = 0;
+    size_t i = 0;
+
+    for( i = 0; i < vecLen; i++ )
+    {
+        if( isApplicationVector( pVec, &pTransportVec[ i ] ) == true )
+        {
+            pVectors[ i ] = pTransportVec[ i ];
+        }
+        else
+        {
+            ( void ) memcpy( ( void * ) &pAllocatedMem[ index ], ( const void * ) pTransportVec[ i ].iov_base, pTransportVec[ i ].iov_len );
+            pVectors[ i ].iov_base = &pAllocatedMem[ index ];
+            pVectors[ i ].iov_len = pTransportVec[ i ].iov_len;
+            index += pTransportVec[ i ].iov_len;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
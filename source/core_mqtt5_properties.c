@@ -6,6 +6,18 @@
 #include "core_mqtt5_properties.h"
 #include <string.h>
 
+/**
+ * @brief Index entry of a property that was decoded into a view but not
+ * stored, as it was not requested.
+ */
+#define MQTT5_PROPERTY_SKIPPED    ( 0xFFU )
+
+/**
+ * @brief Largest value of a Variable Byte Integer, which bounds the properties
+ * length.
+ */
+#define MQTT5_MAX_PROPERTIES_LENGTH    ( 268435455UL )
+
 /*-----------------------------------------------------------*/
 
 MQTTStatus_t MQTT5_InitProperties( MQTT5Properties_t * pProperties,
@@ -23,6 +35,9 @@ MQTTStatus_t MQTT5_InitProperties( MQTT5Properties_t * pProperties,
         pProperties->pProperties = pBuffer;
         pProperties->count = 0U;
         pProperties->capacity = capacity;
+        pProperties->pFrozen = NULL;
+        pProperties->frozenSize = 0U;
+        pProperties->frozenLength = 0U;
     }
 
     return status;
@@ -35,7 +50,7 @@ MQTTStatus_t MQTT5_AddProperty( MQTT5Properties_t * pProperties,
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    if( ( pProperties == NULL ) || ( pProperty == NULL ) )
+    if( ( pProperties == NULL ) || ( pProperty == NULL ) || ( pProperties->pFrozen != NULL ) )
     {
         status = MQTTBadParameter;
     }
@@ -90,7 +105,11 @@ size_t MQTT5_GetPropertiesSize( const MQTT5Properties_t * pProperties )
     size_t totalSize = 0U;
     size_t i;
 
-    if( pProperties != NULL )
+    if( ( pProperties != NULL ) && ( pProperties->pFrozen != NULL ) )
+    {
+        totalSize = pProperties->frozenLength;
+    }
+    else if( pProperties != NULL )
     {
         /* Calculate size of all properties */
         for( i = 0U; i < pProperties->count; i++ )
@@ -152,8 +171,8 @@ size_t MQTT5_GetPropertiesSize( const MQTT5Properties_t * pProperties )
                     break;
                     
                 case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER:
-                    /* Variable Byte Integer - simplified to 1-4 bytes */
-                    totalSize += 4U; /* Conservative estimate */
+                    /* Variable Byte Integer */
+                    totalSize += MQTT_GetVariableByteIntegerSize( pProp->value.fourByteInteger );
                     break;
                     
                 default:
@@ -162,6 +181,10 @@ size_t MQTT5_GetPropertiesSize( const MQTT5Properties_t * pProperties )
             }
         }
     }
+    else
+    {
+        /* MISRA Empty body */
+    }
 
     return totalSize;
 }
@@ -170,38 +193,6 @@ size_t MQTT5_GetPropertiesSize( const MQTT5Properties_t * pProperties )
 
 /*-----------------------------------------------------------*/
 
-/**
- * @brief Encode a Variable Byte Integer
- */
-static size_t encodeVariableByteInteger( uint8_t * pBuffer,
-                                         uint32_t value )
-{
-    size_t bytesWritten = 0U;
-    uint8_t encodedByte;
-
-    do
-    {
-        encodedByte = ( uint8_t ) ( value % 128U );
-        value = value / 128U;
-
-        if( value > 0U )
-        {
-            encodedByte = encodedByte | 0x80U;
-        }
-
-        if( pBuffer != NULL )
-        {
-            pBuffer[ bytesWritten ] = encodedByte;
-        }
-
-        bytesWritten++;
-    } while( value > 0U );
-
-    return bytesWritten;
-}
-
-/*-----------------------------------------------------------*/
-
 /**
  * @brief Decode a Variable Byte Integer
  */
@@ -209,29 +200,19 @@ size_t MQTT5_DecodeVariableByteInteger( const uint8_t * pBuffer,
                                         size_t bufferSize,
                                         uint32_t * pValue )
 {
+    size_t value = 0U;
     size_t bytesRead = 0U;
-    uint32_t multiplier = 1U;
-    uint8_t encodedByte;
 
     *pValue = 0U;
 
-    do
+    if( MQTT_DeserializeVariableByteInteger( pBuffer, bufferSize, &value, &bytesRead ) == MQTTSuccess )
     {
-        if( bytesRead >= bufferSize )
-        {
-            return 0U; /* Error: buffer too small */
-        }
-
-        encodedByte = pBuffer[ bytesRead ];
-        *pValue += ( encodedByte & 0x7FU ) * multiplier;
-        multiplier *= 128U;
-        bytesRead++;
-
-        if( bytesRead > 4U )
-        {
-            return 0U; /* Error: malformed VBI */
-        }
-    } while( ( encodedByte & 0x80U ) != 0U );
+        *pValue = ( uint32_t ) value;
+    }
+    else
+    {
+        bytesRead = 0U; /* Error: buffer too small or malformed VBI */
+    }
 
     return bytesRead;
 }
@@ -246,19 +227,25 @@ MQTTStatus_t MQTT5_SerializeProperties( const MQTT5Properties_t * pProperties,
     size_t index = 0U;
     size_t i;
     size_t propertiesLength;
-    size_t vbiLength;
+    size_t vbiLength = 0U;
 
     if( ( pProperties == NULL ) || ( pBuffer == NULL ) || ( pSize == NULL ) )
     {
         status = MQTTBadParameter;
     }
+    else if( pProperties->pFrozen != NULL )
+    {
+        /* The block was encoded by MQTT5_FreezeProperties. */
+        ( void ) memcpy( pBuffer, pProperties->pFrozen, pProperties->frozenSize );
+        *pSize = pProperties->frozenSize;
+    }
     else
     {
         /* Calculate properties length (excluding the length field itself) */
         propertiesLength = MQTT5_GetPropertiesSize( pProperties );
 
         /* Encode properties length as Variable Byte Integer */
-        vbiLength = encodeVariableByteInteger( &pBuffer[ index ], ( uint32_t ) propertiesLength );
+        status = MQTT_SerializeVariableByteInteger( propertiesLength, &pBuffer[ index ], &vbiLength );
         index += vbiLength;
 
         /* Serialize each property */
@@ -351,7 +338,10 @@ MQTTStatus_t MQTT5_SerializeProperties( const MQTT5Properties_t * pProperties,
 
                 case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER:
                     /* Variable Byte Integer */
-                    index += encodeVariableByteInteger( &pBuffer[ index ], pProp->value.fourByteInteger );
+                    status = MQTT_SerializeVariableByteInteger( pProp->value.fourByteInteger,
+                                                                &pBuffer[ index ],
+                                                                &vbiLength );
+                    index += vbiLength;
                     break;
 
                 default:
@@ -368,14 +358,283 @@ MQTTStatus_t MQTT5_SerializeProperties( const MQTT5Properties_t * pProperties,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT5_FreezeProperties( MQTT5Properties_t * pProperties,
+                                     uint8_t * pBuffer,
+                                     size_t bufferSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t propertiesLength = 0U;
+    size_t encodedSize = 0U;
+
+    if( ( pProperties == NULL ) || ( pProperties->pProperties == NULL ) ||
+        ( pProperties->pFrozen != NULL ) || ( pBuffer == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        propertiesLength = MQTT5_GetPropertiesSize( pProperties );
+
+        if( propertiesLength > MQTT5_MAX_PROPERTIES_LENGTH )
+        {
+            status = MQTTBadParameter;
+        }
+        else if( ( MQTT_GetVariableByteIntegerSize( propertiesLength ) + propertiesLength ) > bufferSize )
+        {
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            status = MQTT5_SerializeProperties( pProperties, pBuffer, &encodedSize );
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pProperties->pFrozen = pBuffer;
+        pProperties->frozenSize = encodedSize;
+        pProperties->frozenLength = propertiesLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decode a two byte length and the data following it, and advance the
+ * index past them.
+ */
+static MQTTStatus_t decodeLengthPrefixed( const uint8_t * pBuffer,
+                                          size_t end,
+                                          size_t * pIndex,
+                                          const uint8_t ** ppData,
+                                          uint16_t * pLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = *pIndex;
+    uint16_t length;
+
+    if( ( end - index ) < 2U )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        length = ( uint16_t ) ( ( ( uint16_t ) pBuffer[ index ] << 8U ) |
+                                ( uint16_t ) pBuffer[ index + 1U ] );
+        index += 2U;
+
+        if( ( size_t ) length > ( end - index ) )
+        {
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            *ppData = &pBuffer[ index ];
+            *pLength = length;
+            *pIndex = index + length;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decode the property at an index of a property block, and advance the
+ * index past it.
+ *
+ * @param[in] pBuffer Buffer containing the property block.
+ * @param[in] end Index of the end of the property block.
+ * @param[in,out] pIndex Index of the property identifier.
+ * @param[out] pProperty Decoded property.
+ *
+ * @return MQTTSuccess, or MQTTBadParameter if the property is unknown or runs
+ * past the end of the block.
+ */
+static MQTTStatus_t decodeProperty( const uint8_t * pBuffer,
+                                    size_t end,
+                                    size_t * pIndex,
+                                    MQTT5Property_t * pProperty )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = *pIndex;
+    size_t vbiLength;
+    const uint8_t * pData = NULL;
+
+    /* Read property identifier */
+    pProperty->type = ( MQTT5PropertyType_t ) pBuffer[ index ];
+    index++;
+
+    /* Read property value based on type */
+    switch( pProperty->type )
+    {
+        case MQTT5_PROPERTY_PAYLOAD_FORMAT_INDICATOR:
+        case MQTT5_PROPERTY_REQUEST_PROBLEM_INFORMATION:
+        case MQTT5_PROPERTY_REQUEST_RESPONSE_INFORMATION:
+        case MQTT5_PROPERTY_MAXIMUM_QOS:
+        case MQTT5_PROPERTY_RETAIN_AVAILABLE:
+        case MQTT5_PROPERTY_WILDCARD_SUBSCRIPTION_AVAILABLE:
+        case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER_AVAILABLE:
+        case MQTT5_PROPERTY_SHARED_SUBSCRIPTION_AVAILABLE:
+
+            if( ( end - index ) < 1U )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                pProperty->value.byte = pBuffer[ index ];
+                index++;
+            }
+
+            break;
+
+        case MQTT5_PROPERTY_SERVER_KEEP_ALIVE:
+        case MQTT5_PROPERTY_RECEIVE_MAXIMUM:
+        case MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM:
+        case MQTT5_PROPERTY_TOPIC_ALIAS:
+
+            if( ( end - index ) < 2U )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                pProperty->value.twoByteInteger = ( uint16_t ) ( ( ( uint16_t ) pBuffer[ index ] << 8U ) |
+                                                                 ( uint16_t ) pBuffer[ index + 1U ] );
+                index += 2U;
+            }
+
+            break;
+
+        case MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL:
+        case MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL:
+        case MQTT5_PROPERTY_WILL_DELAY_INTERVAL:
+        case MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE:
+
+            if( ( end - index ) < 4U )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                pProperty->value.fourByteInteger = ( ( uint32_t ) pBuffer[ index ] << 24U ) |
+                                                   ( ( uint32_t ) pBuffer[ index + 1U ] << 16U ) |
+                                                   ( ( uint32_t ) pBuffer[ index + 2U ] << 8U ) |
+                                                   ( uint32_t ) pBuffer[ index + 3U ];
+                index += 4U;
+            }
+
+            break;
+
+        case MQTT5_PROPERTY_CONTENT_TYPE:
+        case MQTT5_PROPERTY_RESPONSE_TOPIC:
+        case MQTT5_PROPERTY_ASSIGNED_CLIENT_IDENTIFIER:
+        case MQTT5_PROPERTY_AUTHENTICATION_METHOD:
+        case MQTT5_PROPERTY_RESPONSE_INFORMATION:
+        case MQTT5_PROPERTY_SERVER_REFERENCE:
+        case MQTT5_PROPERTY_REASON_STRING:
+            /* UTF-8 String */
+            status = decodeLengthPrefixed( pBuffer, end, &index, &pData,
+                                           &pProperty->value.utf8String.length );
+            pProperty->value.utf8String.pString = ( const char * ) pData;
+            break;
+
+        case MQTT5_PROPERTY_CORRELATION_DATA:
+        case MQTT5_PROPERTY_AUTHENTICATION_DATA:
+            /* Binary Data */
+            status = decodeLengthPrefixed( pBuffer, end, &index, &pData,
+                                           &pProperty->value.binaryData.length );
+            pProperty->value.binaryData.pData = pData;
+            break;
+
+        case MQTT5_PROPERTY_USER_PROPERTY:
+            /* Key */
+            status = decodeLengthPrefixed( pBuffer, end, &index, &pData,
+                                           &pProperty->value.userProperty.keyLength );
+            pProperty->value.userProperty.pKey = ( const char * ) pData;
+
+            /* Value */
+            if( status == MQTTSuccess )
+            {
+                status = decodeLengthPrefixed( pBuffer, end, &index, &pData,
+                                               &pProperty->value.userProperty.valueLength );
+                pProperty->value.userProperty.pValue = ( const char * ) pData;
+            }
+
+            break;
+
+        case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER:
+            vbiLength = MQTT5_DecodeVariableByteInteger( &pBuffer[ index ], end - index,
+                                                         &pProperty->value.fourByteInteger );
+
+            if( vbiLength == 0U )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                index += vbiLength;
+            }
+
+            break;
+
+        default:
+            /* Unknown property */
+            status = MQTTBadParameter;
+            break;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        *pIndex = index;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the end of a property block from its length.
+ */
+static MQTTStatus_t getPropertiesEnd( const uint8_t * pBuffer,
+                                      size_t size,
+                                      size_t * pIndex,
+                                      size_t * pEnd )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t propertiesLength;
+    size_t vbiLength;
+
+    /* Decode properties length */
+    vbiLength = MQTT5_DecodeVariableByteInteger( pBuffer, size, &propertiesLength );
+
+    if( ( vbiLength == 0U ) || ( propertiesLength > ( size - vbiLength ) ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        *pIndex = vbiLength;
+        *pEnd = vbiLength + propertiesLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT5_DeserializeProperties( MQTT5Properties_t * pProperties,
                                           const uint8_t * pBuffer,
                                           size_t size )
 {
     MQTTStatus_t status = MQTTSuccess;
     size_t index = 0U;
-    uint32_t propertiesLength;
-    size_t vbiLength;
+    size_t end = 0U;
     MQTT5Property_t property;
 
     if( ( pProperties == NULL ) || ( pBuffer == NULL ) )
@@ -384,123 +643,225 @@ MQTTStatus_t MQTT5_DeserializeProperties( MQTT5Properties_t * pProperties,
     }
     else
     {
-        /* Decode properties length */
-        vbiLength = MQTT5_DecodeVariableByteInteger( pBuffer, size, &propertiesLength );
+        status = getPropertiesEnd( pBuffer, size, &index, &end );
 
-        if( vbiLength == 0U )
+        /* Parse properties */
+        while( ( status == MQTTSuccess ) && ( index < end ) )
         {
-            status = MQTTBadParameter;
+            status = decodeProperty( pBuffer, end, &index, &property );
+
+            /* Add property to collection */
+            if( status == MQTTSuccess )
+            {
+                status = MQTT5_AddProperty( pProperties, &property );
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_FindProperty( const uint8_t * pBuffer,
+                                 size_t size,
+                                 MQTT5PropertyType_t type,
+                                 MQTT5Property_t * pProperty )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = 0U;
+    size_t end = 0U;
+    bool found = false;
+    MQTT5Property_t property;
+
+    if( ( pBuffer == NULL ) || ( pProperty == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = getPropertiesEnd( pBuffer, size, &index, &end );
+
+        /* Decode up to the first match, without storing the others. */
+        while( ( status == MQTTSuccess ) && ( index < end ) && ( found == false ) )
+        {
+            status = decodeProperty( pBuffer, end, &index, &property );
+            found = ( status == MQTTSuccess ) && ( property.type == type );
+        }
+
+        if( found == true )
+        {
+            *pProperty = property;
+        }
+        else if( status == MQTTSuccess )
+        {
+            status = MQTTNoDataAvailable;
         }
         else
         {
-            index = vbiLength;
+            /* Malformed property block. */
+        }
+    }
 
-            /* Parse properties */
-            while( ( index < size ) && ( index < ( vbiLength + propertiesLength ) ) &&
-                   ( status == MQTTSuccess ) )
-            {
-                /* Read property identifier */
-                property.type = ( MQTT5PropertyType_t ) pBuffer[ index ];
-                index++;
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether properties of a type may appear more than once in a packet.
+ */
+static bool isRepeatable( MQTT5PropertyType_t type )
+{
+    return ( type == MQTT5_PROPERTY_USER_PROPERTY ) ||
+           ( type == MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether a type was requested with #MQTT5_RequestProperty.
+ */
+static bool isRequested( const MQTT5PropertyView_t * pView,
+                         MQTT5PropertyType_t type )
+{
+    size_t id = ( size_t ) type;
+
+    return ( ( pView->requested[ id / 8U ] >> ( id % 8U ) ) & 1U ) != 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_InitPropertyView( MQTT5PropertyView_t * pView,
+                                     MQTT5Property_t * pBuffer,
+                                     size_t capacity,
+                                     MQTT5Property_t * pRepeatedBuffer,
+                                     size_t repeatedCapacity )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* Positions are stored in a byte, and fewer properties may appear once
+     * than there are identifiers. */
+    if( ( pView == NULL ) || ( pBuffer == NULL ) || ( capacity == 0U ) ||
+        ( capacity > MQTT5_PROPERTY_INDEX_SIZE ) ||
+        ( ( pRepeatedBuffer == NULL ) && ( repeatedCapacity != 0U ) ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pView, 0, sizeof( MQTT5PropertyView_t ) );
+        pView->pProperties = pBuffer;
+        pView->capacity = capacity;
+        pView->pRepeated = pRepeatedBuffer;
+        pView->repeatedCapacity = repeatedCapacity;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_RequestProperty( MQTT5PropertyView_t * pView,
+                                    MQTT5PropertyType_t type )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t id = ( size_t ) type;
+
+    if( ( pView == NULL ) || ( id == 0U ) || ( id >= MQTT5_PROPERTY_INDEX_SIZE ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pView->requested[ id / 8U ] |= ( uint8_t ) ( 1U << ( id % 8U ) );
+    }
+
+    return status;
+}
 
-                /* Read property value based on type */
-                switch( property.type )
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_DecodePropertyView( MQTT5PropertyView_t * pView,
+                                       const uint8_t * pBuffer,
+                                       size_t size )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = 0U;
+    size_t end = 0U;
+    MQTT5Property_t property;
+    uint8_t * pPosition;
+    uint8_t anyRequested = 0U;
+    size_t i;
+
+    if( ( pView == NULL ) || ( pBuffer == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pView->index, 0, sizeof( pView->index ) );
+        pView->count = 0U;
+        pView->repeatedCount = 0U;
+
+        /* Every type is kept until one is requested. */
+        for( i = 0U; i < sizeof( pView->requested ); i++ )
+        {
+            anyRequested |= pView->requested[ i ];
+        }
+
+        status = getPropertiesEnd( pBuffer, size, &index, &end );
+
+        /* Every property is validated, but only the requested ones are
+         * stored. */
+        while( ( status == MQTTSuccess ) && ( index < end ) )
+        {
+            status = decodeProperty( pBuffer, end, &index, &property );
+
+            if( status != MQTTSuccess )
+            {
+                /* Malformed property block. */
+            }
+            else if( isRepeatable( property.type ) == true )
+            {
+                if( ( anyRequested != 0U ) && ( isRequested( pView, property.type ) == false ) )
                 {
-                    case MQTT5_PROPERTY_PAYLOAD_FORMAT_INDICATOR:
-                    case MQTT5_PROPERTY_REQUEST_PROBLEM_INFORMATION:
-                    case MQTT5_PROPERTY_REQUEST_RESPONSE_INFORMATION:
-                    case MQTT5_PROPERTY_MAXIMUM_QOS:
-                    case MQTT5_PROPERTY_RETAIN_AVAILABLE:
-                    case MQTT5_PROPERTY_WILDCARD_SUBSCRIPTION_AVAILABLE:
-                    case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER_AVAILABLE:
-                    case MQTT5_PROPERTY_SHARED_SUBSCRIPTION_AVAILABLE:
-                        property.value.byte = pBuffer[ index ];
-                        index++;
-                        break;
-
-                    case MQTT5_PROPERTY_SERVER_KEEP_ALIVE:
-                    case MQTT5_PROPERTY_RECEIVE_MAXIMUM:
-                    case MQTT5_PROPERTY_TOPIC_ALIAS_MAXIMUM:
-                    case MQTT5_PROPERTY_TOPIC_ALIAS:
-                        property.value.twoByteInteger = ( ( uint16_t ) pBuffer[ index ] << 8U ) |
-                                                        ( uint16_t ) pBuffer[ index + 1U ];
-                        index += 2U;
-                        break;
-
-                    case MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL:
-                    case MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL:
-                    case MQTT5_PROPERTY_WILL_DELAY_INTERVAL:
-                    case MQTT5_PROPERTY_MAXIMUM_PACKET_SIZE:
-                        property.value.fourByteInteger = ( ( uint32_t ) pBuffer[ index ] << 24U ) |
-                                                         ( ( uint32_t ) pBuffer[ index + 1U ] << 16U ) |
-                                                         ( ( uint32_t ) pBuffer[ index + 2U ] << 8U ) |
-                                                         ( uint32_t ) pBuffer[ index + 3U ];
-                        index += 4U;
-                        break;
-
-                    case MQTT5_PROPERTY_CONTENT_TYPE:
-                    case MQTT5_PROPERTY_RESPONSE_TOPIC:
-                    case MQTT5_PROPERTY_ASSIGNED_CLIENT_IDENTIFIER:
-                    case MQTT5_PROPERTY_AUTHENTICATION_METHOD:
-                    case MQTT5_PROPERTY_RESPONSE_INFORMATION:
-                    case MQTT5_PROPERTY_SERVER_REFERENCE:
-                    case MQTT5_PROPERTY_REASON_STRING:
-                        /* UTF-8 String */
-                        property.value.utf8String.length = ( ( uint16_t ) pBuffer[ index ] << 8U ) |
-                                                           ( uint16_t ) pBuffer[ index + 1U ];
-                        index += 2U;
-                        property.value.utf8String.pString = ( const char * ) &pBuffer[ index ];
-                        index += property.value.utf8String.length;
-                        break;
-
-                    case MQTT5_PROPERTY_CORRELATION_DATA:
-                    case MQTT5_PROPERTY_AUTHENTICATION_DATA:
-                        /* Binary Data */
-                        property.value.binaryData.length = ( ( uint16_t ) pBuffer[ index ] << 8U ) |
-                                                           ( uint16_t ) pBuffer[ index + 1U ];
-                        index += 2U;
-                        property.value.binaryData.pData = &pBuffer[ index ];
-                        index += property.value.binaryData.length;
-                        break;
-
-                    case MQTT5_PROPERTY_USER_PROPERTY:
-                        /* Key */
-                        property.value.userProperty.keyLength = ( ( uint16_t ) pBuffer[ index ] << 8U ) |
-                                                                ( uint16_t ) pBuffer[ index + 1U ];
-                        index += 2U;
-                        property.value.userProperty.pKey = ( const char * ) &pBuffer[ index ];
-                        index += property.value.userProperty.keyLength;
-                        /* Value */
-                        property.value.userProperty.valueLength = ( ( uint16_t ) pBuffer[ index ] << 8U ) |
-                                                                  ( uint16_t ) pBuffer[ index + 1U ];
-                        index += 2U;
-                        property.value.userProperty.pValue = ( const char * ) &pBuffer[ index ];
-                        index += property.value.userProperty.valueLength;
-                        break;
-
-                    case MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER:
-                        vbiLength = MQTT5_DecodeVariableByteInteger( &pBuffer[ index ], size - index,
-                                                              &property.value.fourByteInteger );
-                        if( vbiLength == 0U )
-                        {
-                            status = MQTTBadParameter;
-                        }
-                        else
-                        {
-                            index += vbiLength;
-                        }
-                        break;
-
-                    default:
-                        /* Unknown property - skip it */
-                        status = MQTTBadParameter;
-                        break;
+                    /* Skipped. */
                 }
+                else if( pView->repeatedCount >= pView->repeatedCapacity )
+                {
+                    status = MQTTNoMemory;
+                }
+                else
+                {
+                    pView->pRepeated[ pView->repeatedCount ] = property;
+                    pView->repeatedCount++;
+                }
+            }
+            else
+            {
+                pPosition = &( pView->index[ ( size_t ) property.type ] );
 
-                /* Add property to collection */
-                if( status == MQTTSuccess )
+                if( *pPosition != 0U )
+                {
+                    /* A property that may appear once is a protocol error
+                     * when repeated, whether requested or not. */
+                    status = MQTTBadParameter;
+                }
+                else if( ( anyRequested != 0U ) && ( isRequested( pView, property.type ) == false ) )
+                {
+                    /* Skipped, but remembered to detect a repetition. */
+                    *pPosition = MQTT5_PROPERTY_SKIPPED;
+                }
+                else if( pView->count >= pView->capacity )
+                {
+                    status = MQTTNoMemory;
+                }
+                else
                 {
-                    status = MQTT5_AddProperty( pProperties, &property );
+                    pView->pProperties[ pView->count ] = property;
+                    pView->count++;
+                    *pPosition = ( uint8_t ) pView->count;
                 }
             }
         }
@@ -508,3 +869,138 @@ MQTTStatus_t MQTT5_DeserializeProperties( MQTT5Properties_t * pProperties,
 
     return status;
 }
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_GetViewProperty( const MQTT5PropertyView_t * pView,
+                                    MQTT5PropertyType_t type,
+                                    MQTT5Property_t * pProperty )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t id = ( size_t ) type;
+
+    if( ( pView == NULL ) || ( pProperty == NULL ) || ( id == 0U ) ||
+        ( id >= MQTT5_PROPERTY_INDEX_SIZE ) || ( isRepeatable( type ) == true ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else if( ( pView->index[ id ] == 0U ) || ( pView->index[ id ] == MQTT5_PROPERTY_SKIPPED ) )
+    {
+        status = MQTTNoDataAvailable;
+    }
+    else
+    {
+        *pProperty = pView->pProperties[ pView->index[ id ] - 1U ];
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_InitPropertyCursor( MQTT5PropertyCursor_t * pCursor,
+                                       const uint8_t * pBuffer,
+                                       size_t size )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = 0U;
+    size_t end = 0U;
+    MQTT5Property_t property;
+
+    if( ( pCursor == NULL ) || ( pBuffer == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = getPropertiesEnd( pBuffer, size, &index, &end );
+
+        if( status == MQTTSuccess )
+        {
+            pCursor->pBuffer = pBuffer;
+            pCursor->start = index;
+            pCursor->index = index;
+            pCursor->end = end;
+        }
+
+        /* Walk the block once so later reads need no length checks. */
+        while( ( status == MQTTSuccess ) && ( index < end ) )
+        {
+            status = decodeProperty( pBuffer, end, &index, &property );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_NextProperty( MQTT5PropertyCursor_t * pCursor,
+                                 MQTT5Property_t * pProperty )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pCursor == NULL ) || ( pCursor->pBuffer == NULL ) || ( pProperty == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else if( pCursor->index >= pCursor->end )
+    {
+        status = MQTTNoDataAvailable;
+    }
+    else
+    {
+        status = decodeProperty( pCursor->pBuffer, pCursor->end, &pCursor->index, pProperty );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_CursorFindProperty( MQTT5PropertyCursor_t * pCursor,
+                                       MQTT5PropertyType_t type,
+                                       MQTT5Property_t * pProperty )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    bool found = false;
+    MQTT5Property_t property;
+
+    if( ( pCursor == NULL ) || ( pCursor->pBuffer == NULL ) || ( pProperty == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        while( ( status == MQTTSuccess ) && ( found == false ) )
+        {
+            status = MQTT5_NextProperty( pCursor, &property );
+            found = ( status == MQTTSuccess ) && ( property.type == type );
+        }
+
+        if( found == true )
+        {
+            *pProperty = property;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT5_ResetPropertyCursor( MQTT5PropertyCursor_t * pCursor )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pCursor == NULL ) || ( pCursor->pBuffer == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pCursor->index = pCursor->start;
+    }
+
+    return status;
+}
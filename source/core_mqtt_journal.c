@@ -0,0 +1,1259 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_journal.c
+ * @brief Implements the functions in core_mqtt_journal.h.
+ */
+#include <assert.h>
+#include <string.h>
+#include "core_mqtt_journal.h"
+#include "core_mqtt_state.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Entry holding a stored PUBLISH packet.
+ */
+#define MQTT_JOURNAL_ENTRY_PACKET    ( ( uint8_t ) 0x50U )
+
+/**
+ * @brief Entry recording that a stored PUBLISH packet was cleared.
+ */
+#define MQTT_JOURNAL_ENTRY_CLEAR     ( ( uint8_t ) 0x43U )
+
+/**
+ * @brief Entry holding the new state of a record.
+ */
+#define MQTT_JOURNAL_ENTRY_STATE     ( ( uint8_t ) 0x53U )
+
+/**
+ * @brief Entry recording that every record and packet was cleared.
+ */
+#define MQTT_JOURNAL_ENTRY_RESET     ( ( uint8_t ) 0x52U )
+
+/**
+ * @brief Bytes of an entry before its data: type, information, packet ID and
+ * length of the data.
+ */
+#define MQTT_JOURNAL_ENTRY_HEADER    ( 8U )
+
+/**
+ * @brief Bit of the information byte of a state entry set for an outgoing
+ * publish record. The QoS is kept in the bits above it.
+ */
+#define MQTT_JOURNAL_OUTGOING        ( 0x01U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Read a big endian 4 byte value.
+ *
+ * @param[in] pData First byte of the value.
+ *
+ * @return The value.
+ */
+static uint32_t readUint32( const uint8_t * pData );
+
+/**
+ * @brief Write a big endian 4 byte value.
+ *
+ * @param[out] pData First byte of the value.
+ * @param[in] value The value.
+ */
+static void writeUint32( uint8_t * pData,
+                         uint32_t value );
+
+/**
+ * @brief Calculate the checksum of bytes written in a generation of a half.
+ *
+ * Including the generation keeps entries left in a half by an earlier
+ * generation from being read as part of the current one.
+ *
+ * @param[in] generation Generation of the half.
+ * @param[in] pData The bytes.
+ * @param[in] length Number of bytes.
+ *
+ * @return The FNV-1a hash of the generation and the bytes.
+ */
+static uint32_t checksum( uint32_t generation,
+                          const uint8_t * pData,
+                          size_t length );
+
+/**
+ * @brief Make bytes of the journal durable with the flush callback, if any.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] offset Offset of the first byte.
+ * @param[in] length Number of bytes.
+ */
+static void flush( const MQTTSessionJournal_t * pJournal,
+                   size_t offset,
+                   size_t length );
+
+/**
+ * @brief Find the slot of a packet ID in the packet index.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] packetId Packet ID to search for.
+ *
+ * @return The slot, or the number of slots if the packet ID is not indexed.
+ */
+static size_t findSlot( const MQTTSessionJournal_t * pJournal,
+                        uint16_t packetId );
+
+/**
+ * @brief Index the entry of a PUBLISH packet, replacing any for its packet ID.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[in] offset Offset of its entry.
+ *
+ * @return `false` if every slot is used; `true` otherwise.
+ */
+static bool setSlot( MQTTSessionJournal_t * pJournal,
+                     uint16_t packetId,
+                     size_t offset );
+
+/**
+ * @brief Remove a slot from the packet index, moving back the slots which
+ * follow it so that no lookup stops early at the emptied slot.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] slot Slot to remove.
+ */
+static void removeSlot( MQTTSessionJournal_t * pJournal,
+                        size_t slot );
+
+/**
+ * @brief Write an entry header at an offset.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] offset Offset of the entry.
+ * @param[in] type Type of the entry.
+ * @param[in] info Information byte of the entry.
+ * @param[in] packetId Packet ID of the entry.
+ * @param[in] length Length of the data of the entry.
+ */
+static void writeEntryHeader( const MQTTSessionJournal_t * pJournal,
+                              size_t offset,
+                              uint8_t type,
+                              uint8_t info,
+                              uint16_t packetId,
+                              size_t length );
+
+/**
+ * @brief Write the checksum of an entry whose header and data are written.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] offset Offset of the entry.
+ * @param[in] generation Generation of the half holding the entry.
+ *
+ * @return The size of the entry.
+ */
+static size_t sealEntry( const MQTTSessionJournal_t * pJournal,
+                         size_t offset,
+                         uint32_t generation );
+
+/**
+ * @brief Check an entry read from the journal.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] offset Offset of the entry.
+ * @param[in] end Offset of the end of the half holding the entry.
+ * @param[in] generation Generation of the half.
+ *
+ * @return The size of the entry, or 0 if there is no valid entry at the offset.
+ */
+static size_t readEntry( const MQTTSessionJournal_t * pJournal,
+                         size_t offset,
+                         size_t end,
+                         uint32_t generation );
+
+/**
+ * @brief Write a state entry at an offset.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] offset Offset of the entry.
+ * @param[in] generation Generation of the half holding the entry.
+ * @param[in] pRecord The record.
+ * @param[in] isOutgoing Whether the record tracks an outgoing publish.
+ *
+ * @return The size of the entry.
+ */
+static size_t writeStateEntry( const MQTTSessionJournal_t * pJournal,
+                               size_t offset,
+                               uint32_t generation,
+                               const MQTTPubAckInfo_t * pRecord,
+                               bool isOutgoing );
+
+/**
+ * @brief Read the header of a half of the journal.
+ *
+ * @param[in] pJournal The journal.
+ * @param[in] half Offset of the half.
+ * @param[out] pGeneration Generation of the half.
+ *
+ * @return `true` if the half holds a journal; `false` otherwise.
+ */
+static bool readHalfHeader( const MQTTSessionJournal_t * pJournal,
+                            size_t half,
+                            uint32_t * pGeneration );
+
+/**
+ * @brief Copy the entries of the records of a context and of their stored
+ * packets to the other half of the journal, and append to it from then on.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] pJournal The journal.
+ *
+ * @return `false` if the entries do not fit in a half; `true` otherwise.
+ */
+static bool compact( const MQTTContext_t * pContext,
+                     MQTTSessionJournal_t * pJournal );
+
+/**
+ * @brief Make room for an entry at the end of the journal, compacting it if
+ * it is full or mostly taken by entries no longer needed.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] pJournal The journal.
+ * @param[in] entrySize Size of the entry.
+ * @param[out] pCompacted Whether the journal was compacted.
+ *
+ * @return `true` if the entry fits; `false` otherwise.
+ */
+static bool reserveEntry( const MQTTContext_t * pContext,
+                          MQTTSessionJournal_t * pJournal,
+                          size_t entrySize,
+                          bool * pCompacted );
+
+/**
+ * @brief Apply a state entry to a record array whose records are kept from
+ * its start, in order.
+ *
+ * @param[in] records The records.
+ * @param[in] recordCount Number of records in the array.
+ * @param[in,out] pUsedCount Number of records used.
+ * @param[in] packetId Packet ID of the record.
+ * @param[in] qos QoS of the record.
+ * @param[in] state New state of the record.
+ *
+ * @return `false` if the array is full; `true` otherwise.
+ */
+static bool restoreRecord( MQTTPubAckInfo_t * records,
+                           size_t recordCount,
+                           size_t * pUsedCount,
+                           uint16_t packetId,
+                           MQTTQoS_t qos,
+                           MQTTPublishState_t state );
+
+/**
+ * @brief Rebuild the records and packet index of a context from the entries
+ * of the half of the journal appended to.
+ *
+ * @param[in] pContext MQTT context.
+ * @param[in] pJournal The journal.
+ *
+ * @return #MQTTNoMemory if the records or the index are full;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t replayJournal( MQTTContext_t * pContext,
+                                   MQTTSessionJournal_t * pJournal );
+
+/**
+ * @brief Set the next packet ID of a context past the restored outgoing
+ * records, so that new publishes do not reuse their packet IDs.
+ *
+ * @param[in] pContext MQTT context.
+ */
+static void restoreNextPacketId( MQTTContext_t * pContext );
+
+/**
+ * @brief The #MQTTStorePacketForRetransmit callback of the journal.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[in] pMqttVec The PUBLISH packet.
+ *
+ * @return `true` if the packet was journaled; `false` otherwise.
+ */
+static bool storePacket( struct MQTTContext * pContext,
+                         uint16_t packetId,
+                         MQTTVec_t * pMqttVec );
+
+/**
+ * @brief The #MQTTRetrievePacketForRetransmit callback of the journal.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[out] pSerializedMqttVec The journaled packet.
+ * @param[out] pSerializedMqttVecLen Length of the journaled packet.
+ *
+ * @return `true` if the packet was found; `false` otherwise.
+ */
+static bool retrievePacket( struct MQTTContext * pContext,
+                            uint16_t packetId,
+                            uint8_t ** pSerializedMqttVec,
+                            size_t * pSerializedMqttVecLen );
+
+/**
+ * @brief The #MQTTClearPacketForRetransmit callback of the journal.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] packetId Packet ID of the acknowledged PUBLISH.
+ */
+static void clearPacket( struct MQTTContext * pContext,
+                         uint16_t packetId );
+
+/**
+ * @brief The #MQTTRecordStateCallback_t callback of the journal.
+ *
+ * @param[in] pContext MQTT context the journal is registered with.
+ * @param[in] packetId Packet ID of the record, or #MQTT_PACKET_ID_INVALID
+ * when every record is cleared.
+ * @param[in] qos QoS of the record.
+ * @param[in] state New state of the record.
+ * @param[in] isOutgoing Whether the record tracks an outgoing publish.
+ */
+static void recordState( const MQTTContext_t * pContext,
+                         uint16_t packetId,
+                         MQTTQoS_t qos,
+                         MQTTPublishState_t state,
+                         bool isOutgoing );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Bytes identifying a half of a journal.
+ */
+static const uint8_t journalMagic[ 4 ] = { 0x4DU, 0x51U, 0x4AU, 0x31U };
+
+/*-----------------------------------------------------------*/
+
+static uint32_t readUint32( const uint8_t * pData )
+{
+    return ( ( uint32_t ) pData[ 0 ] << 24 ) |
+           ( ( uint32_t ) pData[ 1 ] << 16 ) |
+           ( ( uint32_t ) pData[ 2 ] << 8 ) |
+           ( uint32_t ) pData[ 3 ];
+}
+
+/*-----------------------------------------------------------*/
+
+static void writeUint32( uint8_t * pData,
+                         uint32_t value )
+{
+    pData[ 0 ] = ( uint8_t ) ( ( value >> 24 ) & 0xFFU );
+    pData[ 1 ] = ( uint8_t ) ( ( value >> 16 ) & 0xFFU );
+    pData[ 2 ] = ( uint8_t ) ( ( value >> 8 ) & 0xFFU );
+    pData[ 3 ] = ( uint8_t ) ( value & 0xFFU );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t checksum( uint32_t generation,
+                          const uint8_t * pData,
+                          size_t length )
+{
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for( i = 0U; i < 4U; i++ )
+    {
+        hash ^= ( generation >> ( 24U - ( 8U * i ) ) ) & 0xFFU;
+        hash *= 16777619U;
+    }
+
+    for( i = 0U; i < length; i++ )
+    {
+        hash ^= pData[ i ];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
+static void flush( const MQTTSessionJournal_t * pJournal,
+                   size_t offset,
+                   size_t length )
+{
+    if( pJournal->flushFunction != NULL )
+    {
+        pJournal->flushFunction( &pJournal->pBuffer[ offset ], length );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t findSlot( const MQTTSessionJournal_t * pJournal,
+                        uint16_t packetId )
+{
+    /* Fibonacci hashing, as for the packet ID index of the state records. */
+    uint32_t hash = ( uint32_t ) packetId * 2654435769U;
+    size_t slot = ( size_t ) ( ( ( uint64_t ) hash * ( uint64_t ) pJournal->slotCount ) >> 32 );
+    size_t found = pJournal->slotCount;
+
+    /* There are more slots than outgoing records, so an empty slot ends every
+     * probe sequence. */
+    while( pJournal->pSlots[ slot ].packetId != MQTT_PACKET_ID_INVALID )
+    {
+        if( pJournal->pSlots[ slot ].packetId == packetId )
+        {
+            found = slot;
+            break;
+        }
+
+        slot = ( slot + 1U ) % pJournal->slotCount;
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool setSlot( MQTTSessionJournal_t * pJournal,
+                     uint16_t packetId,
+                     size_t offset )
+{
+    uint32_t hash = ( uint32_t ) packetId * 2654435769U;
+    size_t slot = ( size_t ) ( ( ( uint64_t ) hash * ( uint64_t ) pJournal->slotCount ) >> 32 );
+    size_t probes = 0U;
+
+    /* Claim the slot of the packet ID, or the first empty one, keeping one
+     * empty slot to end probe sequences. */
+    while( ( pJournal->pSlots[ slot ].packetId != MQTT_PACKET_ID_INVALID ) &&
+           ( pJournal->pSlots[ slot ].packetId != packetId ) &&
+           ( probes < pJournal->slotCount ) )
+    {
+        slot = ( slot + 1U ) % pJournal->slotCount;
+        probes++;
+    }
+
+    if( probes < ( pJournal->slotCount - 1U ) )
+    {
+        pJournal->pSlots[ slot ].packetId = packetId;
+        pJournal->pSlots[ slot ].offset = offset;
+    }
+
+    return probes < ( pJournal->slotCount - 1U );
+}
+
+/*-----------------------------------------------------------*/
+
+static void removeSlot( MQTTSessionJournal_t * pJournal,
+                        size_t slot )
+{
+    size_t slotCount = pJournal->slotCount;
+    size_t hole = slot;
+    size_t next = ( slot + 1U ) % slotCount;
+    size_t home = 0U;
+    uint32_t hash = 0U;
+
+    while( pJournal->pSlots[ next ].packetId != MQTT_PACKET_ID_INVALID )
+    {
+        hash = ( uint32_t ) pJournal->pSlots[ next ].packetId * 2654435769U;
+        home = ( size_t ) ( ( ( uint64_t ) hash * ( uint64_t ) slotCount ) >> 32 );
+
+        /* A slot can fill the hole only if the hole lies between its home and
+         * its current position. */
+        if( ( ( next + slotCount - home ) % slotCount ) >= ( ( next + slotCount - hole ) % slotCount ) )
+        {
+            pJournal->pSlots[ hole ] = pJournal->pSlots[ next ];
+            hole = next;
+        }
+
+        next = ( next + 1U ) % slotCount;
+    }
+
+    pJournal->pSlots[ hole ].packetId = MQTT_PACKET_ID_INVALID;
+    pJournal->pSlots[ hole ].offset = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+static void writeEntryHeader( const MQTTSessionJournal_t * pJournal,
+                              size_t offset,
+                              uint8_t type,
+                              uint8_t info,
+                              uint16_t packetId,
+                              size_t length )
+{
+    uint8_t * pEntry = &pJournal->pBuffer[ offset ];
+
+    pEntry[ 0 ] = type;
+    pEntry[ 1 ] = info;
+    pEntry[ 2 ] = ( uint8_t ) ( packetId >> 8 );
+    pEntry[ 3 ] = ( uint8_t ) ( packetId & 0xFFU );
+    writeUint32( &pEntry[ 4 ], ( uint32_t ) length );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t sealEntry( const MQTTSessionJournal_t * pJournal,
+                         size_t offset,
+                         uint32_t generation )
+{
+    uint8_t * pEntry = &pJournal->pBuffer[ offset ];
+    size_t length = MQTT_JOURNAL_ENTRY_HEADER + ( size_t ) readUint32( &pEntry[ 4 ] );
+
+    writeUint32( &pEntry[ length ], checksum( generation, pEntry, length ) );
+
+    return length + 4U;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t readEntry( const MQTTSessionJournal_t * pJournal,
+                         size_t offset,
+                         size_t end,
+                         uint32_t generation )
+{
+    const uint8_t * pEntry = &pJournal->pBuffer[ offset ];
+    size_t entrySize = 0U;
+    size_t length = 0U;
+    uint16_t packetId = 0U;
+    bool isValid = false;
+
+    if( ( end - offset ) >= MQTT_JOURNAL_ENTRY_OVERHEAD )
+    {
+        length = ( size_t ) readUint32( &pEntry[ 4 ] );
+        packetId = ( uint16_t ) ( ( ( uint16_t ) pEntry[ 2 ] << 8 ) | ( uint16_t ) pEntry[ 3 ] );
+
+        switch( pEntry[ 0 ] )
+        {
+            case MQTT_JOURNAL_ENTRY_PACKET:
+                isValid = ( packetId != MQTT_PACKET_ID_INVALID ) &&
+                          ( length <= ( end - offset - MQTT_JOURNAL_ENTRY_OVERHEAD ) );
+                break;
+
+            case MQTT_JOURNAL_ENTRY_CLEAR:
+                isValid = ( packetId != MQTT_PACKET_ID_INVALID ) && ( length == 0U );
+                break;
+
+            case MQTT_JOURNAL_ENTRY_STATE:
+                isValid = ( packetId != MQTT_PACKET_ID_INVALID ) && ( length == 1U ) &&
+                          ( ( end - offset ) >= MQTT_JOURNAL_STATE_ENTRY_SIZE ) &&
+                          ( ( pEntry[ 1 ] >> 1 ) <= ( uint8_t ) MQTTQoS2 ) &&
+                          ( pEntry[ MQTT_JOURNAL_ENTRY_HEADER ] <= ( uint8_t ) MQTTPublishDone );
+                break;
+
+            case MQTT_JOURNAL_ENTRY_RESET:
+                isValid = ( length == 0U );
+                break;
+
+            default:
+                /* Not an entry, such as the end of the journal. */
+                break;
+        }
+    }
+
+    /* An entry torn by a crash, or left by an earlier generation, does not
+     * match its checksum. */
+    if( ( isValid == true ) &&
+        ( readUint32( &pEntry[ MQTT_JOURNAL_ENTRY_HEADER + length ] ) ==
+          checksum( generation, pEntry, MQTT_JOURNAL_ENTRY_HEADER + length ) ) )
+    {
+        entrySize = MQTT_JOURNAL_ENTRY_OVERHEAD + length;
+    }
+
+    return entrySize;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t writeStateEntry( const MQTTSessionJournal_t * pJournal,
+                               size_t offset,
+                               uint32_t generation,
+                               const MQTTPubAckInfo_t * pRecord,
+                               bool isOutgoing )
+{
+    uint8_t info = ( uint8_t ) ( ( uint8_t ) pRecord->qos << 1 );
+
+    if( isOutgoing == true )
+    {
+        info |= MQTT_JOURNAL_OUTGOING;
+    }
+
+    writeEntryHeader( pJournal, offset, MQTT_JOURNAL_ENTRY_STATE, info, pRecord->packetId, 1U );
+    pJournal->pBuffer[ offset + MQTT_JOURNAL_ENTRY_HEADER ] = ( uint8_t ) pRecord->publishState;
+
+    return sealEntry( pJournal, offset, generation );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool readHalfHeader( const MQTTSessionJournal_t * pJournal,
+                            size_t half,
+                            uint32_t * pGeneration )
+{
+    const uint8_t * pHeader = &pJournal->pBuffer[ half ];
+    uint32_t generation = readUint32( &pHeader[ 4 ] );
+    bool isValid;
+
+    isValid = ( memcmp( pHeader, journalMagic, sizeof( journalMagic ) ) == 0 ) &&
+              ( readUint32( &pHeader[ 8 ] ) == checksum( generation, pHeader, 8U ) );
+
+    *pGeneration = generation;
+
+    return isValid;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool compact( const MQTTContext_t * pContext,
+                     MQTTSessionJournal_t * pJournal )
+{
+    size_t halfSize = pJournal->bufferSize / 2U;
+    size_t target = ( pJournal->activeHalf == 0U ) ? halfSize : 0U;
+    size_t end = target + halfSize;
+    size_t offset = target + MQTT_JOURNAL_HEADER_SIZE;
+    uint32_t generation = pJournal->generation + 1U;
+    const MQTTPubAckInfo_t * records = NULL;
+    const MQTTPubAckIndex_t * pIndex = NULL;
+    size_t recordCount = 0U;
+    size_t position;
+    size_t recordIndex;
+    size_t slot;
+    size_t entrySize;
+    size_t direction;
+    bool fits = true;
+
+    /* Outgoing records first, each after its stored packet, then incoming
+     * records, in the order the state engine keeps them. */
+    for( direction = 0U; ( direction < 2U ) && ( fits == true ); direction++ )
+    {
+        records = ( direction == 0U ) ? pContext->outgoingPublishRecords : pContext->incomingPublishRecords;
+        recordCount = ( direction == 0U ) ? pContext->outgoingPublishRecordMaxCount : pContext->incomingPublishRecordMaxCount;
+        pIndex = ( direction == 0U ) ? pContext->outgoingPublishIndex : pContext->incomingPublishIndex;
+
+        for( position = 0U; ( position < recordCount ) && ( fits == true ); position++ )
+        {
+            recordIndex = ( pIndex != NULL ) ? ( ( pIndex->head + position ) % recordCount ) : position;
+
+            if( ( records[ recordIndex ].packetId != MQTT_PACKET_ID_INVALID ) &&
+                ( records[ recordIndex ].publishState != MQTTStateNull ) )
+            {
+                slot = ( direction == 0U ) ? findSlot( pJournal, records[ recordIndex ].packetId ) : pJournal->slotCount;
+                entrySize = 0U;
+
+                if( slot != pJournal->slotCount )
+                {
+                    entrySize = MQTT_JOURNAL_ENTRY_OVERHEAD +
+                                ( size_t ) readUint32( &pJournal->pBuffer[ pJournal->pSlots[ slot ].offset + 4U ] );
+                }
+
+                fits = ( ( end - offset ) >= ( entrySize + MQTT_JOURNAL_STATE_ENTRY_SIZE ) );
+
+                if( fits == true )
+                {
+                    if( entrySize > 0U )
+                    {
+                        ( void ) memcpy( &pJournal->pBuffer[ offset ],
+                                         &pJournal->pBuffer[ pJournal->pSlots[ slot ].offset ],
+                                         entrySize - 4U );
+                        offset += sealEntry( pJournal, offset, generation );
+                    }
+
+                    offset += writeStateEntry( pJournal, offset, generation, &records[ recordIndex ], direction == 0U );
+                }
+            }
+        }
+    }
+
+    if( fits == true )
+    {
+        /* The entries must be durable before the header makes the half the
+         * current one. */
+        flush( pJournal, target + MQTT_JOURNAL_HEADER_SIZE, offset - target - MQTT_JOURNAL_HEADER_SIZE );
+
+        ( void ) memcpy( &pJournal->pBuffer[ target ], journalMagic, sizeof( journalMagic ) );
+        writeUint32( &pJournal->pBuffer[ target + 4U ], generation );
+        writeUint32( &pJournal->pBuffer[ target + 8U ], checksum( generation, &pJournal->pBuffer[ target ], 8U ) );
+        writeUint32( &pJournal->pBuffer[ target + 12U ], 0U );
+        flush( pJournal, target, MQTT_JOURNAL_HEADER_SIZE );
+
+        pJournal->activeHalf = target;
+        pJournal->generation = generation;
+        pJournal->writeOffset = offset;
+        pJournal->liveBytes = offset - target - MQTT_JOURNAL_HEADER_SIZE;
+
+        /* Index the copied packets at their new offsets. */
+        ( void ) memset( pJournal->pSlots, 0x00, pJournal->slotCount * sizeof( *pJournal->pSlots ) );
+
+        for( offset = target + MQTT_JOURNAL_HEADER_SIZE; offset < pJournal->writeOffset; offset += entrySize )
+        {
+            entrySize = MQTT_JOURNAL_ENTRY_OVERHEAD + ( size_t ) readUint32( &pJournal->pBuffer[ offset + 4U ] );
+
+            if( pJournal->pBuffer[ offset ] == MQTT_JOURNAL_ENTRY_PACKET )
+            {
+                ( void ) setSlot( pJournal,
+                                  ( uint16_t ) ( ( ( uint16_t ) pJournal->pBuffer[ offset + 2U ] << 8 ) |
+                                                 ( uint16_t ) pJournal->pBuffer[ offset + 3U ] ),
+                                  offset );
+            }
+        }
+    }
+    else
+    {
+        LogError( ( "Session state does not fit in half of a journal of %lu bytes.",
+                    ( unsigned long ) pJournal->bufferSize ) );
+    }
+
+    return fits;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool reserveEntry( const MQTTContext_t * pContext,
+                          MQTTSessionJournal_t * pJournal,
+                          size_t entrySize,
+                          bool * pCompacted )
+{
+    size_t end = pJournal->activeHalf + ( pJournal->bufferSize / 2U );
+    size_t usedBytes = pJournal->writeOffset - pJournal->activeHalf - MQTT_JOURNAL_HEADER_SIZE;
+    size_t deadBytes = ( usedBytes > pJournal->liveBytes ) ? ( usedBytes - pJournal->liveBytes ) : 0U;
+
+    *pCompacted = false;
+
+    /* Compacting once the dead entries outnumber the live ones bounds the
+     * journal read on a restart by the session state, while copying each
+     * live entry only once for every entry that died. */
+    if( ( ( end - pJournal->writeOffset ) < entrySize ) ||
+        ( ( deadBytes > pJournal->liveBytes ) && ( deadBytes >= MQTT_JOURNAL_COMPACTION_THRESHOLD ) ) )
+    {
+        *pCompacted = compact( pContext, pJournal );
+        end = pJournal->activeHalf + ( pJournal->bufferSize / 2U );
+    }
+
+    return ( end - pJournal->writeOffset ) >= entrySize;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool restoreRecord( MQTTPubAckInfo_t * records,
+                           size_t recordCount,
+                           size_t * pUsedCount,
+                           uint16_t packetId,
+                           MQTTQoS_t qos,
+                           MQTTPublishState_t state )
+{
+    size_t recordIndex = 0U;
+    bool restored = true;
+
+    while( ( recordIndex < *pUsedCount ) && ( records[ recordIndex ].packetId != packetId ) )
+    {
+        recordIndex++;
+    }
+
+    if( ( recordIndex < *pUsedCount ) && ( state != MQTTStateNull ) && ( state != MQTTPubRelSend ) )
+    {
+        records[ recordIndex ].qos = qos;
+        records[ recordIndex ].publishState = state;
+    }
+    else
+    {
+        /* Removed records close up, and a record awaiting a PUBREL moves to
+         * the end, as in the state engine. */
+        if( recordIndex < *pUsedCount )
+        {
+            ( void ) memmove( &records[ recordIndex ],
+                              &records[ recordIndex + 1U ],
+                              ( *pUsedCount - recordIndex - 1U ) * sizeof( *records ) );
+            ( *pUsedCount )--;
+            ( void ) memset( &records[ *pUsedCount ], 0x00, sizeof( *records ) );
+        }
+
+        if( state == MQTTStateNull )
+        {
+            /* Nothing to add. */
+        }
+        else if( *pUsedCount == recordCount )
+        {
+            restored = false;
+        }
+        else
+        {
+            records[ *pUsedCount ].packetId = packetId;
+            records[ *pUsedCount ].qos = qos;
+            records[ *pUsedCount ].publishState = state;
+            ( *pUsedCount )++;
+        }
+    }
+
+    return restored;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t replayJournal( MQTTContext_t * pContext,
+                                   MQTTSessionJournal_t * pJournal )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t end = pJournal->activeHalf + ( pJournal->bufferSize / 2U );
+    size_t offset = pJournal->activeHalf + MQTT_JOURNAL_HEADER_SIZE;
+    size_t entrySize = readEntry( pJournal, offset, end, pJournal->generation );
+    size_t outgoingCount = 0U;
+    size_t incomingCount = 0U;
+    size_t slot;
+    const uint8_t * pEntry;
+    uint16_t packetId;
+    MQTTQoS_t qos;
+    MQTTPublishState_t state;
+    bool restored = true;
+
+    while( ( entrySize > 0U ) && ( status == MQTTSuccess ) )
+    {
+        pEntry = &pJournal->pBuffer[ offset ];
+        packetId = ( uint16_t ) ( ( ( uint16_t ) pEntry[ 2 ] << 8 ) | ( uint16_t ) pEntry[ 3 ] );
+
+        switch( pEntry[ 0 ] )
+        {
+            case MQTT_JOURNAL_ENTRY_PACKET:
+                restored = setSlot( pJournal, packetId, offset );
+                break;
+
+            case MQTT_JOURNAL_ENTRY_CLEAR:
+                slot = findSlot( pJournal, packetId );
+
+                if( slot != pJournal->slotCount )
+                {
+                    removeSlot( pJournal, slot );
+                }
+
+                break;
+
+            case MQTT_JOURNAL_ENTRY_STATE:
+                qos = ( MQTTQoS_t ) ( pEntry[ 1 ] >> 1 );
+                state = ( MQTTPublishState_t ) pEntry[ MQTT_JOURNAL_ENTRY_HEADER ];
+
+                if( ( pEntry[ 1 ] & MQTT_JOURNAL_OUTGOING ) != 0U )
+                {
+                    restored = restoreRecord( pContext->outgoingPublishRecords,
+                                              pContext->outgoingPublishRecordMaxCount,
+                                              &outgoingCount,
+                                              packetId,
+                                              qos,
+                                              state );
+                }
+                else
+                {
+                    restored = restoreRecord( pContext->incomingPublishRecords,
+                                              pContext->incomingPublishRecordMaxCount,
+                                              &incomingCount,
+                                              packetId,
+                                              qos,
+                                              state );
+                }
+
+                break;
+
+            default:
+                /* A reset entry. */
+                ( void ) memset( pContext->outgoingPublishRecords, 0x00, outgoingCount * sizeof( *pContext->outgoingPublishRecords ) );
+                ( void ) memset( pContext->incomingPublishRecords, 0x00, incomingCount * sizeof( *pContext->incomingPublishRecords ) );
+                ( void ) memset( pJournal->pSlots, 0x00, pJournal->slotCount * sizeof( *pJournal->pSlots ) );
+                outgoingCount = 0U;
+                incomingCount = 0U;
+                break;
+        }
+
+        if( restored == false )
+        {
+            LogError( ( "Journal holds more records than the context: PacketId=%hu.",
+                        ( unsigned short ) packetId ) );
+            status = MQTTNoMemory;
+        }
+
+        offset += entrySize;
+        entrySize = readEntry( pJournal, offset, end, pJournal->generation );
+    }
+
+    pJournal->writeOffset = offset;
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void restoreNextPacketId( MQTTContext_t * pContext )
+{
+    const MQTTPubAckInfo_t * records = pContext->outgoingPublishRecords;
+    size_t recordIndex;
+    uint16_t packetId = 0U;
+    bool inUse = true;
+
+    for( recordIndex = 0U; recordIndex < pContext->outgoingPublishRecordMaxCount; recordIndex++ )
+    {
+        if( records[ recordIndex ].packetId > packetId )
+        {
+            packetId = records[ recordIndex ].packetId;
+        }
+    }
+
+    if( packetId != 0U )
+    {
+        /* Continue after the highest packet ID. IDs that wrapped around
+         * below it may still be held by a record, so skip those. */
+        while( inUse == true )
+        {
+            if( packetId == ( uint16_t ) UINT16_MAX )
+            {
+                packetId = 1U;
+            }
+            else
+            {
+                packetId++;
+            }
+
+            inUse = false;
+
+            for( recordIndex = 0U; recordIndex < pContext->outgoingPublishRecordMaxCount; recordIndex++ )
+            {
+                if( records[ recordIndex ].packetId == packetId )
+                {
+                    inUse = true;
+                }
+            }
+        }
+
+        pContext->nextPacketId = packetId;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool storePacket( struct MQTTContext * pContext,
+                         uint16_t packetId,
+                         MQTTVec_t * pMqttVec )
+{
+    MQTTSessionJournal_t * pJournal = pContext->pSessionJournal;
+    size_t packetSize = MQTT_GetBytesInMQTTVec( pMqttVec );
+    size_t entrySize = MQTT_JOURNAL_ENTRY_OVERHEAD + packetSize;
+    size_t offset = 0U;
+    size_t slot = 0U;
+    bool compacted = false;
+    bool stored = false;
+
+    assert( pJournal != NULL );
+
+    if( reserveEntry( pContext, pJournal, entrySize, &compacted ) == false )
+    {
+        LogError( ( "PUBLISH of %lu bytes does not fit in the journal.",
+                    ( unsigned long ) packetSize ) );
+    }
+    else
+    {
+        offset = pJournal->writeOffset;
+        writeEntryHeader( pJournal, offset, MQTT_JOURNAL_ENTRY_PACKET, 0U, packetId, packetSize );
+        MQTT_SerializeMQTTVec( &pJournal->pBuffer[ offset + MQTT_JOURNAL_ENTRY_HEADER ], pMqttVec );
+        pJournal->writeOffset += sealEntry( pJournal, offset, pJournal->generation );
+        flush( pJournal, offset, entrySize );
+
+        /* A PUBLISH sent again with the same packet ID replaces its copy. */
+        slot = findSlot( pJournal, packetId );
+
+        if( slot != pJournal->slotCount )
+        {
+            pJournal->liveBytes -= MQTT_JOURNAL_ENTRY_OVERHEAD +
+                                   ( size_t ) readUint32( &pJournal->pBuffer[ pJournal->pSlots[ slot ].offset + 4U ] );
+        }
+
+        pJournal->liveBytes += entrySize;
+        stored = setSlot( pJournal, packetId, offset );
+    }
+
+    return stored;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool retrievePacket( struct MQTTContext * pContext,
+                            uint16_t packetId,
+                            uint8_t ** pSerializedMqttVec,
+                            size_t * pSerializedMqttVecLen )
+{
+    const MQTTSessionJournal_t * pJournal = pContext->pSessionJournal;
+    size_t slot = 0U;
+    size_t offset = 0U;
+    bool found = false;
+
+    assert( pJournal != NULL );
+
+    slot = findSlot( pJournal, packetId );
+
+    if( slot != pJournal->slotCount )
+    {
+        offset = pJournal->pSlots[ slot ].offset;
+        *pSerializedMqttVec = &pJournal->pBuffer[ offset + MQTT_JOURNAL_ENTRY_HEADER ];
+        *pSerializedMqttVecLen = ( size_t ) readUint32( &pJournal->pBuffer[ offset + 4U ] );
+        found = true;
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static void clearPacket( struct MQTTContext * pContext,
+                         uint16_t packetId )
+{
+    MQTTSessionJournal_t * pJournal = pContext->pSessionJournal;
+    size_t slot = 0U;
+    size_t offset = 0U;
+    bool compacted = false;
+
+    assert( pJournal != NULL );
+
+    if( reserveEntry( pContext, pJournal, MQTT_JOURNAL_ENTRY_OVERHEAD, &compacted ) == false )
+    {
+        LogError( ( "Clear of PacketId=%hu does not fit in the journal.",
+                    ( unsigned short ) packetId ) );
+    }
+    else
+    {
+        /* A compaction drops the packets of removed records. */
+        slot = findSlot( pJournal, packetId );
+
+        if( slot != pJournal->slotCount )
+        {
+            pJournal->liveBytes -= MQTT_JOURNAL_ENTRY_OVERHEAD +
+                                   ( size_t ) readUint32( &pJournal->pBuffer[ pJournal->pSlots[ slot ].offset + 4U ] );
+            removeSlot( pJournal, slot );
+
+            offset = pJournal->writeOffset;
+            writeEntryHeader( pJournal, offset, MQTT_JOURNAL_ENTRY_CLEAR, 0U, packetId, 0U );
+            pJournal->writeOffset += sealEntry( pJournal, offset, pJournal->generation );
+            flush( pJournal, offset, MQTT_JOURNAL_ENTRY_OVERHEAD );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void recordState( const MQTTContext_t * pContext,
+                         uint16_t packetId,
+                         MQTTQoS_t qos,
+                         MQTTPublishState_t state,
+                         bool isOutgoing )
+{
+    MQTTSessionJournal_t * pJournal = pContext->pSessionJournal;
+    MQTTPubAckInfo_t record;
+    size_t offset = 0U;
+    size_t entrySize = ( packetId == MQTT_PACKET_ID_INVALID ) ? MQTT_JOURNAL_ENTRY_OVERHEAD : MQTT_JOURNAL_STATE_ENTRY_SIZE;
+    bool compacted = false;
+
+    assert( pJournal != NULL );
+
+    if( reserveEntry( pContext, pJournal, entrySize, &compacted ) == false )
+    {
+        LogError( ( "State of PacketId=%hu does not fit in the journal.",
+                    ( unsigned short ) packetId ) );
+    }
+    else if( compacted == true )
+    {
+        /* The compaction copied the records with this change. */
+    }
+    else if( packetId == MQTT_PACKET_ID_INVALID )
+    {
+        offset = pJournal->writeOffset;
+        writeEntryHeader( pJournal, offset, MQTT_JOURNAL_ENTRY_RESET, 0U, MQTT_PACKET_ID_INVALID, 0U );
+        pJournal->writeOffset += sealEntry( pJournal, offset, pJournal->generation );
+        flush( pJournal, offset, entrySize );
+
+        ( void ) memset( pJournal->pSlots, 0x00, pJournal->slotCount * sizeof( *pJournal->pSlots ) );
+        pJournal->liveBytes = 0U;
+    }
+    else
+    {
+        record.packetId = packetId;
+        record.qos = qos;
+        record.publishState = state;
+
+        offset = pJournal->writeOffset;
+        pJournal->writeOffset += writeStateEntry( pJournal, offset, pJournal->generation, &record, isOutgoing );
+        flush( pJournal, offset, entrySize );
+
+        /* Only the latest entry of a record is live. Records are added in
+         * these states and removed in the null state; the compaction
+         * recounts the live bytes should this ever drift. */
+        if( state == MQTTStateNull )
+        {
+            pJournal->liveBytes -= ( pJournal->liveBytes > entrySize ) ? entrySize : pJournal->liveBytes;
+        }
+        else if( ( ( isOutgoing == true ) && ( state == MQTTPublishSend ) ) ||
+                 ( ( isOutgoing == false ) && ( ( state == MQTTPubAckSend ) || ( state == MQTTPubRecSend ) ) ) )
+        {
+            pJournal->liveBytes += entrySize;
+        }
+        else
+        {
+            /* The entry replaces a live one of the same size. */
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RestoreSession( MQTTContext_t * pContext,
+                                  MQTTSessionJournal_t * pJournal )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t halfSize = 0U;
+    uint32_t firstGeneration = 0U;
+    uint32_t secondGeneration = 0U;
+    bool firstValid = false;
+    bool secondValid = false;
+
+    if( ( pContext == NULL ) || ( pJournal == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, pJournal=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pJournal ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pJournal->pBuffer == NULL ) || ( pJournal->pSlots == NULL ) )
+    {
+        LogError( ( "Journal buffer and slots cannot be NULL: pBuffer=%p, pSlots=%p.",
+                    ( void * ) pJournal->pBuffer,
+                    ( void * ) pJournal->pSlots ) );
+        status = MQTTBadParameter;
+    }
+    else if( pContext->outgoingPublishRecords == NULL )
+    {
+        LogError( ( "Outgoing publish records must be set up with MQTT_InitStatefulQoS "
+                    "before restoring a session." ) );
+        status = MQTTBadParameter;
+    }
+    else if( pJournal->slotCount <= pContext->outgoingPublishRecordMaxCount )
+    {
+        LogError( ( "A journal needs more slots than outgoing publish records: slotCount=%lu.",
+                    ( unsigned long ) pJournal->slotCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pJournal->bufferSize / 2U ) < ( MQTT_JOURNAL_HEADER_SIZE + MQTT_JOURNAL_STATE_ENTRY_SIZE ) )
+    {
+        LogError( ( "Journal buffer of %lu bytes is too small.",
+                    ( unsigned long ) pJournal->bufferSize ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        halfSize = pJournal->bufferSize / 2U;
+        firstValid = readHalfHeader( pJournal, 0U, &firstGeneration );
+        secondValid = readHalfHeader( pJournal, halfSize, &secondGeneration );
+
+        ( void ) memset( pContext->outgoingPublishRecords,
+                         0x00,
+                         pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+
+        if( pContext->incomingPublishRecordMaxCount > 0U )
+        {
+            ( void ) memset( pContext->incomingPublishRecords,
+                             0x00,
+                             pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+        }
+
+        ( void ) memset( pJournal->pSlots, 0x00, pJournal->slotCount * sizeof( *pJournal->pSlots ) );
+
+        /* The half with the later generation is the current one. A half left
+         * by a compaction interrupted before its header was written still has
+         * the header of two generations earlier. */
+        if( ( firstValid == true ) &&
+            ( ( secondValid == false ) || ( ( int32_t ) ( firstGeneration - secondGeneration ) > 0 ) ) )
+        {
+            pJournal->activeHalf = 0U;
+            pJournal->generation = firstGeneration;
+            status = replayJournal( pContext, pJournal );
+        }
+        else if( secondValid == true )
+        {
+            pJournal->activeHalf = halfSize;
+            pJournal->generation = secondGeneration;
+            status = replayJournal( pContext, pJournal );
+        }
+        else
+        {
+            /* No journal yet. The compaction below creates one in the first half. */
+            pJournal->activeHalf = halfSize;
+            pJournal->generation = 0U;
+            pJournal->writeOffset = halfSize + MQTT_JOURNAL_HEADER_SIZE;
+        }
+
+        pJournal->liveBytes = 0U;
+    }
+
+    if( status == MQTTSuccess )
+    {
+        MQTT_IndexStateRecords( pContext );
+        restoreNextPacketId( pContext );
+
+        /* Start a new generation holding only the restored state, so that
+         * entries past a torn one are never read as part of it. */
+        if( compact( pContext, pJournal ) == false )
+        {
+            status = MQTTNoMemory;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_InitRetransmits( pContext, storePacket, retrievePacket, clearPacket );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pContext->recordStateFunction = recordState;
+        pContext->pSessionJournal = pJournal;
+    }
+    else if( status == MQTTNoMemory )
+    {
+        /* Do not leave a partial session behind. */
+        ( void ) memset( pContext->outgoingPublishRecords,
+                         0x00,
+                         pContext->outgoingPublishRecordMaxCount * sizeof( *pContext->outgoingPublishRecords ) );
+
+        if( pContext->incomingPublishRecordMaxCount > 0U )
+        {
+            ( void ) memset( pContext->incomingPublishRecords,
+                             0x00,
+                             pContext->incomingPublishRecordMaxCount * sizeof( *pContext->incomingPublishRecords ) );
+        }
+
+        MQTT_IndexStateRecords( pContext );
+    }
+    else
+    {
+        /* Invalid parameters. */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,535 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_retransmit.c
+ * @brief Implements the functions in core_mqtt_retransmit.h.
+ */
+#include <assert.h>
+#include <string.h>
+#include "core_mqtt_retransmit.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Size of an entry of the hash table: a 2 byte packet ID, 0 for an
+ * empty entry, followed by a 2 byte slot number.
+ */
+#define MQTT_RETRANSMIT_ENTRY_SIZE     ( 4U )
+
+/**
+ * @brief Size of the header of a slot: the length of the stored packet, or
+ * the next unused slot while the slot is unused.
+ */
+#define MQTT_RETRANSMIT_HEADER_SIZE    ( 4U )
+
+/**
+ * @brief Largest number of slots. Slot numbers are stored in 2 bytes, and no
+ * more PUBLISH packets than packet IDs can await an acknowledgement.
+ */
+#define MQTT_RETRANSMIT_MAX_SLOTS      ( ( size_t ) UINT16_MAX )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Calculate the first hash table entry to probe for a packet ID.
+ *
+ * @param[in] packetId Packet ID to hash.
+ * @param[in] indexCount Number of entries in the hash table.
+ *
+ * @return The first entry to probe for the packet ID.
+ */
+static size_t indexHome( uint16_t packetId,
+                         size_t indexCount );
+
+/**
+ * @brief Get the packet ID of a hash table entry.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] entry Hash table entry.
+ *
+ * @return The packet ID, or #MQTT_PACKET_ID_INVALID for an empty entry.
+ */
+static uint16_t getEntryPacketId( const MQTTRetransmitStore_t * pStore,
+                                  size_t entry );
+
+/**
+ * @brief Get the slot of a hash table entry.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] entry Hash table entry.
+ *
+ * @return The slot holding the packet of the entry.
+ */
+static size_t getEntrySlot( const MQTTRetransmitStore_t * pStore,
+                            size_t entry );
+
+/**
+ * @brief Set the packet ID and slot of a hash table entry.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] entry Hash table entry.
+ * @param[in] packetId Packet ID, or #MQTT_PACKET_ID_INVALID to empty the entry.
+ * @param[in] slot Slot holding the packet.
+ */
+static void setEntry( MQTTRetransmitStore_t * pStore,
+                      size_t entry,
+                      uint16_t packetId,
+                      size_t slot );
+
+/**
+ * @brief Find the hash table entry of a packet ID.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] packetId Packet ID to search for.
+ *
+ * @return The entry, or the number of entries if the packet ID is not stored.
+ */
+static size_t findEntry( const MQTTRetransmitStore_t * pStore,
+                         uint16_t packetId );
+
+/**
+ * @brief Remove a hash table entry, moving back the entries which follow it
+ * so that no lookup stops early at the emptied entry.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] entry Hash table entry to remove.
+ */
+static void removeEntry( MQTTRetransmitStore_t * pStore,
+                         size_t entry );
+
+/**
+ * @brief Get the memory of a slot, starting with its header.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] slot Slot number.
+ *
+ * @return The first byte of the slot.
+ */
+static uint8_t * getSlot( const MQTTRetransmitStore_t * pStore,
+                          size_t slot );
+
+/**
+ * @brief Read the header of a slot.
+ *
+ * @param[in] pSlot The slot.
+ *
+ * @return The value in the header.
+ */
+static size_t readSlotHeader( const uint8_t * pSlot );
+
+/**
+ * @brief Write the header of a slot.
+ *
+ * @param[in] pSlot The slot.
+ * @param[in] value The value to write, less than 2^32.
+ */
+static void writeSlotHeader( uint8_t * pSlot,
+                             size_t value );
+
+/**
+ * @brief Release the slot of a hash table entry, and remove the entry.
+ *
+ * @param[in] pStore Retransmit store.
+ * @param[in] entry Hash table entry.
+ */
+static void releaseEntry( MQTTRetransmitStore_t * pStore,
+                          size_t entry );
+
+/**
+ * @brief The #MQTTStorePacketForRetransmit callback of the store.
+ *
+ * @param[in] pContext MQTT context the store is registered with.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[in] pMqttVec The PUBLISH packet.
+ *
+ * @return `true` if the packet was stored; `false` if it is too large or every
+ * slot is used.
+ */
+static bool storePacket( struct MQTTContext * pContext,
+                         uint16_t packetId,
+                         MQTTVec_t * pMqttVec );
+
+/**
+ * @brief The #MQTTRetrievePacketForRetransmit callback of the store.
+ *
+ * @param[in] pContext MQTT context the store is registered with.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[out] pSerializedMqttVec The stored packet.
+ * @param[out] pSerializedMqttVecLen Length of the stored packet.
+ *
+ * @return `true` if the packet was found; `false` otherwise.
+ */
+static bool retrievePacket( struct MQTTContext * pContext,
+                            uint16_t packetId,
+                            uint8_t ** pSerializedMqttVec,
+                            size_t * pSerializedMqttVecLen );
+
+/**
+ * @brief The #MQTTClearPacketForRetransmit callback of the store.
+ *
+ * @param[in] pContext MQTT context the store is registered with.
+ * @param[in] packetId Packet ID of the acknowledged PUBLISH.
+ */
+static void clearPacket( struct MQTTContext * pContext,
+                         uint16_t packetId );
+
+/*-----------------------------------------------------------*/
+
+static size_t indexHome( uint16_t packetId,
+                         size_t indexCount )
+{
+    /* Fibonacci hashing, as for the packet ID index of the state records.
+     * Sequential packet IDs land far apart, so probe runs stay short. */
+    uint32_t hash = ( uint32_t ) packetId * 2654435769U;
+
+    return ( size_t ) ( ( ( uint64_t ) hash * ( uint64_t ) indexCount ) >> 32 );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t getEntryPacketId( const MQTTRetransmitStore_t * pStore,
+                                  size_t entry )
+{
+    const uint8_t * pEntry = &pStore->pIndex[ entry * MQTT_RETRANSMIT_ENTRY_SIZE ];
+
+    return ( uint16_t ) ( ( ( uint16_t ) pEntry[ 0 ] << 8 ) | ( uint16_t ) pEntry[ 1 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t getEntrySlot( const MQTTRetransmitStore_t * pStore,
+                            size_t entry )
+{
+    const uint8_t * pEntry = &pStore->pIndex[ entry * MQTT_RETRANSMIT_ENTRY_SIZE ];
+
+    return ( ( size_t ) pEntry[ 2 ] << 8 ) | ( size_t ) pEntry[ 3 ];
+}
+
+/*-----------------------------------------------------------*/
+
+static void setEntry( MQTTRetransmitStore_t * pStore,
+                      size_t entry,
+                      uint16_t packetId,
+                      size_t slot )
+{
+    uint8_t * pEntry = &pStore->pIndex[ entry * MQTT_RETRANSMIT_ENTRY_SIZE ];
+
+    pEntry[ 0 ] = ( uint8_t ) ( packetId >> 8 );
+    pEntry[ 1 ] = ( uint8_t ) ( packetId & 0xFFU );
+    pEntry[ 2 ] = ( uint8_t ) ( slot >> 8 );
+    pEntry[ 3 ] = ( uint8_t ) ( slot & 0xFFU );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t findEntry( const MQTTRetransmitStore_t * pStore,
+                         uint16_t packetId )
+{
+    size_t entry = indexHome( packetId, pStore->indexCount );
+    size_t found = pStore->indexCount;
+    uint16_t entryPacketId = getEntryPacketId( pStore, entry );
+
+    /* The table has twice as many entries as there are slots, so an empty
+     * entry ends every probe sequence. */
+    while( entryPacketId != MQTT_PACKET_ID_INVALID )
+    {
+        if( entryPacketId == packetId )
+        {
+            found = entry;
+            break;
+        }
+
+        entry = ( entry + 1U ) % pStore->indexCount;
+        entryPacketId = getEntryPacketId( pStore, entry );
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static void removeEntry( MQTTRetransmitStore_t * pStore,
+                         size_t entry )
+{
+    size_t indexCount = pStore->indexCount;
+    size_t hole = entry;
+    size_t next = ( entry + 1U ) % indexCount;
+    size_t homeDistance = 0U;
+    size_t holeDistance = 0U;
+    uint16_t packetId = getEntryPacketId( pStore, next );
+
+    while( packetId != MQTT_PACKET_ID_INVALID )
+    {
+        /* An entry can fill the hole only if the hole lies between its home
+         * and its current position. Otherwise a lookup starting at its home
+         * would never reach it. */
+        homeDistance = ( next + indexCount - indexHome( packetId, indexCount ) ) % indexCount;
+        holeDistance = ( next + indexCount - hole ) % indexCount;
+
+        if( homeDistance >= holeDistance )
+        {
+            setEntry( pStore, hole, packetId, getEntrySlot( pStore, next ) );
+            hole = next;
+        }
+
+        next = ( next + 1U ) % indexCount;
+        packetId = getEntryPacketId( pStore, next );
+    }
+
+    setEntry( pStore, hole, MQTT_PACKET_ID_INVALID, 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * getSlot( const MQTTRetransmitStore_t * pStore,
+                          size_t slot )
+{
+    return &pStore->pSlots[ slot * ( MQTT_RETRANSMIT_HEADER_SIZE + pStore->maxPacketSize ) ];
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t readSlotHeader( const uint8_t * pSlot )
+{
+    return ( ( size_t ) pSlot[ 0 ] << 24 ) |
+           ( ( size_t ) pSlot[ 1 ] << 16 ) |
+           ( ( size_t ) pSlot[ 2 ] << 8 ) |
+           ( size_t ) pSlot[ 3 ];
+}
+
+/*-----------------------------------------------------------*/
+
+static void writeSlotHeader( uint8_t * pSlot,
+                             size_t value )
+{
+    pSlot[ 0 ] = ( uint8_t ) ( ( value >> 24 ) & 0xFFU );
+    pSlot[ 1 ] = ( uint8_t ) ( ( value >> 16 ) & 0xFFU );
+    pSlot[ 2 ] = ( uint8_t ) ( ( value >> 8 ) & 0xFFU );
+    pSlot[ 3 ] = ( uint8_t ) ( value & 0xFFU );
+}
+
+/*-----------------------------------------------------------*/
+
+static void releaseEntry( MQTTRetransmitStore_t * pStore,
+                          size_t entry )
+{
+    size_t slot = getEntrySlot( pStore, entry );
+
+    removeEntry( pStore, entry );
+
+    /* The released slot becomes the first unused one. */
+    writeSlotHeader( getSlot( pStore, slot ), pStore->freeSlot );
+    pStore->freeSlot = slot;
+    pStore->usedCount--;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool storePacket( struct MQTTContext * pContext,
+                         uint16_t packetId,
+                         MQTTVec_t * pMqttVec )
+{
+    MQTTRetransmitStore_t * pStore = pContext->pRetransmitStore;
+    size_t packetSize = MQTT_GetBytesInMQTTVec( pMqttVec );
+    size_t entry = 0U;
+    size_t slot = 0U;
+    uint8_t * pSlot = NULL;
+    bool stored = false;
+
+    assert( pStore != NULL );
+
+    entry = findEntry( pStore, packetId );
+
+    if( packetSize > pStore->maxPacketSize )
+    {
+        LogError( ( "PUBLISH of %lu bytes does not fit in a retransmit slot of %lu bytes.",
+                    ( unsigned long ) packetSize,
+                    ( unsigned long ) pStore->maxPacketSize ) );
+
+        /* Do not leave an older copy behind to be resent in its place. */
+        if( entry != pStore->indexCount )
+        {
+            releaseEntry( pStore, entry );
+        }
+    }
+    else if( entry != pStore->indexCount )
+    {
+        /* A PUBLISH sent again with the same packet ID replaces its copy. */
+        slot = getEntrySlot( pStore, entry );
+        stored = true;
+    }
+    else if( pStore->freeSlot == pStore->slotCount )
+    {
+        LogError( ( "Every retransmit slot is used: slotCount=%lu.",
+                    ( unsigned long ) pStore->slotCount ) );
+    }
+    else
+    {
+        slot = pStore->freeSlot;
+        pStore->freeSlot = readSlotHeader( getSlot( pStore, slot ) );
+        pStore->usedCount++;
+
+        /* Claim the first empty entry of the probe sequence. */
+        entry = indexHome( packetId, pStore->indexCount );
+
+        while( getEntryPacketId( pStore, entry ) != MQTT_PACKET_ID_INVALID )
+        {
+            entry = ( entry + 1U ) % pStore->indexCount;
+        }
+
+        setEntry( pStore, entry, packetId, slot );
+        stored = true;
+    }
+
+    if( stored == true )
+    {
+        pSlot = getSlot( pStore, slot );
+        writeSlotHeader( pSlot, packetSize );
+        MQTT_SerializeMQTTVec( &pSlot[ MQTT_RETRANSMIT_HEADER_SIZE ], pMqttVec );
+    }
+
+    return stored;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool retrievePacket( struct MQTTContext * pContext,
+                            uint16_t packetId,
+                            uint8_t ** pSerializedMqttVec,
+                            size_t * pSerializedMqttVecLen )
+{
+    const MQTTRetransmitStore_t * pStore = pContext->pRetransmitStore;
+    size_t entry = 0U;
+    uint8_t * pSlot = NULL;
+    bool found = false;
+
+    assert( pStore != NULL );
+
+    entry = findEntry( pStore, packetId );
+
+    if( entry != pStore->indexCount )
+    {
+        pSlot = getSlot( pStore, getEntrySlot( pStore, entry ) );
+        *pSerializedMqttVec = &pSlot[ MQTT_RETRANSMIT_HEADER_SIZE ];
+        *pSerializedMqttVecLen = readSlotHeader( pSlot );
+        found = true;
+    }
+    else
+    {
+        LogError( ( "No stored PUBLISH for packet ID %hu.",
+                    ( unsigned short ) packetId ) );
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static void clearPacket( struct MQTTContext * pContext,
+                         uint16_t packetId )
+{
+    MQTTRetransmitStore_t * pStore = pContext->pRetransmitStore;
+    size_t entry = 0U;
+
+    assert( pStore != NULL );
+
+    entry = findEntry( pStore, packetId );
+
+    if( entry != pStore->indexCount )
+    {
+        releaseEntry( pStore, entry );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitRetransmitStore( MQTTContext_t * pContext,
+                                       MQTTRetransmitStore_t * pStore,
+                                       uint8_t * pBuffer,
+                                       size_t bufferSize,
+                                       size_t maxPacketSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t slotCount = 0U;
+    size_t slot = 0U;
+
+    if( ( pContext == NULL ) || ( pStore == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, pStore=%p, pBuffer=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pStore,
+                    ( void * ) pBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( maxPacketSize == 0U ) ||
+             ( bufferSize < MQTT_RETRANSMIT_SLOT_OVERHEAD ) ||
+             ( maxPacketSize > ( bufferSize - MQTT_RETRANSMIT_SLOT_OVERHEAD ) ) )
+    {
+        LogError( ( "Buffer does not hold a single slot: bufferSize=%lu, maxPacketSize=%lu.",
+                    ( unsigned long ) bufferSize,
+                    ( unsigned long ) maxPacketSize ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = MQTT_InitRetransmits( pContext, storePacket, retrievePacket, clearPacket );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        slotCount = bufferSize / ( maxPacketSize + MQTT_RETRANSMIT_SLOT_OVERHEAD );
+
+        if( slotCount > MQTT_RETRANSMIT_MAX_SLOTS )
+        {
+            slotCount = MQTT_RETRANSMIT_MAX_SLOTS;
+        }
+
+        /* The hash table comes first, followed by the slots. */
+        pStore->pIndex = pBuffer;
+        pStore->indexCount = 2U * slotCount;
+        pStore->pSlots = &pBuffer[ pStore->indexCount * MQTT_RETRANSMIT_ENTRY_SIZE ];
+        pStore->slotCount = slotCount;
+        pStore->maxPacketSize = maxPacketSize;
+        pStore->freeSlot = 0U;
+        pStore->usedCount = 0U;
+
+        ( void ) memset( pStore->pIndex, 0x00, pStore->indexCount * MQTT_RETRANSMIT_ENTRY_SIZE );
+
+        /* Chain every slot into the list of unused slots. */
+        for( slot = 0U; slot < slotCount; slot++ )
+        {
+            writeSlotHeader( getSlot( pStore, slot ), slot + 1U );
+        }
+
+        pContext->pRetransmitStore = pStore;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,784 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router.c
+ * @brief Implements the functions in core_mqtt_router.h.
+ */
+#include <assert.h>
+#include <string.h>
+#include "core_mqtt_router.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Index of the root node of the trie.
+ */
+#define MQTT_ROUTER_ROOT_NODE    ( ( uint16_t ) 0U )
+
+/**
+ * @brief FNV-1a 32 bit offset basis.
+ */
+#define MQTT_ROUTER_FNV_OFFSET    ( 2166136261U )
+
+/**
+ * @brief FNV-1a 32 bit prime.
+ */
+#define MQTT_ROUTER_FNV_PRIME     ( 16777619U )
+
+/**
+ * @brief An entry of the stack used by #MQTT_RouterMatch.
+ */
+typedef struct MQTTRouterCursor
+{
+    uint16_t node; /**< @brief Node reached in the trie. */
+    size_t offset; /**< @brief Offset of the topic level to match below the node. */
+} MQTTRouterCursor_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Validate a topic filter and count its topic levels.
+ *
+ * A wildcard must occupy a whole topic level, and "#" can only be the last
+ * topic level.
+ *
+ * @param[in] pTopicFilter The topic filter.
+ * @param[in] topicFilterLength Length of the topic filter.
+ *
+ * @return Number of topic levels, or 0 if the topic filter is invalid.
+ */
+static size_t validateTopicFilter( const char * pTopicFilter,
+                                   uint16_t topicFilterLength );
+
+/**
+ * @brief Find the end of the topic level starting at an offset.
+ *
+ * @param[in] pTopic Topic name or topic filter.
+ * @param[in] topicLength Length of @p pTopic.
+ * @param[in] offset Offset of the start of the topic level.
+ *
+ * @return Offset of the '/' ending the topic level, or @p topicLength for the
+ * last topic level.
+ */
+static size_t levelEnd( const char * pTopic,
+                        size_t topicLength,
+                        size_t offset );
+
+/**
+ * @brief Hash a topic level together with its parent node.
+ *
+ * @param[in] parent Parent node.
+ * @param[in] pLevel The topic level.
+ * @param[in] levelLength Length of the topic level.
+ *
+ * @return FNV-1a hash of the parent node and the topic level.
+ */
+static uint32_t hashLevel( uint16_t parent,
+                           const char * pLevel,
+                           size_t levelLength );
+
+/**
+ * @brief Find the literal child node of a node for a topic level.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] parent Parent node.
+ * @param[in] pLevel The topic level.
+ * @param[in] levelLength Length of the topic level.
+ * @param[in] hash Hash of @p parent and the topic level.
+ *
+ * @return Slot holding the child node, or #MQTT_ROUTER_NODE_INVALID cast to
+ * size_t if the node has no such child.
+ */
+static size_t findSlot( const MQTTRouter_t * pRouter,
+                        uint16_t parent,
+                        const char * pLevel,
+                        size_t levelLength,
+                        uint32_t hash );
+
+/**
+ * @brief Find the child node of a node for a topic filter level.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] parent Parent node.
+ * @param[in] pLevel The topic filter level.
+ * @param[in] levelLength Length of the topic filter level.
+ *
+ * @return The child node, or #MQTT_ROUTER_NODE_INVALID if the node has no
+ * such child.
+ */
+static uint16_t findChild( const MQTTRouter_t * pRouter,
+                           uint16_t parent,
+                           const char * pLevel,
+                           size_t levelLength );
+
+/**
+ * @brief Create the child node of a node for a topic filter level.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] parent Parent node.
+ * @param[in] pLevel The topic filter level.
+ * @param[in] levelLength Length of the topic filter level.
+ *
+ * @return The new child node, or #MQTT_ROUTER_NODE_INVALID if the router has
+ * no unused node left.
+ */
+static uint16_t addChild( MQTTRouter_t * pRouter,
+                          uint16_t parent,
+                          const char * pLevel,
+                          size_t levelLength );
+
+/**
+ * @brief Unlink a node from its parent and return it to the unused nodes.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] node The node to release. Must not be the root node.
+ */
+static void releaseNode( MQTTRouter_t * pRouter,
+                         uint16_t node );
+
+/**
+ * @brief Release a node and its ancestors as long as they have neither
+ * handlers nor children.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] node The deepest node to consider.
+ */
+static void pruneNodes( MQTTRouter_t * pRouter,
+                        uint16_t node );
+
+/*-----------------------------------------------------------*/
+
+static size_t validateTopicFilter( const char * pTopicFilter,
+                                   uint16_t topicFilterLength )
+{
+    size_t levelCount = 0U;
+    size_t offset = 0U;
+    size_t end = 0U;
+    size_t index = 0U;
+    bool isValid = true;
+
+    while( ( isValid == true ) && ( offset <= topicFilterLength ) )
+    {
+        end = levelEnd( pTopicFilter, topicFilterLength, offset );
+
+        for( index = offset; index < end; index++ )
+        {
+            if( ( pTopicFilter[ index ] == '+' ) || ( pTopicFilter[ index ] == '#' ) )
+            {
+                /* A wildcard must be the only character of its topic level,
+                 * and "#" must also be the last topic level. */
+                if( ( ( end - offset ) != 1U ) ||
+                    ( ( pTopicFilter[ index ] == '#' ) && ( end != topicFilterLength ) ) )
+                {
+                    isValid = false;
+                }
+            }
+        }
+
+        levelCount++;
+        offset = end + 1U;
+    }
+
+    if( ( isValid == false ) || ( levelCount > MQTT_ROUTER_MAX_TOPIC_LEVELS ) )
+    {
+        levelCount = 0U;
+    }
+
+    return levelCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t levelEnd( const char * pTopic,
+                        size_t topicLength,
+                        size_t offset )
+{
+    size_t end = offset;
+
+    while( ( end < topicLength ) && ( pTopic[ end ] != '/' ) )
+    {
+        end++;
+    }
+
+    return end;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t hashLevel( uint16_t parent,
+                           const char * pLevel,
+                           size_t levelLength )
+{
+    uint32_t hash = MQTT_ROUTER_FNV_OFFSET;
+    size_t index = 0U;
+
+    /* Hashing the parent node lets the children of every node share one hash
+     * table. */
+    hash = ( hash ^ ( uint32_t ) ( parent & 0xFFU ) ) * MQTT_ROUTER_FNV_PRIME;
+    hash = ( hash ^ ( uint32_t ) ( parent >> 8 ) ) * MQTT_ROUTER_FNV_PRIME;
+
+    for( index = 0U; index < levelLength; index++ )
+    {
+        hash = ( hash ^ ( uint32_t ) ( uint8_t ) pLevel[ index ] ) * MQTT_ROUTER_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t findSlot( const MQTTRouter_t * pRouter,
+                        uint16_t parent,
+                        const char * pLevel,
+                        size_t levelLength,
+                        uint32_t hash )
+{
+    size_t slot = ( size_t ) MQTT_ROUTER_NODE_INVALID;
+    size_t probe = hash % pRouter->slotCount;
+    const MQTTRouterNode_t * pNode = NULL;
+
+    /* The hash table always has more slots than nodes, so an empty slot ends
+     * every probe sequence for a child which is not present. */
+    while( pRouter->pSlots[ probe ] != MQTT_ROUTER_NODE_INVALID )
+    {
+        pNode = &pRouter->pNodes[ pRouter->pSlots[ probe ] ];
+
+        if( ( pNode->hash == hash ) &&
+            ( pNode->parent == parent ) &&
+            ( pNode->levelLength == levelLength ) &&
+            ( memcmp( pNode->pLevel, pLevel, levelLength ) == 0 ) )
+        {
+            slot = probe;
+            break;
+        }
+
+        probe = ( probe + 1U ) % pRouter->slotCount;
+    }
+
+    return slot;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findChild( const MQTTRouter_t * pRouter,
+                           uint16_t parent,
+                           const char * pLevel,
+                           size_t levelLength )
+{
+    uint16_t child = MQTT_ROUTER_NODE_INVALID;
+    size_t slot = 0U;
+
+    if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '+' ) )
+    {
+        child = pRouter->pNodes[ parent ].plusChild;
+    }
+    else
+    {
+        slot = findSlot( pRouter,
+                         parent,
+                         pLevel,
+                         levelLength,
+                         hashLevel( parent, pLevel, levelLength ) );
+
+        if( slot != ( size_t ) MQTT_ROUTER_NODE_INVALID )
+        {
+            child = pRouter->pSlots[ slot ];
+        }
+    }
+
+    return child;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t addChild( MQTTRouter_t * pRouter,
+                          uint16_t parent,
+                          const char * pLevel,
+                          size_t levelLength )
+{
+    uint16_t child = pRouter->freeNode;
+    MQTTRouterNode_t * pNode = NULL;
+    size_t probe = 0U;
+
+    if( child != MQTT_ROUTER_NODE_INVALID )
+    {
+        pNode = &pRouter->pNodes[ child ];
+        pRouter->freeNode = pNode->parent;
+
+        pNode->pLevel = pLevel;
+        pNode->pHandler = NULL;
+        pNode->pMultiLevelHandler = NULL;
+        pNode->hash = hashLevel( parent, pLevel, levelLength );
+        pNode->levelLength = ( uint16_t ) levelLength;
+        pNode->parent = parent;
+        pNode->plusChild = MQTT_ROUTER_NODE_INVALID;
+        pNode->childCount = 0U;
+
+        if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '+' ) )
+        {
+            pRouter->pNodes[ parent ].plusChild = child;
+        }
+        else
+        {
+            probe = pNode->hash % pRouter->slotCount;
+
+            while( pRouter->pSlots[ probe ] != MQTT_ROUTER_NODE_INVALID )
+            {
+                probe = ( probe + 1U ) % pRouter->slotCount;
+            }
+
+            pRouter->pSlots[ probe ] = child;
+        }
+
+        pRouter->pNodes[ parent ].childCount++;
+    }
+
+    return child;
+}
+
+/*-----------------------------------------------------------*/
+
+static void releaseNode( MQTTRouter_t * pRouter,
+                         uint16_t node )
+{
+    MQTTRouterNode_t * pNode = &pRouter->pNodes[ node ];
+    MQTTRouterNode_t * pParent = &pRouter->pNodes[ pNode->parent ];
+    size_t slotCount = pRouter->slotCount;
+    uint16_t * pSlots = pRouter->pSlots;
+    size_t hole = 0U;
+    size_t next = 0U;
+    size_t homeDistance = 0U;
+    size_t holeDistance = 0U;
+
+    assert( node != MQTT_ROUTER_ROOT_NODE );
+
+    if( pParent->plusChild == node )
+    {
+        pParent->plusChild = MQTT_ROUTER_NODE_INVALID;
+    }
+    else
+    {
+        hole = findSlot( pRouter, pNode->parent, pNode->pLevel, pNode->levelLength, pNode->hash );
+        assert( hole != ( size_t ) MQTT_ROUTER_NODE_INVALID );
+        next = ( hole + 1U ) % slotCount;
+
+        while( pSlots[ next ] != MQTT_ROUTER_NODE_INVALID )
+        {
+            /* An entry can fill the hole only if the hole lies between its
+             * home slot and its current slot. Otherwise a lookup starting at
+             * its home slot would never reach it. */
+            homeDistance = ( next + slotCount - ( pRouter->pNodes[ pSlots[ next ] ].hash % slotCount ) ) % slotCount;
+            holeDistance = ( next + slotCount - hole ) % slotCount;
+
+            if( homeDistance >= holeDistance )
+            {
+                pSlots[ hole ] = pSlots[ next ];
+                hole = next;
+            }
+
+            next = ( next + 1U ) % slotCount;
+        }
+
+        pSlots[ hole ] = MQTT_ROUTER_NODE_INVALID;
+    }
+
+    pParent->childCount--;
+
+    pNode->pLevel = NULL;
+    pNode->parent = pRouter->freeNode;
+    pRouter->freeNode = node;
+}
+
+/*-----------------------------------------------------------*/
+
+static void pruneNodes( MQTTRouter_t * pRouter,
+                        uint16_t node )
+{
+    uint16_t current = node;
+    uint16_t parent = MQTT_ROUTER_ROOT_NODE;
+    const MQTTRouterNode_t * pNode = NULL;
+
+    while( current != MQTT_ROUTER_ROOT_NODE )
+    {
+        pNode = &pRouter->pNodes[ current ];
+
+        if( ( pNode->pHandler != NULL ) ||
+            ( pNode->pMultiLevelHandler != NULL ) ||
+            ( pNode->childCount != 0U ) )
+        {
+            break;
+        }
+
+        parent = pNode->parent;
+        releaseNode( pRouter, current );
+        current = parent;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RouterInit( MQTTRouter_t * pRouter,
+                              MQTTRouterNode_t * pNodes,
+                              size_t nodeCount,
+                              uint16_t * pSlots,
+                              size_t slotCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t index = 0U;
+
+    if( ( pRouter == NULL ) || ( pNodes == NULL ) || ( pSlots == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pRouter=%p, pNodes=%p, pSlots=%p.",
+                    ( void * ) pRouter,
+                    ( void * ) pNodes,
+                    ( void * ) pSlots ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( nodeCount == 0U ) || ( nodeCount >= ( size_t ) MQTT_ROUTER_NODE_INVALID ) )
+    {
+        LogError( ( "Node count must be between 1 and %u: nodeCount=%lu.",
+                    ( unsigned int ) MQTT_ROUTER_NODE_INVALID - 1U,
+                    ( unsigned long ) nodeCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( slotCount <= nodeCount )
+    {
+        LogError( ( "Slot count must be greater than node count: slotCount=%lu, nodeCount=%lu.",
+                    ( unsigned long ) slotCount,
+                    ( unsigned long ) nodeCount ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pNodes, 0x00, nodeCount * sizeof( *pNodes ) );
+
+        /* Chain every node except the root into the list of unused nodes. */
+        for( index = 0U; index < nodeCount; index++ )
+        {
+            pNodes[ index ].plusChild = MQTT_ROUTER_NODE_INVALID;
+            pNodes[ index ].parent = ( ( index + 1U ) < nodeCount ) ?
+                                     ( uint16_t ) ( index + 1U ) :
+                                     MQTT_ROUTER_NODE_INVALID;
+        }
+
+        pNodes[ MQTT_ROUTER_ROOT_NODE ].parent = MQTT_ROUTER_NODE_INVALID;
+
+        for( index = 0U; index < slotCount; index++ )
+        {
+            pSlots[ index ] = MQTT_ROUTER_NODE_INVALID;
+        }
+
+        pRouter->pNodes = pNodes;
+        pRouter->nodeCount = nodeCount;
+        pRouter->pSlots = pSlots;
+        pRouter->slotCount = slotCount;
+        pRouter->freeNode = ( nodeCount > 1U ) ? ( uint16_t ) 1U : MQTT_ROUTER_NODE_INVALID;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RouterAdd( MQTTRouter_t * pRouter,
+                             const char * pTopicFilter,
+                             uint16_t topicFilterLength,
+                             void * pHandler )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint16_t node = MQTT_ROUTER_ROOT_NODE;
+    uint16_t child = MQTT_ROUTER_NODE_INVALID;
+    void ** ppHandler = NULL;
+    size_t offset = 0U;
+    size_t end = 0U;
+
+    if( ( pRouter == NULL ) || ( pRouter->pNodes == NULL ) ||
+        ( pTopicFilter == NULL ) || ( topicFilterLength == 0U ) || ( pHandler == NULL ) )
+    {
+        LogError( ( "Invalid input parameter: pRouter=%p, pTopicFilter=%p, "
+                    "topicFilterLength=%hu, pHandler=%p.",
+                    ( const void * ) pRouter,
+                    ( const void * ) pTopicFilter,
+                    ( unsigned short ) topicFilterLength,
+                    pHandler ) );
+        status = MQTTBadParameter;
+    }
+    else if( validateTopicFilter( pTopicFilter, topicFilterLength ) == 0U )
+    {
+        LogError( ( "Invalid topic filter or more than %u topic levels: TopicFilter=%.*s.",
+                    ( unsigned int ) MQTT_ROUTER_MAX_TOPIC_LEVELS,
+                    ( int ) topicFilterLength,
+                    pTopicFilter ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Walk the topic filter levels, creating the nodes which are missing.
+         * A "#" level does not get a node of its own. Its handler is kept by
+         * the node of the level before it. */
+        while( offset <= topicFilterLength )
+        {
+            end = levelEnd( pTopicFilter, topicFilterLength, offset );
+
+            if( ( end == topicFilterLength ) &&
+                ( ( end - offset ) == 1U ) &&
+                ( pTopicFilter[ offset ] == '#' ) )
+            {
+                ppHandler = &pRouter->pNodes[ node ].pMultiLevelHandler;
+                break;
+            }
+
+            child = findChild( pRouter, node, &pTopicFilter[ offset ], end - offset );
+
+            if( child == MQTT_ROUTER_NODE_INVALID )
+            {
+                child = addChild( pRouter, node, &pTopicFilter[ offset ], end - offset );
+            }
+
+            if( child == MQTT_ROUTER_NODE_INVALID )
+            {
+                LogError( ( "Router has no unused node left for topic filter %.*s.",
+                            ( int ) topicFilterLength,
+                            pTopicFilter ) );
+                status = MQTTNoMemory;
+
+                /* Drop the nodes created for this topic filter so far. */
+                pruneNodes( pRouter, node );
+                break;
+            }
+
+            node = child;
+            offset = end + 1U;
+        }
+
+        if( ( status == MQTTSuccess ) && ( ppHandler == NULL ) )
+        {
+            ppHandler = &pRouter->pNodes[ node ].pHandler;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        if( *ppHandler != NULL )
+        {
+            LogError( ( "Topic filter %.*s was already added.",
+                        ( int ) topicFilterLength,
+                        pTopicFilter ) );
+            status = MQTTStateCollision;
+        }
+        else
+        {
+            *ppHandler = pHandler;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RouterRemove( MQTTRouter_t * pRouter,
+                                const char * pTopicFilter,
+                                uint16_t topicFilterLength )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint16_t node = MQTT_ROUTER_ROOT_NODE;
+    void ** ppHandler = NULL;
+    size_t offset = 0U;
+    size_t end = 0U;
+
+    if( ( pRouter == NULL ) || ( pRouter->pNodes == NULL ) ||
+        ( pTopicFilter == NULL ) || ( topicFilterLength == 0U ) ||
+        ( validateTopicFilter( pTopicFilter, topicFilterLength ) == 0U ) )
+    {
+        LogError( ( "Invalid input parameter: pRouter=%p, pTopicFilter=%p, topicFilterLength=%hu.",
+                    ( const void * ) pRouter,
+                    ( const void * ) pTopicFilter,
+                    ( unsigned short ) topicFilterLength ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        while( ( node != MQTT_ROUTER_NODE_INVALID ) && ( offset <= topicFilterLength ) )
+        {
+            end = levelEnd( pTopicFilter, topicFilterLength, offset );
+
+            if( ( end == topicFilterLength ) &&
+                ( ( end - offset ) == 1U ) &&
+                ( pTopicFilter[ offset ] == '#' ) )
+            {
+                ppHandler = &pRouter->pNodes[ node ].pMultiLevelHandler;
+                break;
+            }
+
+            node = findChild( pRouter, node, &pTopicFilter[ offset ], end - offset );
+            offset = end + 1U;
+        }
+
+        if( ( ppHandler == NULL ) && ( node != MQTT_ROUTER_NODE_INVALID ) )
+        {
+            ppHandler = &pRouter->pNodes[ node ].pHandler;
+        }
+
+        if( ( ppHandler == NULL ) || ( *ppHandler == NULL ) )
+        {
+            LogError( ( "Topic filter %.*s was not added.",
+                        ( int ) topicFilterLength,
+                        pTopicFilter ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            *ppHandler = NULL;
+            pruneNodes( pRouter, node );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RouterMatch( const MQTTRouter_t * pRouter,
+                               const char * pTopicName,
+                               uint16_t topicNameLength,
+                               void ** pHandlers,
+                               size_t handlerCount,
+                               size_t * pMatchCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTRouterCursor_t stack[ MQTT_ROUTER_MAX_TOPIC_LEVELS + 1U ];
+    void * candidates[ 2 ];
+    size_t stackCount = 0U;
+    size_t matchCount = 0U;
+    size_t end = 0U;
+    size_t index = 0U;
+    uint16_t child = MQTT_ROUTER_NODE_INVALID;
+    MQTTRouterCursor_t cursor;
+    const MQTTRouterNode_t * pNode = NULL;
+    bool isRootOfSystemTopic = false;
+
+    if( ( pRouter == NULL ) || ( pRouter->pNodes == NULL ) ||
+        ( pTopicName == NULL ) || ( topicNameLength == 0U ) ||
+        ( ( pHandlers == NULL ) && ( handlerCount != 0U ) ) || ( pMatchCount == NULL ) )
+    {
+        LogError( ( "Invalid input parameter: pRouter=%p, pTopicName=%p, topicNameLength=%hu, "
+                    "pHandlers=%p, handlerCount=%lu, pMatchCount=%p.",
+                    ( const void * ) pRouter,
+                    ( const void * ) pTopicName,
+                    ( unsigned short ) topicNameLength,
+                    ( void * ) pHandlers,
+                    ( unsigned long ) handlerCount,
+                    ( void * ) pMatchCount ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        stack[ 0 ].node = MQTT_ROUTER_ROOT_NODE;
+        stack[ 0 ].offset = 0U;
+        stackCount = 1U;
+
+        /* Depth first walk of the nodes matching the topic name so far. A
+         * node is popped with the offset of the topic level after it; an
+         * offset past the end of the topic name means every level matched. */
+        while( stackCount > 0U )
+        {
+            stackCount--;
+            cursor = stack[ stackCount ];
+            pNode = &pRouter->pNodes[ cursor.node ];
+
+            /* Topic names starting with "$" are reserved for the server and
+             * are not matched by topic filters starting with a wildcard. */
+            isRootOfSystemTopic = ( cursor.node == MQTT_ROUTER_ROOT_NODE ) &&
+                                  ( pTopicName[ 0 ] == '$' );
+
+            candidates[ 0 ] = ( isRootOfSystemTopic == true ) ? NULL : pNode->pMultiLevelHandler;
+            candidates[ 1 ] = ( cursor.offset > topicNameLength ) ? pNode->pHandler : NULL;
+
+            for( index = 0U; index < 2U; index++ )
+            {
+                if( candidates[ index ] != NULL )
+                {
+                    if( matchCount < handlerCount )
+                    {
+                        pHandlers[ matchCount ] = candidates[ index ];
+                    }
+
+                    matchCount++;
+                }
+            }
+
+            if( ( cursor.offset <= topicNameLength ) && ( pNode->childCount != 0U ) )
+            {
+                end = levelEnd( pTopicName, topicNameLength, cursor.offset );
+
+                /* Every node has at most one pending sibling per level on the
+                 * stack, so the trie depth bounds the stack. */
+                assert( ( stackCount + 2U ) <= ( MQTT_ROUTER_MAX_TOPIC_LEVELS + 1U ) );
+
+                if( ( pNode->plusChild != MQTT_ROUTER_NODE_INVALID ) &&
+                    ( isRootOfSystemTopic == false ) )
+                {
+                    stack[ stackCount ].node = pNode->plusChild;
+                    stack[ stackCount ].offset = end + 1U;
+                    stackCount++;
+                }
+
+                child = findChild( pRouter,
+                                   cursor.node,
+                                   &pTopicName[ cursor.offset ],
+                                   end - cursor.offset );
+
+                /* A topic level of "+" in a topic name is not a wildcard and
+                 * must not be matched through the "+" child again. */
+                if( ( child != MQTT_ROUTER_NODE_INVALID ) && ( child != pNode->plusChild ) )
+                {
+                    stack[ stackCount ].node = child;
+                    stack[ stackCount ].offset = end + 1U;
+                    stackCount++;
+                }
+            }
+        }
+
+        *pMatchCount = matchCount;
+
+        if( matchCount > handlerCount )
+        {
+            LogError( ( "Topic name %.*s matched %lu topic filters, but only %lu handlers fit.",
+                        ( int ) topicNameLength,
+                        pTopicName,
+                        ( unsigned long ) matchCount,
+                        ( unsigned long ) handlerCount ) );
+            status = MQTTNoMemory;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -35,9 +35,14 @@
 #include "core_mqtt_config_defaults.h"
 
 /**
- * @brief MQTT protocol version 3.1.1.
+ * @brief Protocol level byte sent in CONNECT for MQTT 3.1.1.
  */
-#define MQTT_VERSION_3_1_1                          ( ( uint8_t ) 4U )
+#define MQTT_PROTOCOL_LEVEL_3_1_1                   ( ( uint8_t ) 4U )
+
+/**
+ * @brief Protocol level byte sent in CONNECT for MQTT 5.
+ */
+#define MQTT_PROTOCOL_LEVEL_5                       ( ( uint8_t ) 5U )
 
 /**
  * @brief Size of the fixed and variable header of a CONNECT packet.
@@ -96,6 +101,12 @@
  */
 #define MQTT_MAX_REMAINING_LENGTH                   ( 268435455UL )
 
+/**
+ * @brief The largest fixed header: the packet type byte and a 4 byte
+ * "Remaining length".
+ */
+#define MQTT_FIXED_HEADER_MAX_SIZE                  ( 5UL )
+
 /**
  * @brief Set a bit in an 8-bit unsigned integer.
  */
@@ -197,6 +208,18 @@ static bool calculatePublishPacketSize( const MQTTPublishInfo_t * pPublishInfo,
                                         size_t * pRemainingLength,
                                         size_t * pPacketSize );
 
+/**
+ * @brief Check the topic of an MQTT PUBLISH packet.
+ *
+ * With MQTT 5, an empty topic name is valid when a Topic Alias replaces it.
+ *
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ *
+ * @return true if the topic name, or the Topic Alias replacing it, can be
+ * serialized; false otherwise.
+ */
+static bool validPublishTopic( const MQTTPublishInfo_t * pPublishInfo );
+
 /**
  * @brief Calculates the packet size and remaining length of an MQTT
  * SUBSCRIBE or UNSUBSCRIBE packet.
@@ -272,15 +295,6 @@ static void logConnackResponse( uint8_t responseCode );
 static uint8_t * encodeRemainingLength( uint8_t * pDestination,
                                         size_t length );
 
-/**
- * @brief Retrieve the size of the remaining length if it were to be encoded.
- *
- * @param[in] length The remaining length to be encoded.
- *
- * @return The size of the remaining length if it were to be encoded.
- */
-static size_t remainingLengthEncodedSize( size_t length );
-
 /**
  * @brief Encode a string whose size is at maximum 16 bits in length.
  *
@@ -473,37 +487,16 @@ static MQTTStatus_t deserializePingresp( const MQTTPacketInfo_t * pPingresp );
 
 /*-----------------------------------------------------------*/
 
-static size_t remainingLengthEncodedSize( size_t length )
+size_t MQTT_GetVariableByteIntegerSize( size_t value )
 {
-    size_t encodedSize;
+    size_t encodedSize = 1U;
 
-    /* Determine how many bytes are needed to encode length.
-     * The values below are taken from the MQTT 3.1.1 spec. */
-
-    /* 1 byte is needed to encode lengths between 0 and 127. */
-    if( length < 128U )
-    {
-        encodedSize = 1U;
-    }
-    /* 2 bytes are needed to encode lengths between 128 and 16,383. */
-    else if( length < 16384U )
-    {
-        encodedSize = 2U;
-    }
-    /* 3 bytes are needed to encode lengths between 16,384 and 2,097,151. */
-    else if( length < 2097152U )
-    {
-        encodedSize = 3U;
-    }
-    /* 4 bytes are needed to encode lengths between 2,097,152 and 268,435,455. */
-    else
-    {
-        encodedSize = 4U;
-    }
-
-    LogDebug( ( "Encoded size for length %lu is %lu bytes.",
-                ( unsigned long ) length,
-                ( unsigned long ) encodedSize ) );
+    /* Each threshold is the first value needing one more byte: 128, 128^2 and
+     * 128^3. Unlike an if-else chain, the comparisons do not depend on each
+     * other, so compilers are free to evaluate them without branching. */
+    encodedSize += ( value >= 128U ) ? 1U : 0U;
+    encodedSize += ( value >= 16384U ) ? 1U : 0U;
+    encodedSize += ( value >= 2097152U ) ? 1U : 0U;
 
     return encodedSize;
 }
@@ -513,32 +506,23 @@ static size_t remainingLengthEncodedSize( size_t length )
 static uint8_t * encodeRemainingLength( uint8_t * pDestination,
                                         size_t length )
 {
-    uint8_t lengthByte;
-    uint8_t * pLengthEnd = NULL;
-    size_t remainingLength = length;
+    size_t encodedSize = MQTT_GetVariableByteIntegerSize( length );
+    size_t i;
 
     assert( pDestination != NULL );
+    assert( length <= MQTT_MAX_REMAINING_LENGTH );
 
-    pLengthEnd = pDestination;
-
-    /* This algorithm is copied from the MQTT v3.1.1 spec. */
-    do
+    /* Every byte carries 7 bits of the value and the continuation bit, which
+     * is then cleared in the last byte. The trip count is at most 4, so the
+     * loop is unrolled by the compiler. */
+    for( i = 0U; i < encodedSize; i++ )
     {
-        lengthByte = ( uint8_t ) ( remainingLength % 128U );
-        remainingLength = remainingLength / 128U;
-
-        /* Set the high bit of this byte, indicating that there's more data. */
-        if( remainingLength > 0U )
-        {
-            UINT8_SET_BIT( lengthByte, 7 );
-        }
+        pDestination[ i ] = ( uint8_t ) ( ( ( length >> ( 7U * i ) ) & 0x7FU ) | 0x80U );
+    }
 
-        /* Output a single encoded byte. */
-        *pLengthEnd = lengthByte;
-        pLengthEnd++;
-    } while( remainingLength > 0U );
+    UINT8_CLEAR_BIT( pDestination[ encodedSize - 1U ], 7 );
 
-    return pLengthEnd;
+    return &pDestination[ encodedSize ];
 }
 
 /*-----------------------------------------------------------*/
@@ -612,9 +596,14 @@ static bool calculatePublishPacketSize( const MQTTPublishInfo_t * pPublishInfo,
         {
             size_t propertiesSize = MQTT5_GetPropertiesSize( pPublishInfo->pProperties );
             /* Properties length field (VBI) + properties data */
-            packetSize += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+            packetSize += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
         }
     }
+    else if( pPublishInfo->topicAlias != 0U )
+    {
+        /* Properties length, identifier and value of the Topic Alias. */
+        packetSize += 4U;
+    }
     else
     {
         /* Empty properties (length = 0, encoded as single byte 0x00) */
@@ -646,7 +635,7 @@ static bool calculatePublishPacketSize( const MQTTPublishInfo_t * pPublishInfo,
 
         /* Now that the "Remaining length" is known, recalculate the payload limit
          * based on the size of its encoding. */
-        payloadLimit -= remainingLengthEncodedSize( packetSize );
+        payloadLimit -= MQTT_GetVariableByteIntegerSize( packetSize );
 
         /* Check that the given payload fits within the size allowed by MQTT spec. */
         if( pPublishInfo->payloadLength > payloadLimit )
@@ -665,7 +654,7 @@ static bool calculatePublishPacketSize( const MQTTPublishInfo_t * pPublishInfo,
              * size of the PUBLISH packet. */
             *pRemainingLength = packetSize;
 
-            packetSize += 1U + remainingLengthEncodedSize( packetSize );
+            packetSize += 1U + MQTT_GetVariableByteIntegerSize( packetSize );
             *pPacketSize = packetSize;
         }
     }
@@ -696,7 +685,7 @@ MQTTStatus_t MQTT_SerializePublishHeaderWithoutTopic( const MQTTPublishInfo_t *
     /* Length of serialized packet = First byte
      *                               + Length of encoded remaining length
      *                               + Encoded topic length. */
-    headerLength = 1U + remainingLengthEncodedSize( remainingLength ) + 2U;
+    headerLength = 1U + MQTT_GetVariableByteIntegerSize( remainingLength ) + 2U;
 
     if( pPublishInfo->qos == MQTTQoS1 )
     {
@@ -746,6 +735,142 @@ MQTTStatus_t MQTT_SerializePublishHeaderWithoutTopic( const MQTTPublishInfo_t *
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_SerializeVariableByteInteger( size_t value,
+                                                uint8_t * pBuffer,
+                                                size_t * pEncodedSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pValueEnd = NULL;
+
+    if( ( pBuffer == NULL ) || ( pEncodedSize == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pBuffer=%p, pEncodedSize=%p.",
+                    ( void * ) pBuffer,
+                    ( void * ) pEncodedSize ) );
+        status = MQTTBadParameter;
+    }
+    else if( value > MQTT_MAX_REMAINING_LENGTH )
+    {
+        LogError( ( "Variable byte integer %lu exceeds the maximum of %lu.",
+                    ( unsigned long ) value,
+                    MQTT_MAX_REMAINING_LENGTH ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pValueEnd = encodeRemainingLength( pBuffer, value );
+        *pEncodedSize = ( size_t ) ( pValueEnd - pBuffer );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_DeserializeVariableByteInteger( const uint8_t * pBuffer,
+                                                  size_t bufferSize,
+                                                  size_t * pValue,
+                                                  size_t * pEncodedSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint8_t byte1, byte2, byte3;
+    size_t hasByte2, hasByte3, tooLong;
+    size_t encodedSize = 0U;
+    size_t value = 0U;
+
+    if( ( pBuffer == NULL ) || ( pValue == NULL ) || ( pEncodedSize == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pBuffer=%p, pValue=%p, pEncodedSize=%p.",
+                    ( const void * ) pBuffer,
+                    ( void * ) pValue,
+                    ( void * ) pEncodedSize ) );
+        status = MQTTBadParameter;
+    }
+    else if( bufferSize == 0U )
+    {
+        status = MQTTNeedMoreBytes;
+    }
+    else if( ( pBuffer[ 0 ] & 0x80U ) == 0U )
+    {
+        /* Values below 128 are the common case, and are kept on a branch of
+         * their own so that the encoded size is predicted rather than
+         * computed from the data. */
+        *pValue = pBuffer[ 0 ];
+        *pEncodedSize = 1U;
+    }
+    else
+    {
+        /* Bytes past the end of the buffer read as 0, which has no
+         * continuation bit. An encoding running past the end is then
+         * detected by its size below. */
+        byte1 = ( bufferSize > 1U ) ? pBuffer[ 1 ] : 0U;
+        byte2 = ( bufferSize > 2U ) ? pBuffer[ 2 ] : 0U;
+        byte3 = ( bufferSize > 3U ) ? pBuffer[ 3 ] : 0U;
+
+        /* The first byte has the continuation bit set, so the encoding has
+         * at least 2 bytes. A further byte belongs to it if every byte before
+         * it has the continuation bit set. Each flag is turned into a mask of
+         * all ones or all zeros, so that the bytes are combined without a
+         * data dependent branch or loop, whatever the encoded size. */
+        hasByte2 = ( size_t ) byte1 >> 7;
+        hasByte3 = hasByte2 & ( ( size_t ) byte2 >> 7 );
+        tooLong = hasByte3 & ( ( size_t ) byte3 >> 7 );
+        encodedSize = 2U + hasByte2 + hasByte3;
+
+        value = ( ( size_t ) pBuffer[ 0 ] & 0x7FU ) |
+                ( ( ( size_t ) byte1 & 0x7FU ) << 7 ) |
+                ( ( ( ( size_t ) byte2 & 0x7FU ) << 14 ) & ( 0U - hasByte2 ) ) |
+                ( ( ( ( size_t ) byte3 & 0x7FU ) << 21 ) & ( 0U - hasByte3 ) );
+
+        if( encodedSize > bufferSize )
+        {
+            status = MQTTNeedMoreBytes;
+        }
+        else if( tooLong != 0U )
+        {
+            LogError( ( "Variable byte integer is longer than 4 bytes." ) );
+            status = MQTTBadResponse;
+        }
+        else if( pBuffer[ encodedSize - 1U ] == 0U )
+        {
+            /* A last byte of 0 adds nothing to the value, so a shorter
+             * encoding of the same value exists. */
+            LogError( ( "Variable byte integer of %lu bytes is not the shortest encoding of %lu.",
+                        ( unsigned long ) encodedSize,
+                        ( unsigned long ) value ) );
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            *pValue = value;
+            *pEncodedSize = encodedSize;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool validPublishTopic( const MQTTPublishInfo_t * pPublishInfo )
+{
+    bool valid = ( pPublishInfo->pTopicName != NULL ) &&
+                 ( pPublishInfo->topicNameLength > 0U );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    if( pPublishInfo->topicAlias != 0U )
+    {
+        /* The alias goes in a property block of its own. */
+        valid = ( pPublishInfo->pProperties == NULL ) &&
+                ( ( valid == true ) || ( pPublishInfo->topicNameLength == 0U ) );
+    }
+#endif
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
 static void serializePublishCommon( const MQTTPublishInfo_t * pPublishInfo,
                                     size_t remainingLength,
                                     uint16_t packetIdentifier,
@@ -834,6 +959,15 @@ static void serializePublishCommon( const MQTTPublishInfo_t * pPublishInfo,
         ( void ) status; /* Suppress unused variable warning */
         pIndex += propertiesSize;
     }
+    else if( pPublishInfo->topicAlias != 0U )
+    {
+        /* A property block holding only the Topic Alias. */
+        pIndex[ 0U ] = 3U;
+        pIndex[ 1U ] = ( uint8_t ) MQTT5_PROPERTY_TOPIC_ALIAS;
+        pIndex[ 2U ] = UINT16_HIGH_BYTE( pPublishInfo->topicAlias );
+        pIndex[ 3U ] = UINT16_LOW_BYTE( pPublishInfo->topicAlias );
+        pIndex = &pIndex[ 4U ];
+    }
     else
     {
         /* Empty properties: length = 0 */
@@ -865,45 +999,34 @@ static void serializePublishCommon( const MQTTPublishInfo_t * pPublishInfo,
 static size_t getRemainingLength( TransportRecv_t recvFunc,
                                   NetworkContext_t * pNetworkContext )
 {
-    size_t remainingLength = 0, multiplier = 1, bytesDecoded = 0, expectedSize = 0;
-    uint8_t encodedByte = 0;
-    int32_t bytesReceived = 0;
-
-    /* This algorithm is copied from the MQTT v3.1.1 spec. */
+    size_t remainingLength = MQTT_REMAINING_LENGTH_INVALID;
+    size_t bytesReceived = 0U, encodedSize = 0U;
+    uint8_t encodedBytes[ 4 ] = { 0U, 0U, 0U, 0U };
+    int32_t recvResult = 0;
+    MQTTStatus_t status;
+
+    /* Receive one byte at a time so that no byte after the Remaining Length
+     * is consumed, stopping after the last byte or a fourth byte. */
     do
     {
-        if( multiplier > 2097152U ) /* 128 ^ 3 */
-        {
-            remainingLength = MQTT_REMAINING_LENGTH_INVALID;
-        }
-        else
-        {
-            bytesReceived = recvFunc( pNetworkContext, &encodedByte, 1U );
-
-            if( bytesReceived == 1 )
-            {
-                remainingLength += ( ( size_t ) encodedByte & 0x7FU ) * multiplier;
-                multiplier *= 128U;
-                bytesDecoded++;
-            }
-            else
-            {
-                remainingLength = MQTT_REMAINING_LENGTH_INVALID;
-            }
-        }
+        recvResult = recvFunc( pNetworkContext, &encodedBytes[ bytesReceived ], 1U );
 
-        if( remainingLength == MQTT_REMAINING_LENGTH_INVALID )
+        if( recvResult == 1 )
         {
-            break;
+            bytesReceived++;
         }
-    } while( ( encodedByte & 0x80U ) != 0U );
+    } while( ( recvResult == 1 ) &&
+             ( bytesReceived < sizeof( encodedBytes ) ) &&
+             ( ( encodedBytes[ bytesReceived - 1U ] & 0x80U ) != 0U ) );
 
-    /* Check that the decoded remaining length conforms to the MQTT specification. */
-    if( remainingLength != MQTT_REMAINING_LENGTH_INVALID )
+    if( recvResult == 1 )
     {
-        expectedSize = remainingLengthEncodedSize( remainingLength );
+        status = MQTT_DeserializeVariableByteInteger( encodedBytes,
+                                                      bytesReceived,
+                                                      &remainingLength,
+                                                      &encodedSize );
 
-        if( bytesDecoded != expectedSize )
+        if( status != MQTTSuccess )
         {
             remainingLength = MQTT_REMAINING_LENGTH_INVALID;
         }
@@ -918,66 +1041,31 @@ static MQTTStatus_t processRemainingLength( const uint8_t * pBuffer,
                                             const size_t * pIndex,
                                             MQTTPacketInfo_t * pIncomingPacket )
 {
-    size_t remainingLength = 0;
-    size_t multiplier = 1;
-    size_t bytesDecoded = 0;
-    size_t expectedSize = 0;
-    uint8_t encodedByte = 0;
-    MQTTStatus_t status = MQTTSuccess;
+    size_t remainingLength = 0U;
+    size_t encodedSize = 0U;
+    MQTTStatus_t status = MQTTNeedMoreBytes;
 
-    /* This algorithm is copied from the MQTT v3.1.1 spec. */
-    do
+    /* The Remaining Length follows the packet type byte. */
+    if( *pIndex > 1U )
     {
-        if( multiplier > 2097152U ) /* 128 ^ 3 */
-        {
-            remainingLength = MQTT_REMAINING_LENGTH_INVALID;
-
-            LogError( ( "Invalid remaining length in the packet.\n" ) );
-
-            status = MQTTBadResponse;
-        }
-        else
-        {
-            if( *pIndex > ( bytesDecoded + 1U ) )
-            {
-                /* Get the next byte. It is at the next position after the bytes
-                 * decoded till now since the header of one byte was read before. */
-                encodedByte = pBuffer[ bytesDecoded + 1U ];
-
-                remainingLength += ( ( size_t ) encodedByte & 0x7FU ) * multiplier;
-                multiplier *= 128U;
-                bytesDecoded++;
-            }
-            else
-            {
-                status = MQTTNeedMoreBytes;
-            }
-        }
-
-        /* If the response is incorrect, or no more data is available, then
-         * break out of the loop. */
-        if( ( remainingLength == MQTT_REMAINING_LENGTH_INVALID ) ||
-            ( status != MQTTSuccess ) )
-        {
-            break;
-        }
-    } while( ( encodedByte & 0x80U ) != 0U );
+        status = MQTT_DeserializeVariableByteInteger( &pBuffer[ 1 ],
+                                                      *pIndex - 1U,
+                                                      &remainingLength,
+                                                      &encodedSize );
+    }
 
     if( status == MQTTSuccess )
     {
-        /* Check that the decoded remaining length conforms to the MQTT specification. */
-        expectedSize = remainingLengthEncodedSize( remainingLength );
-
-        if( bytesDecoded != expectedSize )
-        {
-            LogError( ( "Expected and actual length of decoded bytes do not match.\n" ) );
-            status = MQTTBadResponse;
-        }
-        else
-        {
-            pIncomingPacket->remainingLength = remainingLength;
-            pIncomingPacket->headerLength = bytesDecoded + 1U;
-        }
+        pIncomingPacket->remainingLength = remainingLength;
+        pIncomingPacket->headerLength = encodedSize + 1U;
+    }
+    else if( status == MQTTBadResponse )
+    {
+        LogError( ( "Invalid remaining length in the packet." ) );
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
     }
 
     return status;
@@ -1333,7 +1421,7 @@ static MQTTStatus_t calculateSubscriptionPacketSize( const MQTTSubscribeInfo_t *
         /* Calculate the full size of the subscription packet by adding
          * number of bytes required to encode the "Remaining length" field
          * plus 1 byte for the "Packet type" field. */
-        packetSize += 1U + remainingLengthEncodedSize( packetSize );
+        packetSize += 1U + MQTT_GetVariableByteIntegerSize( packetSize );
 
         /*Set the pPacketSize output parameter. */
         *pPacketSize = packetSize;
@@ -1531,7 +1619,7 @@ static MQTTStatus_t validateSubscriptionSerializeParams( const MQTTSubscribeInfo
         /* The serialized packet size = First byte
          * + length of encoded size of remaining length
          * + remaining length. */
-        packetSize = 1U + remainingLengthEncodedSize( remainingLength )
+        packetSize = 1U + MQTT_GetVariableByteIntegerSize( remainingLength )
                      + remainingLength;
 
         if( packetSize > pFixedBuffer->size )
@@ -1629,37 +1717,75 @@ static MQTTStatus_t deserializePublish( const MQTTPacketInfo_t * pIncomingPacket
     }
 
 #if MQTT_VERSION == MQTT_VERSION_5_0
-    if( ( status == MQTTSuccess ) && ( pProperties != NULL ) )
+    if( status == MQTTSuccess )
     {
         size_t remainingSize = pIncomingPacket->remainingLength - headerSize;
         uint32_t propertiesLength;
         size_t vbiLength;
+        MQTT5Property_t topicAlias;
         
         /* Decode properties length VBI */
         vbiLength = MQTT5_DecodeVariableByteInteger( pPacketIdentifierHigh, remainingSize, &propertiesLength );
         
-        if( vbiLength == 0U )
+        if( ( vbiLength == 0U ) || ( propertiesLength > ( remainingSize - vbiLength ) ) )
         {
+            LogError( ( "PUBLISH properties do not fit in the packet." ) );
             status = MQTTBadResponse;
         }
-        else
+        else if( pProperties != NULL )
         {
             /* Deserialize properties */
             status = MQTT5_DeserializeProperties( pProperties,
                                                  pPacketIdentifierHigh,
                                                  vbiLength + propertiesLength );
-            
+        }
+        else
+        {
+            /* MISRA Empty body */
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* The Topic Alias is extracted for the alias table, if any. */
+            status = MQTT5_FindProperty( pPacketIdentifierHigh,
+                                         vbiLength + propertiesLength,
+                                         MQTT5_PROPERTY_TOPIC_ALIAS,
+                                         &topicAlias );
+            pPublishInfo->topicAlias = 0U;
+
+            if( status == MQTTNoDataAvailable )
+            {
+                status = MQTTSuccess;
+            }
+            else if( ( status != MQTTSuccess ) || ( topicAlias.value.twoByteInteger == 0U ) )
+            {
+                LogError( ( "Invalid Topic Alias in PUBLISH." ) );
+                status = MQTTBadResponse;
+            }
+            else
+            {
+                pPublishInfo->topicAlias = topicAlias.value.twoByteInteger;
+            }
+        }
+
+        if( ( status == MQTTSuccess ) &&
+            ( pPublishInfo->topicNameLength == 0U ) && ( pPublishInfo->topicAlias == 0U ) )
+        {
+            LogError( ( "PUBLISH has neither a topic name nor a Topic Alias." ) );
+            status = MQTTBadResponse;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* The raw block stays available for on-demand reads. */
+            pPublishInfo->pRawProperties = pPacketIdentifierHigh;
+            pPublishInfo->rawPropertiesLength = vbiLength + propertiesLength;
+
             /* Advance past properties */
             pPacketIdentifierHigh = &pPacketIdentifierHigh[ vbiLength + propertiesLength ];
             headerSize += vbiLength + propertiesLength;
         }
     }
-    else if( status == MQTTSuccess )
-    {
-        /* Skip properties length field (should be 0x00) */
-        pPacketIdentifierHigh = &pPacketIdentifierHigh[ 1U ];
-        headerSize += 1U;
-    }
 #endif
 
     if( status == MQTTSuccess )
@@ -1798,7 +1924,11 @@ uint8_t * MQTT_SerializeConnectFixedHeader( uint8_t * pIndex,
     pIndexLocal = encodeString( pIndexLocal, "MQTT", 4 );
 
     /* The MQTT protocol version is the second field of the variable header. */
-    *pIndexLocal = MQTT_VERSION_3_1_1;
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    *pIndexLocal = MQTT_PROTOCOL_LEVEL_5;
+#else
+    *pIndexLocal = MQTT_PROTOCOL_LEVEL_3_1_1;
+#endif
     pIndexLocal++;
 
     /* Set the clean session flag if needed. */
@@ -1908,6 +2038,27 @@ static void serializeConnectPacket( const MQTTConnectInfo_t * pConnectInfo,
     /* Write the will topic name and message into the CONNECT packet if provided. */
     if( pWillInfo != NULL )
     {
+#if MQTT_VERSION == MQTT_VERSION_5_0
+        /* The will properties come before the will topic. */
+        if( pWillInfo->pProperties != NULL )
+        {
+            size_t propertiesSize = 0;
+            MQTTStatus_t status;
+
+            status = MQTT5_SerializeProperties( pWillInfo->pProperties,
+                                                pIndex,
+                                                &propertiesSize );
+            assert( status == MQTTSuccess );
+            ( void ) status; /* Suppress unused variable warning in release builds */
+            pIndex += propertiesSize;
+        }
+        else
+        {
+            *pIndex = 0x00;
+            pIndex++;
+        }
+#endif
+
         pIndex = encodeString( pIndex,
                                pWillInfo->pTopicName,
                                pWillInfo->topicNameLength );
@@ -2003,7 +2154,7 @@ MQTTStatus_t MQTT_GetConnectPacketSize( const MQTTConnectInfo_t * pConnectInfo,
             {
                 size_t propertiesSize = MQTT5_GetPropertiesSize( pConnectInfo->pProperties );
                 /* Properties length field (VBI) + properties data */
-                connectPacketSize += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+                connectPacketSize += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
             }
         }
         else
@@ -2018,6 +2169,24 @@ MQTTStatus_t MQTT_GetConnectPacketSize( const MQTTConnectInfo_t * pConnectInfo,
         {
             connectPacketSize += pWillInfo->topicNameLength + sizeof( uint16_t ) +
                                  pWillInfo->payloadLength + sizeof( uint16_t );
+
+#if MQTT_VERSION == MQTT_VERSION_5_0
+            /* Add the will properties, which are empty if not given. */
+            if( pWillInfo->pProperties == NULL )
+            {
+                connectPacketSize += 1U;
+            }
+            else if( ( pWillInfo->pProperties->pProperties == NULL ) ||
+                     ( pWillInfo->pProperties->count > pWillInfo->pProperties->capacity ) )
+            {
+                status = MQTTBadParameter;
+            }
+            else
+            {
+                size_t propertiesSize = MQTT5_GetPropertiesSize( pWillInfo->pProperties );
+                connectPacketSize += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
+            }
+#endif
         }
 
         /* Add the lengths of the user name and password if provided. */
@@ -2037,7 +2206,7 @@ MQTTStatus_t MQTT_GetConnectPacketSize( const MQTTConnectInfo_t * pConnectInfo,
 
         /* Calculate the full size of the MQTT CONNECT packet by adding the size of
          * the "Remaining Length" field plus 1 byte for the "Packet Type" field. */
-        connectPacketSize += 1U + remainingLengthEncodedSize( connectPacketSize );
+        connectPacketSize += 1U + MQTT_GetVariableByteIntegerSize( connectPacketSize );
 
         /* The connectPacketSize calculated from this function's parameters is
          * guaranteed to be less than the maximum MQTT CONNECT packet size, which
@@ -2101,7 +2270,7 @@ MQTTStatus_t MQTT_SerializeConnect( const MQTTConnectInfo_t * pConnectInfo,
         /* Calculate CONNECT packet size. Overflow in in this addition is not checked
          * because it is part of the API contract to call Mqtt_GetConnectPacketSize()
          * before this function. */
-        connectPacketSize = remainingLength + remainingLengthEncodedSize( remainingLength ) + 1U;
+        connectPacketSize = remainingLength + MQTT_GetVariableByteIntegerSize( remainingLength ) + 1U;
 
         /* Check that the full packet size fits within the given buffer. */
         if( connectPacketSize > pFixedBuffer->size )
@@ -2167,8 +2336,8 @@ MQTTStatus_t MQTT_GetSubscribePacketSize( const MQTTSubscribeInfo_t * pSubscript
         if( ( status == MQTTSuccess ) && ( pProperties != NULL ) )
         {
             size_t propertiesSize = MQTT5_GetPropertiesSize( pProperties );
-            *pRemainingLength += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
-            *pPacketSize += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+            *pRemainingLength += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
+            *pPacketSize += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
         }
         else if( status == MQTTSuccess )
         {
@@ -2354,8 +2523,8 @@ MQTTStatus_t MQTT_GetUnsubscribePacketSize( const MQTTSubscribeInfo_t * pSubscri
         if( ( status == MQTTSuccess ) && ( pProperties != NULL ) )
         {
             size_t propertiesSize = MQTT5_GetPropertiesSize( pProperties );
-            *pRemainingLength += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
-            *pPacketSize += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+            *pRemainingLength += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
+            *pPacketSize += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
         }
         else if( status == MQTTSuccess )
         {
@@ -2448,7 +2617,7 @@ MQTTStatus_t MQTT_GetPublishPacketSize( const MQTTPublishInfo_t * pPublishInfo,
                     ( void * ) pPacketSize ) );
         status = MQTTBadParameter;
     }
-    else if( ( pPublishInfo->pTopicName == NULL ) || ( pPublishInfo->topicNameLength == 0U ) )
+    else if( validPublishTopic( pPublishInfo ) == false )
     {
         LogError( ( "Invalid topic name for PUBLISH: pTopicName=%p, "
                     "topicNameLength=%hu.",
@@ -2507,7 +2676,7 @@ MQTTStatus_t MQTT_SerializePublish( const MQTTPublishInfo_t * pPublishInfo,
                     pPublishInfo->pPayload ) );
         status = MQTTBadParameter;
     }
-    else if( ( pPublishInfo->pTopicName == NULL ) || ( pPublishInfo->topicNameLength == 0U ) )
+    else if( validPublishTopic( pPublishInfo ) == false )
     {
         LogError( ( "Invalid topic name for PUBLISH: pTopicName=%p, "
                     "topicNameLength=%hu.",
@@ -2531,7 +2700,7 @@ MQTTStatus_t MQTT_SerializePublish( const MQTTPublishInfo_t * pPublishInfo,
         /* Length of serialized packet = First byte
          *                                + Length of encoded remaining length
          *                                + Remaining length. */
-        packetSize = 1U + remainingLengthEncodedSize( remainingLength )
+        packetSize = 1U + MQTT_GetVariableByteIntegerSize( remainingLength )
                      + remainingLength;
     }
 
@@ -2584,7 +2753,7 @@ MQTTStatus_t MQTT_SerializePublishHeader( const MQTTPublishInfo_t * pPublishInfo
         LogError( ( "Argument cannot be NULL: pFixedBuffer->pBuffer is NULL." ) );
         status = MQTTBadParameter;
     }
-    else if( ( pPublishInfo->pTopicName == NULL ) || ( pPublishInfo->topicNameLength == 0U ) )
+    else if( validPublishTopic( pPublishInfo ) == false )
     {
         LogError( ( "Invalid topic name for publish: pTopicName=%p, "
                     "topicNameLength=%hu.",
@@ -2610,7 +2779,7 @@ MQTTStatus_t MQTT_SerializePublishHeader( const MQTTPublishInfo_t * pPublishInfo
          *                               + Remaining length
          *                               - Payload Length.
          */
-        packetSize = 1U + remainingLengthEncodedSize( remainingLength )
+        packetSize = 1U + MQTT_GetVariableByteIntegerSize( remainingLength )
                      + remainingLength
                      - pPublishInfo->payloadLength;
     }
@@ -3030,6 +3199,79 @@ MQTTStatus_t MQTT_GetIncomingPacketTypeAndLength( TransportRecv_t readFunc,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_GetIncomingPacketTypeAndLengthBuffered( TransportRecv_t readFunc,
+                                                          NetworkContext_t * pNetworkContext,
+                                                          const MQTTFixedBuffer_t * pFixedBuffer,
+                                                          size_t * pBytesInBuffer,
+                                                          MQTTPacketInfo_t * pIncomingPacket )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    int32_t bytesReceived = 0;
+
+    if( ( readFunc == NULL ) || ( pFixedBuffer == NULL ) ||
+        ( pBytesInBuffer == NULL ) || ( pIncomingPacket == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: readFunc is %s, pFixedBuffer=%p, "
+                    "pBytesInBuffer=%p, pIncomingPacket=%p.",
+                    ( readFunc == NULL ) ? "NULL" : "set",
+                    ( const void * ) pFixedBuffer,
+                    ( void * ) pBytesInBuffer,
+                    ( void * ) pIncomingPacket ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pFixedBuffer->pBuffer == NULL ) ||
+             ( pFixedBuffer->size < MQTT_FIXED_HEADER_MAX_SIZE ) ||
+             ( *pBytesInBuffer > pFixedBuffer->size ) )
+    {
+        LogError( ( "The buffer must hold at least %lu bytes: pBuffer=%p, "
+                    "size=%lu, bytesInBuffer=%lu.",
+                    MQTT_FIXED_HEADER_MAX_SIZE,
+                    ( void * ) pFixedBuffer->pBuffer,
+                    ( unsigned long ) pFixedBuffer->size,
+                    ( unsigned long ) *pBytesInBuffer ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Bytes left over from an earlier receive may hold the whole header. */
+        status = MQTT_ProcessIncomingPacketTypeAndLength( pFixedBuffer->pBuffer,
+                                                          pBytesInBuffer,
+                                                          pIncomingPacket );
+    }
+
+    if( ( status == MQTTNoDataAvailable ) || ( status == MQTTNeedMoreBytes ) )
+    {
+        /* Receive as much as fits with a single call. Since the buffer holds
+         * a whole fixed header, the header is either complete afterwards or
+         * the transport has no more bytes yet. */
+        bytesReceived = readFunc( pNetworkContext,
+                                  &( pFixedBuffer->pBuffer[ *pBytesInBuffer ] ),
+                                  pFixedBuffer->size - *pBytesInBuffer );
+
+        if( bytesReceived < 0 )
+        {
+            LogError( ( "Receiving the fixed header failed: transportStatus=%ld.",
+                        ( long int ) bytesReceived ) );
+            status = MQTTRecvFailed;
+        }
+        else if( bytesReceived > 0 )
+        {
+            *pBytesInBuffer += ( size_t ) bytesReceived;
+            status = MQTT_ProcessIncomingPacketTypeAndLength( pFixedBuffer->pBuffer,
+                                                              pBytesInBuffer,
+                                                              pIncomingPacket );
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_UpdateDuplicatePublishFlag( uint8_t * pHeader,
                                               bool set )
 {
@@ -3141,7 +3383,7 @@ MQTTStatus_t MQTT_SerializeDisconnect( uint8_t reasonCode,
             if( pProperties != NULL )
             {
                 propertiesSize = MQTT5_GetPropertiesSize( pProperties );
-                remainingLength += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+                remainingLength += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
             }
             else
             {
@@ -3149,7 +3391,7 @@ MQTTStatus_t MQTT_SerializeDisconnect( uint8_t reasonCode,
             }
         }
         
-        *pPacketSize = 1U + remainingLengthEncodedSize( remainingLength ) + remainingLength;
+        *pPacketSize = 1U + MQTT_GetVariableByteIntegerSize( remainingLength ) + remainingLength;
         
         if( *pPacketSize > pFixedBuffer->size )
         {
@@ -3210,14 +3452,14 @@ MQTTStatus_t MQTT_SerializeAuth( uint8_t reasonCode,
         if( pProperties != NULL )
         {
             propertiesSize = MQTT5_GetPropertiesSize( pProperties );
-            remainingLength += remainingLengthEncodedSize( propertiesSize ) + propertiesSize;
+            remainingLength += MQTT_GetVariableByteIntegerSize( propertiesSize ) + propertiesSize;
         }
         else
         {
             remainingLength += 1U; /* Empty properties */
         }
         
-        *pPacketSize = 1U + remainingLengthEncodedSize( remainingLength ) + remainingLength;
+        *pPacketSize = 1U + MQTT_GetVariableByteIntegerSize( remainingLength ) + remainingLength;
         
         if( *pPacketSize > pFixedBuffer->size )
         {
@@ -69,6 +69,15 @@ static const size_t ZERO_SIZE_T = 0U;
  */
 #define UINT16_CHECK_BIT( x, position )         ( ( ( x ) & ( UINT16_BITMAP_BIT_SET_AT( position ) ) ) == ( UINT16_BITMAP_BIT_SET_AT( position ) ) )
 
+/**
+ * @brief Fraction of an indexed record array kept free of new records.
+ *
+ * When the tail of the ring reaches its head, at least this fraction of the
+ * positions are holes, so a compaction moving every record is followed by as
+ * many additions without one.
+ */
+#define MQTT_INDEX_SLACK_DIVISOR                ( 4U )
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -113,11 +122,75 @@ static bool validateTransitionAck( MQTTPublishState_t currentState,
 static bool isPublishOutgoing( MQTTPubAckType_t packetType,
                                MQTTStateOperation_t opType );
 
+/**
+ * @brief Calculate the home slot of a packet ID in a packet ID index.
+ *
+ * Packet IDs are usually allocated sequentially. Scattering them with a
+ * multiplicative hash keeps the probe clusters short, which bounds the work
+ * done when an entry is removed.
+ *
+ * @param[in] packetId Packet ID to hash.
+ * @param[in] slotCount Number of slots in the index.
+ *
+ * @return The first slot to probe for the packet ID.
+ */
+static size_t indexHome( uint16_t packetId,
+                         size_t slotCount );
+
+/**
+ * @brief Find the slot holding a packet ID in a packet ID index.
+ *
+ * @param[in] pIndex Packet ID index.
+ * @param[in] packetId Packet ID to search for.
+ *
+ * @return Slot of the packet ID if it exists, else #MQTT_INVALID_STATE_COUNT.
+ */
+static size_t indexFind( const MQTTPubAckIndex_t * pIndex,
+                         uint16_t packetId );
+
+/**
+ * @brief Add a packet ID to a packet ID index or update its record position.
+ *
+ * @param[in] pIndex Packet ID index.
+ * @param[in] packetId Packet ID to store.
+ * @param[in] recordIndex Position of the record holding the packet ID.
+ */
+static void indexSet( MQTTPubAckIndex_t * pIndex,
+                      uint16_t packetId,
+                      size_t recordIndex );
+
+/**
+ * @brief Remove a packet ID from a packet ID index.
+ *
+ * The entries following the removed one in its probe sequence are shifted
+ * back, so no tombstones are needed.
+ *
+ * @param[in] pIndex Packet ID index.
+ * @param[in] packetId Packet ID to remove.
+ */
+static void indexRemove( MQTTPubAckIndex_t * pIndex,
+                         uint16_t packetId );
+
+/**
+ * @brief Rebuild a packet ID index and its occupancy from a record array.
+ *
+ * The records are taken to start at position zero, as they do when they were
+ * not indexed before.
+ *
+ * @param[in] records State record array.
+ * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index to rebuild.
+ */
+static void indexRecords( const MQTTPubAckInfo_t * records,
+                          size_t recordCount,
+                          MQTTPubAckIndex_t * pIndex );
+
 /**
  * @brief Find a packet ID in the state record.
  *
  * @param[in] records State record array.
  * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index of the records, or NULL to search linearly.
  * @param[in] packetId packet ID to search for.
  * @param[out] pQos QoS retrieved from record.
  * @param[out] pCurrentState state retrieved from record.
@@ -126,6 +199,7 @@ static bool isPublishOutgoing( MQTTPubAckType_t packetType,
  */
 static size_t findInRecord( const MQTTPubAckInfo_t * records,
                             size_t recordCount,
+                            const MQTTPubAckIndex_t * pIndex,
                             uint16_t packetId,
                             MQTTQoS_t * pQos,
                             MQTTPublishState_t * pCurrentState );
@@ -143,11 +217,89 @@ static size_t findInRecord( const MQTTPubAckInfo_t * records,
 static void compactRecords( MQTTPubAckInfo_t * records,
                             size_t recordCount );
 
+/**
+ * @brief Compact the records of an indexed record array.
+ *
+ * The valid records between the head and the tail are moved towards the head,
+ * keeping their relative order.
+ *
+ * @param[in] records State record array.
+ * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index of the records.
+ */
+static void compactIndexedRecords( MQTTPubAckInfo_t * records,
+                                   size_t recordCount,
+                                   MQTTPubAckIndex_t * pIndex );
+
+/**
+ * @brief Count the valid records before a position of a record array, which
+ * is the position of the record there once the array is compacted.
+ *
+ * @param[in] records State record array.
+ * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ * @param[in] position Position, counted as for #MQTTStateCursor_t.
+ *
+ * @return The number of valid records before the position.
+ */
+static size_t countRecordsBefore( const MQTTPubAckInfo_t * records,
+                                  size_t recordCount,
+                                  const MQTTPubAckIndex_t * pIndex,
+                                  size_t position );
+
+/**
+ * @brief Move the positions of a session resumption along with the records
+ * when records are dropped from the head, and keep them short of the tail,
+ * where new records are added.
+ *
+ * @param[in] pResume Progress of the session resumption.
+ * @param[in] droppedCount Number of positions dropped from the head.
+ * @param[in] tail Position past the last record.
+ */
+static void moveResumePositions( MQTTSessionResume_t * pResume,
+                                 size_t droppedCount,
+                                 size_t tail );
+
+/**
+ * @brief Get the session resumption of a context if it is in progress.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ *
+ * @return The session resumption, or NULL if none is in progress.
+ */
+static MQTTSessionResume_t * resumeInProgress( const MQTTContext_t * pMqttContext );
+
+/**
+ * @brief Get the number of records a record array holds before new records
+ * are refused, leaving the slack of an indexed array free.
+ *
+ * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ *
+ * @return The number of records which may be added.
+ */
+static size_t newRecordLimit( size_t recordCount,
+                              const MQTTPubAckIndex_t * pIndex );
+
+/**
+ * @brief Get the number of outgoing publishes which may await acknowledgment
+ * at once, which is the record limit unless the broker advertised a lower
+ * Receive Maximum.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ *
+ * @return The size of the send window.
+ */
+static size_t sendWindowSize( const MQTTContext_t * pMqttContext );
+
 /**
  * @brief Store a new entry in the state record.
  *
  * @param[in] records State record array.
  * @param[in] recordCount Length of record array.
+ * @param[in] recordLimit Number of entries above which no entry is added.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ * @param[in] pResume Progress of a session resumption over the records, or NULL.
  * @param[in] packetId Packet ID of new entry.
  * @param[in] qos QoS of new entry.
  * @param[in] publishState State of new entry.
@@ -156,6 +308,9 @@ static void compactRecords( MQTTPubAckInfo_t * records,
  */
 static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
                                size_t recordCount,
+                               size_t recordLimit,
+                               MQTTPubAckIndex_t * pIndex,
+                               MQTTSessionResume_t * pResume,
                                uint16_t packetId,
                                MQTTQoS_t qos,
                                MQTTPublishState_t publishState );
@@ -164,15 +319,38 @@ static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
  * @brief Update and possibly delete an entry in the state record.
  *
  * @param[in] records State record array.
+ * @param[in] recordCount Length of record array.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ * @param[in] pResume Progress of a session resumption over the records, or NULL.
  * @param[in] recordIndex index of record to update.
  * @param[in] newState New state to update.
  * @param[in] shouldDelete Whether an existing entry should be deleted.
  */
 static void updateRecord( MQTTPubAckInfo_t * records,
+                          size_t recordCount,
+                          MQTTPubAckIndex_t * pIndex,
+                          MQTTSessionResume_t * pResume,
                           size_t recordIndex,
                           MQTTPublishState_t newState,
                           bool shouldDelete );
 
+/**
+ * @brief Delete the QoS 1 or QoS 2 record of a packet ID.
+ *
+ * @param[in] records State records pointer.
+ * @param[in] recordCount Length of the records array.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ * @param[in] pResume Progress of a session resumption over the records, or NULL.
+ * @param[in] packetId Packet ID of the record to delete.
+ *
+ * @return #MQTTBadParameter if there is no such record, or #MQTTSuccess.
+ */
+static MQTTStatus_t removeRecord( MQTTPubAckInfo_t * records,
+                                  size_t recordCount,
+                                  MQTTPubAckIndex_t * pIndex,
+                                  MQTTSessionResume_t * pResume,
+                                  uint16_t packetId );
+
 /**
  * @brief Get the packet ID and index of an outgoing publish in specified
  * states.
@@ -193,6 +371,8 @@ static uint16_t stateSelect( const MQTTContext_t * pMqttContext,
  *
  * @param[in] records State records pointer.
  * @param[in] maxRecordCount The maximum number of records.
+ * @param[in] pIndex Packet ID index of the records, or NULL.
+ * @param[in] pResume Progress of a session resumption over the records, or NULL.
  * @param[in] recordIndex Index at which the record is stored.
  * @param[in] packetId Packet id of the packet.
  * @param[in] currentState Current state of the publish record.
@@ -202,6 +382,8 @@ static uint16_t stateSelect( const MQTTContext_t * pMqttContext,
  */
 static MQTTStatus_t updateStateAck( MQTTPubAckInfo_t * records,
                                     size_t maxRecordCount,
+                                    MQTTPubAckIndex_t * pIndex,
+                                    MQTTSessionResume_t * pResume,
                                     size_t recordIndex,
                                     uint16_t packetId,
                                     MQTTPublishState_t currentState,
@@ -229,6 +411,22 @@ static MQTTStatus_t updateStatePublish( const MQTTContext_t * pMqttContext,
                                         MQTTPublishState_t currentState,
                                         MQTTPublishState_t newState );
 
+/**
+ * @brief Notify the record state callback of the context, if any, of a
+ * changed state record.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ * @param[in] packetId Packet ID of the record.
+ * @param[in] qos QoS of the record.
+ * @param[in] state New state of the record, or #MQTTStateNull once removed.
+ * @param[in] isOutgoing Whether the record is in the outgoing records.
+ */
+static void notifyRecordState( const MQTTContext_t * pMqttContext,
+                               uint16_t packetId,
+                               MQTTQoS_t qos,
+                               MQTTPublishState_t state,
+                               bool isOutgoing );
+
 /*-----------------------------------------------------------*/
 
 static bool validateTransitionPublish( MQTTPublishState_t currentState,
@@ -437,25 +635,183 @@ static bool isPublishOutgoing( MQTTPubAckType_t packetType,
 
 /*-----------------------------------------------------------*/
 
+static size_t indexHome( uint16_t packetId,
+                         size_t slotCount )
+{
+    /* Fibonacci hashing: 2654435769 is 2^32 divided by the golden ratio.
+     * The high bits of the product are the well mixed ones, so they are
+     * scaled to the slot count instead of taking a remainder. */
+    uint32_t hash = ( uint32_t ) packetId * 2654435769U;
+
+    return ( size_t ) ( ( ( uint64_t ) hash * ( uint64_t ) slotCount ) >> 32 );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t indexFind( const MQTTPubAckIndex_t * pIndex,
+                         uint16_t packetId )
+{
+    size_t slot = MQTT_INVALID_STATE_COUNT;
+    size_t probe = 0U;
+    size_t probeCount = 0U;
+    const MQTTPubAckIndexSlot_t * pSlots = NULL;
+
+    assert( pIndex != NULL );
+    assert( packetId != MQTT_PACKET_ID_INVALID );
+
+    pSlots = pIndex->pSlots;
+    probe = indexHome( packetId, pIndex->slotCount );
+
+    /* The index always has more slots than records, so an empty slot ends
+     * every probe sequence for a packet ID which is not present. */
+    while( ( probeCount < pIndex->slotCount ) &&
+           ( pSlots[ probe ].packetId != MQTT_PACKET_ID_INVALID ) )
+    {
+        if( pSlots[ probe ].packetId == packetId )
+        {
+            slot = probe;
+            break;
+        }
+
+        probe = ( probe + 1U ) % pIndex->slotCount;
+        probeCount++;
+    }
+
+    return slot;
+}
+
+/*-----------------------------------------------------------*/
+
+static void indexSet( MQTTPubAckIndex_t * pIndex,
+                      uint16_t packetId,
+                      size_t recordIndex )
+{
+    size_t probe = 0U;
+    MQTTPubAckIndexSlot_t * pSlots = NULL;
+
+    assert( pIndex != NULL );
+    assert( packetId != MQTT_PACKET_ID_INVALID );
+
+    pSlots = pIndex->pSlots;
+    probe = indexHome( packetId, pIndex->slotCount );
+
+    /* Stop at the existing entry for the packet ID, or at the first empty
+     * slot if there is none. */
+    while( ( pSlots[ probe ].packetId != MQTT_PACKET_ID_INVALID ) &&
+           ( pSlots[ probe ].packetId != packetId ) )
+    {
+        probe = ( probe + 1U ) % pIndex->slotCount;
+    }
+
+    pSlots[ probe ].packetId = packetId;
+    pSlots[ probe ].recordIndex = recordIndex;
+}
+
+/*-----------------------------------------------------------*/
+
+static void indexRemove( MQTTPubAckIndex_t * pIndex,
+                         uint16_t packetId )
+{
+    size_t hole = indexFind( pIndex, packetId );
+    size_t next = 0U;
+    size_t homeDistance = 0U;
+    size_t holeDistance = 0U;
+    size_t slotCount = pIndex->slotCount;
+    MQTTPubAckIndexSlot_t * pSlots = pIndex->pSlots;
+
+    if( hole != MQTT_INVALID_STATE_COUNT )
+    {
+        next = ( hole + 1U ) % slotCount;
+
+        while( pSlots[ next ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            /* An entry can fill the hole only if the hole lies between its
+             * home slot and its current slot. Otherwise a lookup starting at
+             * its home slot would never reach it. */
+            homeDistance = ( next + slotCount - indexHome( pSlots[ next ].packetId, slotCount ) ) % slotCount;
+            holeDistance = ( next + slotCount - hole ) % slotCount;
+
+            if( homeDistance >= holeDistance )
+            {
+                pSlots[ hole ].packetId = pSlots[ next ].packetId;
+                pSlots[ hole ].recordIndex = pSlots[ next ].recordIndex;
+                hole = next;
+            }
+
+            next = ( next + 1U ) % slotCount;
+        }
+
+        pSlots[ hole ].packetId = MQTT_PACKET_ID_INVALID;
+        pSlots[ hole ].recordIndex = 0U;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void indexRecords( const MQTTPubAckInfo_t * records,
+                          size_t recordCount,
+                          MQTTPubAckIndex_t * pIndex )
+{
+    size_t index = 0U;
+
+    assert( pIndex != NULL );
+
+    ( void ) memset( pIndex->pSlots,
+                     0x00,
+                     pIndex->slotCount * sizeof( *pIndex->pSlots ) );
+    pIndex->head = 0U;
+    pIndex->usedCount = 0U;
+    pIndex->liveCount = 0U;
+
+    for( index = 0U; index < recordCount; index++ )
+    {
+        if( records[ index ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            indexSet( pIndex, records[ index ].packetId, index );
+            pIndex->usedCount = index + 1U;
+            pIndex->liveCount++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static size_t findInRecord( const MQTTPubAckInfo_t * records,
                             size_t recordCount,
+                            const MQTTPubAckIndex_t * pIndex,
                             uint16_t packetId,
                             MQTTQoS_t * pQos,
                             MQTTPublishState_t * pCurrentState )
 {
     size_t index = 0;
+    size_t slot = MQTT_INVALID_STATE_COUNT;
 
     assert( packetId != MQTT_PACKET_ID_INVALID );
 
     *pCurrentState = MQTTStateNull;
 
-    for( index = 0; index < recordCount; index++ )
+    if( pIndex != NULL )
     {
-        if( records[ index ].packetId == packetId )
+        slot = indexFind( pIndex, packetId );
+        index = ( slot == MQTT_INVALID_STATE_COUNT ) ? recordCount : pIndex->pSlots[ slot ].recordIndex;
+
+        if( index < recordCount )
         {
+            assert( records[ index ].packetId == packetId );
             *pQos = records[ index ].qos;
             *pCurrentState = records[ index ].publishState;
-            break;
+        }
+    }
+    else
+    {
+        for( index = 0; index < recordCount; index++ )
+        {
+            if( records[ index ].packetId == packetId )
+            {
+                *pQos = records[ index ].qos;
+                *pCurrentState = records[ index ].publishState;
+                break;
+            }
         }
     }
 
@@ -511,8 +867,145 @@ static void compactRecords( MQTTPubAckInfo_t * records,
 
 /*-----------------------------------------------------------*/
 
+static void compactIndexedRecords( MQTTPubAckInfo_t * records,
+                                   size_t recordCount,
+                                   MQTTPubAckIndex_t * pIndex )
+{
+    size_t offset = 0U;
+    size_t readIndex = 0U;
+    size_t writeIndex = 0U;
+
+    assert( records != NULL );
+    assert( pIndex != NULL );
+
+    writeIndex = pIndex->head;
+
+    /* The write position never passes the read position, so records which
+     * have not been read yet are never overwritten. */
+    for( offset = 0U; offset < pIndex->usedCount; offset++ )
+    {
+        readIndex = ( pIndex->head + offset ) % recordCount;
+
+        if( records[ readIndex ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            if( readIndex != writeIndex )
+            {
+                records[ writeIndex ].packetId = records[ readIndex ].packetId;
+                records[ writeIndex ].qos = records[ readIndex ].qos;
+                records[ writeIndex ].publishState = records[ readIndex ].publishState;
+
+                records[ readIndex ].packetId = MQTT_PACKET_ID_INVALID;
+                records[ readIndex ].qos = MQTTQoS0;
+                records[ readIndex ].publishState = MQTTStateNull;
+
+                indexSet( pIndex, records[ writeIndex ].packetId, writeIndex );
+            }
+
+            writeIndex = ( writeIndex + 1U ) % recordCount;
+        }
+    }
+
+    pIndex->usedCount = pIndex->liveCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t countRecordsBefore( const MQTTPubAckInfo_t * records,
+                                  size_t recordCount,
+                                  const MQTTPubAckIndex_t * pIndex,
+                                  size_t position )
+{
+    size_t head = ( pIndex != NULL ) ? pIndex->head : 0U;
+    size_t offset = 0U;
+    size_t count = 0U;
+
+    for( offset = 0U; ( offset < position ) && ( offset < recordCount ); offset++ )
+    {
+        if( records[ ( head + offset ) % recordCount ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+static void moveResumePositions( MQTTSessionResume_t * pResume,
+                                 size_t droppedCount,
+                                 size_t tail )
+{
+    assert( pResume != NULL );
+
+    pResume->next = ( pResume->next > droppedCount ) ? ( pResume->next - droppedCount ) : 0U;
+    pResume->end = ( pResume->end > droppedCount ) ? ( pResume->end - droppedCount ) : 0U;
+
+    /* Records added at the tail from now on are not part of the resumed
+     * session. */
+    if( pResume->end > tail )
+    {
+        pResume->end = tail;
+    }
+
+    if( pResume->next > pResume->end )
+    {
+        pResume->next = pResume->end;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTSessionResume_t * resumeInProgress( const MQTTContext_t * pMqttContext )
+{
+    MQTTSessionResume_t * pResume = pMqttContext->pSessionResume;
+
+    if( ( pResume != NULL ) && ( pResume->inProgress == false ) )
+    {
+        pResume = NULL;
+    }
+
+    return pResume;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t newRecordLimit( size_t recordCount,
+                              const MQTTPubAckIndex_t * pIndex )
+{
+    size_t limit = recordCount;
+
+    if( pIndex != NULL )
+    {
+        limit -= recordCount / MQTT_INDEX_SLACK_DIVISOR;
+    }
+
+    return limit;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t sendWindowSize( const MQTTContext_t * pMqttContext )
+{
+    size_t windowSize = newRecordLimit( pMqttContext->outgoingPublishRecordMaxCount,
+                                        pMqttContext->outgoingPublishIndex );
+
+    if( ( pMqttContext->receiveMaximum != 0U ) &&
+        ( ( size_t ) pMqttContext->receiveMaximum < windowSize ) )
+    {
+        windowSize = pMqttContext->receiveMaximum;
+    }
+
+    return windowSize;
+}
+
+/*-----------------------------------------------------------*/
+
 static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
                                size_t recordCount,
+                               size_t recordLimit,
+                               MQTTPubAckIndex_t * pIndex,
+                               MQTTSessionResume_t * pResume,
                                uint16_t packetId,
                                MQTTQoS_t qos,
                                MQTTPublishState_t publishState )
@@ -520,48 +1013,118 @@ static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
     MQTTStatus_t status = MQTTNoMemory;
     int32_t index = 0;
     size_t availableIndex = recordCount;
+    size_t liveCount = 0U;
     bool validEntryFound = false;
 
     assert( packetId != MQTT_PACKET_ID_INVALID );
     assert( qos != MQTTQoS0 );
 
-    /* Check if we have to compact the records. This is known by checking if
-     * the last spot in the array is filled. */
-    if( records[ recordCount - 1U ].packetId != MQTT_PACKET_ID_INVALID )
+    if( pIndex != NULL )
     {
-        compactRecords( records, recordCount );
-    }
+        if( indexFind( pIndex, packetId ) != MQTT_INVALID_STATE_COUNT )
+        {
+            LogError( ( "Collision when adding PacketID=%u.",
+                        ( unsigned int ) packetId ) );
 
-    /* Start from end so first available index will be populated.
-     * Available index is always found after the last element in the records.
-     * This is to make sure the relative order of the records in order to meet
-     * the message ordering requirement of MQTT spec 3.1.1. */
-    for( index = ( ( int32_t ) recordCount - 1 ); index >= 0; index-- )
-    {
-        /* Available index is only found after packet at the highest index. */
-        if( records[ index ].packetId == MQTT_PACKET_ID_INVALID )
+            status = MQTTStateCollision;
+        }
+        else if( pIndex->liveCount >= recordLimit )
         {
-            if( validEntryFound == false )
-            {
-                availableIndex = ( size_t ) index;
-            }
+            LogWarn( ( "No record for PacketID=%u within the limit of %lu records.",
+                       ( unsigned int ) packetId,
+                       ( unsigned long ) recordLimit ) );
         }
         else
         {
-            /* A non-empty spot found in the records. */
-            validEntryFound = true;
+            /* Holes are only reclaimed once the tail has caught up with the
+             * head. The slack kept by the record limit makes at least a
+             * fraction of the positions holes by then, so the records moved
+             * are paid for by the additions since the last compaction. */
+            if( ( pIndex->usedCount == recordCount ) && ( pIndex->liveCount < recordCount ) )
+            {
+                if( pResume != NULL )
+                {
+                    pResume->next = countRecordsBefore( records, recordCount, pIndex, pResume->next );
+                    pResume->end = countRecordsBefore( records, recordCount, pIndex, pResume->end );
+                }
 
-            if( records[ index ].packetId == packetId )
+                compactIndexedRecords( records, recordCount, pIndex );
+            }
+
+            /* New records always go at the tail to keep the relative order. */
+            if( pIndex->usedCount < recordCount )
             {
-                /* Collision. */
-                LogError( ( "Collision when adding PacketID=%u at index=%d.",
-                            ( unsigned int ) packetId,
-                            ( int ) index ) );
+                if( pResume != NULL )
+                {
+                    moveResumePositions( pResume, 0U, pIndex->usedCount );
+                }
+
+                availableIndex = ( pIndex->head + pIndex->usedCount ) % recordCount;
+                pIndex->usedCount++;
+                pIndex->liveCount++;
+            }
+        }
+    }
+    else
+    {
+        /* Check if we have to compact the records. This is known by checking if
+         * the last spot in the array is filled. */
+        if( records[ recordCount - 1U ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            if( pResume != NULL )
+            {
+                pResume->next = countRecordsBefore( records, recordCount, NULL, pResume->next );
+                pResume->end = countRecordsBefore( records, recordCount, NULL, pResume->end );
+            }
 
-                status = MQTTStateCollision;
-                availableIndex = recordCount;
-                break;
+            compactRecords( records, recordCount );
+        }
+
+        /* Start from end so first available index will be populated.
+         * Available index is always found after the last element in the records.
+         * This is to make sure the relative order of the records in order to meet
+         * the message ordering requirement of MQTT spec 3.1.1. */
+        for( index = ( ( int32_t ) recordCount - 1 ); index >= 0; index-- )
+        {
+            /* Available index is only found after packet at the highest index. */
+            if( records[ index ].packetId == MQTT_PACKET_ID_INVALID )
+            {
+                if( validEntryFound == false )
+                {
+                    availableIndex = ( size_t ) index;
+                }
             }
+            else
+            {
+                /* A non-empty spot found in the records. */
+                validEntryFound = true;
+                liveCount++;
+
+                if( records[ index ].packetId == packetId )
+                {
+                    /* Collision. */
+                    LogError( ( "Collision when adding PacketID=%u at index=%d.",
+                                ( unsigned int ) packetId,
+                                ( int ) index ) );
+
+                    status = MQTTStateCollision;
+                    availableIndex = recordCount;
+                    break;
+                }
+            }
+        }
+
+        if( ( availableIndex < recordCount ) && ( liveCount >= recordLimit ) )
+        {
+            LogWarn( ( "No record for PacketID=%u within the limit of %lu records.",
+                       ( unsigned int ) packetId,
+                       ( unsigned long ) recordLimit ) );
+            availableIndex = recordCount;
+        }
+
+        if( ( pResume != NULL ) && ( availableIndex < recordCount ) )
+        {
+            moveResumePositions( pResume, 0U, availableIndex );
         }
     }
 
@@ -570,6 +1133,12 @@ static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
         records[ availableIndex ].packetId = packetId;
         records[ availableIndex ].qos = qos;
         records[ availableIndex ].publishState = publishState;
+
+        if( pIndex != NULL )
+        {
+            indexSet( pIndex, packetId, availableIndex );
+        }
+
         status = MQTTSuccess;
     }
 
@@ -579,18 +1148,59 @@ static MQTTStatus_t addRecord( MQTTPubAckInfo_t * records,
 /*-----------------------------------------------------------*/
 
 static void updateRecord( MQTTPubAckInfo_t * records,
+                          size_t recordCount,
+                          MQTTPubAckIndex_t * pIndex,
+                          MQTTSessionResume_t * pResume,
                           size_t recordIndex,
                           MQTTPublishState_t newState,
                           bool shouldDelete )
 {
+    size_t droppedCount = 0U;
+
     assert( records != NULL );
 
     if( shouldDelete == true )
     {
+        if( pIndex != NULL )
+        {
+            indexRemove( pIndex, records[ recordIndex ].packetId );
+            pIndex->liveCount--;
+        }
+
         /* Mark the record as invalid. */
         records[ recordIndex ].packetId = MQTT_PACKET_ID_INVALID;
         records[ recordIndex ].qos = MQTTQoS0;
         records[ recordIndex ].publishState = MQTTStateNull;
+
+        if( pIndex != NULL )
+        {
+            /* Drop holes at either end of the ring so that they are reused
+             * without compaction. Each hole is dropped at most once. */
+            while( ( pIndex->usedCount > 0U ) &&
+                   ( records[ pIndex->head ].packetId == MQTT_PACKET_ID_INVALID ) )
+            {
+                pIndex->head = ( pIndex->head + 1U ) % recordCount;
+                pIndex->usedCount--;
+                droppedCount++;
+            }
+
+            while( ( pIndex->usedCount > 0U ) &&
+                   ( records[ ( pIndex->head + pIndex->usedCount - 1U ) % recordCount ].packetId == MQTT_PACKET_ID_INVALID ) )
+            {
+                pIndex->usedCount--;
+            }
+
+            if( pIndex->usedCount == 0U )
+            {
+                pIndex->head = 0U;
+            }
+
+            /* Positions are offsets from the head, which has moved. */
+            if( pResume != NULL )
+            {
+                moveResumePositions( pResume, droppedCount, pIndex->usedCount );
+            }
+        }
     }
     else
     {
@@ -608,6 +1218,8 @@ static uint16_t stateSelect( const MQTTContext_t * pMqttContext,
     uint16_t outgoingStates = 0U;
     const MQTTPubAckInfo_t * records = NULL;
     size_t maxCount;
+    size_t head = 0U;
+    size_t recordIndex = 0U;
     bool stateCheck = false;
 
     assert( pMqttContext != NULL );
@@ -628,14 +1240,24 @@ static uint16_t stateSelect( const MQTTContext_t * pMqttContext,
     records = pMqttContext->outgoingPublishRecords;
     maxCount = pMqttContext->outgoingPublishRecordMaxCount;
 
+    /* For indexed records the cursor is an offset from the head of the ring,
+     * and nothing is stored past the tail. */
+    if( pMqttContext->outgoingPublishIndex != NULL )
+    {
+        head = pMqttContext->outgoingPublishIndex->head;
+        maxCount = pMqttContext->outgoingPublishIndex->usedCount;
+    }
+
     while( *pCursor < maxCount )
     {
+        recordIndex = ( head + *pCursor ) % pMqttContext->outgoingPublishRecordMaxCount;
+
         /* Check if any of the search states are present. */
-        stateCheck = UINT16_CHECK_BIT( searchStates, records[ *pCursor ].publishState );
+        stateCheck = UINT16_CHECK_BIT( searchStates, records[ recordIndex ].publishState );
 
         if( stateCheck == true )
         {
-            packetId = records[ *pCursor ].packetId;
+            packetId = records[ recordIndex ].packetId;
             ( *pCursor )++;
             break;
         }
@@ -699,6 +1321,8 @@ MQTTPublishState_t MQTT_CalculateStateAck( MQTTPubAckType_t packetType,
 
 static MQTTStatus_t updateStateAck( MQTTPubAckInfo_t * records,
                                     size_t maxRecordCount,
+                                    MQTTPubAckIndex_t * pIndex,
+                                    MQTTSessionResume_t * pResume,
                                     size_t recordIndex,
                                     uint16_t packetId,
                                     MQTTPublishState_t currentState,
@@ -727,6 +1351,9 @@ static MQTTStatus_t updateStateAck( MQTTPubAckInfo_t * records,
         if( currentState != newState )
         {
             updateRecord( records,
+                          maxRecordCount,
+                          pIndex,
+                          pResume,
                           recordIndex,
                           newState,
                           shouldDeleteRecord );
@@ -739,6 +1366,9 @@ static MQTTStatus_t updateStateAck( MQTTPubAckInfo_t * records,
             {
                 status = addRecord( records,
                                     maxRecordCount,
+                                    maxRecordCount,
+                                    pIndex,
+                                    pResume,
                                     packetId,
                                     MQTTQoS2,
                                     MQTTPubRelSend );
@@ -758,6 +1388,20 @@ static MQTTStatus_t updateStateAck( MQTTPubAckInfo_t * records,
 
 /*-----------------------------------------------------------*/
 
+static void notifyRecordState( const MQTTContext_t * pMqttContext,
+                               uint16_t packetId,
+                               MQTTQoS_t qos,
+                               MQTTPublishState_t state,
+                               bool isOutgoing )
+{
+    if( pMqttContext->recordStateFunction != NULL )
+    {
+        pMqttContext->recordStateFunction( pMqttContext, packetId, qos, state, isOutgoing );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static MQTTStatus_t updateStatePublish( const MQTTContext_t * pMqttContext,
                                         size_t recordIndex,
                                         uint16_t packetId,
@@ -785,9 +1429,18 @@ static MQTTStatus_t updateStatePublish( const MQTTContext_t * pMqttContext,
         {
             status = addRecord( pMqttContext->incomingPublishRecords,
                                 pMqttContext->incomingPublishRecordMaxCount,
+                                newRecordLimit( pMqttContext->incomingPublishRecordMaxCount,
+                                                pMqttContext->incomingPublishIndex ),
+                                pMqttContext->incomingPublishIndex,
+                                NULL,
                                 packetId,
                                 qos,
                                 newState );
+
+            if( status == MQTTSuccess )
+            {
+                notifyRecordState( pMqttContext, packetId, qos, newState, false );
+            }
         }
         /* Send operation. */
         else
@@ -797,9 +1450,13 @@ static MQTTStatus_t updateStatePublish( const MQTTContext_t * pMqttContext,
             if( currentState != newState )
             {
                 updateRecord( pMqttContext->outgoingPublishRecords,
+                              pMqttContext->outgoingPublishRecordMaxCount,
+                              pMqttContext->outgoingPublishIndex,
+                              resumeInProgress( pMqttContext ),
                               recordIndex,
                               newState,
                               false );
+                notifyRecordState( pMqttContext, packetId, qos, newState, true );
             }
         }
     }
@@ -835,9 +1492,17 @@ MQTTStatus_t MQTT_ReserveState( const MQTTContext_t * pMqttContext,
         /* Collisions are detected when adding the record. */
         status = addRecord( pMqttContext->outgoingPublishRecords,
                             pMqttContext->outgoingPublishRecordMaxCount,
+                            sendWindowSize( pMqttContext ),
+                            pMqttContext->outgoingPublishIndex,
+                            resumeInProgress( pMqttContext ),
                             packetId,
                             qos,
                             MQTTPublishSend );
+
+        if( status == MQTTSuccess )
+        {
+            notifyRecordState( pMqttContext, packetId, qos, MQTTPublishSend, true );
+        }
     }
 
     return status;
@@ -909,6 +1574,7 @@ MQTTStatus_t MQTT_UpdateStatePublish( const MQTTContext_t * pMqttContext,
         /* Search record for entry so we can check QoS. */
         recordIndex = findInRecord( pMqttContext->outgoingPublishRecords,
                                     pMqttContext->outgoingPublishRecordMaxCount,
+                                    pMqttContext->outgoingPublishIndex,
                                     packetId,
                                     &foundQoS,
                                     &currentState );
@@ -948,16 +1614,54 @@ MQTTStatus_t MQTT_UpdateStatePublish( const MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_RemoveStateRecord( const MQTTContext_t * pMqttContext,
-                                     uint16_t packetId )
+static MQTTStatus_t removeRecord( MQTTPubAckInfo_t * records,
+                                  size_t recordCount,
+                                  MQTTPubAckIndex_t * pIndex,
+                                  MQTTSessionResume_t * pResume,
+                                  uint16_t packetId )
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTPubAckInfo_t * records;
     size_t recordIndex;
     /* Current state is updated by the findInRecord function. */
     MQTTPublishState_t currentState;
     MQTTQoS_t qos = MQTTQoS0;
 
+    recordIndex = findInRecord( records,
+                                recordCount,
+                                pIndex,
+                                packetId,
+                                &qos,
+                                &currentState );
+
+    if( currentState == MQTTStateNull )
+    {
+        status = MQTTBadParameter;
+    }
+    else if( ( qos != MQTTQoS1 ) && ( qos != MQTTQoS2 ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Delete the record. */
+        updateRecord( records,
+                      recordCount,
+                      pIndex,
+                      pResume,
+                      recordIndex,
+                      MQTTStateNull,
+                      true );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_RemoveStateRecord( const MQTTContext_t * pMqttContext,
+                                     uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
 
     if( ( pMqttContext == NULL ) || ( ( pMqttContext->outgoingPublishRecords == NULL ) ) )
     {
@@ -965,33 +1669,74 @@ MQTTStatus_t MQTT_RemoveStateRecord( const MQTTContext_t * pMqttContext,
     }
     else
     {
-        records = pMqttContext->outgoingPublishRecords;
+        status = removeRecord( pMqttContext->outgoingPublishRecords,
+                               pMqttContext->outgoingPublishRecordMaxCount,
+                               pMqttContext->outgoingPublishIndex,
+                               resumeInProgress( pMqttContext ),
+                               packetId );
 
-        recordIndex = findInRecord( records,
-                                    pMqttContext->outgoingPublishRecordMaxCount,
-                                    packetId,
-                                    &qos,
-                                    &currentState );
+        if( status == MQTTSuccess )
+        {
+            notifyRecordState( pMqttContext, packetId, MQTTQoS0, MQTTStateNull, true );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
 
-        if( currentState == MQTTStateNull )
+MQTTStatus_t MQTT_RemoveIncomingStateRecord( const MQTTContext_t * pMqttContext,
+                                             uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pMqttContext == NULL ) || ( pMqttContext->incomingPublishRecords == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = removeRecord( pMqttContext->incomingPublishRecords,
+                               pMqttContext->incomingPublishRecordMaxCount,
+                               pMqttContext->incomingPublishIndex,
+                               NULL,
+                               packetId );
+
+        if( status == MQTTSuccess )
         {
-            status = MQTTBadParameter;
+            notifyRecordState( pMqttContext, packetId, MQTTQoS0, MQTTStateNull, false );
         }
-        else if( ( qos != MQTTQoS1 ) && ( qos != MQTTQoS2 ) )
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTT_IndexStateRecords( const MQTTContext_t * pMqttContext )
+{
+    if( pMqttContext == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pMqttContext=%p.",
+                    ( void * ) pMqttContext ) );
+    }
+    else
+    {
+        if( pMqttContext->outgoingPublishIndex != NULL )
         {
-            status = MQTTBadParameter;
+            indexRecords( pMqttContext->outgoingPublishRecords,
+                          pMqttContext->outgoingPublishRecordMaxCount,
+                          pMqttContext->outgoingPublishIndex );
         }
-        else
+
+        if( pMqttContext->incomingPublishIndex != NULL )
         {
-            /* Delete the record. */
-            updateRecord( records,
-                          recordIndex,
-                          MQTTStateNull,
-                          true );
+            indexRecords( pMqttContext->incomingPublishRecords,
+                          pMqttContext->incomingPublishRecordMaxCount,
+                          pMqttContext->incomingPublishIndex );
         }
     }
-
-    return status;
 }
 
 /*-----------------------------------------------------------*/
@@ -1010,6 +1755,8 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
     size_t recordIndex = MQTT_INVALID_STATE_COUNT;
 
     MQTTPubAckInfo_t * records = NULL;
+    MQTTPubAckIndex_t * pIndex = NULL;
+    MQTTSessionResume_t * pResume = NULL;
     MQTTStatus_t status = MQTTBadResponse;
 
     if( ( pMqttContext == NULL ) || ( pNewState == NULL ) )
@@ -1035,15 +1782,19 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
         {
             records = pMqttContext->outgoingPublishRecords;
             maxRecordCount = pMqttContext->outgoingPublishRecordMaxCount;
+            pIndex = pMqttContext->outgoingPublishIndex;
+            pResume = resumeInProgress( pMqttContext );
         }
         else
         {
             records = pMqttContext->incomingPublishRecords;
             maxRecordCount = pMqttContext->incomingPublishRecordMaxCount;
+            pIndex = pMqttContext->incomingPublishIndex;
         }
 
         recordIndex = findInRecord( records,
                                     maxRecordCount,
+                                    pIndex,
                                     packetId,
                                     &qos,
                                     &currentState );
@@ -1056,6 +1807,8 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
         /* Validate state transition and update state record. */
         status = updateStateAck( records,
                                  maxRecordCount,
+                                 pIndex,
+                                 pResume,
                                  recordIndex,
                                  packetId,
                                  currentState,
@@ -1065,6 +1818,16 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
         if( status == MQTTSuccess )
         {
             *pNewState = newState;
+
+            /* A completed publish no longer has a record. */
+            if( currentState != newState )
+            {
+                notifyRecordState( pMqttContext,
+                                   packetId,
+                                   qos,
+                                   ( newState == MQTTPublishDone ) ? MQTTStateNull : newState,
+                                   isOutgoingPublish );
+            }
         }
     }
     else
@@ -1144,6 +1907,55 @@ uint16_t MQTT_PublishToResend( const MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_GetSendWindow( const MQTTContext_t * pMqttContext,
+                                 size_t * pFreeCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t liveCount = 0U;
+    size_t windowSize;
+    size_t recordIndex;
+
+    if( ( pMqttContext == NULL ) || ( pFreeCount == NULL ) )
+    {
+        LogError( ( "Arguments cannot be NULL pMqttContext=%p, pFreeCount=%p",
+                    ( void * ) pMqttContext,
+                    ( void * ) pFreeCount ) );
+        status = MQTTBadParameter;
+    }
+    else if( pMqttContext->outgoingPublishRecords == NULL )
+    {
+        LogError( ( "Outgoing publish records are not set up with MQTT_InitStatefulQoS." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        windowSize = sendWindowSize( pMqttContext );
+
+        if( pMqttContext->outgoingPublishIndex != NULL )
+        {
+            liveCount = pMqttContext->outgoingPublishIndex->liveCount;
+        }
+        else
+        {
+            for( recordIndex = 0U; recordIndex < pMqttContext->outgoingPublishRecordMaxCount; recordIndex++ )
+            {
+                if( pMqttContext->outgoingPublishRecords[ recordIndex ].packetId != MQTT_PACKET_ID_INVALID )
+                {
+                    liveCount++;
+                }
+            }
+        }
+
+        /* The window may have shrunk below the records in use on a
+         * reconnection. */
+        *pFreeCount = ( liveCount < windowSize ) ? ( windowSize - liveCount ) : 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 const char * MQTT_State_strerror( MQTTPublishState_t state )
 {
     const char * str = NULL;
@@ -59,11 +59,45 @@
  */
 #define MQTT_PACKET_ID_INVALID    ( ( uint16_t ) 0U )
 
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes encoded by the library between the topic name and the payload
+ * of an outgoing PUBLISH: the packet ID and, with MQTT 5, a property block
+ * holding at most a Topic Alias.
+ */
+#if MQTT_VERSION == MQTT_VERSION_5_0
+    #define MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE    ( 6U )
+#else
+    #define MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE    ( 2U )
+#endif
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Size of the arena of an #MQTTTopicAliases_t, holding @p aliasCount
+ * topic names of up to @p topicNameMaxLength bytes each.
+ */
+#define MQTT_TOPIC_ALIASES_ARENA_SIZE( aliasCount, topicNameMaxLength ) \
+    ( ( size_t ) ( aliasCount ) * ( size_t ) ( topicNameMaxLength ) )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Size of the arena of an #MQTTIncomingTopicAliases_t, holding
+ * @p aliasCount topic names of up to @p topicNameMaxLength bytes each.
+ */
+#define MQTT_INCOMING_TOPIC_ALIASES_ARENA_SIZE( aliasCount, topicNameMaxLength ) \
+    ( ( size_t ) ( aliasCount ) * ( ( size_t ) ( topicNameMaxLength ) + 2U ) )
+
 /* Structures defined in this file. */
 struct MQTTPubAckInfo;
 struct MQTTContext;
 struct MQTTDeserializedInfo;
 
+/* Structures defined in core_mqtt_retransmit.h. */
+struct MQTTRetransmitStore;
+
+/* Structures defined in core_mqtt_journal.h. */
+struct MQTTSessionJournal;
+
 /**
  * @ingroup mqtt_struct_types
  * @brief An opaque structure provided by the library to the #MQTTStorePacketForRetransmit function when using #MQTTStorePacketForRetransmit.
@@ -107,6 +141,35 @@ typedef void (* MQTTEventCallback_t )( struct MQTTContext * pContext,
                                        struct MQTTPacketInfo * pPacketInfo,
                                        struct MQTTDeserializedInfo * pDeserializedInfo );
 
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for receiving the payload of an incoming
+ * PUBLISH packet that is larger than the network buffer.
+ *
+ * The callback is called once per fragment, in payload order, as the payload
+ * is received. The last fragment is the one for which
+ * @p payloadOffset + @p fragmentLength equals
+ * #MQTTPublishInfo_t.payloadLength.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo Topic name and flags of the PUBLISH. The topic name
+ * stays valid for every fragment of the packet. #MQTTPublishInfo_t.pPayload
+ * is NULL and #MQTTPublishInfo_t.payloadLength is the length of the whole
+ * payload.
+ * @param[in] packetId Packet identifier of the PUBLISH, or 0 for QoS 0.
+ * @param[in] payloadOffset Offset of this fragment within the payload.
+ * @param[in] pFragment Fragment of the payload, in the network buffer.
+ * @param[in] fragmentLength Length of the fragment.
+ */
+/* @[define_mqtt_publishstreamcallback] */
+typedef void (* MQTTPublishStreamCallback_t )( struct MQTTContext * pContext,
+                                               const MQTTPublishInfo_t * pPublishInfo,
+                                               uint16_t packetId,
+                                               size_t payloadOffset,
+                                               const uint8_t * pFragment,
+                                               size_t fragmentLength );
+/* @[define_mqtt_publishstreamcallback] */
+
 /**
  * @brief User defined callback used to store outgoing publishes. Used to track any publish
  * retransmit on an unclean session connection.
@@ -146,6 +209,33 @@ typedef bool ( * MQTTRetrievePacketForRetransmit)( struct MQTTContext * pContext
                                                    size_t * pSerializedMqttVecLen );
 /* @[define_mqtt_retransmitretrievepacket] */
 
+/**
+ * @brief User defined callback used to retreive a stored publish as an array of
+ * vectors for resend operation, in place of #MQTTRetrievePacketForRetransmit.
+ * Used to track any publish retransmit on an unclean session connection.
+ *
+ * This lets a store keep references to the topic name and payload buffers of
+ * the application instead of copying them; see MQTT_GetHeaderBytesInMQTTVec
+ * and MQTT_SerializeMQTTVecHeaders.
+ *
+ * @note The library may modify the returned vectors while sending them, so
+ * the store should fill them in again on every retrieve.
+ *
+ * @param[in] pContext Initialised MQTT Context.
+ * @param[in] packetId Copied publish packet identifier.
+ * @param[out] pIoVec Output parameter to store the pointer to the vectors of
+ *                  the publish packet.
+ * @param[out] pIoVecCount Output parameter to return the number of vectors.
+ *
+ * @return True if the retreive is successful else false.
+ */
+/* @[define_mqtt_retransmitretrievevector] */
+typedef bool ( * MQTTRetrieveVectorForRetransmit)( struct MQTTContext * pContext,
+                                                   uint16_t packetId,
+                                                   TransportOutVector_t ** pIoVec,
+                                                   size_t * pIoVecCount );
+/* @[define_mqtt_retransmitretrievevector] */
+
 /**
  * @brief User defined callback used to clear a particular copied publish packet. Used to
  * track any publish retransmit on an unclean session connection.
@@ -188,6 +278,30 @@ typedef enum MQTTPublishState
     MQTTPublishDone     /**< @brief The PUBLISH has been completed. */
 } MQTTPublishState_t;
 
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Callback notified of every change to the state records of QoS 1 and
+ * QoS 2 publishes, such as the one set by #MQTT_RestoreSession to journal
+ * them.
+ *
+ * The callback is called after the record has changed. It is not called when
+ * a resent packet leaves the state of its record unchanged.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId Packet identifier of the record, or
+ * #MQTT_PACKET_ID_INVALID when every record is cleared for a clean session.
+ * @param[in] qos QoS of the publish, or #MQTTQoS0 when it is unknown because
+ * the record was removed.
+ * @param[in] state New state of the record, or #MQTTStateNull once the record
+ * is removed.
+ * @param[in] isOutgoing Whether the record tracks an outgoing publish.
+ */
+typedef void (* MQTTRecordStateCallback_t )( const struct MQTTContext * pContext,
+                                             uint16_t packetId,
+                                             MQTTQoS_t qos,
+                                             MQTTPublishState_t state,
+                                             bool isOutgoing );
+
 /**
  * @ingroup mqtt_enum_types
  * @brief Packet types used in acknowledging QoS 1 or QoS 2 publishes.
@@ -223,6 +337,160 @@ typedef struct MQTTPubAckInfo
     MQTTPublishState_t publishState; /**< @brief The current state of the publish process. */
 } MQTTPubAckInfo_t;
 
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A slot of the optional packet ID index of the state engine records.
+ */
+typedef struct MQTTPubAckIndexSlot
+{
+    uint16_t packetId;  /**< @brief The packet ID of the indexed record, or 0 for an empty slot. */
+    size_t recordIndex; /**< @brief The position of the record in its #MQTTPubAckInfo_t array. */
+} MQTTPubAckIndexSlot_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief Optional packet ID index and occupancy of a state engine record array.
+ *
+ * The slots form an open addressing hash table keyed on packet ID, so lookups
+ * do not need to scan the records. The records of an indexed array are kept
+ * as an order-preserving ring: new records are added at the tail, and deleted
+ * records leave holes which are only compacted when the tail reaches the head.
+ * A quarter of the records are kept free of new records, so that compaction
+ * moves a bounded number of records per record added.
+ *
+ * The application sets @p pSlots and @p slotCount. The other members are
+ * maintained by the library.
+ */
+typedef struct MQTTPubAckIndex
+{
+    MQTTPubAckIndexSlot_t * pSlots; /**< @brief Memory for the hash table slots. */
+    size_t slotCount;               /**< @brief Number of slots, greater than the number of records. */
+    size_t head;                    /**< @brief Position of the oldest record. */
+    size_t usedCount;               /**< @brief Number of positions from the head to the tail, including holes. */
+    size_t liveCount;               /**< @brief Number of valid records. */
+} MQTTPubAckIndex_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief Progress of the resend of the PUBRELs and PUBLISH packets of a
+ * resumed session, spread over calls of #MQTT_ProcessLoop.
+ *
+ * The resend covers the outgoing publish records present when the CONNACK
+ * was received. Positions are counted as for #MQTTStateCursor_t, and are
+ * moved by the state engine along with the records.
+ *
+ * The application sets @p packetsPerCall. The other members are maintained
+ * by the library.
+ */
+typedef struct MQTTSessionResume
+{
+    size_t packetsPerCall;   /**< @brief Most packets resent by one call of #MQTT_ProcessLoop. */
+    size_t next;             /**< @brief Position of the next outgoing publish record to check. */
+    size_t end;              /**< @brief Position past the last record of the resumed session. */
+    bool resendingPublishes; /**< @brief Whether the PUBRELs have been resent and the PUBLISH packets are next. */
+    bool inProgress;         /**< @brief Whether packets of the resumed session remain to be resent. */
+} MQTTSessionResume_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An outgoing topic alias of an MQTT 5 connection.
+ *
+ * The topic name is copied into the arena of #MQTTTopicAliases_t.
+ */
+typedef struct MQTTTopicAlias
+{
+    uint16_t topicNameLength; /**< @brief Length of the topic name mapped to the alias, or zero if the alias is unused. */
+    uint32_t lastUsed;        /**< @brief Value of #MQTTTopicAliases_t.useCount when the alias was last sent. */
+} MQTTTopicAlias_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief Outgoing topic aliases assigned by #MQTT_Publish with MQTT 5.
+ *
+ * Topic Alias N is held by entry N - 1 of @p pAliases, and its topic name by
+ * bytes ( N - 1 ) * @p topicNameMaxLength of the arena onwards.
+ *
+ * The application sets @p pAliases, @p pArena, @p arenaSize, @p aliasCount
+ * and @p topicNameMaxLength. The other members are maintained by the
+ * library.
+ */
+typedef struct MQTTTopicAliases
+{
+    MQTTTopicAlias_t * pAliases; /**< @brief Memory for the aliases. */
+    uint8_t * pArena;            /**< @brief Memory for the topic names of the aliases. */
+    size_t arenaSize;            /**< @brief Size of @p pArena, at least #MQTT_TOPIC_ALIASES_ARENA_SIZE. */
+    uint16_t aliasCount;         /**< @brief Number of entries in @p pAliases. */
+    uint16_t topicNameMaxLength; /**< @brief Longest topic name given an alias. */
+    uint16_t aliasMaximum;       /**< @brief Aliases usable on the connection, the lesser of @p aliasCount and the Topic Alias Maximum of the broker. */
+    uint32_t useCount;           /**< @brief Number of publishes sent with an alias, ordering the aliases by last use. */
+} MQTTTopicAliases_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief Topic aliases of incoming MQTT 5 publishes, resolved by the library.
+ *
+ * Topic Alias N owns bytes ( N - 1 ) * ( @p topicNameMaxLength + 2 ) of the
+ * arena onwards: the length of the topic name on two bytes, zero if the alias
+ * is not mapped, followed by the topic name.
+ *
+ * The application sets every member.
+ */
+typedef struct MQTTIncomingTopicAliases
+{
+    uint8_t * pArena;            /**< @brief Memory for the topic names of the aliases. */
+    size_t arenaSize;            /**< @brief Size of @p pArena, at least #MQTT_INCOMING_TOPIC_ALIASES_ARENA_SIZE. */
+    uint16_t aliasCount;         /**< @brief Topic Alias Maximum advertised to the broker in the CONNECT. */
+    uint16_t topicNameMaxLength; /**< @brief Longest topic name held by an alias. */
+} MQTTIncomingTopicAliases_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A topic, QoS and retain flag validated and encoded once by
+ * #MQTT_PreparePublish for repeated #MQTT_PublishPrepared calls.
+ */
+typedef struct MQTTPreparedPublish
+{
+    MQTTPublishInfo_t publishInfo;       /**< @brief The publish without payload. The topic is not copied. */
+    size_t variableHeaderLength;         /**< @brief Remaining Length of the publish without payload. */
+    uint8_t headerByte;                  /**< @brief Packet type and flags. */
+    uint8_t serializedTopicLength[ 2U ]; /**< @brief Encoded length of the topic. */
+} MQTTPreparedPublish_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A publish submitted to an #MQTTPublishQueue_t.
+ *
+ * The fixed header is serialized by the producer in #MQTT_EnqueuePublish, so
+ * the thread draining the queue only has to assign the packet ID and send.
+ */
+typedef struct MQTTPublishQueueEntry
+{
+    MQTTPublishInfo_t publishInfo;    /**< @brief The publish. Topic and payload are not copied. */
+    uint16_t packetId;                /**< @brief Packet ID, or 0 to assign one when drained. */
+    uint8_t header[ 7U ];             /**< @brief Fixed header including the topic length. */
+    size_t headerSize;                /**< @brief Number of bytes used in @p header. */
+    uint8_t serializedPacketId[ MQTT_PUBLISH_ID_AND_PROPERTIES_SIZE ]; /**< @brief Packet ID and properties as sent, written when drained. */
+} MQTTPublishQueueEntry_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A single producer, single consumer ring of publishes waiting to be
+ * sent by #MQTT_DrainPublishQueues.
+ *
+ * Only the producer writes @p head and only the draining thread writes
+ * @p tail, so neither side needs to take the MQTT context mutex. Each
+ * producer thread needs its own queue.
+ */
+typedef struct MQTTPublishQueue
+{
+    MQTTPublishQueueEntry_t * pEntries; /**< @brief Memory for the entries. */
+    size_t entryCount;                  /**< @brief Number of entries, a power of two. */
+    volatile size_t head;               /**< @brief Count of entries ever enqueued. */
+    volatile size_t tail;               /**< @brief Count of entries ever drained. */
+    size_t drainIndex;                  /**< @brief Entries taken by the batch being sent. */
+    struct MQTTPublishQueue * pNext;    /**< @brief Next queue attached to the same context. */
+} MQTTPublishQueue_t;
+
 /**
  * @ingroup mqtt_struct_types
  * @brief A struct representing an MQTT connection.
@@ -249,6 +517,22 @@ typedef struct MQTTContext
      */
     size_t incomingPublishRecordMaxCount;
 
+    /**
+     * @brief Optional packet ID index of the outgoing publish records.
+     */
+    MQTTPubAckIndex_t * outgoingPublishIndex;
+
+    /**
+     * @brief Optional packet ID index of the incoming publish records.
+     */
+    MQTTPubAckIndex_t * incomingPublishIndex;
+
+    /**
+     * @brief Optional progress of an incremental session resumption,
+     * registered with #MQTT_InitSessionResume.
+     */
+    MQTTSessionResume_t * pSessionResume;
+
     /**
      * @brief The transport interface used by the MQTT connection.
      */
@@ -300,6 +584,57 @@ typedef struct MQTTContext
      */
     size_t index;
 
+    /**
+     * @brief Offset of the first unprocessed byte in the network buffer.
+     *
+     * Only advanced when the ring receive mode is enabled with
+     * #MQTT_InitRingReceive; otherwise it is always zero.
+     */
+    size_t readIndex;
+
+    /**
+     * @brief Whether processed packets are consumed in place instead of
+     * moving the unprocessed bytes to the start of the network buffer.
+     */
+    bool ringReceive;
+
+    /**
+     * @brief Callback receiving the payload of incoming publishes larger than
+     * the network buffer, or NULL to discard such publishes.
+     */
+    MQTTPublishStreamCallback_t streamCallback;
+
+    /**
+     * @brief Publish queues attached with #MQTT_AttachPublishQueue.
+     */
+    MQTTPublishQueue_t * pPublishQueues;
+
+    /**
+     * @brief Whether the publish queues are drained when a PUBACK or PUBCOMP
+     * frees a place in the send window, enabled with #MQTT_InitDrainOnAck.
+     */
+    bool drainOnAck;
+
+    /**
+     * @brief Receive Maximum of the broker, from the CONNACK with MQTT 5. It
+     * bounds the number of outgoing QoS 1 and QoS 2 publishes awaiting
+     * acknowledgment. Zero, as with MQTT 3.1.1, leaves the number of records
+     * as the only bound.
+     */
+    uint16_t receiveMaximum;
+
+    /**
+     * @brief Optional outgoing topic aliases, registered with
+     * #MQTT_InitTopicAliases.
+     */
+    MQTTTopicAliases_t * pTopicAliases;
+
+    /**
+     * @brief Optional topic aliases of incoming publishes, registered with
+     * #MQTT_InitIncomingTopicAliases.
+     */
+    MQTTIncomingTopicAliases_t * pIncomingTopicAliases;
+
     /* Keep alive members. */
     uint16_t keepAliveIntervalSec; /**< @brief Keep Alive interval. */
     uint32_t pingReqSendTimeMs;    /**< @brief Timestamp of the last sent PINGREQ. */
@@ -315,10 +650,32 @@ typedef struct MQTTContext
      */
     MQTTRetrievePacketForRetransmit retrieveFunction;
 
+    /**
+     * @brief User defined API used to retreive a stored publish as vectors
+     * for resend operation, used in place of @p retrieveFunction.
+     */
+    MQTTRetrieveVectorForRetransmit retrieveVectorFunction;
+
     /**
      * @brief User defined API used to clear a particular copied publish packet.
      */
     MQTTClearPacketForRetransmit clearFunction;
+
+    /**
+     * @brief Retransmit store registered with #MQTT_InitRetransmitStore, used
+     * by the callbacks it provides in place of the three above.
+     */
+    struct MQTTRetransmitStore * pRetransmitStore;
+
+    /**
+     * @brief Callback notified of changes to the state records, or NULL.
+     */
+    MQTTRecordStateCallback_t recordStateFunction;
+
+    /**
+     * @brief Session journal registered with #MQTT_RestoreSession.
+     */
+    struct MQTTSessionJournal * pSessionJournal;
 } MQTTContext_t;
 
 /**
@@ -487,6 +844,229 @@ MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
                                    size_t incomingPublishCount );
 /* @[declare_mqtt_initstatefulqos] */
 
+/**
+ * @brief Attach packet ID indexes to the state engine records of an MQTT context.
+ *
+ * Without an index, every state update searches the publish records linearly
+ * for the packet ID, and the records are compacted whenever the last one is
+ * in use. With an index, the lookup is a hash table probe and the records are
+ * kept as a ring whose holes are only compacted when it is full, which keeps
+ * state updates cheap when a large number of publishes are in flight. The
+ * relative order of the records is preserved, so #MQTT_PublishToResend and
+ * #MQTT_PubrelToResend return the same sequence either way.
+ *
+ * This function must be called on an #MQTTContext_t after MQTT_InitStatefulQoS.
+ * Records already present are added to the index. Calling MQTT_InitStatefulQoS
+ * again detaches the indexes. Once an index is attached, the records it covers
+ * must only be modified through the library.
+ *
+ * @param[in] pContext The context to initialize.
+ * @param[in] pOutgoingPublishIndex Index for the outgoing publish records, with
+ * #MQTTPubAckIndex_t.pSlots and #MQTTPubAckIndex_t.slotCount set. Can be NULL to
+ * keep linear lookups for outgoing publishes.
+ * @param[in] pIncomingPublishIndex Index for the incoming publish records. Can be
+ * NULL to keep linear lookups for incoming publishes.
+ *
+ * @note The slot count of an index must be greater than the number of records
+ * it covers; twice that number keeps the probe sequences short.
+ *
+ * @note An indexed record array holds at most three quarters of its records,
+ * rounded up, so that compaction is spread over the records added. Size the
+ * arrays a third larger than the number of publishes kept in flight.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * const size_t outgoingPublishCount = 1000;
+ * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+ * MQTTPubAckIndexSlot_t outgoingPublishSlots[ 2 * outgoingPublishCount ];
+ * MQTTPubAckIndex_t outgoingPublishIndex = { 0 };
+ *
+ * // Initialize the context with MQTT_Init as usual, then:
+ * status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      outgoingPublishIndex.pSlots = outgoingPublishSlots;
+ *      outgoingPublishIndex.slotCount = 2 * outgoingPublishCount;
+ *
+ *      status = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingPublishIndex, NULL );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initstatefulqosindex] */
+MQTTStatus_t MQTT_InitStatefulQoSIndex( MQTTContext_t * pContext,
+                                        MQTTPubAckIndex_t * pOutgoingPublishIndex,
+                                        MQTTPubAckIndex_t * pIncomingPublishIndex );
+/* @[declare_mqtt_initstatefulqosindex] */
+
+/**
+ * @brief Resend the packets of a resumed session from #MQTT_ProcessLoop
+ * rather than from #MQTT_Connect.
+ *
+ * By default, #MQTT_Connect resends every PUBREL and stored PUBLISH of a
+ * resumed session before it returns, and a single failed send fails the
+ * connection. Once this function is called, #MQTT_Connect returns as soon as
+ * the CONNACK is received, and each later call of #MQTT_ProcessLoop or
+ * #MQTT_ProcessLoopBatch resends up to @p packetsPerCall of those packets
+ * before receiving. Acknowledgements are therefore processed while the
+ * resend is still in progress.
+ *
+ * The PUBRELs are resent first, then the PUBLISH packets, each in the order
+ * of their records. A PUBLISH which cannot be retrieved is skipped, and the
+ * call returns #MQTTPublishRetrieveFailed. A failed send returns
+ * #MQTTSendFailed, and the resend starts again once the connection is
+ * re-established. Packets published while the resend is in progress may be
+ * sent before packets of the resumed session.
+ *
+ * This function must be called on an #MQTTContext_t after MQTT_InitStatefulQoS.
+ *
+ * @param[in] pContext The context to initialize.
+ * @param[in] pResume Progress of the resend, with
+ * #MQTTSessionResume_t.packetsPerCall set to a nonzero value. Can be NULL to
+ * resend from #MQTT_Connect again. It must remain in scope for as long as the
+ * context uses it.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTSessionResume_t sessionResume = { 0 };
+ *
+ * // Initialize the context with MQTT_Init and MQTT_InitStatefulQoS as usual, then:
+ * sessionResume.packetsPerCall = 8;
+ * status = MQTT_InitSessionResume( &mqttContext, &sessionResume );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeoutMs, &sessionPresent );
+ * }
+ *
+ * while( status == MQTTSuccess )
+ * {
+ *      // Resends up to 8 packets, then receives.
+ *      status = MQTT_ProcessLoop( &mqttContext );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initsessionresume] */
+MQTTStatus_t MQTT_InitSessionResume( MQTTContext_t * pContext,
+                                     MQTTSessionResume_t * pResume );
+/* @[declare_mqtt_initsessionresume] */
+
+/**
+ * @brief Replace the topic names of frequent MQTT 5 publishes by Topic
+ * Aliases.
+ *
+ * Once this function is called, each #MQTT_Publish maps its topic name to a
+ * Topic Alias, up to the Topic Alias Maximum sent by the broker in the
+ * CONNACK. The first publish on a topic sends the topic name with its new
+ * alias, and later publishes on the topic send an empty topic name with the
+ * alias. When every alias is in use, the least recently used one is mapped
+ * to the new topic. The aliases are forgotten on each connection.
+ *
+ * A publish keeps its topic name and gets no alias if:
+ * - it is a QoS 1 or QoS 2 publish stored for retransmission with
+ * #MQTT_InitRetransmits, as the stored packet may be resent on a later
+ * connection, where the alias is not mapped;
+ * - it carries properties in #MQTTPublishInfo_t.pProperties;
+ * - its topic name is longer than #MQTTTopicAliases_t.topicNameMaxLength;
+ * - it is sent by #MQTT_PublishMany, #MQTT_PublishPrepared or from a publish
+ * queue.
+ *
+ * The topic name mapped to an alias is copied into the arena, and topic names
+ * are matched by their bytes. The topic name of a publish may be reused for
+ * another topic once #MQTT_Publish returns.
+ *
+ * This function has no effect with MQTT 3.1.1.
+ *
+ * @param[in] pContext The context to initialize.
+ * @param[in] pAliases Aliases of the connection, with the members set by the
+ * application filled in. Can be NULL to stop using aliases. It must remain in
+ * scope for as long as the context uses it.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Up to 8 aliases of topic names of up to 64 bytes.
+ * MQTTTopicAlias_t aliasMemory[ 8 ];
+ * uint8_t aliasArena[ MQTT_TOPIC_ALIASES_ARENA_SIZE( 8, 64 ) ];
+ * MQTTTopicAliases_t topicAliases = { 0 };
+ *
+ * // Initialize the context with MQTT_Init as usual, then before MQTT_Connect:
+ * topicAliases.pAliases = aliasMemory;
+ * topicAliases.pArena = aliasArena;
+ * topicAliases.arenaSize = sizeof( aliasArena );
+ * topicAliases.aliasCount = 8;
+ * topicAliases.topicNameMaxLength = 64;
+ * status = MQTT_InitTopicAliases( &mqttContext, &topicAliases );
+ * @endcode
+ */
+/* @[declare_mqtt_inittopicaliases] */
+MQTTStatus_t MQTT_InitTopicAliases( MQTTContext_t * pContext,
+                                    MQTTTopicAliases_t * pAliases );
+/* @[declare_mqtt_inittopicaliases] */
+
+/**
+ * @brief Resolve the Topic Aliases of incoming MQTT 5 publishes.
+ *
+ * Once this function is called, the topic name of an incoming publish that
+ * maps a Topic Alias is copied into the arena of the alias. An incoming
+ * publish with an empty topic name and a Topic Alias is given to the event
+ * callback with #MQTTPublishInfo_t.pTopicName pointing to the topic name in
+ * the arena, without copying it. #MQTTPublishInfo_t.topicAlias holds the
+ * alias of the publish either way. The aliases are forgotten on each
+ * connection.
+ *
+ * A topic name longer than #MQTTIncomingTopicAliases_t.topicNameMaxLength
+ * leaves its alias unmapped. An incoming publish using an unmapped alias, or
+ * an alias greater than #MQTTIncomingTopicAliases_t.aliasCount, fails with
+ * #MQTTBadResponse.
+ *
+ * The broker only sends aliases up to the Topic Alias Maximum in the
+ * properties of the CONNECT. #MQTT_Connect fails with #MQTTBadParameter if
+ * that maximum exceeds #MQTTIncomingTopicAliases_t.aliasCount.
+ *
+ * This function has no effect with MQTT 3.1.1.
+ *
+ * @param[in] pContext The context to initialize.
+ * @param[in] pAliases Aliases of the connection, with every member set. Can
+ * be NULL to give the incoming publishes to the event callback unresolved. It
+ * must remain in scope for as long as the context uses it.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Up to 8 aliases of topic names of up to 64 bytes.
+ * uint8_t aliasArena[ MQTT_INCOMING_TOPIC_ALIASES_ARENA_SIZE( 8, 64 ) ];
+ * MQTTIncomingTopicAliases_t incomingAliases;
+ *
+ * // Initialize the context with MQTT_Init as usual, then before MQTT_Connect,
+ * // whose CONNECT properties carry a Topic Alias Maximum of 8:
+ * incomingAliases.pArena = aliasArena;
+ * incomingAliases.arenaSize = sizeof( aliasArena );
+ * incomingAliases.aliasCount = 8;
+ * incomingAliases.topicNameMaxLength = 64;
+ * status = MQTT_InitIncomingTopicAliases( &mqttContext, &incomingAliases );
+ * @endcode
+ */
+/* @[declare_mqtt_initincomingtopicaliases] */
+MQTTStatus_t MQTT_InitIncomingTopicAliases( MQTTContext_t * pContext,
+                                            MQTTIncomingTopicAliases_t * pAliases );
+/* @[declare_mqtt_initincomingtopicaliases] */
+
 /**
  * @brief Initialize an MQTT context for publish retransmits for QoS > 0.
  *
@@ -551,33 +1131,232 @@ MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
  *
  * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
  *
- * if( status == MQTTSuccess )
+ * if( status == MQTTSuccess )
+ * {
+ *      // We do not expect any incoming publishes in this example, therefore the incoming
+ *      // publish pointer is NULL and the count is zero.
+ *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *
+ *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ * }
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitRetransmits( &mqttContext, publishStoreCallback,
+ *                                                   publishRetrieveCallback,
+ *                                                   publishClearCallback,
+ *                                                   publishClearAllCallback );
+ *
+ *      // Now unacked Publishes can be resent on an unclean session resumption.
+ * }
+ * @endcode
+ */
+
+/* @[declare_mqtt_initretransmits] */
+MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
+                                   MQTTStorePacketForRetransmit storeFunction,
+                                   MQTTRetrievePacketForRetransmit retrieveFunction,
+                                   MQTTClearPacketForRetransmit clearFunction );
+/* @[declare_mqtt_initretransmits] */
+
+/**
+ * @brief Initialize an MQTT context for publish retransmits for QoS > 0, with
+ * stored publishes retrieved as arrays of vectors.
+ *
+ * This is an alternative to #MQTT_InitRetransmits for stores which keep
+ * references to the topic name and payload of a publish rather than a copy of
+ * the whole packet. Publishes are resent from the vectors returned by
+ * @p retrieveVectorFunction, so the payload is copied neither when storing nor
+ * when resending. The application must then keep the topic name and payload
+ * buffers of a publish unchanged until its packet identifier is cleared.
+ *
+ * @param[in] pContext The context to initialize.
+ * @param[in] storeFunction User defined API used to store outgoing publishes.
+ * @param[in] retrieveVectorFunction User defined API used to retreive a stored
+ * publish as vectors for resend operation.
+ * @param[in] clearFunction User defined API used to clear a particular copied publish packet.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * typedef struct StoredPublish
+ * {
+ *     uint16_t packetId;
+ *     uint8_t headers[ 16 ];
+ *     TransportOutVector_t vectors[ 4 ];
+ *     TransportOutVector_t sendVectors[ 4 ];
+ *     size_t vectorCount;
+ * } StoredPublish_t;
+ *
+ * // Find the stored publish of a packet ID, or a free one for packet ID 0.
+ * StoredPublish_t * findStoredPublish( uint16_t packetId );
+ *
+ * bool publishStoreCallback( struct MQTTContext * pContext,
+ *                            uint16_t packetId,
+ *                            MQTTVec_t * pMqttVec )
+ * {
+ *     StoredPublish_t * pStored = findStoredPublish( packetId );
+ *     bool stored = false;
+ *
+ *     if( pStored == NULL )
+ *     {
+ *         pStored = findStoredPublish( 0 );
+ *     }
+ *
+ *     // Only the header bytes are copied; the topic name and payload are
+ *     // referenced where the application keeps them.
+ *     if( ( pStored != NULL ) &&
+ *         ( MQTT_GetHeaderBytesInMQTTVec( pMqttVec ) <= sizeof( pStored->headers ) ) &&
+ *         ( MQTT_GetVectorCountInMQTTVec( pMqttVec ) <= 4 ) )
+ *     {
+ *         MQTT_SerializeMQTTVecHeaders( pStored->headers, pMqttVec, pStored->vectors );
+ *         pStored->vectorCount = MQTT_GetVectorCountInMQTTVec( pMqttVec );
+ *         pStored->packetId = packetId;
+ *         stored = true;
+ *     }
+ *
+ *     return stored;
+ * }
+ *
+ * bool publishRetrieveCallback( struct MQTTContext * pContext,
+ *                               uint16_t packetId,
+ *                               TransportOutVector_t ** pIoVec,
+ *                               size_t * pIoVecCount )
+ * {
+ *     StoredPublish_t * pStored = findStoredPublish( packetId );
+ *
+ *     if( pStored != NULL )
+ *     {
+ *         // The library may modify the vectors while sending, so hand out a copy.
+ *         memcpy( pStored->sendVectors, pStored->vectors, sizeof( pStored->vectors ) );
+ *         *pIoVec = pStored->sendVectors;
+ *         *pIoVecCount = pStored->vectorCount;
+ *     }
+ *
+ *     return pStored != NULL;
+ * }
+ *
+ * void publishClearCallback( struct MQTTContext * pContext,
+ *                            uint16_t packetId );
+ *
+ * status = MQTT_InitRetransmitVectors( &mqttContext, publishStoreCallback,
+ *                                      publishRetrieveCallback,
+ *                                      publishClearCallback );
+ * @endcode
+ */
+/* @[declare_mqtt_initretransmitvectors] */
+MQTTStatus_t MQTT_InitRetransmitVectors( MQTTContext_t * pContext,
+                                         MQTTStorePacketForRetransmit storeFunction,
+                                         MQTTRetrieveVectorForRetransmit retrieveVectorFunction,
+                                         MQTTClearPacketForRetransmit clearFunction );
+/* @[declare_mqtt_initretransmitvectors] */
+
+/**
+ * @brief Enable the ring receive mode on an MQTT context.
+ *
+ * By default, after every packet handled by #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop the bytes remaining in the network buffer are moved to
+ * its start, so draining a burst of small packets received in one read copies
+ * the unprocessed backlog once per packet. In ring receive mode packets are
+ * consumed in place by advancing #MQTTContext_t.readIndex, and the buffer
+ * wraps back to its start once everything in it has been processed. A
+ * partially received packet is moved to the start of the buffer only when
+ * the space left after it cannot hold the rest of the packet, so the number
+ * of bytes copied per packet no longer depends on how much data is queued.
+ *
+ * @note In this mode, #MQTTPacketInfo_t.pRemainingData given to the
+ * application callback may point anywhere within the network buffer.
+ *
+ * This function must be called after #MQTT_Init.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitRingReceive( &mqttContext );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initringreceive] */
+MQTTStatus_t MQTT_InitRingReceive( MQTTContext_t * pContext );
+/* @[declare_mqtt_initringreceive] */
+
+/**
+ * @brief Stream the payload of incoming PUBLISH packets that do not fit in the
+ * network buffer to the application, instead of discarding them.
+ *
+ * By default, a packet larger than the network buffer is received and dropped.
+ * Once this function is called, such a packet is received into the network
+ * buffer as far as it fits, and the fixed header, topic name and packet
+ * identifier are parsed from it. The rest of the buffer then holds the
+ * payload: it is handed to @p streamCallback and refilled until the whole
+ * payload has been received. The application callback given to #MQTT_Init is
+ * not called for these packets. The PUBACK or PUBREC is sent after the last
+ * fragment, and duplicate QoS 1 and QoS 2 publishes are received without
+ * calling @p streamCallback, as for publishes that fit in the buffer.
+ *
+ * Packets whose variable header does not leave room for the payload in the
+ * network buffer are still discarded.
+ *
+ * @note If receiving fails before the last fragment, the process loop returns
+ * #MQTTRecvFailed and the application must drop the fragments it was given.
+ * The state record of a QoS 1 or QoS 2 publish is removed in that case, so
+ * that the publish is delivered again when the broker resends it.
+ *
+ * This function must be called after #MQTT_Init.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] streamCallback Callback receiving the payload fragments.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Function to write firmware image fragments to flash.
+ * void streamCallback( MQTTContext_t * pContext,
+ *                      const MQTTPublishInfo_t * pPublishInfo,
+ *                      uint16_t packetId,
+ *                      size_t payloadOffset,
+ *                      const uint8_t * pFragment,
+ *                      size_t fragmentLength )
  * {
- *      // We do not expect any incoming publishes in this example, therefore the incoming
- *      // publish pointer is NULL and the count is zero.
- *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *      writeToFlash( payloadOffset, pFragment, fragmentLength );
  *
- *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ *      if( ( payloadOffset + fragmentLength ) == pPublishInfo->payloadLength )
+ *      {
+ *          // The whole image was received.
+ *      }
  * }
  *
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
  * if( status == MQTTSuccess )
  * {
- *      status = MQTT_InitRetransmits( &mqttContext, publishStoreCallback,
- *                                                   publishRetrieveCallback,
- *                                                   publishClearCallback,
- *                                                   publishClearAllCallback );
- *
- *      // Now unacked Publishes can be resent on an unclean session resumption.
+ *      status = MQTT_InitPublishStreaming( &mqttContext, streamCallback );
  * }
  * @endcode
  */
-
-/* @[declare_mqtt_initretransmits] */
-MQTTStatus_t MQTT_InitRetransmits( MQTTContext_t * pContext,
-                                   MQTTStorePacketForRetransmit storeFunction,
-                                   MQTTRetrievePacketForRetransmit retrieveFunction,
-                                   MQTTClearPacketForRetransmit clearFunction );
-/* @[declare_mqtt_initretransmits] */
+/* @[declare_mqtt_initpublishstreaming] */
+MQTTStatus_t MQTT_InitPublishStreaming( MQTTContext_t * pContext,
+                                        MQTTPublishStreamCallback_t streamCallback );
+/* @[declare_mqtt_initpublishstreaming] */
 
 /**
  * @brief Checks the MQTT connection status with the broker.
@@ -777,11 +1556,16 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
 /**
  * @brief Publishes a message to the given topic name.
  *
+ * With MQTT 5, the string and binary values of the properties in
+ * #MQTTPublishInfo_t.pProperties are sent from application memory, as the
+ * topic and payload are, within #MQTT5_PROPERTY_MAX_VECTORS vectors.
+ *
  * @param[in] pContext Initialized MQTT context.
  * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
  * @param[in] packetId packet ID generated by #MQTT_GetPacketId.
  *
- * @return #MQTTNoMemory if pBuffer is too small to hold the MQTT packet;
+ * @return #MQTTNoMemory if pBuffer is too small to hold the MQTT packet, or
+ * the MQTT 5 properties need more vectors or scratch bytes than configured;
  * #MQTTBadParameter if invalid parameters are passed;
  * #MQTTSendFailed if transport write failed;
  * #MQTTStatusNotConnected if the connection is not established yet
@@ -826,6 +1610,363 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
                            uint16_t packetId );
 /* @[declare_mqtt_publish] */
 
+/**
+ * @brief Publishes several messages with as few transport writes as possible.
+ *
+ * The publishes are sent in order with one vectored write for each
+ * #MQTT_PUBLISH_MAX_VECTORS vectors, where a publish takes up to 4 vectors.
+ * The transport should implement writev, otherwise every vector is sent with
+ * its own call to send. With MQTT 5, the properties of each publish must be
+ * frozen with #MQTT5_FreezeProperties, and take one more vector.
+ *
+ * All the publishes are validated before any is sent. If an error occurs
+ * later, the publishes before the failed one are sent in batches, and
+ * @p pSentCount tells how many of them were written. The publishes from
+ * @p pSentCount onwards were not sent and hold no outgoing publish record,
+ * so they can be passed again, with the same packet IDs, once the
+ * connection is back.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo Array of MQTT PUBLISH packet parameters.
+ * @param[in] publishCount Number of publishes in @p pPublishInfo.
+ * @param[in] pPacketIds Array of packet IDs generated by #MQTT_GetPacketId,
+ * one for each publish. The IDs of QoS 0 publishes are ignored, and the array
+ * may be NULL if all the publishes are QoS 0.
+ * @param[out] pSentCount Number of publishes, from the start of
+ * @p pPublishInfo, that were written to the transport. May be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if there is no free outgoing publish record;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTPublishStoreFailed if the user provided callback to copy and store the
+ * outgoing publish packet fails
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t readings[ 8 ] = { 0 };
+ * size_t sentCount = 0;
+ * size_t i;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * for( i = 0; i < 8; i++ )
+ * {
+ *      readings[ i ].qos = MQTTQoS0;
+ *      readings[ i ].pTopicName = sensorTopics[ i ];
+ *      readings[ i ].topicNameLength = strlen( sensorTopics[ i ] );
+ *      readings[ i ].pPayload = &sensorValues[ i ];
+ *      readings[ i ].payloadLength = sizeof( sensorValues[ i ] );
+ * }
+ *
+ * // Packet IDs are only needed for QoS > 0.
+ * status = MQTT_PublishMany( pContext, readings, 8, NULL, &sentCount );
+ *
+ * if( status != MQTTSuccess )
+ * {
+ *      // readings[ sentCount ] to readings[ 7 ] were not sent.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_publishmany] */
+MQTTStatus_t MQTT_PublishMany( MQTTContext_t * pContext,
+                               const MQTTPublishInfo_t * pPublishInfo,
+                               size_t publishCount,
+                               const uint16_t * pPacketIds,
+                               size_t * pSentCount );
+/* @[declare_mqtt_publishmany] */
+
+/**
+ * @brief Validate and encode the parts of a publish that do not change
+ * between messages, for use with #MQTT_PublishPrepared.
+ *
+ * The topic name, QoS, retain flag and, for MQTT 5, the properties of
+ * @p pPublishInfo are kept. The payload and the dup flag are ignored. The
+ * topic name and properties are not copied and must stay valid as long as
+ * the prepared publish is used.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[out] pPreparedPublish The prepared publish.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t publishInfo = { 0 };
+ * MQTTPreparedPublish_t temperature;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * publishInfo.qos = MQTTQoS0;
+ * publishInfo.pTopicName = "/sensors/temperature";
+ * publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+ *
+ * status = MQTT_PreparePublish( pContext, &publishInfo, &temperature );
+ *
+ * while( status == MQTTSuccess )
+ * {
+ *      readTemperature( &value );
+ *      status = MQTT_PublishPrepared( pContext, &temperature, &value, sizeof( value ), 0 );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_preparepublish] */
+MQTTStatus_t MQTT_PreparePublish( const MQTTContext_t * pContext,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  MQTTPreparedPublish_t * pPreparedPublish );
+/* @[declare_mqtt_preparepublish] */
+
+/**
+ * @brief Publishes a payload to the topic of a prepared publish.
+ *
+ * Only the Remaining Length and the packet ID are encoded for each call.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPreparedPublish Publish prepared by #MQTT_PreparePublish.
+ * @param[in] pPayload Message payload.
+ * @param[in] payloadLength Message payload length.
+ * @param[in] packetId packet ID generated by #MQTT_GetPacketId, ignored
+ * for QoS 0.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the packet
+ * would exceed the maximum Remaining Length;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTPublishStoreFailed if the user provided callback to copy and store the
+ * outgoing publish packet fails
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_publishprepared] */
+MQTTStatus_t MQTT_PublishPrepared( MQTTContext_t * pContext,
+                                   const MQTTPreparedPublish_t * pPreparedPublish,
+                                   const void * pPayload,
+                                   size_t payloadLength,
+                                   uint16_t packetId );
+/* @[declare_mqtt_publishprepared] */
+
+/**
+ * @brief Initialize a publish queue for one producer thread.
+ *
+ * A publish queue lets a thread that does not own the MQTT context submit
+ * publishes without taking the context mutex or calling the transport. The
+ * thread that runs #MQTT_ProcessLoop sends the queued publishes with
+ * #MQTT_DrainPublishQueues, several publishes per transport call.
+ *
+ * The publish queue functions are only built when #MQTT_ENABLE_PUBLISH_QUEUES
+ * is set in core_mqtt_config.h.
+ *
+ * @param[out] pQueue Queue to initialize.
+ * @param[in] pEntries Memory for the queued publishes.
+ * @param[in] entryCount Number of entries in @p pEntries. Must be a power
+ * of two.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // One queue for each producer thread.
+ * MQTTPublishQueue_t sensorQueue;
+ * MQTTPublishQueueEntry_t sensorEntries[ 16 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_InitPublishQueue( &sensorQueue, sensorEntries, 16 );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // Attach before the producer thread starts.
+ *      status = MQTT_AttachPublishQueue( &mqttContext, &sensorQueue );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpublishqueue] */
+MQTTStatus_t MQTT_InitPublishQueue( MQTTPublishQueue_t * pQueue,
+                                    MQTTPublishQueueEntry_t * pEntries,
+                                    size_t entryCount );
+/* @[declare_mqtt_initpublishqueue] */
+
+/**
+ * @brief Attach an initialized publish queue to an MQTT context, so that it
+ * is drained by #MQTT_DrainPublishQueues.
+ *
+ * Queues are drained in the order they were attached. This function must be
+ * called from the thread that drains the queues, before the producer starts
+ * using the queue.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pQueue Queue initialized with #MQTT_InitPublishQueue.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the queue is
+ * already attached; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_attachpublishqueue] */
+MQTTStatus_t MQTT_AttachPublishQueue( MQTTContext_t * pContext,
+                                      MQTTPublishQueue_t * pQueue );
+/* @[declare_mqtt_attachpublishqueue] */
+
+/**
+ * @brief Submit a publish from a producer thread.
+ *
+ * The fixed header of the PUBLISH is serialized here; the topic name and
+ * payload are not copied. The publish is sent by the next call to
+ * #MQTT_DrainPublishQueues. Only one thread may enqueue to a given queue.
+ *
+ * The topic and payload must remain valid until the entry has been drained.
+ * With MQTT 5, so must the properties, which have to be frozen with
+ * #MQTT5_FreezeProperties.
+ * Once this function has succeeded for another `entryCount` publishes on the
+ * same queue, the entry is known to have been drained and its buffers can be
+ * reused.
+ *
+ * @param[in] pQueue Queue owned by the calling thread.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] packetId Packet ID of a QoS 1 or QoS 2 publish, or 0 to have
+ * one assigned from the context when the publish is drained. It is
+ * reported to the application callback with the acknowledgment.
+ *
+ * @return #MQTTNoMemory if the queue is full;
+ * #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTPublishInfo_t publishInfo = { 0 };
+ * MQTTStatus_t status;
+ *
+ * publishInfo.qos = MQTTQoS1;
+ * publishInfo.pTopicName = "/sensor/temperature";
+ * publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+ * publishInfo.pPayload = pReading;
+ * publishInfo.payloadLength = readingLength;
+ *
+ * // Called from the sensor thread. The packet ID is assigned when drained.
+ * status = MQTT_EnqueuePublish( &sensorQueue, &publishInfo, 0 );
+ *
+ * if( status == MQTTNoMemory )
+ * {
+ *      // The queue is full. Retry after the owner thread has drained it.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_enqueuepublish] */
+MQTTStatus_t MQTT_EnqueuePublish( MQTTPublishQueue_t * pQueue,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  uint16_t packetId );
+/* @[declare_mqtt_enqueuepublish] */
+
+/**
+ * @brief Send the publishes waiting in the queues attached to a context.
+ *
+ * Publishes from all attached queues are gathered into vectors of up to
+ * #MQTT_PUBLISH_MAX_VECTORS entries, and each vector is written with a
+ * single call to the transport writev function, when it is provided. The
+ * state of QoS 1 and QoS 2 publishes is updated as for #MQTT_Publish.
+ *
+ * This function must be called from the thread that owns the context,
+ * typically between calls to #MQTT_ProcessLoop.
+ *
+ * @note If there is no free outgoing publish record for a QoS 1 or QoS 2
+ * publish, or the send window is full, the publish is left in its queue and
+ * #MQTTNoMemory is returned; it is sent by a later call once acknowledgments
+ * have been received. Any other error while adding a publish, such as a
+ * failed store callback, drops that publish. A failed transport write drops
+ * every publish of the batch it was writing. A dropped publish leaves its
+ * queue and has no outgoing publish record or retransmit copy, so it is
+ * neither acknowledged nor resent; enqueue it again to send it.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[out] pDrainedCount Number of publishes taken from the queues,
+ * including those whose send failed. May be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if the outgoing publish records are exhausted;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTStatusNotConnected if the connection is not established yet
+ * #MQTTStatusDisconnectPending if the user is expected to call MQTT_Disconnect
+ * before calling any other API
+ * #MQTTPublishStoreFailed if the user provided callback to copy and store the
+ * outgoing publish packet fails
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTStatus_t status;
+ *
+ * // Owner thread loop.
+ * for( ; ; )
+ * {
+ *      status = MQTT_DrainPublishQueues( &mqttContext, NULL );
+ *
+ *      if( ( status == MQTTSuccess ) || ( status == MQTTNoMemory ) )
+ *      {
+ *          status = MQTT_ProcessLoop( &mqttContext );
+ *      }
+ *
+ *      if( ( status != MQTTSuccess ) && ( status != MQTTNeedMoreBytes ) )
+ *      {
+ *          break;
+ *      }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_drainpublishqueues] */
+MQTTStatus_t MQTT_DrainPublishQueues( MQTTContext_t * pContext,
+                                      size_t * pDrainedCount );
+/* @[declare_mqtt_drainpublishqueues] */
+
+/**
+ * @brief Drain the attached publish queues from #MQTT_ProcessLoop whenever a
+ * PUBACK or PUBCOMP frees a place in the send window.
+ *
+ * Publishes which do not fit in the send window stay in their queue, so that
+ * with this enabled the queues absorb bursts beyond the Receive Maximum of the
+ * broker, and the window is refilled as soon as acknowledgments arrive. See
+ * #MQTT_GetSendWindow for the send window.
+ *
+ * As with #MQTT_DrainPublishQueues, the queues are then drained by the thread
+ * calling #MQTT_ProcessLoop, which must not drain them from elsewhere.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_AttachPublishQueue( &mqttContext, &sensorQueue );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitDrainOnAck( &mqttContext );
+ * }
+ *
+ * // Publishes enqueued from now on are sent by MQTT_DrainPublishQueues, and
+ * // then by MQTT_ProcessLoop as the broker acknowledges earlier ones.
+ * @endcode
+ */
+/* @[declare_mqtt_initdrainonack] */
+MQTTStatus_t MQTT_InitDrainOnAck( MQTTContext_t * pContext );
+/* @[declare_mqtt_initdrainonack] */
+
 /**
  * @brief Cancels an outgoing publish callback (only for QoS > QoS0) by
  * removing it from the pending ACK list.
@@ -1001,6 +2142,67 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext );
 MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext );
 /* @[declare_mqtt_processloop] */
 
+/**
+ * @brief Loop to receive packets from the transport interface, handling
+ * every complete packet in the network buffer before reading again.
+ *
+ * #MQTT_ProcessLoop handles at most one packet and reads from the transport
+ * interface on every call, even when the network buffer already holds several
+ * complete packets. This function first handles the complete packets left in
+ * the network buffer by earlier calls, then reads from the transport interface
+ * once and handles every complete packet received, up to @p maxPackets in
+ * total. Keep alive is handled as in #MQTT_ProcessLoop when no data is
+ * received.
+ *
+ * A partially received packet is kept in the network buffer to be completed
+ * by a later call, and does not cause #MQTTNeedMoreBytes to be returned.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[in] maxPackets Maximum number of packets to handle in this call.
+ * Must be greater than 0.
+ * @param[out] pProcessedCount Number of packets handed to the application.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTRecvFailed if a network error occurs during reception;
+ * #MQTTSendFailed if a network error occurs while sending an ACK or PINGREQ;
+ * #MQTTBadResponse if an invalid packet is received;
+ * #MQTTKeepAliveTimeout if the server has not sent a PINGRESP before
+ * #MQTT_PINGRESP_TIMEOUT_MS milliseconds;
+ * #MQTTIllegalState if an incoming QoS 1/2 publish or ack causes an
+ * invalid transition for the internal state machine;
+ * #MQTTSuccess on success.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * size_t processedCount;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * while( true )
+ * {
+ *      status = MQTT_ProcessLoopBatch( pContext, 32U, &processedCount );
+ *
+ *      if( status != MQTTSuccess )
+ *      {
+ *          // Determine the error. It's possible we might need to disconnect
+ *          // the underlying transport connection.
+ *      }
+ *      else if( processedCount == 0U )
+ *      {
+ *          // Nothing was received; other application functions.
+ *      }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_processloopbatch] */
+MQTTStatus_t MQTT_ProcessLoopBatch( MQTTContext_t * pContext,
+                                    size_t maxPackets,
+                                    size_t * pProcessedCount );
+/* @[declare_mqtt_processloopbatch] */
+
 /**
  * @brief Loop to receive packets from the transport interface. Does not handle
  * keep alive.
@@ -1247,6 +2449,47 @@ void MQTT_SerializeMQTTVec( uint8_t * pAllocatedMem,
                             const MQTTVec_t * pVec );
 /* @[declare_mqtt_serializemqttvec] */
 
+/**
+ * @brief Get the number of vectors in a #MQTTVec pointer, which is the number
+ * of entries MQTT_SerializeMQTTVecHeaders( uint8_t * pAllocatedMem, const MQTTVec_t * pVec, TransportOutVector_t * pVectors ) fills in.
+ *
+ * @param[in] pVec The #MQTTVec pointer given as input to the user defined #MQTTStorePacketForRetransmit callback function. Must not be NULL.
+ *
+ * @return The number of vectors in the provided #MQTTVec.
+ */
+/* @[declare_mqtt_getvectorcountinmqttvec] */
+size_t MQTT_GetVectorCountInMQTTVec( const MQTTVec_t * pVec );
+/* @[declare_mqtt_getvectorcountinmqttvec] */
+
+/**
+ * @brief Get the bytes of a #MQTTVec pointer which are serialized by the
+ * library, such as the fixed header and packet identifier of a PUBLISH. These
+ * are only valid for the duration of the #MQTTStorePacketForRetransmit call,
+ * unlike the topic name and payload which stay in the buffers of the application.
+ *
+ * @param[in] pVec The #MQTTVec pointer given as input to the user defined #MQTTStorePacketForRetransmit callback function. Must not be NULL.
+ *
+ * @return The bytes to set aside for MQTT_SerializeMQTTVecHeaders( uint8_t * pAllocatedMem, const MQTTVec_t * pVec, TransportOutVector_t * pVectors ).
+ */
+/* @[declare_mqtt_getheaderbytesinmqttvec] */
+size_t MQTT_GetHeaderBytesInMQTTVec( const MQTTVec_t * pVec );
+/* @[declare_mqtt_getheaderbytesinmqttvec] */
+
+/**
+ * @brief Copy the bytes of a #MQTTVec serialized by the library into
+ * \p pAllocatedMem, and fill in vectors describing the whole packet which refer
+ * to that copy and to the topic name and payload buffers of the application.
+ *
+ * @param[in] pAllocatedMem Memory in which to copy the header bytes. It must be of size provided by MQTT_GetHeaderBytesInMQTTVec( const MQTTVec_t * pVec ). Should not be NULL.
+ * @param[in] pVec The #MQTTVec pointer given as input to the user defined #MQTTStorePacketForRetransmit callback function. Must not be NULL.
+ * @param[out] pVectors Array of as many vectors as given by MQTT_GetVectorCountInMQTTVec( const MQTTVec_t * pVec ). Should not be NULL.
+ */
+/* @[declare_mqtt_serializemqttvecheaders] */
+void MQTT_SerializeMQTTVecHeaders( uint8_t * pAllocatedMem,
+                                   const MQTTVec_t * pVec,
+                                   TransportOutVector_t * pVectors );
+/* @[declare_mqtt_serializemqttvecheaders] */
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
     }
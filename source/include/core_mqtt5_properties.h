@@ -102,8 +102,61 @@ typedef struct MQTT5Properties
     MQTT5Property_t * pProperties;
     size_t count;
     size_t capacity;
+    const uint8_t * pFrozen; /**< @brief Encoded block set by #MQTT5_FreezeProperties, or NULL. */
+    size_t frozenSize;       /**< @brief Size of @p pFrozen, including the properties length. */
+    size_t frozenLength;     /**< @brief Properties length encoded at the start of @p pFrozen. */
 } MQTT5Properties_t;
 
+/**
+ * @brief Number of entries in the index of an #MQTT5PropertyView_t, one per
+ * property identifier up to Shared Subscription Available.
+ */
+#define MQTT5_PROPERTY_INDEX_SIZE    ( 43U )
+
+/**
+ * @brief Decoded MQTT 5 properties indexed by identifier
+ *
+ * Properties that may appear once are found through @p index in constant
+ * time. User Properties and Subscription Identifiers, which may repeat, are
+ * kept in wire order in @p pRepeated.
+ * Uses application-provided buffers for zero-copy design.
+ */
+typedef struct MQTT5PropertyView
+{
+    MQTT5Property_t * pProperties; /**< @brief Properties that may appear once. */
+    size_t count;                  /**< @brief Number of properties in @p pProperties. */
+    size_t capacity;               /**< @brief Maximum number of properties in @p pProperties. */
+    MQTT5Property_t * pRepeated;   /**< @brief User Properties and Subscription Identifiers. */
+    size_t repeatedCount;          /**< @brief Number of properties in @p pRepeated. */
+    size_t repeatedCapacity;       /**< @brief Maximum number of properties in @p pRepeated. */
+
+    /**
+     * @brief Position plus one in @p pProperties of the property of each
+     * identifier, or 0 if absent.
+     */
+    uint8_t index[ MQTT5_PROPERTY_INDEX_SIZE ];
+
+    /**
+     * @brief Bit set of the identifiers to keep, or all zeros to keep every
+     * property.
+     */
+    uint8_t requested[ ( MQTT5_PROPERTY_INDEX_SIZE + 7U ) / 8U ];
+} MQTT5PropertyView_t;
+
+/**
+ * @brief Cursor over a serialized MQTT 5 property block
+ *
+ * Walks the properties in place, decoding each one only when it is read.
+ * The block is validated once when the cursor is initialized.
+ */
+typedef struct MQTT5PropertyCursor
+{
+    const uint8_t * pBuffer; /**< @brief Buffer containing the property block. */
+    size_t start;            /**< @brief Index of the first property. */
+    size_t index;            /**< @brief Index of the next property to read. */
+    size_t end;              /**< @brief Index of the end of the property block. */
+} MQTT5PropertyCursor_t;
+
 /**
  * @brief Initialize an MQTT 5 properties collection.
  *
@@ -123,7 +176,8 @@ MQTTStatus_t MQTT5_InitProperties( MQTT5Properties_t * pProperties,
  * @param[in] pProperties Pointer to properties collection.
  * @param[in] pProperty Pointer to property to add.
  *
- * @return MQTTSuccess if successful, error code otherwise.
+ * @return MQTTSuccess if successful, MQTTBadParameter if the collection is
+ * frozen, error code otherwise.
  */
 MQTTStatus_t MQTT5_AddProperty( MQTT5Properties_t * pProperties,
                                 const MQTT5Property_t * pProperty );
@@ -163,6 +217,28 @@ MQTTStatus_t MQTT5_SerializeProperties( const MQTT5Properties_t * pProperties,
                                         uint8_t * pBuffer,
                                         size_t * pSize );
 
+/**
+ * @brief Encode a properties collection once for reuse across packets.
+ *
+ * The properties length and properties are written to @p pBuffer, and the
+ * collection keeps a reference to them. Afterwards
+ * #MQTT5_GetPropertiesSize returns the cached length and
+ * #MQTT5_SerializeProperties copies the cached bytes, so packets that reuse the
+ * collection skip the per-property encoding. A frozen collection cannot be
+ * added to; initialize it again to change it.
+ *
+ * @param[in,out] pProperties Pointer to properties collection.
+ * @param[out] pBuffer Buffer for the encoded properties. Must stay valid and
+ * unmodified while the collection is used.
+ * @param[in] bufferSize Size of buffer.
+ *
+ * @return MQTTSuccess if successful, MQTTNoMemory if @p pBuffer is too small,
+ * MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_FreezeProperties( MQTT5Properties_t * pProperties,
+                                     uint8_t * pBuffer,
+                                     size_t bufferSize );
+
 /**
  * @brief Deserialize properties from a buffer.
  *
@@ -176,6 +252,150 @@ MQTTStatus_t MQTT5_DeserializeProperties( MQTT5Properties_t * pProperties,
                                           const uint8_t * pBuffer,
                                           size_t size );
 
+/**
+ * @brief Find a property in a serialized property block without decoding the
+ * properties into a collection.
+ *
+ * @param[in] pBuffer Buffer containing the properties length and properties.
+ * @param[in] size Size of buffer.
+ * @param[in] type Property type to search for.
+ * @param[out] pProperty Pointer to store the first property of the type.
+ *
+ * @return MQTTSuccess if found, MQTTNoDataAvailable if the block has no
+ * property of the type, MQTTBadParameter if the block is malformed.
+ */
+MQTTStatus_t MQTT5_FindProperty( const uint8_t * pBuffer,
+                                 size_t size,
+                                 MQTT5PropertyType_t type,
+                                 MQTT5Property_t * pProperty );
+
+/**
+ * @brief Initialize an indexed MQTT 5 property view.
+ *
+ * @param[in] pView Pointer to the view to initialize.
+ * @param[in] pBuffer Application-provided buffer for the properties that may
+ * appear once.
+ * @param[in] capacity Maximum number of properties @p pBuffer can hold.
+ * @param[in] pRepeatedBuffer Application-provided buffer for the User
+ * Properties and Subscription Identifiers. Can be NULL to skip them.
+ * @param[in] repeatedCapacity Maximum number of properties
+ * @p pRepeatedBuffer can hold.
+ *
+ * @return MQTTSuccess if successful, MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_InitPropertyView( MQTT5PropertyView_t * pView,
+                                     MQTT5Property_t * pBuffer,
+                                     size_t capacity,
+                                     MQTT5Property_t * pRepeatedBuffer,
+                                     size_t repeatedCapacity );
+
+/**
+ * @brief Keep a property type when decoding into a view.
+ *
+ * Until this function is called, every property is kept. Once it is called,
+ * properties of the other types are validated but not stored.
+ *
+ * @param[in] pView Pointer to the view.
+ * @param[in] type Property type to keep.
+ *
+ * @return MQTTSuccess if successful, MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_RequestProperty( MQTT5PropertyView_t * pView,
+                                    MQTT5PropertyType_t type );
+
+/**
+ * @brief Decode properties from a buffer into a view.
+ *
+ * The properties previously held by the view are dropped.
+ *
+ * @param[in,out] pView Pointer to the view.
+ * @param[in] pBuffer Buffer containing the properties length and properties.
+ * @param[in] size Size of buffer.
+ *
+ * @return MQTTSuccess if successful, MQTTNoMemory if a buffer of the view is
+ * full, MQTTBadParameter if the block is malformed or has a property that may
+ * appear once more than once.
+ */
+MQTTStatus_t MQTT5_DecodePropertyView( MQTT5PropertyView_t * pView,
+                                       const uint8_t * pBuffer,
+                                       size_t size );
+
+/**
+ * @brief Get a property that may appear once from a view.
+ *
+ * User Properties and Subscription Identifiers are read from
+ * #MQTT5PropertyView_t.pRepeated instead.
+ *
+ * @param[in] pView Pointer to the view.
+ * @param[in] type Property type to get.
+ * @param[out] pProperty Pointer to store the property.
+ *
+ * @return MQTTSuccess if found, MQTTNoDataAvailable if the view has no
+ * property of the type, MQTTBadParameter if the type may repeat or is
+ * unknown.
+ */
+MQTTStatus_t MQTT5_GetViewProperty( const MQTT5PropertyView_t * pView,
+                                    MQTT5PropertyType_t type,
+                                    MQTT5Property_t * pProperty );
+
+/**
+ * @brief Initialize a cursor over a serialized property block.
+ *
+ * The lengths of all properties are checked here, so reading from the cursor
+ * cannot fail on a malformed block. Nothing is stored apart from the cursor.
+ *
+ * @param[out] pCursor Pointer to the cursor to initialize.
+ * @param[in] pBuffer Buffer containing the properties length and properties,
+ * such as #MQTTPublishInfo_t.pRawProperties. Must stay valid while the cursor
+ * is used.
+ * @param[in] size Size of buffer.
+ *
+ * @return MQTTSuccess if successful, MQTTBadParameter if the block is
+ * malformed.
+ */
+MQTTStatus_t MQTT5_InitPropertyCursor( MQTT5PropertyCursor_t * pCursor,
+                                       const uint8_t * pBuffer,
+                                       size_t size );
+
+/**
+ * @brief Decode the next property of a cursor.
+ *
+ * @param[in,out] pCursor Pointer to the cursor.
+ * @param[out] pProperty Pointer to store the property.
+ *
+ * @return MQTTSuccess if a property was read, MQTTNoDataAvailable at the end
+ * of the block, MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_NextProperty( MQTT5PropertyCursor_t * pCursor,
+                                 MQTT5Property_t * pProperty );
+
+/**
+ * @brief Advance a cursor to the next property of a type and decode it.
+ *
+ * Properties of other types are skipped. Calling it again with the same type
+ * returns the following match, which reads repeated User Properties or
+ * Subscription Identifiers in wire order.
+ *
+ * @param[in,out] pCursor Pointer to the cursor.
+ * @param[in] type Property type to search for.
+ * @param[out] pProperty Pointer to store the property.
+ *
+ * @return MQTTSuccess if found, MQTTNoDataAvailable if the rest of the block
+ * has no property of the type, MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_CursorFindProperty( MQTT5PropertyCursor_t * pCursor,
+                                       MQTT5PropertyType_t type,
+                                       MQTT5Property_t * pProperty );
+
+/**
+ * @brief Move a cursor back to the first property of its block.
+ *
+ * @param[in,out] pCursor Pointer to the cursor.
+ *
+ * @return MQTTSuccess if successful, MQTTBadParameter otherwise.
+ */
+MQTTStatus_t MQTT5_ResetPropertyCursor( MQTT5PropertyCursor_t * pCursor );
+
 /**
  * @brief Decode a Variable Byte Integer from buffer.
  *
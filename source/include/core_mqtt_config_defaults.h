@@ -195,6 +195,127 @@
     #error MQTT_SEND_RETRY_TIMEOUT_MS is deprecated. Instead use MQTT_SEND_TIMEOUT_MS.
 #endif
 
+/**
+ * @brief Maximum number of topic levels in a topic filter added to a router
+ * with #MQTT_RouterAdd.
+ *
+ * #MQTT_RouterMatch keeps a stack with one entry per topic level on the
+ * stack of the calling task, so this config bounds its stack usage. Topic
+ * names with more levels can still be matched against topic filters ending
+ * with "#".
+ *
+ * <b>Possible values:</b> Any positive integer less than 65535. <br>
+ * <b>Default value:</b> `32`
+ */
+#ifndef MQTT_ROUTER_MAX_TOPIC_LEVELS
+    #define MQTT_ROUTER_MAX_TOPIC_LEVELS    ( 32U )
+#endif
+
+/**
+ * @brief Maximum number of vectors passed to one transport writev call by
+ * #MQTT_PublishMany and #MQTT_DrainPublishQueues.
+ *
+ * A publish takes up to 4 vectors, or 5 with MQTT 5 properties frozen by
+ * #MQTT5_FreezeProperties, so the default sends at least 3 publishes per
+ * call. Publishes that do not fit are sent by further calls. The vectors
+ * and the headers of the publishes they reference are kept on the stack of
+ * the calling task.
+ *
+ * <b>Possible values:</b> Any integer from 4, or 5 with MQTT 5, up to the
+ * IOV_MAX of the platform. <br>
+ * <b>Default value:</b> `16`
+ */
+#ifndef MQTT_PUBLISH_MAX_VECTORS
+    #define MQTT_PUBLISH_MAX_VECTORS    ( 16U )
+#endif
+
+/**
+ * @brief Maximum number of vectors an MQTT 5 property block takes when
+ * #MQTT_Publish or #MQTT_Connect sends it without copying.
+ *
+ * The identifiers, lengths and integers of the properties are encoded into a
+ * scratch buffer, while string and binary values are sent from application
+ * memory. A User Property takes up to 4 vectors, and other string or binary
+ * properties up to 2. A property block that needs more fails with
+ * #MQTTNoMemory; freeze it with #MQTT5_FreezeProperties to send it as a
+ * single vector instead. Only used when MQTT_VERSION is set to
+ * MQTT_VERSION_5_0.
+ *
+ * <b>Possible values:</b> Any positive integer. <br>
+ * <b>Default value:</b> `8`
+ */
+#ifndef MQTT5_PROPERTY_MAX_VECTORS
+    #define MQTT5_PROPERTY_MAX_VECTORS    ( 8U )
+#endif
+
+/**
+ * @brief Size of the scratch buffer holding the identifiers, lengths and
+ * integers of an MQTT 5 property block sent without copying.
+ *
+ * The properties length takes up to 4 bytes, and each property up to 5. Only
+ * used when MQTT_VERSION is set to MQTT_VERSION_5_0.
+ *
+ * <b>Possible values:</b> Any integer of at least 9. <br>
+ * <b>Default value:</b> `32`
+ */
+#ifndef MQTT5_PROPERTY_SCRATCH_SIZE
+    #define MQTT5_PROPERTY_SCRATCH_SIZE    ( 32U )
+#endif
+
+/**
+ * @brief Build the publish queues of #MQTT_EnqueuePublish and
+ * #MQTT_DrainPublishQueues.
+ *
+ * The queues are shared between threads without the MQTT context mutex, so
+ * they need #MQTT_PUBLISH_QUEUE_BARRIER. Applications that do not use them
+ * can leave this disabled and build with any compiler.
+ *
+ * <b>Possible values:</b> `0` or `1`. <br>
+ * <b>Default value:</b> `0`
+ */
+#ifndef MQTT_ENABLE_PUBLISH_QUEUES
+    #define MQTT_ENABLE_PUBLISH_QUEUES    ( 0 )
+#endif
+
+/**
+ * @brief Full memory barrier used between the producer and the draining
+ * thread of an #MQTTPublishQueue_t.
+ *
+ * The producer fills an entry before advancing the head of the queue, and
+ * the draining thread has finished with an entry before advancing the tail.
+ * Each side also reads the index written by the other before touching the
+ * entries it covers.
+ * On a multi-core system, this macro must stop the compiler and the processor
+ * from reordering memory accesses across it. Only used when
+ * #MQTT_ENABLE_PUBLISH_QUEUES is set.
+ *
+ * <b>Default value:</b> `__atomic_thread_fence( __ATOMIC_SEQ_CST )` with GCC
+ * and Clang. Other compilers must define it in core_mqtt_config.h to enable
+ * the publish queues.
+ */
+#if ( MQTT_ENABLE_PUBLISH_QUEUES != 0 ) && !defined( MQTT_PUBLISH_QUEUE_BARRIER )
+    #if defined( __GNUC__ )
+        #define MQTT_PUBLISH_QUEUE_BARRIER()    __atomic_thread_fence( __ATOMIC_SEQ_CST )
+    #else
+        #error "Define MQTT_PUBLISH_QUEUE_BARRIER for this compiler to enable MQTT_ENABLE_PUBLISH_QUEUES"
+    #endif
+#endif
+
+/**
+ * @brief Least number of bytes of journal entries no longer needed before an
+ * #MQTTSessionJournal_t is compacted while it still has room.
+ *
+ * A journal is compacted once its entries no longer needed take more bytes
+ * than the ones still needed, and at least this many. A larger value copies
+ * the session state less often when it is small.
+ *
+ * <b>Possible values:</b> Any positive integer. <br>
+ * <b>Default value:</b> `1024`
+ */
+#ifndef MQTT_JOURNAL_COMPACTION_THRESHOLD
+    #define MQTT_JOURNAL_COMPACTION_THRESHOLD    ( 1024U )
+#endif
+
 /**
  * @brief Macro that is called in the MQTT library for logging "Error" level
  * messages.
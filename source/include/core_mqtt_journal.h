@@ -0,0 +1,214 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_journal.h
+ * @brief A journal of the QoS 1 and QoS 2 session state, kept in application
+ * memory which outlives the process, such as a memory mapped file.
+ *
+ * The state records and the outgoing PUBLISH packets awaiting an
+ * acknowledgement are lost when the process stops. The journal appends every
+ * change to them to a buffer of the application, so that
+ * #MQTT_RestoreSession can rebuild them when the process starts again, and the
+ * session can be resumed with the broker.
+ */
+#ifndef CORE_MQTT_JOURNAL_H
+#define CORE_MQTT_JOURNAL_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes at the start of each half of a journal buffer, identifying the
+ * half and its generation.
+ */
+#define MQTT_JOURNAL_HEADER_SIZE        ( 16U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes of an entry of a journal in addition to its data: a type, the
+ * packet ID, the length of the data and a checksum.
+ */
+#define MQTT_JOURNAL_ENTRY_OVERHEAD     ( 12U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes of a journal entry recording the state of a record.
+ */
+#define MQTT_JOURNAL_STATE_ENTRY_SIZE    ( MQTT_JOURNAL_ENTRY_OVERHEAD + 1U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Smallest journal buffer for @p outgoingCount outgoing and
+ * @p incomingCount incoming publish records, with PUBLISH packets of up to
+ * @p maxPacketSize bytes.
+ *
+ * Each half of the buffer holds every record and stored packet at once, and
+ * one more packet. A larger buffer is compacted less often.
+ */
+#define MQTT_JOURNAL_BUFFER_SIZE( outgoingCount, incomingCount, maxPacketSize )                   \
+    ( 2U * ( MQTT_JOURNAL_HEADER_SIZE +                                                            \
+             ( ( ( outgoingCount ) + 1U ) *                                                        \
+               ( MQTT_JOURNAL_STATE_ENTRY_SIZE + MQTT_JOURNAL_ENTRY_OVERHEAD + ( maxPacketSize ) ) ) + \
+             ( ( incomingCount ) * MQTT_JOURNAL_STATE_ENTRY_SIZE ) ) )
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback making bytes written to the journal buffer
+ * durable, for example with msync on a memory mapped file.
+ *
+ * The entries of a journal are checksummed, so entries torn by a crash are
+ * detected and ignored. Making each entry durable before the next one is
+ * written ensures that only the last entry can be torn.
+ *
+ * @param[in] pData First byte written.
+ * @param[in] length Number of bytes written.
+ */
+typedef void (* MQTTJournalFlushFunc_t )( const uint8_t * pData,
+                                          size_t length );
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A slot of the packet ID index of the PUBLISH packets in a journal.
+ */
+typedef struct MQTTJournalSlot
+{
+    uint16_t packetId; /**< @brief The packet ID of the indexed PUBLISH, or 0 for an empty slot. */
+    size_t offset;     /**< @brief The offset of its entry in the journal buffer. */
+} MQTTJournalSlot_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A session journal.
+ *
+ * The buffer is split in two halves. Entries are appended to one half until
+ * more than half of its bytes are taken by entries which are no longer
+ * needed, or it is full. The entries still needed are then copied to the
+ * other half, which becomes the one appended to. The amount of the journal
+ * to read on a restart is therefore bounded by the session state, rather than
+ * by the number of publishes since the journal was created.
+ *
+ * The application sets @p pBuffer, @p bufferSize, @p pSlots, @p slotCount and
+ * @p flushFunction. The other members are maintained by the library.
+ */
+typedef struct MQTTSessionJournal
+{
+    uint8_t * pBuffer;                    /**< @brief Memory of the journal, kept across restarts. */
+    size_t bufferSize;                    /**< @brief Size of @p pBuffer. */
+    MQTTJournalSlot_t * pSlots;           /**< @brief Memory for the packet ID index, which need not be kept. */
+    size_t slotCount;                     /**< @brief Number of slots, greater than the number of outgoing publish records. */
+    MQTTJournalFlushFunc_t flushFunction; /**< @brief Callback making written bytes durable, or NULL. */
+    size_t activeHalf;                    /**< @brief Offset of the half appended to. */
+    uint32_t generation;                  /**< @brief Generation of the half appended to. */
+    size_t writeOffset;                   /**< @brief Offset of the end of the last entry. */
+    size_t liveBytes;                     /**< @brief Bytes of the entries still needed. */
+} MQTTSessionJournal_t;
+
+/**
+ * @brief Restore the QoS 1 and QoS 2 session state kept in a journal, and
+ * journal the state of the context from then on.
+ *
+ * The state records of the context are replaced by the ones in the journal,
+ * and the context resends the PUBLISH packets stored in the journal when the
+ * session is resumed with #MQTT_Connect. Packet IDs returned by
+ * #MQTT_GetPacketId continue after the restored outgoing publishes. A buffer
+ * which holds no journal, such as one filled with zeros, restores an empty
+ * session. A journaled session is discarded by connecting with a clean
+ * session.
+ *
+ * The journal registers retransmit callbacks in place of ones set with
+ * #MQTT_InitRetransmits. A PUBLISH larger than a half of the journal fails
+ * with #MQTTPublishStoreFailed.
+ *
+ * @param[in] pContext Initialized MQTT context, with records set up by
+ * #MQTT_InitStatefulQoS.
+ * @param[in] pJournal The journal, with the members to be set by the
+ * application set. It must remain in scope for as long as the context uses it.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if the journal holds more records than the context, or more
+ * than a half of the buffer; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * #define OUTGOING_PUBLISH_COUNT    30
+ * #define INCOMING_PUBLISH_COUNT    30
+ * #define MAX_PUBLISH_SIZE          512
+ * #define JOURNAL_SIZE              MQTT_JOURNAL_BUFFER_SIZE( OUTGOING_PUBLISH_COUNT, INCOMING_PUBLISH_COUNT, MAX_PUBLISH_SIZE )
+ *
+ * MQTTPubAckInfo_t outgoingPublishes[ OUTGOING_PUBLISH_COUNT ];
+ * MQTTPubAckInfo_t incomingPublishes[ INCOMING_PUBLISH_COUNT ];
+ * MQTTJournalSlot_t journalSlots[ 2 * OUTGOING_PUBLISH_COUNT ];
+ * MQTTSessionJournal_t journal = { 0 };
+ *
+ * void flushJournal( const uint8_t * pData, size_t length )
+ * {
+ *     // msync() the pages holding the range.
+ * }
+ *
+ * // A file, created filled with zeros, mapped with mmap().
+ * journal.pBuffer = mapJournalFile( "session.journal", JOURNAL_SIZE );
+ * journal.bufferSize = JOURNAL_SIZE;
+ * journal.pSlots = journalSlots;
+ * journal.slotCount = 2 * OUTGOING_PUBLISH_COUNT;
+ * journal.flushFunction = flushJournal;
+ *
+ * status = MQTT_InitStatefulQoS( &mqttContext,
+ *                                outgoingPublishes,
+ *                                OUTGOING_PUBLISH_COUNT,
+ *                                incomingPublishes,
+ *                                INCOMING_PUBLISH_COUNT );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *     status = MQTT_RestoreSession( &mqttContext, &journal );
+ * }
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *     // Resume the session, resending the publishes awaiting acknowledgement.
+ *     connectInfo.cleanSession = false;
+ *     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeoutMs, &sessionPresent );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_restoresession] */
+MQTTStatus_t MQTT_RestoreSession( MQTTContext_t * pContext,
+                                  MQTTSessionJournal_t * pJournal );
+/* @[declare_mqtt_restoresession] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_JOURNAL_H */
@@ -0,0 +1,150 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_retransmit.h
+ * @brief A retransmit store for outgoing QoS 1 and QoS 2 PUBLISH packets,
+ * kept in fixed size slots of one application buffer.
+ *
+ * #MQTT_InitRetransmits leaves the storage of PUBLISH packets awaiting an
+ * acknowledgement to the application. This store is a ready made
+ * implementation of those callbacks: packets are copied into slots carved out
+ * of a single buffer, and found through a hash table keyed on packet ID, so
+ * storing, retrieving and clearing a packet take constant time and never use
+ * the heap.
+ */
+#ifndef CORE_MQTT_RETRANSMIT_H
+#define CORE_MQTT_RETRANSMIT_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes of bookkeeping per slot of a retransmit store, in addition to
+ * the largest packet the slot holds.
+ */
+#define MQTT_RETRANSMIT_SLOT_OVERHEAD    ( 12U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Size of the buffer needed by a retransmit store of @p slotCount
+ * slots, each holding a PUBLISH packet of up to @p maxPacketSize bytes.
+ */
+#define MQTT_RETRANSMIT_BUFFER_SIZE( slotCount, maxPacketSize ) \
+    ( ( slotCount ) * ( ( maxPacketSize ) + MQTT_RETRANSMIT_SLOT_OVERHEAD ) )
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A retransmit store.
+ *
+ * The buffer given to #MQTT_InitRetransmitStore is split into a hash table
+ * mapping packet IDs to slots, and the slots themselves. A slot holds the
+ * length of its packet followed by the packet, or the next free slot while it
+ * is unused.
+ *
+ * The members of this struct are maintained by the library and should not be
+ * modified by the application.
+ */
+typedef struct MQTTRetransmitStore
+{
+    uint8_t * pIndex;     /**< @brief Hash table of packet ID and slot pairs. */
+    size_t indexCount;    /**< @brief Number of entries in @p pIndex, twice the number of slots. */
+    uint8_t * pSlots;     /**< @brief Memory of the slots. */
+    size_t slotCount;     /**< @brief Number of slots. */
+    size_t maxPacketSize; /**< @brief Largest packet a slot holds. */
+    size_t freeSlot;      /**< @brief First unused slot, or @p slotCount if every slot is used. */
+    size_t usedCount;     /**< @brief Number of stored packets. */
+} MQTTRetransmitStore_t;
+
+/**
+ * @brief Initialize a retransmit store and register it with a context, in
+ * place of callbacks passed to #MQTT_InitRetransmits.
+ *
+ * A PUBLISH packet is stored when it is sent with QoS 1 or QoS 2, cleared when
+ * it is acknowledged, and resent from the store when a session is resumed. A
+ * PUBLISH larger than @p maxPacketSize, or sent while every slot is used,
+ * fails with #MQTTPublishStoreFailed.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[out] pStore The store to initialize. It must remain in scope for as
+ * long as the context uses it.
+ * @param[in] pBuffer Memory for the store.
+ * @param[in] bufferSize Size of @p pBuffer. #MQTT_RETRANSMIT_BUFFER_SIZE gives
+ * the size needed for a number of slots.
+ * @param[in] maxPacketSize Largest PUBLISH packet, including its header, to
+ * store in a slot.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or @p pBuffer
+ * does not hold a single slot; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // One slot per outgoing publish record, for publishes of up to 512 bytes.
+ * #define OUTGOING_PUBLISH_COUNT    30
+ * #define MAX_PUBLISH_SIZE          512
+ *
+ * MQTTPubAckInfo_t outgoingPublishes[ OUTGOING_PUBLISH_COUNT ];
+ * uint8_t retransmitBuffer[ MQTT_RETRANSMIT_BUFFER_SIZE( OUTGOING_PUBLISH_COUNT, MAX_PUBLISH_SIZE ) ];
+ * MQTTRetransmitStore_t retransmitStore;
+ *
+ * status = MQTT_InitStatefulQoS( &mqttContext,
+ *                                outgoingPublishes,
+ *                                OUTGOING_PUBLISH_COUNT,
+ *                                NULL,
+ *                                0 );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *     status = MQTT_InitRetransmitStore( &mqttContext,
+ *                                        &retransmitStore,
+ *                                        retransmitBuffer,
+ *                                        sizeof( retransmitBuffer ),
+ *                                        MAX_PUBLISH_SIZE );
+ *
+ *     // Now unacknowledged publishes are resent on an unclean session resumption.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initretransmitstore] */
+MQTTStatus_t MQTT_InitRetransmitStore( MQTTContext_t * pContext,
+                                       MQTTRetransmitStore_t * pStore,
+                                       uint8_t * pBuffer,
+                                       size_t bufferSize,
+                                       size_t maxPacketSize );
+/* @[declare_mqtt_initretransmitstore] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_RETRANSMIT_H */
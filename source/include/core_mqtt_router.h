@@ -0,0 +1,247 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router.h
+ * @brief Routing of incoming PUBLISH topic names to the handlers of many
+ * topic filters.
+ *
+ * #MQTT_MatchTopic compares a topic name with a single topic filter. The router
+ * instead compiles every topic filter into a trie of topic levels, so that all
+ * the filters matching a topic name are found in one walk of the topic name,
+ * however many filters are registered.
+ */
+#ifndef CORE_MQTT_ROUTER_H
+#define CORE_MQTT_ROUTER_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+#include "core_mqtt.h"
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Value of a node link which does not refer to any node.
+ */
+#define MQTT_ROUTER_NODE_INVALID    ( ( uint16_t ) 0xFFFFU )
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A node of the topic level trie of a router.
+ *
+ * The members of this struct are maintained by the router and should not be
+ * modified by the application.
+ */
+typedef struct MQTTRouterNode
+{
+    const char * pLevel;       /**< @brief Topic level of the node, pointing into the topic filter which created it. */
+    void * pHandler;           /**< @brief Handler of the topic filter ending at this node, or NULL. */
+    void * pMultiLevelHandler; /**< @brief Handler of the topic filter ending with "#" below this node, or NULL. */
+    uint32_t hash;             /**< @brief Hash of the parent node and the topic level. */
+    uint16_t levelLength;      /**< @brief Length of the topic level. */
+    uint16_t parent;           /**< @brief Parent node, or the next free node while the node is unused. */
+    uint16_t plusChild;        /**< @brief Child node for the "+" wildcard. */
+    uint16_t childCount;       /**< @brief Number of child nodes, including the "+" child. */
+} MQTTRouterNode_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A topic filter router.
+ *
+ * The nodes of the trie and the hash table which finds the child of a node
+ * for a topic level both live in memory provided by the application. A topic
+ * filter needs at most one node per topic level, fewer when it shares leading
+ * levels with topic filters already added.
+ */
+typedef struct MQTTRouter
+{
+    MQTTRouterNode_t * pNodes; /**< @brief Memory for the trie nodes. Node 0 is the root. */
+    size_t nodeCount;          /**< @brief Number of nodes in @p pNodes. */
+    uint16_t * pSlots;         /**< @brief Hash table of literal child nodes. */
+    size_t slotCount;          /**< @brief Number of slots in @p pSlots. */
+    uint16_t freeNode;         /**< @brief First unused node. */
+} MQTTRouter_t;
+
+/**
+ * @brief Initialize a topic filter router.
+ *
+ * @param[out] pRouter The router to initialize.
+ * @param[in] pNodes Memory for the trie nodes.
+ * @param[in] nodeCount Number of nodes in @p pNodes, at least 1 and less than
+ * #MQTT_ROUTER_NODE_INVALID. One node is used as the root of the trie.
+ * @param[in] pSlots Memory for the hash table of child nodes.
+ * @param[in] slotCount Number of slots in @p pSlots. Must be greater than
+ * @p nodeCount; twice that number keeps the probe sequences short.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTRouter_t router;
+ * MQTTRouterNode_t nodes[ 256 ];
+ * uint16_t slots[ 512 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_RouterInit( &router, nodes, 256, slots, 512 );
+ * @endcode
+ */
+/* @[declare_mqtt_routerinit] */
+MQTTStatus_t MQTT_RouterInit( MQTTRouter_t * pRouter,
+                              MQTTRouterNode_t * pNodes,
+                              size_t nodeCount,
+                              uint16_t * pSlots,
+                              size_t slotCount );
+/* @[declare_mqtt_routerinit] */
+
+/**
+ * @brief Add a topic filter and its handler to a router.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] pTopicFilter The topic filter, which may contain the "+" and
+ * "#" wildcards.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in] pHandler Application defined handler returned by
+ * #MQTT_RouterMatch for topic names matching the topic filter. Must not be NULL.
+ *
+ * @note The router keeps pointers into @p pTopicFilter instead of copying its
+ * topic levels, so the topic filter must remain in scope for as long as the
+ * router is used.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed, including a
+ * topic filter with more than #MQTT_ROUTER_MAX_TOPIC_LEVELS levels;
+ * #MQTTStateCollision if the topic filter was already added;
+ * #MQTTNoMemory if the router ran out of nodes;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Handlers can be any application data, for example a callback table entry.
+ * extern MyHandler_t temperatureHandler;
+ *
+ * status = MQTT_RouterAdd( &router,
+ *                          "fleet/+/temperature",
+ *                          strlen( "fleet/+/temperature" ),
+ *                          &temperatureHandler );
+ * @endcode
+ */
+/* @[declare_mqtt_routeradd] */
+MQTTStatus_t MQTT_RouterAdd( MQTTRouter_t * pRouter,
+                             const char * pTopicFilter,
+                             uint16_t topicFilterLength,
+                             void * pHandler );
+/* @[declare_mqtt_routeradd] */
+
+/**
+ * @brief Remove a topic filter from a router.
+ *
+ * Nodes which are no longer used by any topic filter are returned to the
+ * router.
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] pTopicFilter The topic filter to remove.
+ * @param[in] topicFilterLength Length of the topic filter.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the topic
+ * filter was not added; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * status = MQTT_RouterRemove( &router,
+ *                             "fleet/+/temperature",
+ *                             strlen( "fleet/+/temperature" ) );
+ * @endcode
+ */
+/* @[declare_mqtt_routerremove] */
+MQTTStatus_t MQTT_RouterRemove( MQTTRouter_t * pRouter,
+                                const char * pTopicFilter,
+                                uint16_t topicFilterLength );
+/* @[declare_mqtt_routerremove] */
+
+/**
+ * @brief Find the handlers of all topic filters matching a topic name.
+ *
+ * Matching follows the topic wildcard rules of the MQTT specification, and
+ * topic names starting with "$" do not match topic filters starting with a
+ * wildcard. Unlike #MQTT_MatchTopic, a "+" level followed by "#" also matches
+ * when the topic name ends at the "+" level, for example "sport/+/#" matches
+ * "sport/tennis", and "+/+" matches "sport/".
+ *
+ * @param[in] pRouter Initialized router.
+ * @param[in] pTopicName The topic name of an incoming PUBLISH.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[out] pHandlers Array which receives the handlers of the matching
+ * topic filters.
+ * @param[in] handlerCount Number of handlers which fit in @p pHandlers.
+ * @param[out] pMatchCount Number of matching topic filters. This can exceed
+ * @p handlerCount, in which case only the first @p handlerCount handlers are
+ * written.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if more topic filters match than fit in @p pHandlers;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Can be called from the event callback on an incoming PUBLISH.
+ * void * handlers[ 8 ];
+ * size_t matchCount = 0;
+ * size_t i;
+ *
+ * status = MQTT_RouterMatch( &router,
+ *                            pPublishInfo->pTopicName,
+ *                            pPublishInfo->topicNameLength,
+ *                            handlers,
+ *                            8,
+ *                            &matchCount );
+ *
+ * for( i = 0; ( i < matchCount ) && ( i < 8 ); i++ )
+ * {
+ *     // Invoke the handler.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_routermatch] */
+MQTTStatus_t MQTT_RouterMatch( const MQTTRouter_t * pRouter,
+                               const char * pTopicName,
+                               uint16_t topicNameLength,
+                               void ** pHandlers,
+                               size_t handlerCount,
+                               size_t * pMatchCount );
+/* @[declare_mqtt_routermatch] */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ifndef CORE_MQTT_ROUTER_H */
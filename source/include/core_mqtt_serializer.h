@@ -310,6 +310,33 @@ typedef struct MQTTPublishInfo
      * @warning Violating these requirements results in undefined behavior.
      */
     const struct MQTT5Properties * pProperties;
+
+    /**
+     * @brief Topic Alias sent with the PUBLISH, or 0 to send none. Only
+     * available when MQTT_VERSION is set to MQTT_VERSION_5_0.
+     *
+     * With a nonzero alias, @p topicNameLength may be 0 to publish on the
+     * topic previously mapped to the alias. The alias cannot be combined with
+     * @p pProperties. #MQTT_DeserializePublish sets it to the Topic Alias of
+     * the incoming publish, or 0 if it has none.
+     */
+    uint16_t topicAlias;
+
+    /**
+     * @brief Property block of an incoming PUBLISH, starting with the
+     * properties length. Only available when MQTT_VERSION is set to
+     * MQTT_VERSION_5_0.
+     *
+     * Set by #MQTT_DeserializePublish to point into the packet, so the
+     * properties can be read on demand with #MQTT5_InitPropertyCursor. It is
+     * ignored when sending.
+     */
+    const uint8_t * pRawProperties;
+
+    /**
+     * @brief Length of @p pRawProperties, including the properties length.
+     */
+    size_t rawPropertiesLength;
 #endif
 } MQTTPublishInfo_t;
 
@@ -851,6 +878,53 @@ MQTTStatus_t MQTT_SerializePublishHeaderWithoutTopic( const MQTTPublishInfo_t *
                                                       uint8_t * pBuffer,
                                                       size_t * headerSize );
 
+/**
+ * @brief Get the number of bytes needed to encode a Variable Byte Integer,
+ * such as the Remaining Length of an MQTT packet.
+ *
+ * @param[in] value The value to encode, at most 268,435,455.
+ *
+ * @return The encoded size, from 1 to 4 bytes.
+ */
+size_t MQTT_GetVariableByteIntegerSize( size_t value );
+
+/**
+ * @brief Encode a Variable Byte Integer, such as the Remaining Length of an
+ * MQTT packet, in the given buffer.
+ *
+ * @param[in] value The value to encode.
+ * @param[out] pBuffer Buffer of at least 4 bytes for the encoded value.
+ * @param[out] pEncodedSize Number of bytes written to @p pBuffer.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the value
+ * exceeds 268,435,455; #MQTTSuccess otherwise.
+ */
+MQTTStatus_t MQTT_SerializeVariableByteInteger( size_t value,
+                                                uint8_t * pBuffer,
+                                                size_t * pEncodedSize );
+
+/**
+ * @brief Decode a Variable Byte Integer, such as the Remaining Length of an
+ * MQTT packet, from the given buffer.
+ *
+ * Only the shortest encoding of a value is accepted, as required by the MQTT
+ * specification.
+ *
+ * @param[in] pBuffer Buffer holding the encoded value.
+ * @param[in] bufferSize Number of bytes available in @p pBuffer.
+ * @param[out] pValue The decoded value.
+ * @param[out] pEncodedSize Number of bytes the encoded value occupies.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNeedMoreBytes if @p pBuffer ends before the encoded value does;
+ * #MQTTBadResponse if the encoding is longer than 4 bytes or is not the
+ * shortest one; #MQTTSuccess otherwise.
+ */
+MQTTStatus_t MQTT_DeserializeVariableByteInteger( const uint8_t * pBuffer,
+                                                  size_t bufferSize,
+                                                  size_t * pValue,
+                                                  size_t * pEncodedSize );
+
 /**
  * @brief Serialize an MQTT PUBLISH packet header in the given buffer.
  *
@@ -1302,6 +1376,87 @@ MQTTStatus_t MQTT_GetIncomingPacketTypeAndLength( TransportRecv_t readFunc,
                                                   MQTTPacketInfo_t * pIncomingPacket );
 /* @[declare_mqtt_getincomingpackettypeandlength] */
 
+/**
+ * @brief Extract the MQTT packet type and length of an incoming packet from
+ * bytes received in bulk.
+ *
+ * #MQTT_GetIncomingPacketTypeAndLength calls the transport once for each byte
+ * of the fixed header. This function instead decodes the fixed header from
+ * bytes already in @p pFixedBuffer, and only if they do not hold a complete
+ * fixed header, calls the transport once to fill the rest of the buffer. The
+ * bytes received this way usually include the rest of a small packet, so a
+ * packet can be read with a single transport call.
+ *
+ * On success, the packet starts at the beginning of the buffer: the fixed
+ * header of #MQTTPacketInfo_t.headerLength bytes is followed by the part of
+ * the packet that was already received. The caller receives the rest of the
+ * packet if @p pBytesInBuffer is less than the packet size. Any bytes after
+ * the packet belong to the next one; the caller moves them to the beginning
+ * of the buffer and updates @p pBytesInBuffer before the next call.
+ *
+ * @param[in] readFunc Transport layer read function pointer.
+ * @param[in] pNetworkContext The network context pointer provided by the application.
+ * @param[in] pFixedBuffer Buffer for received bytes, of at least 5 bytes.
+ * @param[in,out] pBytesInBuffer Number of bytes at the beginning of the
+ * buffer that were received before. Incremented by the bytes received.
+ * @param[out] pIncomingPacket Pointer to MQTTPacketInfo_t structure. This is
+ * where type, remaining length and header length are stored.
+ *
+ * @return #MQTTSuccess on successful extraction of type and length,
+ * #MQTTBadParameter if invalid parameters are passed,
+ * #MQTTRecvFailed on transport receive failure,
+ * #MQTTBadResponse if an invalid packet is read,
+ * #MQTTNeedMoreBytes if only part of the fixed header was received, and
+ * #MQTTNoDataAvailable if there is nothing to read.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTPacketInfo_t incomingPacket;
+ * MQTTStatus_t status;
+ * uint8_t buffer[ BUFFER_SIZE ];
+ * MQTTFixedBuffer_t fixedBuffer = { buffer, BUFFER_SIZE };
+ * size_t bytesInBuffer = 0;
+ * size_t packetSize;
+ *
+ * do{
+ *      status = MQTT_GetIncomingPacketTypeAndLengthBuffered(
+ *          socket_recv,
+ *          &networkContext,
+ *          &fixedBuffer,
+ *          &bytesInBuffer,
+ *          &incomingPacket
+ *      );
+ * } while( ( status == MQTTNoDataAvailable ) || ( status == MQTTNeedMoreBytes ) );
+ *
+ * assert( status == MQTTSuccess );
+ * packetSize = incomingPacket.headerLength + incomingPacket.remainingLength;
+ * assert( packetSize <= BUFFER_SIZE );
+ *
+ * // Receive the part of the packet that is not in the buffer yet.
+ * while( bytesInBuffer < packetSize )
+ * {
+ *      bytesInBuffer += socket_recv( &networkContext,
+ *                                    &buffer[ bytesInBuffer ],
+ *                                    packetSize - bytesInBuffer );
+ * }
+ *
+ * incomingPacket.pRemainingData = &buffer[ incomingPacket.headerLength ];
+ *
+ * // After processing the packet, keep the bytes of the next one.
+ * memmove( buffer, &buffer[ packetSize ], bytesInBuffer - packetSize );
+ * bytesInBuffer -= packetSize;
+ * @endcode
+ */
+/* @[declare_mqtt_getincomingpackettypeandlengthbuffered] */
+MQTTStatus_t MQTT_GetIncomingPacketTypeAndLengthBuffered( TransportRecv_t readFunc,
+                                                          NetworkContext_t * pNetworkContext,
+                                                          const MQTTFixedBuffer_t * pFixedBuffer,
+                                                          size_t * pBytesInBuffer,
+                                                          MQTTPacketInfo_t * pIncomingPacket );
+/* @[declare_mqtt_getincomingpackettypeandlengthbuffered] */
+
 /**
  * @brief Extract the MQTT packet type and length from incoming packet.
  *
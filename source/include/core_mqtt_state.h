@@ -71,7 +71,9 @@ typedef enum MQTTStateOperation
  * @param[in] packetId The ID of the publish packet.
  * @param[in] qos 1 or 2.
  *
- * @return MQTTSuccess, MQTTNoMemory, or MQTTStateCollision.
+ * @return MQTTSuccess, MQTTNoMemory, or MQTTStateCollision. MQTTNoMemory is
+ * also returned when the outgoing publishes awaiting acknowledgment fill the
+ * Receive Maximum of the broker.
  */
 
 /**
@@ -144,6 +146,40 @@ MQTTStatus_t MQTT_RemoveStateRecord( const MQTTContext_t * pMqttContext,
                                      uint16_t packetId );
 /** @endcond */
 
+/**
+ * @fn MQTTStatus_t MQTT_RemoveIncomingStateRecord( const MQTTContext_t * pMqttContext, uint16_t packetId );
+ * @brief Remove the state record for an incoming PUBLISH packet.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ * @param[in] packetId ID of the PUBLISH packet.
+ *
+ * @return #MQTTBadParameter or #MQTTSuccess.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+MQTTStatus_t MQTT_RemoveIncomingStateRecord( const MQTTContext_t * pMqttContext,
+                                             uint16_t packetId );
+/** @endcond */
+
+/**
+ * @fn void MQTT_IndexStateRecords( const MQTTContext_t * pMqttContext );
+ * @brief Rebuild the packet ID indexes attached to the state records.
+ *
+ * Every attached index is cleared and each valid record is added to it.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+void MQTT_IndexStateRecords( const MQTTContext_t * pMqttContext );
+/** @endcond */
+
 /**
  * @fn MQTTPublishState_t MQTT_CalculateStateAck( MQTTPubAckType_t packetType, MQTTStateOperation_t opType, MQTTQoS_t qos );
  * @brief Calculate the state from a PUBACK, PUBREC, PUBREL, or PUBCOMP.
@@ -285,6 +321,41 @@ uint16_t MQTT_PublishToResend( const MQTTContext_t * pMqttContext,
                                MQTTStateCursor_t * pCursor );
 /* @[declare_mqtt_publishtoresend] */
 
+/**
+ * @brief Get the number of QoS 1 and QoS 2 publishes which can be sent before
+ * acknowledgments are received.
+ *
+ * The send window is the number of outgoing publish records, or the Receive
+ * Maximum of the broker if it advertised a lower one in its CONNACK. Every
+ * outgoing record in use, from the reservation of its packet ID until its
+ * PUBACK or PUBCOMP is received, takes a place in the window. Once the window
+ * is full, QoS 1 and QoS 2 publishes fail with #MQTTNoMemory instead of being
+ * sent beyond the limit of the broker, which would close the connection.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ * @param[out] pFreeCount Number of free places in the send window.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the outgoing
+ * publish records are not set up; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * size_t freeCount = 0;
+ *
+ * // Only take readings off the sensor queue when they can be sent now.
+ * if( ( MQTT_GetSendWindow( pContext, &freeCount ) == MQTTSuccess ) &&
+ *     ( freeCount > 0 ) )
+ * {
+ *      status = MQTT_Publish( pContext, &publishInfo, MQTT_GetPacketId( pContext ) );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_getsendwindow] */
+MQTTStatus_t MQTT_GetSendWindow( const MQTTContext_t * pMqttContext,
+                                 size_t * pFreeCount );
+/* @[declare_mqtt_getsendwindow] */
+
 /**
  * @fn const char * MQTT_State_strerror( MQTTPublishState_t state );
  * @brief State to string conversion for state engine.
@@ -0,0 +1,1053 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_benchmark.c
+ * @brief Micro benchmarks for the serializer, state engine and topic matching
+ * hot paths.
+ *
+ * Every benchmark repeats one operation until a minimum time has passed and
+ * reports the best of several repetitions as nanoseconds per operation, along
+ * with the number of MQTT packet bytes the operation produces or consumes.
+ * Run with --help for the options.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_mqtt.h"
+#include "core_mqtt_state.h"
+
+/**
+ * @brief Number of timed repetitions of each benchmark. The fastest one is
+ * reported, as it is the least disturbed by the rest of the system.
+ */
+#define BENCHMARK_REPETITIONS            ( 5U )
+
+/**
+ * @brief Default minimum duration of each repetition.
+ */
+#define BENCHMARK_DEFAULT_MIN_TIME_MS    ( 100U )
+
+/**
+ * @brief Maximum number of values in a list option.
+ */
+#define BENCHMARK_MAX_LIST_LENGTH        ( 16U )
+
+/**
+ * @brief Size of the network and loopback buffers. Large enough for the
+ * biggest payload accepted on the command line.
+ */
+#define BENCHMARK_BUFFER_SIZE            ( 1024U * 1024U )
+
+/**
+ * @brief Largest payload size accepted on the command line.
+ */
+#define BENCHMARK_MAX_PAYLOAD_SIZE       ( BENCHMARK_BUFFER_SIZE - 1024U )
+
+/**
+ * @brief Topic name of the PUBLISH packets used by the benchmarks.
+ */
+#define BENCHMARK_TOPIC                  "fleet/region-eu-west-1/site-000123/device-abcdef0123/sensor/temperature"
+
+/**
+ * @brief Number of Variable Byte Integers encoded or decoded by one operation.
+ */
+#define BENCHMARK_VBI_COUNT              ( 64U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief An operation to benchmark.
+ *
+ * @param[in] pArg Benchmark specific state.
+ *
+ * @return Number of MQTT packet bytes produced or consumed by the operation.
+ */
+typedef size_t (* BenchmarkOperation_t )( void * pArg );
+
+/**
+ * @brief In-memory loopback transport. Bytes sent are queued and returned by
+ * the next receives.
+ */
+struct NetworkContext
+{
+    uint8_t * pBuffer; /**< @brief Queued bytes. */
+    size_t size;       /**< @brief Size of pBuffer. */
+    size_t head;       /**< @brief Offset of the first queued byte. */
+    size_t tail;       /**< @brief Offset after the last queued byte. */
+};
+
+/**
+ * @brief State of the serializer benchmarks.
+ */
+typedef struct SerializerBenchmark
+{
+    MQTTPublishInfo_t publishInfo; /**< @brief The PUBLISH to serialize. */
+    MQTTFixedBuffer_t fixedBuffer; /**< @brief Buffer to serialize into. */
+    size_t packetSize;             /**< @brief Size of the serialized PUBLISH. */
+    NetworkContext_t * pLoopback;  /**< @brief Loopback transport. */
+    uint8_t * pReceiveBuffer;      /**< @brief Buffer received packets are copied to. */
+} SerializerBenchmark_t;
+
+/**
+ * @brief State of the state engine benchmark.
+ */
+typedef struct StateBenchmark
+{
+    MQTTContext_t * pContext; /**< @brief Context holding the state records. */
+    uint16_t * pInFlight;     /**< @brief Packet IDs of the in-flight publishes. */
+    size_t inFlightCount;     /**< @brief Number of in-flight publishes. */
+    uint8_t * pInUse;         /**< @brief Whether each packet ID is in flight. */
+    uint16_t nextPacketId;    /**< @brief Next packet ID to try for a new publish. */
+    uint32_t random;          /**< @brief Random number generator state. */
+} StateBenchmark_t;
+
+/**
+ * @brief State of the topic matching benchmark.
+ */
+typedef struct MatchBenchmark
+{
+    const char * pTopicName;   /**< @brief Topic name to match. */
+    const char * pTopicFilter; /**< @brief Topic filter to match. */
+} MatchBenchmark_t;
+
+/**
+ * @brief State of the Variable Byte Integer benchmarks.
+ */
+typedef struct VbiBenchmark
+{
+    size_t values[ BENCHMARK_VBI_COUNT ];        /**< @brief Values to encode. */
+    uint8_t encoded[ BENCHMARK_VBI_COUNT * 4U ]; /**< @brief The values, encoded back to back. */
+    size_t encodedLength;                        /**< @brief Bytes used in encoded. */
+} VbiBenchmark_t;
+
+/**
+ * @brief Command line options.
+ */
+typedef struct BenchmarkOptions
+{
+    size_t payloadSizes[ BENCHMARK_MAX_LIST_LENGTH ];   /**< @brief PUBLISH payload sizes. */
+    size_t payloadSizeCount;                            /**< @brief Number of payload sizes. */
+    size_t inFlightCounts[ BENCHMARK_MAX_LIST_LENGTH ]; /**< @brief In-flight publish counts. */
+    size_t inFlightCountCount;                          /**< @brief Number of in-flight counts. */
+    size_t spareRecordsPercent;                         /**< @brief State records beyond the in-flight count. */
+    size_t iterations;                                  /**< @brief Fixed iteration count, or 0 to calibrate. */
+    unsigned long minTimeMs;                            /**< @brief Minimum duration of a repetition. */
+    const char * pFilter;                               /**< @brief Run only benchmarks whose name contains this. */
+    int json;                                           /**< @brief Print JSON lines instead of a table. */
+} BenchmarkOptions_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Options in effect.
+ */
+static BenchmarkOptions_t options;
+
+/**
+ * @brief Sink for operation results, so that the compiler cannot drop the
+ * operations.
+ */
+static volatile size_t benchmarkSink = 0U;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+static double nowNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( double ) now.tv_sec * 1e9 ) + ( double ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time source for the MQTT context.
+ */
+static uint32_t getTimeMs( void )
+{
+    return ( uint32_t ) ( nowNs() / 1e6 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event callback for the MQTT context. No packets are processed by the
+ * benchmarks, so it is never called.
+ */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Queue bytes on the loopback transport.
+ */
+static int32_t loopbackSend( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend )
+{
+    int32_t bytesSent = 0;
+
+    /* Restart at the beginning of the buffer once everything was received. */
+    if( pNetworkContext->head == pNetworkContext->tail )
+    {
+        pNetworkContext->head = 0U;
+        pNetworkContext->tail = 0U;
+    }
+
+    if( bytesToSend <= ( pNetworkContext->size - pNetworkContext->tail ) )
+    {
+        ( void ) memcpy( &pNetworkContext->pBuffer[ pNetworkContext->tail ], pBuffer, bytesToSend );
+        pNetworkContext->tail += bytesToSend;
+        bytesSent = ( int32_t ) bytesToSend;
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receive bytes queued on the loopback transport.
+ */
+static int32_t loopbackRecv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv )
+{
+    size_t available = pNetworkContext->tail - pNetworkContext->head;
+    size_t bytesReceived = ( bytesToRecv < available ) ? bytesToRecv : available;
+
+    ( void ) memcpy( pBuffer, &pNetworkContext->pBuffer[ pNetworkContext->head ], bytesReceived );
+    pNetworkContext->head += bytesReceived;
+
+    return ( int32_t ) bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print one benchmark result.
+ */
+static void reportResult( const char * pName,
+                          const char * pParameters,
+                          size_t iterations,
+                          double nsPerOp,
+                          size_t bytesPerOp )
+{
+    if( options.json != 0 )
+    {
+        ( void ) printf( "{\"benchmark\":\"%s\",\"parameters\":\"%s\",\"mqtt_version\":%d,"
+                         "\"iterations\":%lu,\"ns_per_op\":%.2f,\"bytes_per_op\":%lu}\n",
+                         pName,
+                         pParameters,
+                         ( int ) MQTT_VERSION,
+                         ( unsigned long ) iterations,
+                         nsPerOp,
+                         ( unsigned long ) bytesPerOp );
+    }
+    else
+    {
+        ( void ) printf( "%-20s %-36s %10lu %10.2f %10lu\n",
+                         pName,
+                         pParameters,
+                         ( unsigned long ) iterations,
+                         nsPerOp,
+                         ( unsigned long ) bytesPerOp );
+    }
+
+    ( void ) fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time an operation and report the result.
+ *
+ * Unless a fixed iteration count was given, the iteration count is doubled
+ * until one repetition lasts at least a tenth of the minimum time, and then
+ * scaled up to the minimum time.
+ */
+static void runBenchmark( const char * pName,
+                          const char * pParameters,
+                          BenchmarkOperation_t operation,
+                          void * pArg )
+{
+    size_t iterations = options.iterations;
+    size_t bytesPerOp = 0U;
+    size_t i = 0U;
+    size_t repetition = 0U;
+    double start = 0.0;
+    double elapsed = 0.0;
+    double best = 0.0;
+    double minTimeNs = ( double ) options.minTimeMs * 1e6;
+
+    if( iterations == 0U )
+    {
+        iterations = 1U;
+
+        for( ; ; )
+        {
+            start = nowNs();
+
+            for( i = 0U; i < iterations; i++ )
+            {
+                bytesPerOp = operation( pArg );
+            }
+
+            elapsed = nowNs() - start;
+
+            if( ( elapsed >= ( minTimeNs / 10.0 ) ) || ( iterations >= ( ( size_t ) 1U << 30 ) ) )
+            {
+                break;
+            }
+
+            iterations *= 2U;
+        }
+
+        if( elapsed > 0.0 )
+        {
+            iterations = ( size_t ) ( ( double ) iterations * ( minTimeNs / elapsed ) ) + 1U;
+        }
+    }
+
+    for( repetition = 0U; repetition < BENCHMARK_REPETITIONS; repetition++ )
+    {
+        start = nowNs();
+
+        for( i = 0U; i < iterations; i++ )
+        {
+            bytesPerOp = operation( pArg );
+        }
+
+        elapsed = nowNs() - start;
+
+        if( ( repetition == 0U ) || ( elapsed < best ) )
+        {
+            best = elapsed;
+        }
+    }
+
+    reportResult( pName, pParameters, iterations, best / ( double ) iterations, bytesPerOp );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether a benchmark was selected on the command line.
+ */
+static int isSelected( const char * pName )
+{
+    return ( options.pFilter == NULL ) || ( strstr( pName, options.pFilter ) != NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop the benchmarks if an operation failed, as its timing would be
+ * meaningless.
+ */
+static void checkStatus( MQTTStatus_t status,
+                         const char * pOperation )
+{
+    if( status != MQTTSuccess )
+    {
+        ( void ) fprintf( stderr, "%s failed: %s\n", pOperation, MQTT_Status_strerror( status ) );
+        exit( EXIT_FAILURE );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serialize a PUBLISH packet.
+ */
+static size_t serializePublishOperation( void * pArg )
+{
+    SerializerBenchmark_t * pBenchmark = ( SerializerBenchmark_t * ) pArg;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    MQTTStatus_t status;
+
+    status = MQTT_GetPublishPacketSize( &pBenchmark->publishInfo, &remainingLength, &packetSize );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePublish( &pBenchmark->publishInfo, 1U, remainingLength, &pBenchmark->fixedBuffer );
+    }
+
+    checkStatus( status, "Serialize PUBLISH" );
+
+    return packetSize;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Extract the type and remaining length of a serialized PUBLISH.
+ */
+static size_t processTypeAndLengthOperation( void * pArg )
+{
+    SerializerBenchmark_t * pBenchmark = ( SerializerBenchmark_t * ) pArg;
+    MQTTPacketInfo_t packetInfo;
+    MQTTStatus_t status;
+
+    ( void ) memset( &packetInfo, 0x00, sizeof( packetInfo ) );
+    status = MQTT_ProcessIncomingPacketTypeAndLength( pBenchmark->fixedBuffer.pBuffer,
+                                                      &pBenchmark->packetSize,
+                                                      &packetInfo );
+    checkStatus( status, "Process type and length" );
+    benchmarkSink += packetInfo.remainingLength;
+
+    return pBenchmark->packetSize;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse and deserialize a serialized PUBLISH.
+ */
+static size_t deserializePublishOperation( void * pArg )
+{
+    SerializerBenchmark_t * pBenchmark = ( SerializerBenchmark_t * ) pArg;
+    MQTTPacketInfo_t packetInfo;
+    MQTTPublishInfo_t publishInfo;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+
+    ( void ) memset( &packetInfo, 0x00, sizeof( packetInfo ) );
+    status = MQTT_ProcessIncomingPacketTypeAndLength( pBenchmark->fixedBuffer.pBuffer,
+                                                      &pBenchmark->packetSize,
+                                                      &packetInfo );
+
+    if( status == MQTTSuccess )
+    {
+        packetInfo.pRemainingData = &pBenchmark->fixedBuffer.pBuffer[ packetInfo.headerLength ];
+        status = MQTT_DeserializePublish( &packetInfo,
+                                          &packetId,
+                                          &publishInfo
+                                          #if MQTT_VERSION == MQTT_VERSION_5_0
+                                              , NULL
+                                          #endif
+                                          );
+    }
+
+    checkStatus( status, "Deserialize PUBLISH" );
+    benchmarkSink += packetId;
+
+    return pBenchmark->packetSize;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serialize a PUBLISH, pass it through the loopback transport, and
+ * parse and deserialize it on the receiving side.
+ */
+static size_t loopbackPublishOperation( void * pArg )
+{
+    SerializerBenchmark_t * pBenchmark = ( SerializerBenchmark_t * ) pArg;
+    MQTTPacketInfo_t packetInfo;
+    MQTTPublishInfo_t publishInfo;
+    uint16_t packetId = 0U;
+    size_t received = 0U;
+    int32_t bytes = 0;
+    MQTTStatus_t status;
+
+    ( void ) serializePublishOperation( pArg );
+    bytes = loopbackSend( pBenchmark->pLoopback, pBenchmark->fixedBuffer.pBuffer, pBenchmark->packetSize );
+
+    if( bytes > 0 )
+    {
+        received = ( size_t ) loopbackRecv( pBenchmark->pLoopback, pBenchmark->pReceiveBuffer, BENCHMARK_BUFFER_SIZE );
+    }
+
+    ( void ) memset( &packetInfo, 0x00, sizeof( packetInfo ) );
+    status = MQTT_ProcessIncomingPacketTypeAndLength( pBenchmark->pReceiveBuffer, &received, &packetInfo );
+
+    if( status == MQTTSuccess )
+    {
+        packetInfo.pRemainingData = &pBenchmark->pReceiveBuffer[ packetInfo.headerLength ];
+        status = MQTT_DeserializePublish( &packetInfo,
+                                          &packetId,
+                                          &publishInfo
+                                          #if MQTT_VERSION == MQTT_VERSION_5_0
+                                              , NULL
+                                          #endif
+                                          );
+    }
+
+    checkStatus( status, "Deserialize PUBLISH" );
+    benchmarkSink += packetId;
+
+    return pBenchmark->packetSize;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Acknowledge a random in-flight QoS 1 publish and replace it with a
+ * new one, so that the in-flight count stays constant.
+ */
+static size_t updateStateAckOperation( void * pArg )
+{
+    StateBenchmark_t * pBenchmark = ( StateBenchmark_t * ) pArg;
+    MQTTPublishState_t state = MQTTStateNull;
+    size_t slot = 0U;
+    uint16_t packetId = 0U;
+    MQTTStatus_t status;
+
+    pBenchmark->random = ( pBenchmark->random * 1103515245U ) + 12345U;
+    slot = ( size_t ) ( pBenchmark->random >> 8 ) % pBenchmark->inFlightCount;
+    packetId = pBenchmark->pInFlight[ slot ];
+
+    status = MQTT_UpdateStateAck( pBenchmark->pContext, packetId, MQTTPuback, MQTT_RECEIVE, &state );
+    pBenchmark->pInUse[ packetId ] = 0U;
+
+    /* Find an unused packet ID for the replacement publish. */
+    do
+    {
+        pBenchmark->nextPacketId = ( pBenchmark->nextPacketId == UINT16_MAX ) ? 1U : ( uint16_t ) ( pBenchmark->nextPacketId + 1U );
+    } while( pBenchmark->pInUse[ pBenchmark->nextPacketId ] != 0U );
+
+    packetId = pBenchmark->nextPacketId;
+    pBenchmark->pInUse[ packetId ] = 1U;
+    pBenchmark->pInFlight[ slot ] = packetId;
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_ReserveState( pBenchmark->pContext, packetId, MQTTQoS1 );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_UpdateStatePublish( pBenchmark->pContext, packetId, MQTT_SEND, MQTTQoS1, &state );
+    }
+
+    checkStatus( status, "State update" );
+
+    return 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Match a topic name against a topic filter.
+ */
+static size_t matchTopicOperation( void * pArg )
+{
+    const MatchBenchmark_t * pBenchmark = ( const MatchBenchmark_t * ) pArg;
+    bool isMatch = false;
+    MQTTStatus_t status;
+
+    status = MQTT_MatchTopic( pBenchmark->pTopicName,
+                              ( uint16_t ) strlen( pBenchmark->pTopicName ),
+                              pBenchmark->pTopicFilter,
+                              ( uint16_t ) strlen( pBenchmark->pTopicFilter ),
+                              &isMatch );
+    checkStatus( status, "Match topic" );
+    benchmarkSink += ( isMatch ? 1U : 0U );
+
+    return 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Encode a batch of Variable Byte Integers back to back.
+ */
+static size_t vbiEncodeOperation( void * pArg )
+{
+    VbiBenchmark_t * pBenchmark = ( VbiBenchmark_t * ) pArg;
+    size_t encodedLength = 0U;
+    size_t encodedSize = 0U;
+    MQTTStatus_t status = MQTTSuccess;
+    size_t i = 0U;
+
+    for( i = 0U; ( status == MQTTSuccess ) && ( i < BENCHMARK_VBI_COUNT ); i++ )
+    {
+        status = MQTT_SerializeVariableByteInteger( pBenchmark->values[ i ],
+                                                    &pBenchmark->encoded[ encodedLength ],
+                                                    &encodedSize );
+        encodedLength += encodedSize;
+    }
+
+    checkStatus( status, "Encode variable byte integer" );
+
+    return encodedLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decode a batch of back to back Variable Byte Integers.
+ */
+static size_t vbiDecodeOperation( void * pArg )
+{
+    const VbiBenchmark_t * pBenchmark = ( const VbiBenchmark_t * ) pArg;
+    size_t decodedLength = 0U;
+    size_t encodedSize = 0U;
+    size_t value = 0U;
+    size_t sum = 0U;
+    MQTTStatus_t status = MQTTSuccess;
+
+    while( ( status == MQTTSuccess ) && ( decodedLength < pBenchmark->encodedLength ) )
+    {
+        status = MQTT_DeserializeVariableByteInteger( &pBenchmark->encoded[ decodedLength ],
+                                                      pBenchmark->encodedLength - decodedLength,
+                                                      &value,
+                                                      &encodedSize );
+        decodedLength += encodedSize;
+        sum += value;
+    }
+
+    checkStatus( status, "Decode variable byte integer" );
+    benchmarkSink += sum;
+
+    return decodedLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the Variable Byte Integer benchmarks for values of every encoded
+ * size, and for a mix of sizes that defeats branch prediction.
+ */
+static void runVbiBenchmarks( void )
+{
+    /* Smallest value of each encoded size, and the largest value plus one. */
+    static const size_t limits[ 5 ] = { 0U, 128U, 16384U, 2097152U, 268435456U };
+    VbiBenchmark_t benchmark;
+    char parameters[ 64 ];
+    uint32_t random = 1U;
+    size_t encodedSize = 0U;
+    size_t size = 0U;
+    size_t i = 0U;
+
+    for( size = 1U; size <= 5U; size++ )
+    {
+        benchmark.encodedLength = 0U;
+
+        for( i = 0U; i < BENCHMARK_VBI_COUNT; i++ )
+        {
+            /* Size 5 stands for a random size per value. */
+            random = ( random * 1103515245U ) + 12345U;
+            encodedSize = ( size < 5U ) ? size : ( 1U + ( ( random >> 16 ) % 4U ) );
+            random = ( random * 1103515245U ) + 12345U;
+            benchmark.values[ i ] = limits[ encodedSize - 1U ] +
+                                    ( ( size_t ) random % ( limits[ encodedSize ] - limits[ encodedSize - 1U ] ) );
+            benchmark.encodedLength += encodedSize;
+        }
+
+        if( size < 5U )
+        {
+            ( void ) sprintf( parameters, "bytes=%lu,count=%u", ( unsigned long ) size, BENCHMARK_VBI_COUNT );
+        }
+        else
+        {
+            ( void ) sprintf( parameters, "bytes=mixed,count=%u", BENCHMARK_VBI_COUNT );
+        }
+
+        ( void ) vbiEncodeOperation( &benchmark );
+
+        if( isSelected( "vbi_encode" ) != 0 )
+        {
+            runBenchmark( "vbi_encode", parameters, vbiEncodeOperation, &benchmark );
+        }
+
+        if( isSelected( "vbi_decode" ) != 0 )
+        {
+            runBenchmark( "vbi_decode", parameters, vbiDecodeOperation, &benchmark );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the serializer benchmarks for every payload size.
+ */
+static void runSerializerBenchmarks( void )
+{
+    SerializerBenchmark_t benchmark;
+    NetworkContext_t loopback;
+    uint8_t * pPayload = NULL;
+    char parameters[ 64 ];
+    size_t i = 0U;
+
+    ( void ) memset( &benchmark, 0x00, sizeof( benchmark ) );
+    ( void ) memset( &loopback, 0x00, sizeof( loopback ) );
+
+    pPayload = calloc( BENCHMARK_MAX_PAYLOAD_SIZE, 1U );
+    benchmark.fixedBuffer.pBuffer = malloc( BENCHMARK_BUFFER_SIZE );
+    benchmark.fixedBuffer.size = BENCHMARK_BUFFER_SIZE;
+    benchmark.pReceiveBuffer = malloc( BENCHMARK_BUFFER_SIZE );
+    loopback.pBuffer = malloc( BENCHMARK_BUFFER_SIZE );
+    loopback.size = BENCHMARK_BUFFER_SIZE;
+    benchmark.pLoopback = &loopback;
+
+    if( ( pPayload == NULL ) || ( benchmark.fixedBuffer.pBuffer == NULL ) ||
+        ( benchmark.pReceiveBuffer == NULL ) || ( loopback.pBuffer == NULL ) )
+    {
+        ( void ) fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    benchmark.publishInfo.qos = MQTTQoS1;
+    benchmark.publishInfo.pTopicName = BENCHMARK_TOPIC;
+    benchmark.publishInfo.topicNameLength = ( uint16_t ) strlen( BENCHMARK_TOPIC );
+    benchmark.publishInfo.pPayload = pPayload;
+
+    for( i = 0U; i < options.payloadSizeCount; i++ )
+    {
+        benchmark.publishInfo.payloadLength = options.payloadSizes[ i ];
+        ( void ) sprintf( parameters, "payload=%lu", ( unsigned long ) options.payloadSizes[ i ] );
+
+        /* Serialize once up front for the parsing benchmarks. */
+        benchmark.packetSize = serializePublishOperation( &benchmark );
+
+        if( isSelected( "serialize_publish" ) != 0 )
+        {
+            runBenchmark( "serialize_publish", parameters, serializePublishOperation, &benchmark );
+        }
+
+        if( isSelected( "process_type_length" ) != 0 )
+        {
+            runBenchmark( "process_type_length", parameters, processTypeAndLengthOperation, &benchmark );
+        }
+
+        if( isSelected( "deserialize_publish" ) != 0 )
+        {
+            runBenchmark( "deserialize_publish", parameters, deserializePublishOperation, &benchmark );
+        }
+
+        if( isSelected( "loopback_publish" ) != 0 )
+        {
+            runBenchmark( "loopback_publish", parameters, loopbackPublishOperation, &benchmark );
+        }
+    }
+
+    free( loopback.pBuffer );
+    free( benchmark.pReceiveBuffer );
+    free( benchmark.fixedBuffer.pBuffer );
+    free( pPayload );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the state engine benchmark for one in-flight count, with or
+ * without a packet ID index.
+ */
+static void runStateBenchmark( size_t inFlightCount,
+                               int useIndex )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    NetworkContext_t loopback;
+    MQTTFixedBuffer_t networkBuffer;
+    uint8_t buffer[ 64 ];
+    MQTTPubAckInfo_t * pRecords = NULL;
+    size_t recordCount = inFlightCount + ( ( inFlightCount * options.spareRecordsPercent ) / 100U );
+    MQTTPubAckIndex_t index;
+    StateBenchmark_t benchmark;
+    MQTTPublishState_t state = MQTTStateNull;
+    char parameters[ 64 ];
+    MQTTStatus_t status;
+    size_t i = 0U;
+
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &loopback, 0x00, sizeof( loopback ) );
+    ( void ) memset( &index, 0x00, sizeof( index ) );
+    ( void ) memset( &benchmark, 0x00, sizeof( benchmark ) );
+
+    transport.recv = loopbackRecv;
+    transport.send = loopbackSend;
+    transport.writev = NULL;
+    transport.pNetworkContext = &loopback;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    /* An indexed array keeps a quarter of its records free. */
+    if( ( useIndex != 0 ) && ( recordCount < ( inFlightCount + ( ( inFlightCount + 2U ) / 3U ) ) ) )
+    {
+        recordCount = inFlightCount + ( ( inFlightCount + 2U ) / 3U );
+    }
+
+    pRecords = calloc( recordCount, sizeof( MQTTPubAckInfo_t ) );
+    index.slotCount = ( 2U * recordCount ) + 1U;
+    index.pSlots = calloc( index.slotCount, sizeof( MQTTPubAckIndexSlot_t ) );
+    benchmark.pInFlight = calloc( inFlightCount, sizeof( uint16_t ) );
+    benchmark.pInUse = calloc( ( size_t ) UINT16_MAX + 1U, 1U );
+
+    if( ( pRecords == NULL ) || ( index.pSlots == NULL ) ||
+        ( benchmark.pInFlight == NULL ) || ( benchmark.pInUse == NULL ) )
+    {
+        ( void ) fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    status = MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_InitStatefulQoS( &context, pRecords, recordCount, NULL, 0U );
+    }
+
+    if( ( status == MQTTSuccess ) && ( useIndex != 0 ) )
+    {
+        status = MQTT_InitStatefulQoSIndex( &context, &index, NULL );
+    }
+
+    /* Fill the records with in-flight QoS 1 publishes. */
+    for( i = 0U; ( status == MQTTSuccess ) && ( i < inFlightCount ); i++ )
+    {
+        benchmark.pInFlight[ i ] = ( uint16_t ) ( i + 1U );
+        benchmark.pInUse[ i + 1U ] = 1U;
+        status = MQTT_ReserveState( &context, ( uint16_t ) ( i + 1U ), MQTTQoS1 );
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_UpdateStatePublish( &context, ( uint16_t ) ( i + 1U ), MQTT_SEND, MQTTQoS1, &state );
+        }
+    }
+
+    checkStatus( status, "State engine setup" );
+
+    benchmark.pContext = &context;
+    benchmark.inFlightCount = inFlightCount;
+    benchmark.nextPacketId = ( uint16_t ) inFlightCount;
+    benchmark.random = 1U;
+
+    ( void ) sprintf( parameters,
+                      "inflight=%lu,records=%lu,index=%s",
+                      ( unsigned long ) inFlightCount,
+                      ( unsigned long ) recordCount,
+                      ( useIndex != 0 ) ? "on" : "off" );
+    runBenchmark( "update_state_ack", parameters, updateStateAckOperation, &benchmark );
+
+    free( benchmark.pInUse );
+    free( benchmark.pInFlight );
+    free( index.pSlots );
+    free( pRecords );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the topic matching benchmarks.
+ */
+static void runMatchBenchmarks( void )
+{
+    static const char * const cases[][ 3 ] =
+    {
+        { "exact",          BENCHMARK_TOPIC, BENCHMARK_TOPIC                                                             },
+        { "literal_miss",   BENCHMARK_TOPIC, "fleet/region-eu-west-1/site-000123/device-abcdef0123/sensor/humidity" },
+        { "single_level",   BENCHMARK_TOPIC, "fleet/+/site-000123/+/sensor/temperature"                               },
+        { "multi_level",    BENCHMARK_TOPIC, "fleet/region-eu-west-1/site-000123/#"                                   },
+        { "short",          "a/b/c",         "a/+/c"                                                                  }
+    };
+    MatchBenchmark_t benchmark;
+    size_t i = 0U;
+
+    for( i = 0U; i < ( sizeof( cases ) / sizeof( cases[ 0 ] ) ); i++ )
+    {
+        benchmark.pTopicName = cases[ i ][ 1 ];
+        benchmark.pTopicFilter = cases[ i ][ 2 ];
+        runBenchmark( "match_topic", cases[ i ][ 0 ], matchTopicOperation, &benchmark );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse a comma separated list of sizes.
+ *
+ * @return 0 on success, -1 if the list is invalid.
+ */
+static int parseList( const char * pValue,
+                      size_t * pList,
+                      size_t * pCount,
+                      size_t maxValue )
+{
+    int result = 0;
+    char * pEnd = NULL;
+    unsigned long value = 0UL;
+
+    *pCount = 0U;
+
+    while( ( result == 0 ) && ( *pValue != '\0' ) )
+    {
+        value = strtoul( pValue, &pEnd, 10 );
+
+        if( ( pEnd == pValue ) || ( value == 0UL ) || ( value > maxValue ) ||
+            ( *pCount == BENCHMARK_MAX_LIST_LENGTH ) )
+        {
+            result = -1;
+        }
+        else
+        {
+            pList[ *pCount ] = ( size_t ) value;
+            ( *pCount )++;
+            pValue = ( *pEnd == ',' ) ? ( pEnd + 1 ) : pEnd;
+        }
+    }
+
+    if( *pCount == 0U )
+    {
+        result = -1;
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print the command line usage.
+ */
+static void printUsage( const char * pProgram )
+{
+    ( void ) printf( "Usage: %s [options]\n"
+                     "  --payload-sizes=N[,N...]  PUBLISH payload sizes in bytes (default 16,256,4096).\n"
+                     "  --inflight=N[,N...]       In-flight QoS 1 publishes for update_state_ack\n"
+                     "                            (default 10,100,1000).\n",
+                     pProgram );
+    ( void ) printf( "  --spare-records=P         State records beyond the in-flight count, in percent\n"
+                     "                            of it (default 100). At 0 every acknowledgement\n"
+                     "                            leaves the only free record in the middle. Indexed\n"
+                     "                            runs use at least the third the index keeps free.\n" );
+    ( void ) printf( "  --iterations=N            Fixed iterations per repetition instead of calibrating.\n"
+                     "  --min-time-ms=N           Minimum duration of a repetition (default %u).\n"
+                     "  --filter=NAME             Run only benchmarks whose name contains NAME.\n"
+                     "  --json                    Print one JSON object per result.\n",
+                     BENCHMARK_DEFAULT_MIN_TIME_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int result = EXIT_SUCCESS;
+    int i = 0;
+    size_t j = 0U;
+    const char * pArg = NULL;
+
+    options.payloadSizes[ 0 ] = 16U;
+    options.payloadSizes[ 1 ] = 256U;
+    options.payloadSizes[ 2 ] = 4096U;
+    options.payloadSizeCount = 3U;
+    options.inFlightCounts[ 0 ] = 10U;
+    options.inFlightCounts[ 1 ] = 100U;
+    options.inFlightCounts[ 2 ] = 1000U;
+    options.inFlightCountCount = 3U;
+    options.spareRecordsPercent = 100U;
+    options.minTimeMs = BENCHMARK_DEFAULT_MIN_TIME_MS;
+
+    for( i = 1; ( result == EXIT_SUCCESS ) && ( i < argc ); i++ )
+    {
+        pArg = argv[ i ];
+
+        if( strncmp( pArg, "--payload-sizes=", 16 ) == 0 )
+        {
+            result = ( parseList( &pArg[ 16 ], options.payloadSizes, &options.payloadSizeCount,
+                                  BENCHMARK_MAX_PAYLOAD_SIZE ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--inflight=", 11 ) == 0 )
+        {
+            /* Half of the packet IDs stay free, so replacements are found quickly. */
+            result = ( parseList( &pArg[ 11 ], options.inFlightCounts, &options.inFlightCountCount,
+                                  UINT16_MAX / 2U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--spare-records=", 16 ) == 0 )
+        {
+            options.spareRecordsPercent = ( size_t ) strtoul( &pArg[ 16 ], NULL, 10 );
+        }
+        else if( strncmp( pArg, "--iterations=", 13 ) == 0 )
+        {
+            options.iterations = ( size_t ) strtoul( &pArg[ 13 ], NULL, 10 );
+        }
+        else if( strncmp( pArg, "--min-time-ms=", 14 ) == 0 )
+        {
+            options.minTimeMs = strtoul( &pArg[ 14 ], NULL, 10 );
+        }
+        else if( strncmp( pArg, "--filter=", 9 ) == 0 )
+        {
+            options.pFilter = &pArg[ 9 ];
+        }
+        else if( strcmp( pArg, "--json" ) == 0 )
+        {
+            options.json = 1;
+        }
+        else
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    if( result != EXIT_SUCCESS )
+    {
+        printUsage( argv[ 0 ] );
+    }
+    else
+    {
+        if( options.json == 0 )
+        {
+            ( void ) printf( "%-20s %-36s %10s %10s %10s\n", "benchmark", "parameters", "iterations", "ns/op", "bytes/op" );
+        }
+
+        runSerializerBenchmarks();
+        runVbiBenchmarks();
+
+        if( isSelected( "update_state_ack" ) != 0 )
+        {
+            for( j = 0U; j < options.inFlightCountCount; j++ )
+            {
+                runStateBenchmark( options.inFlightCounts[ j ], 0 );
+                runStateBenchmark( options.inFlightCounts[ j ], 1 );
+            }
+        }
+
+        if( isSelected( "match_topic" ) != 0 )
+        {
+            runMatchBenchmarks();
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,1094 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_loopback_harness.c
+ * @brief End to end throughput harness running a full MQTT context against a
+ * scripted broker over an in-memory transport.
+ *
+ * The client connects, publishes a fixed number of messages at each selected
+ * QoS while keeping a window of publishes in flight, and processes the
+ * acknowledgements with #MQTT_ProcessLoop or #MQTT_ProcessLoopBatch. Publishes
+ * can also be submitted through a publish queue and sent with
+ * #MQTT_DrainPublishQueues, sent in bursts with #MQTT_PublishMany, or sent with
+ * #MQTT_PublishPrepared. The broker
+ * runs inside the transport functions: it answers CONNECT, PUBLISH, PUBREL and
+ * PINGREQ packets as soon as the client sends them, and can publish to the
+ * client at a set rate.
+ *
+ * For each QoS the harness reports messages per second, the median and 99th
+ * percentile time from #MQTT_Publish to the PUBACK or PUBCOMP callback, and the
+ * transport calls made per message. Every transport call stands for one
+ * system call of a socket based transport. Run with --help for the options.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_mqtt.h"
+
+/**
+ * @brief Size of each direction of the in-memory pipe.
+ */
+#define HARNESS_PIPE_SIZE                ( 1024U * 1024U )
+
+/**
+ * @brief Largest payload size accepted on the command line.
+ */
+#define HARNESS_MAX_PAYLOAD_SIZE         ( 256U * 1024U )
+
+/**
+ * @brief Bytes of the network buffer beyond the payload size, for the topic
+ * name and packet headers.
+ */
+#define HARNESS_BUFFER_OVERHEAD          ( 1024U )
+
+/**
+ * @brief Number of incoming QoS 1 and 2 publish records of the client. The
+ * broker keeps at most this many of its publishes unacknowledged.
+ */
+#define HARNESS_INCOMING_RECORDS         ( 32U )
+
+/**
+ * @brief Time without any acknowledgement after which a run is stopped.
+ */
+#define HARNESS_STALL_TIMEOUT_NS         ( 1e9 )
+
+/**
+ * @brief Topic name of the client publishes.
+ */
+#define HARNESS_UPLINK_TOPIC             "fleet/site-000123/device-abcdef0123/telemetry"
+
+/**
+ * @brief Topic name of the broker publishes.
+ */
+#define HARNESS_DOWNLINK_TOPIC           "fleet/site-000123/device-abcdef0123/commands"
+
+/**
+ * @brief Payload size of the broker publishes.
+ */
+#define HARNESS_DOWNLINK_PAYLOAD_SIZE    ( 64U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief One direction of the in-memory pipe.
+ */
+typedef struct HarnessPipe
+{
+    uint8_t * pBuffer; /**< @brief Queued bytes. */
+    size_t size;       /**< @brief Size of pBuffer. */
+    size_t head;       /**< @brief Offset of the first queued byte. */
+    size_t tail;       /**< @brief Offset after the last queued byte. */
+} HarnessPipe_t;
+
+/**
+ * @brief The connection between the client and the scripted broker.
+ */
+struct NetworkContext
+{
+    HarnessPipe_t toBroker;          /**< @brief Bytes sent by the client, not yet handled by the broker. */
+    HarnessPipe_t toClient;          /**< @brief Bytes sent by the broker, not yet received by the client. */
+    double rateStartNs;              /**< @brief Time the broker started publishing. */
+    unsigned long publishRate;       /**< @brief Broker publishes per second, or 0 for none. */
+    MQTTQoS_t publishQos;            /**< @brief QoS of the broker publishes. */
+    size_t publishesSent;            /**< @brief Publishes sent by the broker. */
+    size_t publishesOutstanding;     /**< @brief Broker publishes the client has not acknowledged yet. */
+    uint16_t nextPacketId;           /**< @brief Packet ID of the next broker publish. */
+    int connected;                   /**< @brief Whether the broker sent a CONNACK. */
+    unsigned long sendCalls;         /**< @brief Calls of the send function. */
+    unsigned long writevCalls;       /**< @brief Calls of the writev function. */
+    unsigned long recvCalls;         /**< @brief Calls of the receive function. */
+    unsigned long emptyRecvCalls;    /**< @brief Calls of the receive function that returned no data. */
+};
+
+/**
+ * @brief Command line options.
+ */
+typedef struct HarnessOptions
+{
+    int qosSelected[ 3 ];      /**< @brief Whether each QoS is run. */
+    size_t messages;           /**< @brief Publishes per run. */
+    size_t payloadSize;        /**< @brief Payload size of the client publishes. */
+    size_t window;             /**< @brief Maximum client publishes in flight. */
+    unsigned long brokerRate;  /**< @brief Broker publishes per second. */
+    MQTTQoS_t brokerQos;       /**< @brief QoS of the broker publishes. */
+    size_t batch;              /**< @brief Packets per #MQTT_ProcessLoopBatch call, or 0 for #MQTT_ProcessLoop. */
+    size_t queueSize;          /**< @brief Entries of the publish queue, or 0 to call #MQTT_Publish. */
+    int publishMany;           /**< @brief Whether each burst is sent with #MQTT_PublishMany. */
+    int prepared;              /**< @brief Whether publishes are sent with #MQTT_PublishPrepared. */
+    int useWritev;             /**< @brief Whether the transport provides writev. */
+    int json;                  /**< @brief Print JSON lines instead of a table. */
+} HarnessOptions_t;
+
+/**
+ * @brief Acknowledgement tracking of a run, updated by the event callback.
+ */
+typedef struct HarnessRun
+{
+    double * pSendTimes;     /**< @brief Send time of each in-flight packet ID. */
+    double * pLatencies;     /**< @brief Acknowledgement latency of each publish. */
+    size_t latencyCount;     /**< @brief Number of entries in pLatencies. */
+    size_t inFlight;         /**< @brief Client publishes not acknowledged yet. */
+    size_t received;         /**< @brief Broker publishes received. */
+    double lastProgressNs;   /**< @brief Time of the last acknowledgement. */
+} HarnessRun_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Options in effect.
+ */
+static HarnessOptions_t options;
+
+/**
+ * @brief The run in progress.
+ */
+static HarnessRun_t run;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+static double nowNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( double ) now.tv_sec * 1e9 ) + ( double ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time source for the MQTT context.
+ */
+static uint32_t getTimeMs( void )
+{
+    return ( uint32_t ) ( nowNs() / 1e6 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Stop the harness with an error message.
+ */
+static void fail( const char * pMessage,
+                  MQTTStatus_t status )
+{
+    ( void ) fprintf( stderr, "%s: %s\n", pMessage, MQTT_Status_strerror( status ) );
+    exit( EXIT_FAILURE );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append bytes to a pipe, moving the queued bytes to the front of the
+ * buffer if needed.
+ */
+static void pipeWrite( HarnessPipe_t * pPipe,
+                       const void * pData,
+                       size_t length )
+{
+    if( length > ( pPipe->size - pPipe->tail ) )
+    {
+        ( void ) memmove( pPipe->pBuffer, &pPipe->pBuffer[ pPipe->head ], pPipe->tail - pPipe->head );
+        pPipe->tail -= pPipe->head;
+        pPipe->head = 0U;
+    }
+
+    if( length > ( pPipe->size - pPipe->tail ) )
+    {
+        fail( "In-memory pipe is full", MQTTNoMemory );
+    }
+
+    ( void ) memcpy( &pPipe->pBuffer[ pPipe->tail ], pData, length );
+    pPipe->tail += length;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send a four byte acknowledgement from the broker.
+ */
+static void brokerSendAck( NetworkContext_t * pConnection,
+                           uint8_t packetType,
+                           uint16_t packetId )
+{
+    uint8_t ack[ 4 ];
+
+    ack[ 0 ] = packetType;
+    ack[ 1 ] = 2U;
+    ack[ 2 ] = ( uint8_t ) ( packetId >> 8 );
+    ack[ 3 ] = ( uint8_t ) ( packetId & 0xFFU );
+
+    pipeWrite( &pConnection->toClient, ack, sizeof( ack ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send the publishes the broker is due to send at the configured rate.
+ *
+ * A QoS 1 or 2 publish is only sent while fewer than
+ * #HARNESS_INCOMING_RECORDS earlier ones are unacknowledged, so the client
+ * never runs out of incoming publish records.
+ */
+static void brokerPublish( NetworkContext_t * pConnection )
+{
+    static const uint8_t payload[ HARNESS_DOWNLINK_PAYLOAD_SIZE ] = { 0 };
+    uint8_t header[ 16 ];
+    size_t headerLength = 0U;
+    size_t topicLength = sizeof( HARNESS_DOWNLINK_TOPIC ) - 1U;
+    size_t remainingLength = 0U;
+    size_t due = 0U;
+
+    if( ( pConnection->connected != 0 ) && ( pConnection->publishRate != 0UL ) )
+    {
+        due = ( size_t ) ( ( ( nowNs() - pConnection->rateStartNs ) / 1e9 ) * ( double ) pConnection->publishRate );
+    }
+
+    while( ( pConnection->publishesSent < due ) &&
+           ( ( pConnection->publishQos == MQTTQoS0 ) ||
+             ( pConnection->publishesOutstanding < HARNESS_INCOMING_RECORDS ) ) )
+    {
+        remainingLength = 2U + topicLength + sizeof( payload );
+
+        if( pConnection->publishQos != MQTTQoS0 )
+        {
+            remainingLength += 2U;
+        }
+
+        #if MQTT_VERSION == MQTT_VERSION_5_0
+            /* Empty property list. */
+            remainingLength += 1U;
+        #endif
+
+        headerLength = 0U;
+        header[ headerLength++ ] = ( uint8_t ) ( MQTT_PACKET_TYPE_PUBLISH | ( ( uint8_t ) pConnection->publishQos << 1 ) );
+
+        do
+        {
+            header[ headerLength ] = ( uint8_t ) ( remainingLength & 0x7FU );
+            remainingLength >>= 7;
+
+            if( remainingLength != 0U )
+            {
+                header[ headerLength ] |= 0x80U;
+            }
+
+            headerLength++;
+        } while( remainingLength != 0U );
+
+        header[ headerLength++ ] = ( uint8_t ) ( topicLength >> 8 );
+        header[ headerLength++ ] = ( uint8_t ) ( topicLength & 0xFFU );
+        pipeWrite( &pConnection->toClient, header, headerLength );
+        pipeWrite( &pConnection->toClient, HARNESS_DOWNLINK_TOPIC, topicLength );
+
+        headerLength = 0U;
+
+        if( pConnection->publishQos != MQTTQoS0 )
+        {
+            header[ headerLength++ ] = ( uint8_t ) ( pConnection->nextPacketId >> 8 );
+            header[ headerLength++ ] = ( uint8_t ) ( pConnection->nextPacketId & 0xFFU );
+            pConnection->nextPacketId = ( pConnection->nextPacketId == UINT16_MAX ) ? 1U : ( uint16_t ) ( pConnection->nextPacketId + 1U );
+            pConnection->publishesOutstanding++;
+        }
+
+        #if MQTT_VERSION == MQTT_VERSION_5_0
+            header[ headerLength++ ] = 0U;
+        #endif
+
+        pipeWrite( &pConnection->toClient, header, headerLength );
+        pipeWrite( &pConnection->toClient, payload, sizeof( payload ) );
+        pConnection->publishesSent++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Answer one complete packet sent by the client.
+ */
+static void brokerHandlePacket( NetworkContext_t * pConnection,
+                                uint8_t packetType,
+                                const uint8_t * pRemaining,
+                                size_t remainingLength )
+{
+    uint16_t packetId = 0U;
+    uint16_t topicLength = 0U;
+    uint8_t qos = 0U;
+
+    #if MQTT_VERSION == MQTT_VERSION_5_0
+        static const uint8_t connack[] = { MQTT_PACKET_TYPE_CONNACK, 3U, 0U, 0U, 0U };
+    #else
+        static const uint8_t connack[] = { MQTT_PACKET_TYPE_CONNACK, 2U, 0U, 0U };
+    #endif
+    static const uint8_t pingresp[] = { MQTT_PACKET_TYPE_PINGRESP, 0U };
+
+    if( ( remainingLength >= 2U ) && ( ( packetType & 0xF0U ) != MQTT_PACKET_TYPE_PUBLISH ) )
+    {
+        packetId = ( uint16_t ) ( ( ( uint16_t ) pRemaining[ 0 ] << 8 ) | pRemaining[ 1 ] );
+    }
+
+    switch( packetType & 0xF0U )
+    {
+        case MQTT_PACKET_TYPE_CONNECT:
+            pipeWrite( &pConnection->toClient, connack, sizeof( connack ) );
+            pConnection->connected = 1;
+            pConnection->rateStartNs = nowNs();
+            break;
+
+        case MQTT_PACKET_TYPE_PUBLISH:
+            qos = ( uint8_t ) ( ( packetType >> 1 ) & 0x03U );
+
+            if( qos != 0U )
+            {
+                topicLength = ( uint16_t ) ( ( ( uint16_t ) pRemaining[ 0 ] << 8 ) | pRemaining[ 1 ] );
+                packetId = ( uint16_t ) ( ( ( uint16_t ) pRemaining[ 2U + topicLength ] << 8 ) |
+                                          pRemaining[ 3U + topicLength ] );
+                brokerSendAck( pConnection,
+                               ( qos == 1U ) ? MQTT_PACKET_TYPE_PUBACK : MQTT_PACKET_TYPE_PUBREC,
+                               packetId );
+            }
+
+            break;
+
+        case ( MQTT_PACKET_TYPE_PUBREL & 0xF0U ):
+            brokerSendAck( pConnection, MQTT_PACKET_TYPE_PUBCOMP, packetId );
+            break;
+
+        case MQTT_PACKET_TYPE_PUBREC:
+            brokerSendAck( pConnection, MQTT_PACKET_TYPE_PUBREL, packetId );
+            break;
+
+        case MQTT_PACKET_TYPE_PUBACK:
+        case MQTT_PACKET_TYPE_PUBCOMP:
+            pConnection->publishesOutstanding--;
+            break;
+
+        case MQTT_PACKET_TYPE_PINGREQ:
+            pipeWrite( &pConnection->toClient, pingresp, sizeof( pingresp ) );
+            break;
+
+        case MQTT_PACKET_TYPE_DISCONNECT:
+            pConnection->connected = 0;
+            break;
+
+        default:
+            fail( "Broker received an unexpected packet", MQTTBadResponse );
+            break;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Answer every complete packet the client has sent so far.
+ */
+static void brokerProcess( NetworkContext_t * pConnection )
+{
+    HarnessPipe_t * pPipe = &pConnection->toBroker;
+    size_t available = 0U;
+    size_t remainingLength = 0U;
+    size_t headerLength = 0U;
+    size_t shift = 0U;
+    int complete = 1;
+
+    while( complete != 0 )
+    {
+        available = pPipe->tail - pPipe->head;
+        remainingLength = 0U;
+        shift = 0U;
+        headerLength = 1U;
+        complete = 0;
+
+        /* Decode the remaining length, if it was received in full. */
+        while( headerLength < available )
+        {
+            remainingLength |= ( ( size_t ) pPipe->pBuffer[ pPipe->head + headerLength ] & 0x7FU ) << shift;
+            shift += 7U;
+            headerLength++;
+
+            if( ( pPipe->pBuffer[ pPipe->head + headerLength - 1U ] & 0x80U ) == 0U )
+            {
+                complete = ( ( headerLength + remainingLength ) <= available ) ? 1 : 0;
+                break;
+            }
+        }
+
+        if( complete != 0 )
+        {
+            brokerHandlePacket( pConnection,
+                                pPipe->pBuffer[ pPipe->head ],
+                                &pPipe->pBuffer[ pPipe->head + headerLength ],
+                                remainingLength );
+            pPipe->head += headerLength + remainingLength;
+        }
+    }
+
+    if( pPipe->head == pPipe->tail )
+    {
+        pPipe->head = 0U;
+        pPipe->tail = 0U;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Transport send function. The broker answers right away.
+ */
+static int32_t harnessSend( NetworkContext_t * pNetworkContext,
+                            const void * pBuffer,
+                            size_t bytesToSend )
+{
+    pNetworkContext->sendCalls++;
+    pipeWrite( &pNetworkContext->toBroker, pBuffer, bytesToSend );
+    brokerProcess( pNetworkContext );
+
+    return ( int32_t ) bytesToSend;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Transport writev function. The broker answers right away.
+ */
+static int32_t harnessWritev( NetworkContext_t * pNetworkContext,
+                              TransportOutVector_t * pIoVec,
+                              size_t ioVecCount )
+{
+    size_t bytesSent = 0U;
+    size_t i = 0U;
+
+    pNetworkContext->writevCalls++;
+
+    for( i = 0U; i < ioVecCount; i++ )
+    {
+        pipeWrite( &pNetworkContext->toBroker, pIoVec[ i ].iov_base, pIoVec[ i ].iov_len );
+        bytesSent += pIoVec[ i ].iov_len;
+    }
+
+    brokerProcess( pNetworkContext );
+
+    return ( int32_t ) bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Transport receive function. The broker first sends the publishes it
+ * is due to send.
+ */
+static int32_t harnessRecv( NetworkContext_t * pNetworkContext,
+                            void * pBuffer,
+                            size_t bytesToRecv )
+{
+    HarnessPipe_t * pPipe = &pNetworkContext->toClient;
+    size_t available = 0U;
+    size_t bytesReceived = 0U;
+
+    pNetworkContext->recvCalls++;
+    brokerPublish( pNetworkContext );
+
+    available = pPipe->tail - pPipe->head;
+    bytesReceived = ( bytesToRecv < available ) ? bytesToRecv : available;
+
+    if( bytesReceived == 0U )
+    {
+        pNetworkContext->emptyRecvCalls++;
+    }
+
+    ( void ) memcpy( pBuffer, &pPipe->pBuffer[ pPipe->head ], bytesReceived );
+    pPipe->head += bytesReceived;
+
+    if( pPipe->head == pPipe->tail )
+    {
+        pPipe->head = 0U;
+        pPipe->tail = 0U;
+    }
+
+    return ( int32_t ) bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event callback. Records the latency of each acknowledged publish and
+ * counts the broker publishes.
+ */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    uint16_t packetId = pDeserializedInfo->packetIdentifier;
+
+    ( void ) pContext;
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        run.received++;
+    }
+    else if( ( pPacketInfo->type == MQTT_PACKET_TYPE_PUBACK ) ||
+             ( pPacketInfo->type == MQTT_PACKET_TYPE_PUBCOMP ) )
+    {
+        if( run.pSendTimes[ packetId ] != 0.0 )
+        {
+            run.lastProgressNs = nowNs();
+            run.pLatencies[ run.latencyCount ] = run.lastProgressNs - run.pSendTimes[ packetId ];
+            run.latencyCount++;
+            run.pSendTimes[ packetId ] = 0.0;
+            run.inFlight--;
+        }
+    }
+    else
+    {
+        /* PUBREC and PUBREL need no handling. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Comparison function to sort latencies.
+ */
+static int compareDoubles( const void * pLeft,
+                           const void * pRight )
+{
+    double left = *( const double * ) pLeft;
+    double right = *( const double * ) pRight;
+
+    return ( left < right ) ? -1 : ( ( left > right ) ? 1 : 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Latency percentile in microseconds, from sorted latencies.
+ */
+static double percentileUs( size_t percent )
+{
+    double result = 0.0;
+
+    if( run.latencyCount > 0U )
+    {
+        result = run.pLatencies[ ( ( run.latencyCount - 1U ) * percent ) / 100U ] / 1e3;
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print the result of one run.
+ */
+static void reportResult( MQTTQoS_t qos,
+                          double elapsedNs,
+                          const NetworkContext_t * pConnection )
+{
+    double messages = ( double ) options.messages;
+    double messagesPerSec = messages / ( elapsedNs / 1e9 );
+    double sendsPerMessage = ( double ) ( pConnection->sendCalls + pConnection->writevCalls ) / messages;
+    double recvsPerMessage = ( double ) pConnection->recvCalls / messages;
+    double p50 = percentileUs( 50U );
+    double p99 = percentileUs( 99U );
+
+    if( options.json != 0 )
+    {
+        ( void ) printf( "{\"harness\":\"loopback\",\"mqtt_version\":%d,\"qos\":%d,\"messages\":%lu,"
+                         "\"payload\":%lu,\"window\":%lu,\"batch\":%lu,\"queue\":%lu,\"many\":%s,\"prepared\":%s,\"writev\":%s,",
+                         ( int ) MQTT_VERSION,
+                         ( int ) qos,
+                         ( unsigned long ) options.messages,
+                         ( unsigned long ) options.payloadSize,
+                         ( unsigned long ) options.window,
+                         ( unsigned long ) options.batch,
+                         ( unsigned long ) options.queueSize,
+                         ( options.publishMany != 0 ) ? "true" : "false",
+                         ( options.prepared != 0 ) ? "true" : "false",
+                         ( options.useWritev != 0 ) ? "true" : "false" );
+        ( void ) printf( "\"msgs_per_sec\":%.0f,\"ack_p50_us\":%.3f,\"ack_p99_us\":%.3f,"
+                         "\"sends_per_msg\":%.3f,\"recvs_per_msg\":%.3f,\"empty_recvs_per_msg\":%.3f,"
+                         "\"syscalls_per_msg\":%.3f,\"broker_publishes\":%lu}\n",
+                         messagesPerSec,
+                         p50,
+                         p99,
+                         sendsPerMessage,
+                         recvsPerMessage,
+                         ( double ) pConnection->emptyRecvCalls / messages,
+                         sendsPerMessage + recvsPerMessage,
+                         ( unsigned long ) run.received );
+    }
+    else
+    {
+        ( void ) printf( "%-4d %10lu %12.0f %10.3f %10.3f %10.3f %10.3f %10.3f %10lu\n",
+                         ( int ) qos,
+                         ( unsigned long ) options.messages,
+                         messagesPerSec,
+                         p50,
+                         p99,
+                         sendsPerMessage,
+                         recvsPerMessage,
+                         sendsPerMessage + recvsPerMessage,
+                         ( unsigned long ) run.received );
+    }
+
+    ( void ) fflush( stdout );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect, publish the configured number of messages at one QoS,
+ * wait for every acknowledgement and disconnect.
+ */
+static void runHarness( MQTTQoS_t qos )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    NetworkContext_t connection;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPubAckInfo_t * pOutgoingRecords = NULL;
+    MQTTPubAckInfo_t incomingRecords[ HARNESS_INCOMING_RECORDS ];
+    MQTTConnectInfo_t connectInfo;
+    MQTTPublishInfo_t publishInfo;
+    MQTTPreparedPublish_t preparedPublish;
+    MQTTPublishQueue_t queue;
+    MQTTPublishQueueEntry_t * pQueueEntries = NULL;
+    MQTTPublishInfo_t * pBurstInfo = NULL;
+    uint16_t * pBurstIds = NULL;
+    uint8_t * pPayload = NULL;
+    bool sessionPresent = false;
+    size_t sent = 0U;
+    size_t burst = 0U;
+    size_t burstLimit = options.window;
+    size_t processed = 0U;
+    uint16_t packetId = 0U;
+    double start = 0.0;
+    double elapsed = 0.0;
+    MQTTStatus_t status;
+
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &connection, 0x00, sizeof( connection ) );
+    ( void ) memset( incomingRecords, 0x00, sizeof( incomingRecords ) );
+    ( void ) memset( &connectInfo, 0x00, sizeof( connectInfo ) );
+    ( void ) memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    ( void ) memset( &run, 0x00, sizeof( run ) );
+
+    connection.toBroker.size = HARNESS_PIPE_SIZE;
+    connection.toBroker.pBuffer = malloc( HARNESS_PIPE_SIZE );
+    connection.toClient.size = HARNESS_PIPE_SIZE;
+    connection.toClient.pBuffer = malloc( HARNESS_PIPE_SIZE );
+    connection.publishRate = options.brokerRate;
+    connection.publishQos = options.brokerQos;
+    connection.nextPacketId = 1U;
+
+    networkBuffer.size = options.payloadSize + HARNESS_BUFFER_OVERHEAD;
+    networkBuffer.pBuffer = malloc( networkBuffer.size );
+    pOutgoingRecords = calloc( options.window, sizeof( MQTTPubAckInfo_t ) );
+    pPayload = calloc( options.payloadSize + 1U, 1U );
+    run.pSendTimes = calloc( ( size_t ) UINT16_MAX + 1U, sizeof( double ) );
+    run.pLatencies = calloc( options.messages, sizeof( double ) );
+    pQueueEntries = calloc( options.queueSize + 1U, sizeof( MQTTPublishQueueEntry_t ) );
+    pBurstInfo = calloc( options.window, sizeof( MQTTPublishInfo_t ) );
+    pBurstIds = calloc( options.window, sizeof( uint16_t ) );
+
+    if( ( connection.toBroker.pBuffer == NULL ) || ( connection.toClient.pBuffer == NULL ) ||
+        ( networkBuffer.pBuffer == NULL ) || ( pOutgoingRecords == NULL ) ||
+        ( pPayload == NULL ) || ( run.pSendTimes == NULL ) || ( run.pLatencies == NULL ) ||
+        ( pQueueEntries == NULL ) || ( pBurstInfo == NULL ) || ( pBurstIds == NULL ) )
+    {
+        fail( "Out of memory", MQTTNoMemory );
+    }
+
+    transport.recv = harnessRecv;
+    transport.send = harnessSend;
+    transport.writev = ( options.useWritev != 0 ) ? harnessWritev : NULL;
+    transport.pNetworkContext = &connection;
+
+    status = MQTT_Init( &context, &transport, getTimeMs, eventCallback, &networkBuffer );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_InitStatefulQoS( &context,
+                                       pOutgoingRecords,
+                                       options.window,
+                                       incomingRecords,
+                                       HARNESS_INCOMING_RECORDS );
+    }
+
+    if( ( status == MQTTSuccess ) && ( options.queueSize > 0U ) )
+    {
+        status = MQTT_InitPublishQueue( &queue, pQueueEntries, options.queueSize );
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_AttachPublishQueue( &context, &queue );
+        }
+
+        /* A burst must fit in the queue. */
+        if( options.queueSize < burstLimit )
+        {
+            burstLimit = options.queueSize;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        connectInfo.cleanSession = true;
+        connectInfo.pClientIdentifier = "loopback-harness";
+        connectInfo.clientIdentifierLength = ( uint16_t ) strlen( connectInfo.pClientIdentifier );
+        connectInfo.keepAliveSeconds = 60U;
+        status = MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent );
+    }
+
+    if( status != MQTTSuccess )
+    {
+        fail( "Connect failed", status );
+    }
+
+    publishInfo.qos = qos;
+    publishInfo.pTopicName = HARNESS_UPLINK_TOPIC;
+    publishInfo.topicNameLength = ( uint16_t ) strlen( HARNESS_UPLINK_TOPIC );
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = options.payloadSize;
+
+    status = MQTT_PreparePublish( &context, &publishInfo, &preparedPublish );
+
+    if( status != MQTTSuccess )
+    {
+        fail( "Preparing the publish failed", status );
+    }
+
+    /* Count only the transport calls of the timed part. */
+    connection.sendCalls = 0UL;
+    connection.writevCalls = 0UL;
+    connection.recvCalls = 0UL;
+    connection.emptyRecvCalls = 0UL;
+
+    start = nowNs();
+    run.lastProgressNs = start;
+
+    while( ( sent < options.messages ) || ( run.inFlight > 0U ) )
+    {
+        /* QoS 0 publishes are also sent in bursts of at most a window, so that
+         * the broker publishes are received in between. */
+        for( burst = 0U;
+             ( burst < burstLimit ) && ( sent < options.messages ) && ( run.inFlight < options.window );
+             burst++ )
+        {
+            packetId = 0U;
+
+            if( qos != MQTTQoS0 )
+            {
+                packetId = MQTT_GetPacketId( &context );
+                run.pSendTimes[ packetId ] = nowNs();
+                run.inFlight++;
+            }
+
+            if( options.publishMany != 0 )
+            {
+                pBurstInfo[ burst ] = publishInfo;
+                pBurstIds[ burst ] = packetId;
+            }
+            else if( options.queueSize > 0U )
+            {
+                status = MQTT_EnqueuePublish( &queue, &publishInfo, packetId );
+            }
+            else if( options.prepared != 0 )
+            {
+                status = MQTT_PublishPrepared( &context, &preparedPublish, pPayload, options.payloadSize, packetId );
+            }
+            else
+            {
+                status = MQTT_Publish( &context, &publishInfo, packetId );
+            }
+
+            if( status != MQTTSuccess )
+            {
+                fail( "Publish failed", status );
+            }
+
+            sent++;
+        }
+
+        if( ( options.publishMany != 0 ) && ( burst > 0U ) )
+        {
+            status = MQTT_PublishMany( &context, pBurstInfo, burst, pBurstIds, NULL );
+
+            if( status != MQTTSuccess )
+            {
+                fail( "Publish failed", status );
+            }
+        }
+
+        if( options.queueSize > 0U )
+        {
+            status = MQTT_DrainPublishQueues( &context, NULL );
+
+            if( status != MQTTSuccess )
+            {
+                fail( "Draining the publish queue failed", status );
+            }
+        }
+
+        if( options.batch == 0U )
+        {
+            status = MQTT_ProcessLoop( &context );
+        }
+        else
+        {
+            status = MQTT_ProcessLoopBatch( &context, options.batch, &processed );
+        }
+
+        if( ( status != MQTTSuccess ) && ( status != MQTTNeedMoreBytes ) )
+        {
+            fail( "Processing failed", status );
+        }
+
+        if( ( run.inFlight > 0U ) && ( ( nowNs() - run.lastProgressNs ) > HARNESS_STALL_TIMEOUT_NS ) )
+        {
+            fail( "No acknowledgement received", MQTTKeepAliveTimeout );
+        }
+    }
+
+    elapsed = nowNs() - start;
+
+    qsort( run.pLatencies, run.latencyCount, sizeof( double ), compareDoubles );
+    reportResult( qos, elapsed, &connection );
+
+    status = MQTT_Disconnect( &context );
+
+    if( status != MQTTSuccess )
+    {
+        fail( "Disconnect failed", status );
+    }
+
+    free( pQueueEntries );
+    free( pBurstInfo );
+    free( pBurstIds );
+    free( run.pLatencies );
+    free( run.pSendTimes );
+    free( pPayload );
+    free( pOutgoingRecords );
+    free( networkBuffer.pBuffer );
+    free( connection.toClient.pBuffer );
+    free( connection.toBroker.pBuffer );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse a positive number option.
+ *
+ * @return 0 on success, -1 if the value is invalid.
+ */
+static int parseNumber( const char * pValue,
+                        size_t * pNumber,
+                        size_t minValue,
+                        size_t maxValue )
+{
+    char * pEnd = NULL;
+    unsigned long value = strtoul( pValue, &pEnd, 10 );
+    int result = -1;
+
+    if( ( pEnd != pValue ) && ( *pEnd == '\0' ) && ( value >= minValue ) && ( value <= maxValue ) )
+    {
+        *pNumber = ( size_t ) value;
+        result = 0;
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse the comma separated list of QoS levels to run.
+ *
+ * @return 0 on success, -1 if the list is invalid.
+ */
+static int parseQosList( const char * pValue )
+{
+    int result = ( *pValue == '\0' ) ? -1 : 0;
+
+    options.qosSelected[ 0 ] = 0;
+    options.qosSelected[ 1 ] = 0;
+    options.qosSelected[ 2 ] = 0;
+
+    while( ( result == 0 ) && ( *pValue != '\0' ) )
+    {
+        if( ( pValue[ 0 ] >= '0' ) && ( pValue[ 0 ] <= '2' ) &&
+            ( ( pValue[ 1 ] == ',' ) || ( pValue[ 1 ] == '\0' ) ) )
+        {
+            options.qosSelected[ pValue[ 0 ] - '0' ] = 1;
+            pValue = ( pValue[ 1 ] == ',' ) ? &pValue[ 2 ] : &pValue[ 1 ];
+        }
+        else
+        {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print the command line usage.
+ */
+static void printUsage( const char * pProgram )
+{
+    ( void ) printf( "Usage: %s [options]\n"
+                     "  --qos=Q[,Q...]       QoS levels of the client publishes (default 0,1,2).\n"
+                     "  --messages=N         Publishes per QoS level (default 100000).\n"
+                     "  --payload=N          Payload size of the client publishes (default 256).\n",
+                     pProgram );
+    ( void ) printf( "  --window=N           Maximum QoS 1 and 2 publishes in flight, and publishes sent\n"
+                     "                       between two calls of the process loop (default 32).\n"
+                     "  --broker-rate=N      Publishes per second sent by the broker (default 0).\n"
+                     "  --broker-qos=Q       QoS of the broker publishes (default 1).\n"
+                     "  --batch=N            Use MQTT_ProcessLoopBatch with up to N packets per call\n"
+                     "                       instead of MQTT_ProcessLoop.\n" );
+    ( void ) printf( "  --queue=N            Submit publishes through a publish queue of N entries,\n"
+                     "                       a power of two, and send them with MQTT_DrainPublishQueues.\n"
+                     "  --many               Send each burst of publishes with MQTT_PublishMany.\n"
+                     "  --prepared           Send publishes with MQTT_PublishPrepared.\n" );
+    ( void ) printf( "  --writev             Provide a writev function in the transport interface.\n"
+                     "  --json               Print one JSON object per result.\n" );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int result = EXIT_SUCCESS;
+    int i = 0;
+    size_t value = 0U;
+    const char * pArg = NULL;
+
+    options.qosSelected[ 0 ] = 1;
+    options.qosSelected[ 1 ] = 1;
+    options.qosSelected[ 2 ] = 1;
+    options.messages = 100000U;
+    options.payloadSize = 256U;
+    options.window = 32U;
+    options.brokerQos = MQTTQoS1;
+
+    for( i = 1; ( result == EXIT_SUCCESS ) && ( i < argc ); i++ )
+    {
+        pArg = argv[ i ];
+
+        if( strncmp( pArg, "--qos=", 6 ) == 0 )
+        {
+            result = ( parseQosList( &pArg[ 6 ] ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--messages=", 11 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 11 ], &options.messages, 1U, 100000000U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--payload=", 10 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 10 ], &options.payloadSize, 0U, HARNESS_MAX_PAYLOAD_SIZE ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--window=", 9 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 9 ], &options.window, 1U, UINT16_MAX ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--broker-rate=", 14 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 14 ], &value, 0U, 100000000U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+            options.brokerRate = ( unsigned long ) value;
+        }
+        else if( strncmp( pArg, "--broker-qos=", 13 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 13 ], &value, 0U, 2U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+            options.brokerQos = ( MQTTQoS_t ) value;
+        }
+        else if( strncmp( pArg, "--batch=", 8 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 8 ], &options.batch, 1U, 1000000U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else if( strncmp( pArg, "--queue=", 8 ) == 0 )
+        {
+            result = ( parseNumber( &pArg[ 8 ], &options.queueSize, 1U, 65536U ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+            if( ( options.queueSize & ( options.queueSize - 1U ) ) != 0U )
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+        else if( strcmp( pArg, "--prepared" ) == 0 )
+        {
+            options.prepared = 1;
+        }
+        else if( strcmp( pArg, "--many" ) == 0 )
+        {
+            options.publishMany = 1;
+        }
+        else if( strcmp( pArg, "--writev" ) == 0 )
+        {
+            options.useWritev = 1;
+        }
+        else if( strcmp( pArg, "--json" ) == 0 )
+        {
+            options.json = 1;
+        }
+        else
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    if( result != EXIT_SUCCESS )
+    {
+        printUsage( argv[ 0 ] );
+    }
+    else
+    {
+        if( options.json == 0 )
+        {
+            ( void ) printf( "%-4s %10s %12s %10s %10s %10s %10s %10s %10s\n",
+                             "qos", "messages", "msgs/sec", "p50 us", "p99 us",
+                             "sends/msg", "recvs/msg", "calls/msg", "received" );
+        }
+
+        for( i = 0; i < 3; i++ )
+        {
+            if( options.qosSelected[ i ] != 0 )
+            {
+                runHarness( ( MQTTQoS_t ) i );
+            }
+        }
+    }
+
+    return result;
+}
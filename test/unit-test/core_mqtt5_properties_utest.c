@@ -0,0 +1,1013 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file core_mqtt5_properties_utest.c
+ * @brief Unit tests for functions in core_mqtt5_properties.h, built with
+ * MQTT_VERSION set to MQTT_VERSION_5_0.
+ */
+#include <string.h>
+#include "unity.h"
+
+#include "core_mqtt.h"
+#include "core_mqtt5_properties.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Number of properties that may appear once held by a view.
+ */
+#define VIEW_CAPACITY        ( 4U )
+
+/**
+ * @brief Number of repeated properties held by a view.
+ */
+#define REPEATED_CAPACITY    ( 4U )
+
+/**
+ * @brief Number of User Properties needing more than #MQTT5_PROPERTY_MAX_VECTORS
+ * vectors. Each one takes four: a key length, a key, a value length and a value.
+ */
+#define VECTOR_OVERFLOW_COUNT     ( ( MQTT5_PROPERTY_MAX_VECTORS / 4U ) + 1U )
+
+/**
+ * @brief Number of four byte integer properties needing more than
+ * #MQTT5_PROPERTY_SCRATCH_SIZE bytes of scratch. Each one takes five.
+ */
+#define SCRATCH_OVERFLOW_COUNT    ( ( MQTT5_PROPERTY_SCRATCH_SIZE / 5U ) + 1U )
+
+/**
+ * @brief A property block with a Content Type, a Topic Alias, a Subscription
+ * Identifier and two User Properties.
+ */
+static const uint8_t propertyBlock[] =
+{
+    24U,                                                   /* Properties length. */
+    0x03U, 0x00U, 0x02U, 'a', 'b',                         /* Content Type "ab". */
+    0x26U, 0x00U, 0x01U, 'k', 0x00U, 0x01U, 'v',           /* User Property k=v. */
+    0x23U, 0x00U, 0x05U,                                   /* Topic Alias 5. */
+    0x0BU, 0x07U,                                          /* Subscription Identifier 7. */
+    0x26U, 0x00U, 0x01U, 'x', 0x00U, 0x01U, 'y'            /* User Property x=y. */
+};
+
+/**
+ * @brief A network context capturing the bytes sent and replaying a CONNACK.
+ */
+struct NetworkContext
+{
+    uint8_t sent[ 256 ];      /**< @brief Bytes sent. */
+    size_t sentLength;        /**< @brief Number of bytes sent. */
+    const uint8_t * pConnack; /**< @brief The CONNACK to receive. */
+    size_t connackLength;     /**< @brief Number of bytes in @p pConnack. */
+    size_t receivedLength;    /**< @brief Number of bytes of the CONNACK received. */
+};
+
+/**
+ * @brief A CONNACK accepting the connection, without properties.
+ */
+static const uint8_t connack[] = { 0x20U, 0x03U, 0x00U, 0x00U, 0x00U };
+
+/**
+ * @brief A CONNACK accepting the connection with a Topic Alias Maximum of 2.
+ */
+static const uint8_t connackTopicAliases[] =
+{
+    0x20U, 0x06U, 0x00U, 0x00U,
+    0x03U,                     /* Properties length. */
+    0x22U, 0x00U, 0x02U        /* Topic Alias Maximum 2. */
+};
+
+static MQTTContext_t context;
+static TransportInterface_t transport;
+static NetworkContext_t networkContext;
+static MQTTFixedBuffer_t networkBuffer;
+static uint8_t buffer[ 128 ];
+static MQTT5PropertyView_t view;
+static MQTT5Property_t viewProperties[ VIEW_CAPACITY ];
+static MQTT5Property_t repeatedProperties[ REPEATED_CAPACITY ];
+
+/**
+ * @brief Time function for the context.
+ */
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+/**
+ * @brief Event callback for the context.
+ */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/**
+ * @brief Transport send capturing the bytes sent.
+ */
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( pNetworkContext->sent ), pNetworkContext->sentLength + bytesToSend );
+    ( void ) memcpy( &pNetworkContext->sent[ pNetworkContext->sentLength ], pBuffer, bytesToSend );
+    pNetworkContext->sentLength += bytesToSend;
+
+    return ( int32_t ) bytesToSend;
+}
+
+/**
+ * @brief Transport writev joining the vectors into the bytes sent.
+ */
+static int32_t transportWritev( NetworkContext_t * pNetworkContext,
+                                TransportOutVector_t * pIoVectorIterator,
+                                size_t vectorsToBeSent )
+{
+    int32_t bytesSent = 0;
+    size_t i;
+
+    for( i = 0U; i < vectorsToBeSent; i++ )
+    {
+        bytesSent += transportSend( pNetworkContext,
+                                    pIoVectorIterator[ i ].iov_base,
+                                    pIoVectorIterator[ i ].iov_len );
+    }
+
+    return bytesSent;
+}
+
+/**
+ * @brief Transport receive returning the bytes of the CONNACK of the network
+ * context.
+ */
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    size_t length = pNetworkContext->connackLength - pNetworkContext->receivedLength;
+
+    if( length > bytesToRecv )
+    {
+        length = bytesToRecv;
+    }
+
+    ( void ) memcpy( pBuffer, &pNetworkContext->pConnack[ pNetworkContext->receivedLength ], length );
+    pNetworkContext->receivedLength += length;
+
+    return ( int32_t ) length;
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+
+/* Called before each test method. */
+void setUp( void )
+{
+    memset( &context, 0x00, sizeof( context ) );
+    memset( &networkContext, 0x00, sizeof( networkContext ) );
+    networkContext.pConnack = connack;
+    networkContext.connackLength = sizeof( connack );
+
+    transport.pNetworkContext = &networkContext;
+    transport.send = transportSend;
+    transport.recv = transportRecv;
+    transport.writev = transportWritev;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTT5_InitPropertyView( &view,
+                                               viewProperties,
+                                               VIEW_CAPACITY,
+                                               repeatedProperties,
+                                               REPEATED_CAPACITY ) );
+}
+
+/* Called after each test method. */
+void tearDown( void )
+{
+}
+
+/* Called at the beginning of the whole suite. */
+void suiteSetUp()
+{
+}
+
+/* Called at the end of the whole suite. */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Check a User Property.
+ */
+static void expectUserProperty( const MQTT5Property_t * pProperty,
+                                const char * pKey,
+                                const char * pValue )
+{
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_USER_PROPERTY, pProperty->type );
+    TEST_ASSERT_EQUAL( strlen( pKey ), pProperty->value.userProperty.keyLength );
+    TEST_ASSERT_EQUAL_MEMORY( pKey, pProperty->value.userProperty.pKey, strlen( pKey ) );
+    TEST_ASSERT_EQUAL( strlen( pValue ), pProperty->value.userProperty.valueLength );
+    TEST_ASSERT_EQUAL_MEMORY( pValue, pProperty->value.userProperty.pValue, strlen( pValue ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that MQTT5_InitPropertyView rejects invalid parameters.
+ */
+void test_MQTT5_InitPropertyView_Invalid( void )
+{
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyView( NULL, viewProperties, VIEW_CAPACITY, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyView( &view, NULL, VIEW_CAPACITY, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyView( &view, viewProperties, 0U, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyView( &view, viewProperties, MQTT5_PROPERTY_INDEX_SIZE + 1U, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyView( &view, viewProperties, VIEW_CAPACITY, NULL, 1U ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_RequestProperty( NULL, MQTT5_PROPERTY_TOPIC_ALIAS ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_RequestProperty( &view, ( MQTT5PropertyType_t ) 0 ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_RequestProperty( &view, ( MQTT5PropertyType_t ) MQTT5_PROPERTY_INDEX_SIZE ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( NULL, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, NULL, sizeof( propertyBlock ) ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that properties that may appear once are found by identifier,
+ * and repeated ones are kept in wire order.
+ */
+void test_MQTT5_DecodePropertyView_Indexed( void )
+{
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( 2U, view.count );
+    TEST_ASSERT_EQUAL( 3U, view.repeatedCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_TOPIC_ALIAS, property.type );
+    TEST_ASSERT_EQUAL( 5U, property.value.twoByteInteger );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_CONTENT_TYPE, &property ) );
+    TEST_ASSERT_EQUAL( 2U, property.value.utf8String.length );
+    TEST_ASSERT_EQUAL_PTR( &propertyBlock[ 4 ], property.value.utf8String.pString );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_RESPONSE_TOPIC, &property ) );
+
+    /* User Properties may repeat, and are read from the repeated buffer. */
+    expectUserProperty( &view.pRepeated[ 0 ], "k", "v" );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER, view.pRepeated[ 1 ].type );
+    TEST_ASSERT_EQUAL( 7U, view.pRepeated[ 1 ].value.fourByteInteger );
+    expectUserProperty( &view.pRepeated[ 2 ], "x", "y" );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_USER_PROPERTY, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER, &property ) );
+
+    /* Unknown identifiers are not found. */
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( &view, ( MQTT5PropertyType_t ) 0, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( &view, ( MQTT5PropertyType_t ) MQTT5_PROPERTY_INDEX_SIZE, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_GetViewProperty( NULL, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+
+    /* Decoding again drops the previous properties. */
+    {
+        static const uint8_t otherBlock[] = { 3U, 0x21U, 0x00U, 0x0AU };
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, otherBlock, sizeof( otherBlock ) ) );
+        TEST_ASSERT_EQUAL( 1U, view.count );
+        TEST_ASSERT_EQUAL( 0U, view.repeatedCount );
+        TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_RECEIVE_MAXIMUM, &property ) );
+        TEST_ASSERT_EQUAL( 10U, property.value.twoByteInteger );
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a property that may appear once is rejected when it
+ * repeats, even if it was not requested, while User Properties may repeat.
+ */
+void test_MQTT5_DecodePropertyView_Duplicates( void )
+{
+    static const uint8_t duplicateBlock[] =
+    {
+        6U,
+        0x23U, 0x00U, 0x01U,
+        0x23U, 0x00U, 0x02U
+    };
+    static const uint8_t userPropertiesBlock[] =
+    {
+        14U,
+        0x26U, 0x00U, 0x01U, 'a', 0x00U, 0x00U,
+        0x26U, 0x00U, 0x01U, 'a', 0x00U, 0x02U, '1', '2'
+    };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, duplicateBlock, sizeof( duplicateBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_RequestProperty( &view, MQTT5_PROPERTY_CONTENT_TYPE ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, duplicateBlock, sizeof( duplicateBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyView( &view, viewProperties, VIEW_CAPACITY, repeatedProperties, REPEATED_CAPACITY ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, userPropertiesBlock, sizeof( userPropertiesBlock ) ) );
+    TEST_ASSERT_EQUAL( 0U, view.count );
+    TEST_ASSERT_EQUAL( 2U, view.repeatedCount );
+    expectUserProperty( &view.pRepeated[ 0 ], "a", "" );
+    expectUserProperty( &view.pRepeated[ 1 ], "a", "12" );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that properties and Variable Byte Integers running past the
+ * end of the block, and unknown identifiers, are rejected.
+ */
+void test_MQTT5_DecodePropertyView_Malformed( void )
+{
+    /* The properties length runs past the buffer. */
+    static const uint8_t longLength[] = { 4U, 0x23U, 0x00U, 0x01U };
+    /* The properties length is a truncated Variable Byte Integer. */
+    static const uint8_t truncatedLength[] = { 0x80U };
+    /* The properties length takes more than four bytes. */
+    static const uint8_t oversizedLength[] = { 0x80U, 0x80U, 0x80U, 0x80U, 0x01U };
+    /* A Topic Alias cut short by the properties length. */
+    static const uint8_t shortInteger[] = { 2U, 0x23U, 0x00U, 0x01U };
+    /* A string whose length runs past the properties. */
+    static const uint8_t shortString[] = { 4U, 0x03U, 0x00U, 0x03U, 'a' };
+    /* A User Property missing its value. */
+    static const uint8_t shortUserProperty[] = { 5U, 0x26U, 0x00U, 0x01U, 'k', 0x00U };
+    /* A Subscription Identifier whose Variable Byte Integer is truncated. */
+    static const uint8_t shortIdentifier[] = { 2U, 0x0BU, 0x80U };
+    /* An identifier that is not an MQTT 5 property. */
+    static const uint8_t unknownIdentifier[] = { 2U, 0x04U, 0x00U };
+    /* A Topic Alias followed by bytes past the properties. */
+    static const uint8_t trailingBytes[] = { 3U, 0x23U, 0x00U, 0x01U, 0xFFU };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, longLength, sizeof( longLength ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, truncatedLength, sizeof( truncatedLength ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, oversizedLength, sizeof( oversizedLength ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, shortInteger, sizeof( shortInteger ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, shortString, sizeof( shortString ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, shortUserProperty, sizeof( shortUserProperty ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, shortIdentifier, sizeof( shortIdentifier ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_DecodePropertyView( &view, unknownIdentifier, sizeof( unknownIdentifier ) ) );
+
+    /* The block may end before the buffer, as it does in a packet. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, trailingBytes, sizeof( trailingBytes ) ) );
+    TEST_ASSERT_EQUAL( 1U, view.count );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that properties of types not requested are validated but not
+ * stored.
+ */
+void test_MQTT5_DecodePropertyView_Requested( void )
+{
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_RequestProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_RequestProperty( &view, MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+
+    TEST_ASSERT_EQUAL( 1U, view.count );
+    TEST_ASSERT_EQUAL( 1U, view.repeatedCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( 5U, property.value.twoByteInteger );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_CONTENT_TYPE, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER, view.pRepeated[ 0 ].type );
+    TEST_ASSERT_EQUAL( 7U, view.pRepeated[ 0 ].value.fourByteInteger );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a view whose buffers are full fails to decode, and that
+ * a view without a repeated buffer only takes blocks without repeated
+ * properties unless they are not requested.
+ */
+void test_MQTT5_DecodePropertyView_NoMemory( void )
+{
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyView( &view, viewProperties, 1U, repeatedProperties, REPEATED_CAPACITY ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyView( &view, viewProperties, VIEW_CAPACITY, repeatedProperties, 2U ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyView( &view, viewProperties, VIEW_CAPACITY, NULL, 0U ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_RequestProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_DecodePropertyView( &view, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_GetViewProperty( &view, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that MQTT5_InitPropertyCursor rejects invalid parameters and
+ * malformed blocks, and that an uninitialized cursor cannot be read.
+ */
+void test_MQTT5_InitPropertyCursor_Invalid( void )
+{
+    static const uint8_t truncatedLength[] = { 0x80U };
+    static const uint8_t unknownIdentifier[] = { 2U, 0x04U, 0x00U };
+    MQTT5PropertyCursor_t cursor = { 0 };
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyCursor( NULL, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyCursor( &cursor, NULL, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyCursor( &cursor, propertyBlock, sizeof( propertyBlock ) - 1U ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyCursor( &cursor, truncatedLength, sizeof( truncatedLength ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_InitPropertyCursor( &cursor, unknownIdentifier, sizeof( unknownIdentifier ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_CursorFindProperty( NULL, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_NextProperty( NULL, &property ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_ResetPropertyCursor( NULL ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyCursor( &cursor, propertyBlock, sizeof( propertyBlock ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_NextProperty( &cursor, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_TOPIC_ALIAS, NULL ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a cursor reads every property in wire order and can be
+ * reset to the start.
+ */
+void test_MQTT5_NextProperty( void )
+{
+    MQTT5PropertyCursor_t cursor;
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyCursor( &cursor, propertyBlock, sizeof( propertyBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_CONTENT_TYPE, property.type );
+    TEST_ASSERT_EQUAL_PTR( &propertyBlock[ 4 ], property.value.utf8String.pString );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    expectUserProperty( &property, "k", "v" );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_TOPIC_ALIAS, property.type );
+    TEST_ASSERT_EQUAL( 5U, property.value.twoByteInteger );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER, property.type );
+    TEST_ASSERT_EQUAL( 7U, property.value.fourByteInteger );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    expectUserProperty( &property, "x", "y" );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_NextProperty( &cursor, &property ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_ResetPropertyCursor( &cursor ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_CONTENT_TYPE, property.type );
+
+    /* An empty block has nothing to read. */
+    {
+        static const uint8_t emptyBlock[] = { 0U };
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyCursor( &cursor, emptyBlock, sizeof( emptyBlock ) ) );
+        TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_NextProperty( &cursor, &property ) );
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that searching a cursor skips properties of other types and
+ * returns repeated properties in wire order.
+ */
+void test_MQTT5_CursorFindProperty( void )
+{
+    MQTT5PropertyCursor_t cursor;
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyCursor( &cursor, propertyBlock, sizeof( propertyBlock ) ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_USER_PROPERTY, &property ) );
+    expectUserProperty( &property, "k", "v" );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_USER_PROPERTY, &property ) );
+    expectUserProperty( &property, "x", "y" );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_USER_PROPERTY, &property ) );
+
+    /* The search continues from the cursor, so earlier properties need a reset. */
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_ResetPropertyCursor( &cursor ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( 5U, property.value.twoByteInteger );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_NextProperty( &cursor, &property ) );
+    TEST_ASSERT_EQUAL( MQTT5_PROPERTY_SUBSCRIPTION_IDENTIFIER, property.type );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_ResetPropertyCursor( &cursor ) );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_RESPONSE_TOPIC, &property ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a cursor reads the properties of a deserialized PUBLISH
+ * in place.
+ */
+void test_MQTT5_CursorFindProperty_Publish( void )
+{
+    /* Topic "t", properties with a Topic Alias of 9, payload "P". */
+    uint8_t remainingData[] = { 0x00U, 0x01U, 't', 3U, 0x23U, 0x00U, 0x09U, 'P' };
+    MQTTPacketInfo_t packetInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTT5PropertyCursor_t cursor;
+    MQTT5Property_t property;
+    uint16_t packetId = 0U;
+
+    packetInfo.type = MQTT_PACKET_TYPE_PUBLISH;
+    packetInfo.pRemainingData = remainingData;
+    packetInfo.remainingLength = sizeof( remainingData );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_DeserializePublish( &packetInfo, &packetId, &publishInfo, NULL ) );
+    TEST_ASSERT_EQUAL_PTR( &remainingData[ 3 ], publishInfo.pRawProperties );
+    TEST_ASSERT_EQUAL( 4U, publishInfo.rawPropertiesLength );
+    TEST_ASSERT_EQUAL( 1U, publishInfo.payloadLength );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitPropertyCursor( &cursor, publishInfo.pRawProperties, publishInfo.rawPropertiesLength ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_CursorFindProperty( &cursor, MQTT5_PROPERTY_TOPIC_ALIAS, &property ) );
+    TEST_ASSERT_EQUAL( 9U, property.value.twoByteInteger );
+    TEST_ASSERT_EQUAL_PTR( &remainingData[ 3 ], cursor.pBuffer );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Fill a collection with a Content Type, a Message Expiry Interval and
+ * a User Property.
+ */
+static void addProperties( MQTT5Properties_t * pProperties,
+                           MQTT5Property_t * pBuffer,
+                           size_t capacity )
+{
+    MQTT5Property_t property;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( pProperties, pBuffer, capacity ) );
+
+    property.type = MQTT5_PROPERTY_CONTENT_TYPE;
+    property.value.utf8String.pString = "json";
+    property.value.utf8String.length = 4U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( pProperties, &property ) );
+
+    property.type = MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL;
+    property.value.fourByteInteger = 60U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( pProperties, &property ) );
+
+    property.type = MQTT5_PROPERTY_USER_PROPERTY;
+    property.value.userProperty.pKey = "k";
+    property.value.userProperty.keyLength = 1U;
+    property.value.userProperty.pValue = "v";
+    property.value.userProperty.valueLength = 1U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( pProperties, &property ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a frozen collection has the size and bytes of the same
+ * collection unfrozen, and cannot be added to or frozen again.
+ */
+void test_MQTT5_FreezeProperties( void )
+{
+    MQTT5Property_t buffer[ VIEW_CAPACITY ];
+    MQTT5Properties_t properties;
+    MQTT5Property_t property = { 0 };
+    uint8_t expected[ 32 ];
+    uint8_t frozen[ 32 ];
+    uint8_t serialized[ 32 ];
+    size_t expectedSize = 0U;
+    size_t serializedSize = 0U;
+    size_t propertiesLength;
+
+    addProperties( &properties, buffer, VIEW_CAPACITY );
+    propertiesLength = MQTT5_GetPropertiesSize( &properties );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_SerializeProperties( &properties, expected, &expectedSize ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_FreezeProperties( NULL, frozen, sizeof( frozen ) ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_FreezeProperties( &properties, NULL, sizeof( frozen ) ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT5_FreezeProperties( &properties, frozen, expectedSize - 1U ) );
+    TEST_ASSERT_NULL( properties.pFrozen );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_FreezeProperties( &properties, frozen, expectedSize ) );
+    TEST_ASSERT_EQUAL_PTR( frozen, properties.pFrozen );
+    TEST_ASSERT_EQUAL( expectedSize, properties.frozenSize );
+    TEST_ASSERT_EQUAL( propertiesLength, properties.frozenLength );
+    TEST_ASSERT_EQUAL_MEMORY( expected, frozen, expectedSize );
+
+    TEST_ASSERT_EQUAL( propertiesLength, MQTT5_GetPropertiesSize( &properties ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_SerializeProperties( &properties, serialized, &serializedSize ) );
+    TEST_ASSERT_EQUAL( expectedSize, serializedSize );
+    TEST_ASSERT_EQUAL_MEMORY( expected, serialized, expectedSize );
+
+    property.type = MQTT5_PROPERTY_TOPIC_ALIAS;
+    property.value.twoByteInteger = 1U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_AddProperty( &properties, &property ) );
+    TEST_ASSERT_EQUAL( 3U, properties.count );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT5_FreezeProperties( &properties, serialized, sizeof( serialized ) ) );
+    TEST_ASSERT_EQUAL_PTR( frozen, properties.pFrozen );
+
+    /* Initializing the collection again unfreezes it. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &properties, buffer, VIEW_CAPACITY ) );
+    TEST_ASSERT_NULL( properties.pFrozen );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &properties, &property ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a frozen collection is serialized from its cached bytes,
+ * not from its properties.
+ */
+void test_MQTT5_FreezeProperties_Cached( void )
+{
+    MQTT5Property_t buffer[ VIEW_CAPACITY ];
+    MQTT5Properties_t properties;
+    uint8_t frozen[ 32 ];
+    uint8_t serialized[ 32 ];
+    size_t serializedSize = 0U;
+    size_t propertiesLength;
+
+    addProperties( &properties, buffer, VIEW_CAPACITY );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_FreezeProperties( &properties, frozen, sizeof( frozen ) ) );
+    propertiesLength = properties.frozenLength;
+
+    /* Change the values and drop a property behind the collection's back. */
+    buffer[ 0 ].value.utf8String.pString = "text/plain";
+    buffer[ 0 ].value.utf8String.length = 10U;
+    buffer[ 1 ].value.fourByteInteger = 0U;
+    properties.count = 2U;
+
+    TEST_ASSERT_EQUAL( propertiesLength, MQTT5_GetPropertiesSize( &properties ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_SerializeProperties( &properties, serialized, &serializedSize ) );
+    TEST_ASSERT_EQUAL( properties.frozenSize, serializedSize );
+    TEST_ASSERT_EQUAL_MEMORY( frozen, serialized, serializedSize );
+    TEST_ASSERT_EQUAL_MEMORY( "json", &serialized[ 4 ], 4U );
+
+    /* A PUBLISH carries the frozen bytes too. */
+    {
+        uint8_t packet[ 64 ];
+        MQTTFixedBuffer_t fixedBuffer = { packet, sizeof( packet ) };
+        MQTTPublishInfo_t publishInfo = { 0 };
+        size_t remainingLength = 0U;
+        size_t packetSize = 0U;
+
+        publishInfo.pTopicName = "t";
+        publishInfo.topicNameLength = 1U;
+        publishInfo.pPayload = "P";
+        publishInfo.payloadLength = 1U;
+        publishInfo.pProperties = &properties;
+
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) );
+        TEST_ASSERT_EQUAL( 2U + 3U + serializedSize + 1U, packetSize );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializePublish( &publishInfo, 0U, remainingLength, &fixedBuffer ) );
+        TEST_ASSERT_EQUAL_MEMORY( frozen, &packet[ 5 ], serializedSize );
+        TEST_ASSERT_EQUAL( 'P', packet[ packetSize - 1U ] );
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Add a User Property to a collection.
+ */
+static void addUserProperty( MQTT5Properties_t * pProperties,
+                             const char * pKey,
+                             const char * pValue )
+{
+    MQTT5Property_t property;
+
+    property.type = MQTT5_PROPERTY_USER_PROPERTY;
+    property.value.userProperty.pKey = pKey;
+    property.value.userProperty.keyLength = ( uint16_t ) strlen( pKey );
+    property.value.userProperty.pValue = pValue;
+    property.value.userProperty.valueLength = ( uint16_t ) strlen( pValue );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( pProperties, &property ) );
+}
+
+/**
+ * @brief Check that the bytes sent are the PUBLISH serialized by
+ * #MQTT_SerializePublish, and clear them.
+ */
+static void expectSentPublish( const MQTTPublishInfo_t * pPublishInfo )
+{
+    uint8_t expected[ sizeof( networkContext.sent ) ];
+    MQTTFixedBuffer_t fixedBuffer = { expected, sizeof( expected ) };
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetPublishPacketSize( pPublishInfo, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializePublish( pPublishInfo, 0U, remainingLength, &fixedBuffer ) );
+    TEST_ASSERT_EQUAL( packetSize, networkContext.sentLength );
+    TEST_ASSERT_EQUAL_MEMORY( expected, networkContext.sent, packetSize );
+
+    networkContext.sentLength = 0U;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a CONNECT whose properties and will properties are sent
+ * as vectors has the bytes serialized by #MQTT_SerializeConnect.
+ */
+void test_MQTT_Connect_PropertyVectors( void )
+{
+    MQTT5Property_t connectBuffer[ VIEW_CAPACITY ];
+    MQTT5Property_t willBuffer[ VIEW_CAPACITY ];
+    MQTT5Properties_t connectProperties;
+    MQTT5Properties_t willProperties;
+    MQTT5Property_t property;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t willInfo = { 0 };
+    uint8_t expected[ sizeof( networkContext.sent ) ];
+    MQTTFixedBuffer_t fixedBuffer = { expected, sizeof( expected ) };
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    bool sessionPresent = false;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &connectProperties, connectBuffer, VIEW_CAPACITY ) );
+    property.type = MQTT5_PROPERTY_SESSION_EXPIRY_INTERVAL;
+    property.value.fourByteInteger = 300U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &connectProperties, &property ) );
+    property.type = MQTT5_PROPERTY_RECEIVE_MAXIMUM;
+    property.value.twoByteInteger = 10U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &connectProperties, &property ) );
+    addUserProperty( &connectProperties, "app", "demo" );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &willProperties, willBuffer, VIEW_CAPACITY ) );
+    property.type = MQTT5_PROPERTY_WILL_DELAY_INTERVAL;
+    property.value.fourByteInteger = 5U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &willProperties, &property ) );
+    property.type = MQTT5_PROPERTY_CONTENT_TYPE;
+    property.value.utf8String.pString = "text/plain";
+    property.value.utf8String.length = 10U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &willProperties, &property ) );
+    addUserProperty( &willProperties, "k", "" );
+
+    connectInfo.pClientIdentifier = "client";
+    connectInfo.clientIdentifierLength = 6U;
+    connectInfo.cleanSession = true;
+    connectInfo.keepAliveSeconds = 60U;
+    connectInfo.pUserName = "user";
+    connectInfo.userNameLength = 4U;
+    connectInfo.pProperties = &connectProperties;
+    willInfo.qos = MQTTQoS1;
+    willInfo.pTopicName = "will/topic";
+    willInfo.topicNameLength = 10U;
+    willInfo.pPayload = "bye";
+    willInfo.payloadLength = 3U;
+    willInfo.pProperties = &willProperties;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetConnectPacketSize( &connectInfo, &willInfo, &remainingLength, &packetSize ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SerializeConnect( &connectInfo, &willInfo, remainingLength, &fixedBuffer ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, &willInfo, 1000U, &sessionPresent ) );
+    TEST_ASSERT_EQUAL( packetSize, networkContext.sentLength );
+    TEST_ASSERT_EQUAL_MEMORY( expected, networkContext.sent, packetSize );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a PUBLISH whose properties are sent as vectors, or frozen,
+ * has the bytes serialized by #MQTT_SerializePublish.
+ */
+void test_MQTT_Publish_PropertyVectors( void )
+{
+    MQTT5Property_t propertyBuffer[ VIEW_CAPACITY ];
+    MQTT5Properties_t properties;
+    MQTT5Property_t property;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t frozen[ 64 ];
+
+    context.connectStatus = MQTTConnected;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &properties, propertyBuffer, VIEW_CAPACITY ) );
+    property.type = MQTT5_PROPERTY_RESPONSE_TOPIC;
+    property.value.utf8String.pString = "reply/to";
+    property.value.utf8String.length = 8U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &properties, &property ) );
+    property.type = MQTT5_PROPERTY_CORRELATION_DATA;
+    property.value.binaryData.pData = ( const uint8_t * ) "\x01\x02\x03";
+    property.value.binaryData.length = 3U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &properties, &property ) );
+    property.type = MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL;
+    property.value.fourByteInteger = 99U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &properties, &property ) );
+    addUserProperty( &properties, "k", "" );
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.retain = true;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "hello";
+    publishInfo.payloadLength = 5U;
+    publishInfo.pProperties = &properties;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_FreezeProperties( &properties, frozen, sizeof( frozen ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+
+    /* A PUBLISH without properties has an empty properties length. */
+    publishInfo.pProperties = NULL;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that properties needing more vectors or scratch than
+ * configured are not sent until they are frozen.
+ */
+void test_MQTT_Publish_PropertyVectors_NoMemory( void )
+{
+    MQTT5Property_t propertyBuffer[ SCRATCH_OVERFLOW_COUNT + VECTOR_OVERFLOW_COUNT ];
+    MQTT5Properties_t properties;
+    MQTT5Property_t property;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t frozen[ 128 ];
+    size_t i;
+
+    context.connectStatus = MQTTConnected;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "hello";
+    publishInfo.payloadLength = 5U;
+    publishInfo.pProperties = &properties;
+
+    /* Too many vectors. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &properties, propertyBuffer, VECTOR_OVERFLOW_COUNT ) );
+
+    for( i = 0U; i < VECTOR_OVERFLOW_COUNT; i++ )
+    {
+        addUserProperty( &properties, "k", "v" );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_Publish( &context, &publishInfo, 0U ) );
+    TEST_ASSERT_EQUAL( 0U, networkContext.sentLength );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_FreezeProperties( &properties, frozen, sizeof( frozen ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+
+    /* Too many bytes of scratch. The encoder does not check for repeats. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &properties, propertyBuffer, SCRATCH_OVERFLOW_COUNT ) );
+    property.type = MQTT5_PROPERTY_MESSAGE_EXPIRY_INTERVAL;
+    property.value.fourByteInteger = 0x01020304U;
+
+    for( i = 0U; i < SCRATCH_OVERFLOW_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_AddProperty( &properties, &property ) );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_Publish( &context, &publishInfo, 0U ) );
+    TEST_ASSERT_EQUAL( 0U, networkContext.sentLength );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_FreezeProperties( &properties, frozen, sizeof( frozen ) ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a CONNECT whose will properties need more vectors than
+ * configured is not sent.
+ */
+void test_MQTT_Connect_PropertyVectors_NoMemory( void )
+{
+    MQTT5Property_t willBuffer[ VECTOR_OVERFLOW_COUNT ];
+    MQTT5Properties_t willProperties;
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t willInfo = { 0 };
+    bool sessionPresent = false;
+    size_t i;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT5_InitProperties( &willProperties, willBuffer, VECTOR_OVERFLOW_COUNT ) );
+
+    for( i = 0U; i < VECTOR_OVERFLOW_COUNT; i++ )
+    {
+        addUserProperty( &willProperties, "k", "v" );
+    }
+
+    connectInfo.pClientIdentifier = "client";
+    connectInfo.clientIdentifierLength = 6U;
+    connectInfo.cleanSession = true;
+    willInfo.pTopicName = "will/topic";
+    willInfo.topicNameLength = 10U;
+    willInfo.pPayload = "bye";
+    willInfo.payloadLength = 3U;
+    willInfo.pProperties = &willProperties;
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_Connect( &context, &connectInfo, &willInfo, 1000U, &sessionPresent ) );
+    TEST_ASSERT_EQUAL( 0U, networkContext.sentLength );
+    TEST_ASSERT_EQUAL( MQTTNotConnected, context.connectStatus );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that #MQTT_Publish maps outgoing topic aliases by the bytes of
+ * the topic name, which may be reused for another topic after each publish.
+ */
+void test_MQTT_Publish_TopicAliases( void )
+{
+    MQTTTopicAlias_t aliasMemory[ 2 ];
+    uint8_t arena[ MQTT_TOPIC_ALIASES_ARENA_SIZE( 2, 8 ) ];
+    MQTTTopicAliases_t topicAliases = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishInfo_t sentInfo = { 0 };
+    char topicName[ 16 ];
+    bool sessionPresent = false;
+
+    topicAliases.pAliases = aliasMemory;
+    topicAliases.pArena = arena;
+    topicAliases.arenaSize = sizeof( arena );
+    topicAliases.aliasCount = 2U;
+    topicAliases.topicNameMaxLength = 8U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicAliases( &context, &topicAliases ) );
+
+    networkContext.pConnack = connackTopicAliases;
+    networkContext.connackLength = sizeof( connackTopicAliases );
+    connectInfo.pClientIdentifier = "client";
+    connectInfo.clientIdentifierLength = 6U;
+    connectInfo.cleanSession = true;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Connect( &context, &connectInfo, NULL, 1000U, &sessionPresent ) );
+    TEST_ASSERT_EQUAL( 2U, topicAliases.aliasMaximum );
+    networkContext.sentLength = 0U;
+
+    publishInfo.pTopicName = topicName;
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "hello";
+    publishInfo.payloadLength = 5U;
+
+    /* The first publish on a topic maps an alias to it. */
+    ( void ) memcpy( topicName, "a/1", 3U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    sentInfo = publishInfo;
+    sentInfo.topicAlias = 1U;
+    expectSentPublish( &sentInfo );
+
+    /* The same buffer holding another topic gets another alias. */
+    ( void ) memcpy( topicName, "a/2", 3U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    sentInfo.topicAlias = 2U;
+    expectSentPublish( &sentInfo );
+
+    /* A topic already mapped is sent by its alias alone. */
+    ( void ) memcpy( topicName, "a/1", 3U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    sentInfo.pTopicName = NULL;
+    sentInfo.topicNameLength = 0U;
+    sentInfo.topicAlias = 1U;
+    expectSentPublish( &sentInfo );
+
+    /* A topic name longer than the arena allows gets no alias. */
+    ( void ) memcpy( topicName, "a/b/c/d/e", 9U );
+    publishInfo.topicNameLength = 9U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Publish( &context, &publishInfo, 0U ) );
+    expectSentPublish( &publishInfo );
+}
@@ -0,0 +1,629 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_journal_utest.c
+ * @brief Unit tests for functions in core_mqtt_journal.h.
+ */
+#include <string.h>
+#include "unity.h"
+
+#include "core_mqtt_journal.h"
+#include "core_mqtt_state.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Number of outgoing publish records. Four of them may be in use when
+ * they are indexed.
+ */
+#define OUTGOING_COUNT     ( 5U )
+
+/**
+ * @brief Number of incoming publish records.
+ */
+#define INCOMING_COUNT     ( 4U )
+
+/**
+ * @brief Number of slots of the packet index of the journal.
+ */
+#define SLOT_COUNT         ( 2U * OUTGOING_COUNT )
+
+/**
+ * @brief Largest PUBLISH journaled by the tests.
+ */
+#define MAX_PACKET_SIZE    ( 32U )
+
+/**
+ * @brief Size of the journal buffer.
+ */
+#define JOURNAL_SIZE       MQTT_JOURNAL_BUFFER_SIZE( OUTGOING_COUNT, INCOMING_COUNT, MAX_PACKET_SIZE )
+
+/**
+ * @brief A network context capturing the bytes sent.
+ */
+struct NetworkContext
+{
+    uint8_t sent[ 256 ]; /**< @brief Bytes sent. */
+    size_t sentLength;   /**< @brief Number of bytes sent. */
+};
+
+static MQTTContext_t context;
+static TransportInterface_t transport;
+static NetworkContext_t networkContext;
+static MQTTFixedBuffer_t networkBuffer;
+static uint8_t buffer[ 128 ];
+static MQTTPubAckInfo_t outgoingRecords[ OUTGOING_COUNT ];
+static MQTTPubAckInfo_t incomingRecords[ INCOMING_COUNT ];
+static MQTTJournalSlot_t slots[ SLOT_COUNT ];
+static MQTTSessionJournal_t journal;
+static uint8_t journalBuffer[ JOURNAL_SIZE ];
+static size_t flushedBytes;
+static MQTTPubAckIndexSlot_t outgoingIndexSlots[ 2U * OUTGOING_COUNT ];
+static MQTTPubAckIndexSlot_t incomingIndexSlots[ 2U * INCOMING_COUNT ];
+static MQTTPubAckIndex_t outgoingIndex;
+static MQTTPubAckIndex_t incomingIndex;
+static bool useIndex;
+
+/**
+ * @brief Time function for the context.
+ */
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+/**
+ * @brief Event callback for the context.
+ */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/**
+ * @brief Transport send capturing the bytes sent.
+ */
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( pNetworkContext->sent ), pNetworkContext->sentLength + bytesToSend );
+    ( void ) memcpy( &pNetworkContext->sent[ pNetworkContext->sentLength ], pBuffer, bytesToSend );
+    pNetworkContext->sentLength += bytesToSend;
+
+    return ( int32_t ) bytesToSend;
+}
+
+/**
+ * @brief Transport receive, never called.
+ */
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+    ( void ) bytesToRecv;
+
+    return 0;
+}
+
+/**
+ * @brief Flush callback checking that flushed bytes lie in the journal.
+ */
+static void flushJournal( const uint8_t * pData,
+                          size_t length )
+{
+    TEST_ASSERT_TRUE( pData >= journalBuffer );
+    TEST_ASSERT_TRUE( &pData[ length ] <= &journalBuffer[ JOURNAL_SIZE ] );
+    flushedBytes += length;
+}
+
+/**
+ * @brief Simulate a restart: set up the context and the journal again, with
+ * only the journal buffer kept, and restore the session.
+ */
+static MQTTStatus_t restart( void )
+{
+    MQTTStatus_t status;
+
+    memset( &context, 0x00, sizeof( context ) );
+    memset( outgoingRecords, 0x00, sizeof( outgoingRecords ) );
+    memset( incomingRecords, 0x00, sizeof( incomingRecords ) );
+    memset( slots, 0x00, sizeof( slots ) );
+    memset( &journal, 0x00, sizeof( journal ) );
+
+    status = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_InitStatefulQoS( &context, outgoingRecords, OUTGOING_COUNT, incomingRecords, INCOMING_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    if( useIndex == true )
+    {
+        memset( &outgoingIndex, 0x00, sizeof( outgoingIndex ) );
+        memset( &incomingIndex, 0x00, sizeof( incomingIndex ) );
+        outgoingIndex.pSlots = outgoingIndexSlots;
+        outgoingIndex.slotCount = 2U * OUTGOING_COUNT;
+        incomingIndex.pSlots = incomingIndexSlots;
+        incomingIndex.slotCount = 2U * INCOMING_COUNT;
+        status = MQTT_InitStatefulQoSIndex( &context, &outgoingIndex, &incomingIndex );
+        TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    }
+
+    journal.pBuffer = journalBuffer;
+    journal.bufferSize = sizeof( journalBuffer );
+    journal.pSlots = slots;
+    journal.slotCount = SLOT_COUNT;
+    journal.flushFunction = flushJournal;
+
+    status = MQTT_RestoreSession( &context, &journal );
+    context.connectStatus = MQTTConnected;
+
+    return status;
+}
+
+/**
+ * @brief Publish with the given packet ID and QoS.
+ */
+static void publish( uint16_t packetId,
+                     MQTTQoS_t qos,
+                     const char * pPayload )
+{
+    MQTTPublishInfo_t publishInfo;
+    MQTTStatus_t status;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.qos = qos;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = strlen( pPayload );
+
+    networkContext.sentLength = 0U;
+    status = MQTT_Publish( &context, &publishInfo, packetId );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+}
+
+/**
+ * @brief Process an acknowledgement of an outgoing publish as #MQTT_ProcessLoop
+ * does.
+ */
+static void receiveAck( uint16_t packetId,
+                        MQTTPubAckType_t packetType )
+{
+    MQTTPublishState_t state;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &context, packetId, packetType, MQTT_RECEIVE, &state ) );
+
+    if( ( packetType == MQTTPuback ) || ( packetType == MQTTPubrec ) )
+    {
+        context.clearFunction( &context, packetId );
+    }
+}
+
+/**
+ * @brief Check the record at a position of a record array, counted from the
+ * head of its index if it has one.
+ */
+static void expectRecord( const MQTTPubAckInfo_t * records,
+                          const MQTTPubAckIndex_t * pIndex,
+                          size_t recordCount,
+                          size_t position,
+                          uint16_t packetId,
+                          MQTTQoS_t qos,
+                          MQTTPublishState_t state )
+{
+    size_t head = ( pIndex != NULL ) ? pIndex->head : 0U;
+    const MQTTPubAckInfo_t * pRecord = &records[ ( head + position ) % recordCount ];
+
+    TEST_ASSERT_EQUAL( packetId, pRecord->packetId );
+    TEST_ASSERT_EQUAL( qos, pRecord->qos );
+    TEST_ASSERT_EQUAL( state, pRecord->publishState );
+}
+
+/**
+ * @brief Check the journaled copy of a publish.
+ */
+static void expectPacket( uint16_t packetId,
+                          const uint8_t * pExpected,
+                          size_t expectedLength )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, packetId, &pPacket, &packetLength ) );
+    TEST_ASSERT_EQUAL( expectedLength, packetLength );
+    TEST_ASSERT_EQUAL_MEMORY( pExpected, pPacket, packetLength );
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+void setUp( void )
+{
+    memset( &networkContext, 0x00, sizeof( networkContext ) );
+    memset( journalBuffer, 0x00, sizeof( journalBuffer ) );
+    flushedBytes = 0U;
+    useIndex = false;
+
+    transport.pNetworkContext = &networkContext;
+    transport.send = transportSend;
+    transport.recv = transportRecv;
+    transport.writev = NULL;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that MQTT_RestoreSession rejects invalid parameters.
+ */
+void test_MQTT_RestoreSession_Invalid( void )
+{
+    MQTTSessionJournal_t otherJournal = journal;
+    MQTTContext_t otherContext;
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( NULL, &otherJournal ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &context, NULL ) );
+
+    otherJournal.pBuffer = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &context, &otherJournal ) );
+    otherJournal = journal;
+    otherJournal.pSlots = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &context, &otherJournal ) );
+
+    /* Every outgoing record and one empty slot are needed. */
+    otherJournal = journal;
+    otherJournal.slotCount = OUTGOING_COUNT;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &context, &otherJournal ) );
+
+    otherJournal = journal;
+    otherJournal.bufferSize = 2U * ( MQTT_JOURNAL_HEADER_SIZE + MQTT_JOURNAL_STATE_ENTRY_SIZE ) - 1U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &context, &otherJournal ) );
+
+    /* The records must be set up first. */
+    memset( &otherContext, 0x00, sizeof( otherContext ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &otherContext, &transport, getTime, eventCallback, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RestoreSession( &otherContext, &journal ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a buffer of zeros restores an empty session and starts a
+ * journal in it.
+ */
+void test_MQTT_RestoreSession_Empty( void )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+    size_t i;
+
+    TEST_ASSERT_EQUAL_PTR( &journal, context.pSessionJournal );
+    TEST_ASSERT_NOT_NULL( context.storeFunction );
+    TEST_ASSERT_NOT_NULL( context.retrieveFunction );
+    TEST_ASSERT_NOT_NULL( context.clearFunction );
+    TEST_ASSERT_NOT_NULL( context.recordStateFunction );
+    TEST_ASSERT_EQUAL( 0U, journal.activeHalf );
+    TEST_ASSERT_EQUAL( 1U, journal.generation );
+    TEST_ASSERT_EQUAL( MQTT_JOURNAL_HEADER_SIZE, journal.writeOffset );
+    TEST_ASSERT_EQUAL( 0U, journal.liveBytes );
+    TEST_ASSERT_EQUAL( MQTT_JOURNAL_HEADER_SIZE, flushedBytes );
+
+    for( i = 0U; i < OUTGOING_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, outgoingRecords[ i ].packetId );
+    }
+
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+
+    /* Restoring the empty journal moves it to the other half. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    TEST_ASSERT_EQUAL( JOURNAL_SIZE / 2U, journal.activeHalf );
+    TEST_ASSERT_EQUAL( 2U, journal.generation );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that the records and the publishes awaiting acknowledgement
+ * are restored after a restart, in the order kept by the state engine.
+ */
+void test_MQTT_RestoreSession_Restart( void )
+{
+    uint8_t sent[ 3 ][ MAX_PACKET_SIZE ];
+    size_t sentLength[ 3 ];
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+    MQTTPublishState_t state;
+
+    publish( 1U, MQTTQoS1, "one" );
+    publish( 2U, MQTTQoS2, "two" );
+    memcpy( sent[ 1 ], networkContext.sent, networkContext.sentLength );
+    sentLength[ 1 ] = networkContext.sentLength;
+    publish( 3U, MQTTQoS1, "three" );
+    memcpy( sent[ 2 ], networkContext.sent, networkContext.sentLength );
+    sentLength[ 2 ] = networkContext.sentLength;
+    publish( 4U, MQTTQoS2, "four" );
+
+    receiveAck( 1U, MQTTPuback );
+    receiveAck( 4U, MQTTPubrec );
+
+    /* An incoming QoS 2 publish whose PUBREC was sent. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &context, 7U, MQTT_RECEIVE, MQTTQoS2, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &context, 7U, MQTTPubrec, MQTT_SEND, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &context, 8U, MQTT_RECEIVE, MQTTQoS1, &state ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 2U, MQTTQoS2, MQTTPubRecPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 3U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 2U, 4U, MQTTQoS2, MQTTPubRelSend );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 3U, 0U, MQTTQoS0, MQTTStateNull );
+    expectRecord( incomingRecords, context.incomingPublishIndex, INCOMING_COUNT, 0U, 7U, MQTTQoS2, MQTTPubRelPending );
+    expectRecord( incomingRecords, context.incomingPublishIndex, INCOMING_COUNT, 1U, 8U, MQTTQoS1, MQTTPubAckSend );
+
+    /* The copies are marked as duplicates. */
+    sent[ 1 ][ 0 ] |= 0x08U;
+    sent[ 2 ][ 0 ] |= 0x08U;
+    expectPacket( 2U, sent[ 1 ], sentLength[ 1 ] );
+    expectPacket( 3U, sent[ 2 ], sentLength[ 2 ] );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 4U, &pPacket, &packetLength ) );
+
+    /* The restored session keeps being journaled. */
+    receiveAck( 3U, MQTTPuback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &context, 7U, MQTTPubrel, MQTT_RECEIVE, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 2U, MQTTQoS2, MQTTPubRecPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 4U, MQTTQoS2, MQTTPubRelSend );
+    expectRecord( incomingRecords, context.incomingPublishIndex, INCOMING_COUNT, 0U, 7U, MQTTQoS2, MQTTPubCompSend );
+    expectRecord( incomingRecords, context.incomingPublishIndex, INCOMING_COUNT, 1U, 8U, MQTTQoS1, MQTTPubAckSend );
+    expectPacket( 2U, sent[ 1 ], sentLength[ 1 ] );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 3U, &pPacket, &packetLength ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that packet IDs handed out after a restart do not collide with
+ * the restored outgoing records.
+ */
+void test_MQTT_RestoreSession_NextPacketId( void )
+{
+    uint16_t packetId;
+
+    publish( 1U, MQTTQoS1, "one" );
+    publish( 2U, MQTTQoS1, "two" );
+    publish( 3U, MQTTQoS1, "three" );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+
+    packetId = MQTT_GetPacketId( &context );
+    TEST_ASSERT_EQUAL( 4U, packetId );
+    publish( packetId, MQTTQoS1, "four" );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 3U, 4U, MQTTQoS1, MQTTPubAckPending );
+
+    /* IDs that wrapped around below the highest one are skipped as well. */
+    receiveAck( 1U, MQTTPuback );
+    receiveAck( 2U, MQTTPuback );
+    receiveAck( 3U, MQTTPuback );
+    receiveAck( 4U, MQTTPuback );
+    publish( UINT16_MAX, MQTTQoS1, "max" );
+    publish( 1U, MQTTQoS1, "one" );
+    publish( 2U, MQTTQoS1, "two" );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    TEST_ASSERT_EQUAL( 3U, MQTT_GetPacketId( &context ) );
+
+    /* An empty session keeps the first packet ID. */
+    memset( journalBuffer, 0x00, sizeof( journalBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    TEST_ASSERT_EQUAL( 1U, MQTT_GetPacketId( &context ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that an entry torn by a crash is ignored, and that the restored
+ * journal is appended to after the last valid entry.
+ */
+void test_MQTT_RestoreSession_TornEntry( void )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+
+    publish( 1U, MQTTQoS1, "one" );
+    publish( 2U, MQTTQoS1, "two" );
+
+    /* Tear the last entry, which moved record 2 past MQTTPublishSend. */
+    journalBuffer[ journal.writeOffset - 1U ] ^= 0xFFU;
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 1U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 2U, MQTTQoS1, MQTTPublishSend );
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, 2U, &pPacket, &packetLength ) );
+
+    /* A restart right after the restore finds the same session. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 1U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 2U, MQTTQoS1, MQTTPublishSend );
+
+    /* A torn half header falls back to the other half, of the generation
+     * before. */
+    journalBuffer[ journal.activeHalf + 8U ] ^= 0xFFU;
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 1U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 2U, MQTTQoS1, MQTTPublishSend );
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that the journal is compacted as publishes are acknowledged,
+ * so that it stays within its buffer and restores the latest session.
+ */
+void test_MQTT_RestoreSession_Compaction( void )
+{
+    char payload[ 8 ];
+    uint16_t packetId;
+    uint32_t generation = journal.generation;
+    MQTTPublishState_t state;
+
+    /* A publish kept unacknowledged throughout. */
+    publish( 1000U, MQTTQoS2, "kept" );
+
+    for( packetId = 1U; packetId <= 500U; packetId++ )
+    {
+        payload[ 0 ] = ( char ) ( 'a' + ( packetId % 26U ) );
+        payload[ 1 ] = '\0';
+        publish( packetId, ( ( packetId % 2U ) == 0U ) ? MQTTQoS1 : MQTTQoS2, payload );
+
+        if( ( packetId % 2U ) == 0U )
+        {
+            receiveAck( packetId, MQTTPuback );
+        }
+        else
+        {
+            receiveAck( packetId, MQTTPubrec );
+            TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &context, packetId, MQTTPubrel, MQTT_SEND, &state ) );
+            receiveAck( packetId, MQTTPubcomp );
+        }
+
+        TEST_ASSERT_TRUE( journal.writeOffset <= ( journal.activeHalf + ( JOURNAL_SIZE / 2U ) ) );
+    }
+
+    TEST_ASSERT_TRUE( journal.generation > ( generation + 10U ) );
+
+    /* A publish left in flight at the crash. */
+    publish( 501U, MQTTQoS1, "last" );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 1000U, MQTTQoS2, MQTTPubRecPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 501U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 2U, 0U, MQTTQoS0, MQTTStateNull );
+
+    /* The restored journal holds only the live entries. */
+    TEST_ASSERT_EQUAL( journal.writeOffset - journal.activeHalf - MQTT_JOURNAL_HEADER_SIZE, journal.liveBytes );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a clean session clears the journaled session.
+ */
+void test_MQTT_RestoreSession_Reset( void )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+
+    publish( 1U, MQTTQoS1, "one" );
+
+    /* What a clean session does to the records. */
+    memset( outgoingRecords, 0x00, sizeof( outgoingRecords ) );
+    MQTT_IndexStateRecords( &context );
+    context.recordStateFunction( &context, MQTT_PACKET_ID_INVALID, MQTTQoS0, MQTTStateNull, true );
+    TEST_ASSERT_EQUAL( 0U, journal.liveBytes );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+
+    publish( 2U, MQTTQoS1, "two" );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 0U, 2U, MQTTQoS1, MQTTPubAckPending );
+    expectRecord( outgoingRecords, context.outgoingPublishIndex, OUTGOING_COUNT, 1U, 0U, MQTTQoS0, MQTTStateNull );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, 2U, &pPacket, &packetLength ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a journal holding more records than the context fails to
+ * restore, leaving no records behind.
+ */
+void test_MQTT_RestoreSession_NoMemory( void )
+{
+    MQTTSessionJournal_t otherJournal;
+    size_t i;
+
+    publish( 1U, MQTTQoS1, "one" );
+    publish( 2U, MQTTQoS1, "two" );
+
+    memset( &context, 0x00, sizeof( context ) );
+    memset( outgoingRecords, 0x00, sizeof( outgoingRecords ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitStatefulQoS( &context, outgoingRecords, 1U, incomingRecords, INCOMING_COUNT ) );
+
+    otherJournal = journal;
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_RestoreSession( &context, &otherJournal ) );
+    TEST_ASSERT_NULL( context.pSessionJournal );
+
+    for( i = 0U; i < OUTGOING_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, outgoingRecords[ i ].packetId );
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests restarts of a context whose records are indexed, whose rings
+ * can start anywhere in the record arrays.
+ */
+void test_MQTT_RestoreSession_Indexed( void )
+{
+    useIndex = true;
+    memset( journalBuffer, 0x00, sizeof( journalBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    test_MQTT_RestoreSession_Restart();
+
+    memset( journalBuffer, 0x00, sizeof( journalBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, restart() );
+    test_MQTT_RestoreSession_Compaction();
+}
@@ -0,0 +1,439 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_retransmit_utest.c
+ * @brief Unit tests for functions in core_mqtt_retransmit.h.
+ */
+#include <string.h>
+#include "unity.h"
+
+#include "core_mqtt_retransmit.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Number of slots of the store under test.
+ */
+#define SLOT_COUNT         ( 8U )
+
+/**
+ * @brief Largest packet stored by the store under test.
+ */
+#define MAX_PACKET_SIZE    ( 64U )
+
+/**
+ * @brief Number of outgoing publish records.
+ */
+#define RECORD_COUNT       ( 8U )
+
+/**
+ * @brief The opaque vector passed to the store callback. Mirrors the
+ * definition in core_mqtt.c so that the callbacks can be called directly.
+ */
+struct MQTTVec
+{
+    TransportOutVector_t * pVector;         /**< Pointer to transport vector. */
+    size_t vectorLen;                       /**< Length of the transport vector. */
+    const MQTTPublishInfo_t * pPublishInfo; /**< Publish the vector refers to. */
+};
+
+/**
+ * @brief A network context capturing the bytes sent.
+ */
+struct NetworkContext
+{
+    uint8_t sent[ 256 ]; /**< @brief Bytes sent. */
+    size_t sentLength;   /**< @brief Number of bytes sent. */
+};
+
+static MQTTContext_t context;
+static TransportInterface_t transport;
+static NetworkContext_t networkContext;
+static MQTTFixedBuffer_t networkBuffer;
+static uint8_t buffer[ 128 ];
+static MQTTPubAckInfo_t outgoingRecords[ RECORD_COUNT ];
+static MQTTRetransmitStore_t store;
+static uint8_t storeBuffer[ MQTT_RETRANSMIT_BUFFER_SIZE( SLOT_COUNT, MAX_PACKET_SIZE ) ];
+
+/**
+ * @brief Time function for the context.
+ */
+static uint32_t getTime( void )
+{
+    return 0U;
+}
+
+/**
+ * @brief Event callback for the context.
+ */
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/**
+ * @brief Transport send capturing the bytes sent.
+ */
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( pNetworkContext->sent ), pNetworkContext->sentLength + bytesToSend );
+    ( void ) memcpy( &pNetworkContext->sent[ pNetworkContext->sentLength ], pBuffer, bytesToSend );
+    pNetworkContext->sentLength += bytesToSend;
+
+    return ( int32_t ) bytesToSend;
+}
+
+/**
+ * @brief Transport receive, never called.
+ */
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+    ( void ) bytesToRecv;
+
+    return 0;
+}
+
+/**
+ * @brief Store a packet of the given length, filled with a byte derived from
+ * the packet ID, through the store callback of the context.
+ */
+static bool storeTestPacket( uint16_t packetId,
+                             size_t length )
+{
+    uint8_t packet[ MAX_PACKET_SIZE + 1U ];
+    TransportOutVector_t vectors[ 2 ];
+    MQTTVec_t mqttVec;
+
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( packet ), length );
+    ( void ) memset( packet, ( int ) ( packetId & 0xFFU ), sizeof( packet ) );
+
+    /* Split the packet over two vectors to check they are joined. */
+    vectors[ 0 ].iov_base = packet;
+    vectors[ 0 ].iov_len = length / 2U;
+    vectors[ 1 ].iov_base = &packet[ length / 2U ];
+    vectors[ 1 ].iov_len = length - ( length / 2U );
+    mqttVec.pVector = vectors;
+    mqttVec.vectorLen = 2U;
+    mqttVec.pPublishInfo = NULL;
+
+    return context.storeFunction( &context, packetId, &mqttVec );
+}
+
+/**
+ * @brief Check that a packet stored by #storeTestPacket can be retrieved.
+ */
+static void expectTestPacket( uint16_t packetId,
+                              size_t length )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+    size_t i;
+
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, packetId, &pPacket, &packetLength ) );
+    TEST_ASSERT_EQUAL( length, packetLength );
+
+    for( i = 0U; i < length; i++ )
+    {
+        TEST_ASSERT_EQUAL_HEX8( packetId & 0xFFU, pPacket[ i ] );
+    }
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+void setUp( void )
+{
+    MQTTStatus_t status;
+
+    memset( &context, 0x00, sizeof( context ) );
+    memset( &networkContext, 0x00, sizeof( networkContext ) );
+    memset( &store, 0x00, sizeof( store ) );
+
+    transport.pNetworkContext = &networkContext;
+    transport.send = transportSend;
+    transport.recv = transportRecv;
+    transport.writev = NULL;
+    networkBuffer.pBuffer = buffer;
+    networkBuffer.size = sizeof( buffer );
+
+    status = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_InitStatefulQoS( &context, outgoingRecords, RECORD_COUNT, NULL, 0U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_InitRetransmitStore( &context, &store, storeBuffer, sizeof( storeBuffer ), MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that MQTT_InitRetransmitStore rejects invalid parameters and
+ * carves the buffer into the expected number of slots.
+ */
+void test_MQTT_InitRetransmitStore( void )
+{
+    MQTTRetransmitStore_t otherStore;
+    MQTTStatus_t status;
+
+    status = MQTT_InitRetransmitStore( NULL, &otherStore, storeBuffer, sizeof( storeBuffer ), MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_InitRetransmitStore( &context, NULL, storeBuffer, sizeof( storeBuffer ), MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_InitRetransmitStore( &context, &otherStore, NULL, sizeof( storeBuffer ), MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_InitRetransmitStore( &context, &otherStore, storeBuffer, sizeof( storeBuffer ), 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_InitRetransmitStore( &context, &otherStore, storeBuffer, MQTT_RETRANSMIT_SLOT_OVERHEAD - 1U, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_InitRetransmitStore( &context, &otherStore, storeBuffer,
+                                       MQTT_RETRANSMIT_BUFFER_SIZE( 1U, MAX_PACKET_SIZE ) - 1U, MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* The failed calls left the store of the fixture registered. */
+    TEST_ASSERT_EQUAL_PTR( &store, context.pRetransmitStore );
+    TEST_ASSERT_EQUAL( SLOT_COUNT, store.slotCount );
+    TEST_ASSERT_EQUAL( 2U * SLOT_COUNT, store.indexCount );
+    TEST_ASSERT_EQUAL( 0U, store.usedCount );
+    TEST_ASSERT_NOT_NULL( context.storeFunction );
+    TEST_ASSERT_NOT_NULL( context.retrieveFunction );
+    TEST_ASSERT_NOT_NULL( context.clearFunction );
+
+    /* Spare bytes short of a slot are left unused. */
+    status = MQTT_InitRetransmitStore( &context, &otherStore, storeBuffer,
+                                       MQTT_RETRANSMIT_BUFFER_SIZE( 3U, MAX_PACKET_SIZE ) - 1U, MAX_PACKET_SIZE );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 2U, otherStore.slotCount );
+    TEST_ASSERT_EQUAL_PTR( &otherStore, context.pRetransmitStore );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests storing, retrieving, replacing and clearing packets.
+ */
+void test_MQTT_RetransmitStore_StoreRetrieveClear( void )
+{
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+
+    TEST_ASSERT_TRUE( storeTestPacket( 1U, 10U ) );
+    TEST_ASSERT_TRUE( storeTestPacket( 2U, MAX_PACKET_SIZE ) );
+    TEST_ASSERT_EQUAL( 2U, store.usedCount );
+    expectTestPacket( 1U, 10U );
+    expectTestPacket( 2U, MAX_PACKET_SIZE );
+
+    /* Storing a packet ID again replaces its copy in the same slot. */
+    TEST_ASSERT_TRUE( storeTestPacket( 1U, 20U ) );
+    TEST_ASSERT_EQUAL( 2U, store.usedCount );
+    expectTestPacket( 1U, 20U );
+
+    /* A packet larger than a slot is refused, and drops the older copy. */
+    TEST_ASSERT_FALSE( storeTestPacket( 1U, MAX_PACKET_SIZE + 1U ) );
+    TEST_ASSERT_EQUAL( 1U, store.usedCount );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 1U, &pPacket, &packetLength ) );
+    TEST_ASSERT_FALSE( storeTestPacket( 3U, MAX_PACKET_SIZE + 1U ) );
+    TEST_ASSERT_EQUAL( 1U, store.usedCount );
+
+    context.clearFunction( &context, 2U );
+    TEST_ASSERT_EQUAL( 0U, store.usedCount );
+    TEST_ASSERT_FALSE( context.retrieveFunction( &context, 2U, &pPacket, &packetLength ) );
+
+    /* Clearing a packet ID which is not stored does nothing. */
+    context.clearFunction( &context, 2U );
+    TEST_ASSERT_EQUAL( 0U, store.usedCount );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a store with every slot used refuses new packets until a
+ * slot is cleared.
+ */
+void test_MQTT_RetransmitStore_Full( void )
+{
+    uint16_t packetId;
+
+    for( packetId = 1U; packetId <= SLOT_COUNT; packetId++ )
+    {
+        TEST_ASSERT_TRUE( storeTestPacket( packetId, packetId ) );
+    }
+
+    TEST_ASSERT_FALSE( storeTestPacket( SLOT_COUNT + 1U, 1U ) );
+
+    /* Replacing a stored packet needs no new slot. */
+    TEST_ASSERT_TRUE( storeTestPacket( 3U, 5U ) );
+
+    context.clearFunction( &context, 4U );
+    TEST_ASSERT_TRUE( storeTestPacket( SLOT_COUNT + 1U, 1U ) );
+
+    for( packetId = 1U; packetId <= ( SLOT_COUNT + 1U ); packetId++ )
+    {
+        if( packetId == 3U )
+        {
+            expectTestPacket( packetId, 5U );
+        }
+        else if( packetId == ( SLOT_COUNT + 1U ) )
+        {
+            expectTestPacket( packetId, 1U );
+        }
+        else if( packetId != 4U )
+        {
+            expectTestPacket( packetId, packetId );
+        }
+        else
+        {
+            /* Cleared. */
+        }
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests random stores and clears against a model of the stored packet
+ * IDs, so that entries moved back by removals are still found.
+ */
+void test_MQTT_RetransmitStore_Random( void )
+{
+    static size_t storedLengths[ UINT16_MAX + 1U ];
+    uint16_t storedIds[ SLOT_COUNT ];
+    size_t storedCount = 0U;
+    uint32_t random = 1U;
+    uint16_t packetId;
+    size_t length;
+    size_t i, j;
+
+    memset( storedLengths, 0x00, sizeof( storedLengths ) );
+
+    for( i = 0U; i < 20000U; i++ )
+    {
+        random = ( random * 1103515245U ) + 12345U;
+
+        if( ( storedCount < SLOT_COUNT ) && ( ( ( random >> 16 ) % 2U ) == 0U ) )
+        {
+            /* Few distinct packet IDs, so that probe runs collide often. */
+            random = ( random * 1103515245U ) + 12345U;
+            packetId = ( uint16_t ) ( 1U + ( ( random >> 16 ) % 40U ) );
+            length = 1U + ( ( random >> 8 ) % MAX_PACKET_SIZE );
+
+            TEST_ASSERT_TRUE( storeTestPacket( packetId, length ) );
+
+            if( storedLengths[ packetId ] == 0U )
+            {
+                storedIds[ storedCount ] = packetId;
+                storedCount++;
+            }
+
+            storedLengths[ packetId ] = length;
+        }
+        else if( storedCount > 0U )
+        {
+            random = ( random * 1103515245U ) + 12345U;
+            j = ( random >> 16 ) % storedCount;
+            packetId = storedIds[ j ];
+
+            context.clearFunction( &context, packetId );
+            storedLengths[ packetId ] = 0U;
+            storedCount--;
+            storedIds[ j ] = storedIds[ storedCount ];
+        }
+        else
+        {
+            /* Nothing to clear. */
+        }
+
+        TEST_ASSERT_EQUAL( storedCount, store.usedCount );
+
+        for( j = 0U; j < storedCount; j++ )
+        {
+            expectTestPacket( storedIds[ j ], storedLengths[ storedIds[ j ] ] );
+        }
+    }
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Tests that a QoS 1 PUBLISH is stored as sent, with the DUP flag set,
+ * and that a PUBLISH too large for a slot is not sent.
+ */
+void test_MQTT_RetransmitStore_Publish( void )
+{
+    MQTTPublishInfo_t publishInfo;
+    uint8_t * pPacket = NULL;
+    size_t packetLength = 0U;
+    MQTTStatus_t status;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "payload";
+    publishInfo.payloadLength = 7U;
+
+    context.connectStatus = MQTTConnected;
+    status = MQTT_Publish( &context, &publishInfo, 5U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    TEST_ASSERT_TRUE( context.retrieveFunction( &context, 5U, &pPacket, &packetLength ) );
+    TEST_ASSERT_EQUAL( networkContext.sentLength, packetLength );
+    TEST_ASSERT_EQUAL_HEX8( networkContext.sent[ 0 ] | 0x08U, pPacket[ 0 ] );
+    TEST_ASSERT_EQUAL_MEMORY( &networkContext.sent[ 1 ], &pPacket[ 1 ], packetLength - 1U );
+
+    /* A publish which does not fit in a slot is not sent. */
+    publishInfo.payloadLength = MAX_PACKET_SIZE;
+    networkContext.sentLength = 0U;
+    status = MQTT_Publish( &context, &publishInfo, 6U );
+    TEST_ASSERT_EQUAL( MQTTPublishStoreFailed, status );
+    TEST_ASSERT_EQUAL( 0U, networkContext.sentLength );
+    TEST_ASSERT_EQUAL( 1U, store.usedCount );
+}
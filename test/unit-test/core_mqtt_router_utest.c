@@ -0,0 +1,555 @@
+/*
+ * coreMQTT <DEVELOPMENT BRANCH>
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_mqtt_router_utest.c
+ * @brief Unit tests for functions in core_mqtt_router.h.
+ */
+#include <string.h>
+#include "unity.h"
+
+#include "core_mqtt_router.h"
+
+/* Include config defaults header to get default values of configs. */
+#include "core_mqtt_config_defaults.h"
+
+/**
+ * @brief Number of nodes given to the router under test.
+ */
+#define ROUTER_NODE_COUNT    ( 64U )
+
+/**
+ * @brief Number of hash table slots given to the router under test.
+ */
+#define ROUTER_SLOT_COUNT    ( 128U )
+
+/**
+ * @brief Number of handlers collected by a match.
+ */
+#define HANDLER_COUNT        ( 16U )
+
+/**
+ * @brief Length of a string literal, as a topic length.
+ */
+#define TOPIC_LENGTH( topic )    ( ( uint16_t ) ( sizeof( topic ) - 1U ) )
+
+static MQTTRouter_t router;
+static MQTTRouterNode_t nodes[ ROUTER_NODE_COUNT ];
+static uint16_t slots[ ROUTER_SLOT_COUNT ];
+static void * handlers[ HANDLER_COUNT ];
+
+/**
+ * @brief Handlers registered with the router. Only their addresses matter.
+ */
+static int handlerA, handlerB, handlerC, handlerD;
+
+/* ============================   UNITY FIXTURES ============================ */
+void setUp( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterInit( &router, nodes, ROUTER_NODE_COUNT, slots, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    memset( handlers, 0x00, sizeof( handlers ) );
+}
+
+/* called before each testcase */
+void tearDown( void )
+{
+}
+
+/* called at the beginning of the whole suite */
+void suiteSetUp()
+{
+}
+
+/* called at the end of the whole suite */
+int suiteTearDown( int numFailures )
+{
+    return numFailures;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Check whether a handler is among the handlers returned by a match.
+ */
+static bool handlerMatched( const void * pHandler,
+                            size_t matchCount )
+{
+    bool found = false;
+    size_t i;
+
+    for( i = 0; i < matchCount; i++ )
+    {
+        if( handlers[ i ] == pHandler )
+        {
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Match a topic name and return the number of matching topic filters.
+ */
+static size_t matchTopic( const char * pTopicName )
+{
+    MQTTStatus_t status;
+    size_t matchCount = 0;
+
+    status = MQTT_RouterMatch( &router,
+                               pTopicName,
+                               ( uint16_t ) strlen( pTopicName ),
+                               handlers,
+                               HANDLER_COUNT,
+                               &matchCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    return matchCount;
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test input validation of MQTT_RouterInit.
+ */
+void test_MQTT_RouterInit_Invalid_Params( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterInit( NULL, nodes, ROUTER_NODE_COUNT, slots, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, NULL, ROUTER_NODE_COUNT, slots, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, nodes, ROUTER_NODE_COUNT, NULL, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, nodes, 0U, slots, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, nodes, MQTT_ROUTER_NODE_INVALID, slots, ROUTER_SLOT_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* The hash table needs more slots than nodes. */
+    status = MQTT_RouterInit( &router, nodes, ROUTER_NODE_COUNT, slots, ROUTER_NODE_COUNT );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, nodes, ROUTER_NODE_COUNT, slots, ROUTER_NODE_COUNT + 1U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test input validation of MQTT_RouterAdd, including invalid topic
+ * filters.
+ */
+void test_MQTT_RouterAdd_Invalid_Params( void )
+{
+    MQTTStatus_t status;
+    MQTTRouter_t uninitialized = { 0 };
+    char deepFilter[ ( MQTT_ROUTER_MAX_TOPIC_LEVELS + 1U ) * 2U ];
+    size_t i;
+
+    status = MQTT_RouterAdd( NULL, "a", 1U, &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &uninitialized, "a", 1U, &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &router, NULL, 1U, &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &router, "a", 0U, &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &router, "a", 1U, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* Wildcards must occupy a whole topic level. */
+    status = MQTT_RouterAdd( &router, "a#", TOPIC_LENGTH( "a#" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &router, "a/+b", TOPIC_LENGTH( "a/+b" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* "#" must be the last topic level. */
+    status = MQTT_RouterAdd( &router, "a/#/b", TOPIC_LENGTH( "a/#/b" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* Build "a/a/.../a" with one more level than allowed. */
+    for( i = 0; i <= MQTT_ROUTER_MAX_TOPIC_LEVELS; i++ )
+    {
+        deepFilter[ i * 2U ] = 'a';
+        deepFilter[ ( i * 2U ) + 1U ] = '/';
+    }
+
+    status = MQTT_RouterAdd( &router,
+                             deepFilter,
+                             ( uint16_t ) ( ( ( MQTT_ROUTER_MAX_TOPIC_LEVELS + 1U ) * 2U ) - 1U ),
+                             &handlerA );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* One level less is accepted. */
+    status = MQTT_RouterAdd( &router,
+                             deepFilter,
+                             ( uint16_t ) ( ( MQTT_ROUTER_MAX_TOPIC_LEVELS * 2U ) - 1U ),
+                             &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a/a" ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that adding the same topic filter twice is rejected.
+ */
+void test_MQTT_RouterAdd_Duplicate( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterAdd( &router, "a/+", TOPIC_LENGTH( "a/+" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_RouterAdd( &router, "a/+", TOPIC_LENGTH( "a/+" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, status );
+
+    status = MQTT_RouterAdd( &router, "a/#", TOPIC_LENGTH( "a/#" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_RouterAdd( &router, "a/#", TOPIC_LENGTH( "a/#" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, status );
+
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "a/b" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerB, 2U ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that a topic filter which does not fit in the router leaves
+ * no nodes behind.
+ */
+void test_MQTT_RouterAdd_No_Memory( void )
+{
+    MQTTStatus_t status;
+    MQTTRouterNode_t smallNodes[ 4 ];
+    uint16_t smallSlots[ 8 ];
+
+    status = MQTT_RouterInit( &router, smallNodes, 4U, smallSlots, 8U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* The root and two nodes are used, one node is left. */
+    status = MQTT_RouterAdd( &router, "a/b", TOPIC_LENGTH( "a/b" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* "c/d" needs two new nodes. */
+    status = MQTT_RouterAdd( &router, "c/d", TOPIC_LENGTH( "c/d" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, status );
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "c/d" ) );
+
+    /* The node created for "c" was released again. */
+    status = MQTT_RouterAdd( &router, "a/c", TOPIC_LENGTH( "a/c" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "a/b" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerA, handlers[ 0 ] );
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "a/c" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerB, handlers[ 0 ] );
+
+    /* Filters ending with "#" need no node for the last level. */
+    status = MQTT_RouterAdd( &router, "a/#", TOPIC_LENGTH( "a/#" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "a/c" ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test removing topic filters from the router.
+ */
+void test_MQTT_RouterRemove( void )
+{
+    MQTTStatus_t status;
+    MQTTRouterNode_t smallNodes[ 4 ];
+    uint16_t smallSlots[ 8 ];
+
+    status = MQTT_RouterRemove( NULL, "a", 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterRemove( &router, NULL, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterRemove( &router, "a", 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterRemove( &router, "a#", TOPIC_LENGTH( "a#" ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterInit( &router, smallNodes, 4U, smallSlots, 8U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_RouterAdd( &router, "a/b", TOPIC_LENGTH( "a/b" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "a/#", TOPIC_LENGTH( "a/#" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Filters which were not added. */
+    status = MQTT_RouterRemove( &router, "a", TOPIC_LENGTH( "a" ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterRemove( &router, "a/c", TOPIC_LENGTH( "a/c" ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterRemove( &router, "#", TOPIC_LENGTH( "#" ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* Removing "a/b" keeps node "a" for "a/#". */
+    status = MQTT_RouterRemove( &router, "a/b", TOPIC_LENGTH( "a/b" ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterRemove( &router, "a/b", TOPIC_LENGTH( "a/b" ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "a/b" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerB, handlers[ 0 ] );
+
+    /* Removing "a/#" releases every node, so three levels fit again. */
+    status = MQTT_RouterRemove( &router, "a/#", TOPIC_LENGTH( "a/#" ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "a/b" ) );
+
+    status = MQTT_RouterAdd( &router, "x/+/z", TOPIC_LENGTH( "x/+/z" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "x/y/z" ) );
+
+    status = MQTT_RouterRemove( &router, "x/+/z", TOPIC_LENGTH( "x/+/z" ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "x/y/z" ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test matching topic names against literal and wildcard topic
+ * filters.
+ */
+void test_MQTT_RouterMatch_Wildcards( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterAdd( &router, "sport/tennis/+", TOPIC_LENGTH( "sport/tennis/+" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "sport/#", TOPIC_LENGTH( "sport/#" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "+/+/player1", TOPIC_LENGTH( "+/+/player1" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "sport/tennis/player1", TOPIC_LENGTH( "sport/tennis/player1" ), &handlerD );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    TEST_ASSERT_EQUAL( 4U, matchTopic( "sport/tennis/player1" ) );
+
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "sport/tennis/player2" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerB, 2U ) );
+
+    /* "#" also matches the parent level. */
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "sport" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerB, handlers[ 0 ] );
+
+    /* "+" matches an empty topic level. */
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "sport/tennis/" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "news//player1" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerC, handlers[ 0 ] );
+
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "news/player1" ) );
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "sports/tennis/player1/x" ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that topic names starting with "$" are not matched by topic
+ * filters starting with a wildcard.
+ */
+void test_MQTT_RouterMatch_System_Topic( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterAdd( &router, "#", TOPIC_LENGTH( "#" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "+/monitor/Clients", TOPIC_LENGTH( "+/monitor/Clients" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "$SYS/#", TOPIC_LENGTH( "$SYS/#" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    TEST_ASSERT_EQUAL( 1U, matchTopic( "$SYS/monitor/Clients" ) );
+    TEST_ASSERT_EQUAL_PTR( &handlerC, handlers[ 0 ] );
+
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "SYS/monitor/Clients" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerB, 2U ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test input validation of MQTT_RouterMatch and reporting more
+ * matches than fit in the handler array.
+ */
+void test_MQTT_RouterMatch_Invalid_Params( void )
+{
+    MQTTStatus_t status;
+    size_t matchCount = 0;
+
+    status = MQTT_RouterMatch( NULL, "a", 1U, handlers, HANDLER_COUNT, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterMatch( &router, NULL, 1U, handlers, HANDLER_COUNT, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterMatch( &router, "a", 0U, handlers, HANDLER_COUNT, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterMatch( &router, "a", 1U, NULL, HANDLER_COUNT, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_RouterMatch( &router, "a", 1U, handlers, HANDLER_COUNT, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_RouterAdd( &router, "a", TOPIC_LENGTH( "a" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "+", TOPIC_LENGTH( "+" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "#", TOPIC_LENGTH( "#" ), &handlerC );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* A NULL array only counts the matches. */
+    status = MQTT_RouterMatch( &router, "a", 1U, NULL, 0U, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, status );
+    TEST_ASSERT_EQUAL( 3U, matchCount );
+
+    status = MQTT_RouterMatch( &router, "a", 1U, handlers, 2U, &matchCount );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, status );
+    TEST_ASSERT_EQUAL( 3U, matchCount );
+    TEST_ASSERT_NOT_NULL( handlers[ 0 ] );
+    TEST_ASSERT_NOT_NULL( handlers[ 1 ] );
+    TEST_ASSERT_NULL( handlers[ 2 ] );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test topic names ending at a "+" level which the topic filter
+ * follows with more levels.
+ */
+void test_MQTT_RouterMatch_Plus_At_End_Of_Topic_Name( void )
+{
+    MQTTStatus_t status;
+
+    status = MQTT_RouterAdd( &router, "sport/+/#", TOPIC_LENGTH( "sport/+/#" ), &handlerA );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_RouterAdd( &router, "+/+", TOPIC_LENGTH( "+/+" ), &handlerB );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* "#" matches zero levels after the level matched by "+". */
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "sport/tennis" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerB, 2U ) );
+
+    /* The second "+" matches the empty level after the last '/'. */
+    TEST_ASSERT_EQUAL( 2U, matchTopic( "sport/" ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerA, 2U ) );
+    TEST_ASSERT_TRUE( handlerMatched( &handlerB, 2U ) );
+
+    TEST_ASSERT_EQUAL( 0U, matchTopic( "sport" ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that the router agrees with MQTT_MatchTopic for every pair of
+ * topic filter and topic name in a set of both.
+ */
+void test_MQTT_RouterMatch_Agrees_With_MatchTopic( void )
+{
+    static const char * const filters[] =
+    {
+        "#",           "+",           "+/b",       "a",        "a/#",
+        "a/+",         "a/b",         "a/b/c",     "a/+/c",    "a/b/#",
+        "+/b/+",       "a//c",        "a/+/+/d",   "/a",       "/+",
+        "+/",          "$SYS/#",      "$SYS/+/x",  "b/x/#",    "a/b/c/d/e/f",
+        "a/+/c/+/e/#", "+/+/+/+/+",   "ab",        "a/bc"
+    };
+    static const char * const topics[] =
+    {
+        "a",       "b",     "a/",      "/a",         "a/b",       "a/c",
+        "a/b/c",   "a//c",  "a/b/c/d", "a/x/c/y/e",  "a/b/c/d/e/f",
+        "$SYS/x",  "$SYS",  "$SYS/y/x", "b/x",       "b/x/y",     "/",
+        "ab",      "a/bc",  "ab/c",    "a/b/c/d/e/f/g"
+    };
+    size_t filterCount = sizeof( filters ) / sizeof( filters[ 0 ] );
+    size_t topicCount = sizeof( topics ) / sizeof( topics[ 0 ] );
+    MQTTStatus_t status;
+    size_t matchCount;
+    size_t expectedCount;
+    size_t f, t;
+    bool isMatch;
+
+    for( f = 0; f < filterCount; f++ )
+    {
+        status = MQTT_RouterAdd( &router,
+                                 filters[ f ],
+                                 ( uint16_t ) strlen( filters[ f ] ),
+                                 ( void * ) &filters[ f ] );
+        TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    }
+
+    for( t = 0; t < topicCount; t++ )
+    {
+        matchCount = matchTopic( topics[ t ] );
+        expectedCount = 0;
+
+        for( f = 0; f < filterCount; f++ )
+        {
+            isMatch = false;
+            status = MQTT_MatchTopic( topics[ t ],
+                                      ( uint16_t ) strlen( topics[ t ] ),
+                                      filters[ f ],
+                                      ( uint16_t ) strlen( filters[ f ] ),
+                                      &isMatch );
+            TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+            if( isMatch == true )
+            {
+                expectedCount++;
+            }
+
+            TEST_ASSERT_EQUAL_MESSAGE( isMatch,
+                                       handlerMatched( &filters[ f ], matchCount ),
+                                       filters[ f ] );
+        }
+
+        TEST_ASSERT_EQUAL_MESSAGE( expectedCount, matchCount, topics[ t ] );
+    }
+}
@@ -67,9 +67,9 @@ struct NetworkContext
 
 
 /**
- * @brief MQTT protocol version 3.1.1.
+ * @brief Protocol level byte sent in CONNECT for MQTT 3.1.1.
  */
-#define MQTT_VERSION_3_1_1                  ( ( uint8_t ) 4U )
+#define MQTT_PROTOCOL_LEVEL_3_1_1           ( ( uint8_t ) 4U )
 
 /**
  * @brief Test-defined macro for MQTT username.
@@ -1972,6 +1972,146 @@ void test_MQTT_GetIncomingPacketTypeAndLength( void )
     TEST_ASSERT_EQUAL( MQTTBadResponse, status );
 }
 
+/**
+ * @brief Bytes returned by #mockReceiveAvailable.
+ */
+static const uint8_t * pAvailableBytes = NULL;
+
+/**
+ * @brief Number of bytes left in #pAvailableBytes.
+ */
+static size_t availableByteCount = 0;
+
+/**
+ * @brief Number of calls to #mockReceiveAvailable.
+ */
+static size_t receiveCallCount = 0;
+
+/**
+ * @brief Mock transport receive returning at most the bytes available.
+ */
+static int32_t mockReceiveAvailable( NetworkContext_t * pNetworkContext,
+                                     void * pBuffer,
+                                     size_t bytesToRecv )
+{
+    size_t bytesRead = ( bytesToRecv < availableByteCount ) ? bytesToRecv : availableByteCount;
+
+    ( void ) pNetworkContext;
+
+    if( bytesRead > 0U )
+    {
+        memcpy( pBuffer, pAvailableBytes, bytesRead );
+        pAvailableBytes += bytesRead;
+        availableByteCount -= bytesRead;
+    }
+
+    receiveCallCount++;
+
+    return ( int32_t ) bytesRead;
+}
+
+/**
+ * @brief Tests that MQTT_GetIncomingPacketTypeAndLengthBuffered decodes the
+ * fixed header from bytes received with one call, and keeps the bytes of
+ * following packets.
+ */
+void test_MQTT_GetIncomingPacketTypeAndLengthBuffered( void )
+{
+    MQTTStatus_t status;
+    MQTTPacketInfo_t mqttPacket;
+    NetworkContext_t networkContext = { 0 };
+    uint8_t buffer[ 16 ];
+    MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+    size_t bytesInBuffer = 0;
+    /* A PUBACK followed by a PUBLISH with a remaining length of 128. */
+    const uint8_t stream[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01,
+                               MQTT_PACKET_TYPE_PUBLISH, 0x80, 0x01, 0x00 };
+    const uint8_t invalidLength[] = { MQTT_PACKET_TYPE_PUBLISH, 0xFF, 0xFF, 0xFF, 0xFF };
+
+    memset( &mqttPacket, 0x00, sizeof( mqttPacket ) );
+
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( NULL, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, NULL, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, NULL, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* The buffer must hold a whole fixed header. */
+    fixedBuffer.size = 4;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    fixedBuffer.size = sizeof( buffer );
+
+    bytesInBuffer = sizeof( buffer ) + 1U;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    bytesInBuffer = 0;
+
+    fixedBuffer.pBuffer = NULL;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    fixedBuffer.pBuffer = buffer;
+
+    /* Nothing to read. */
+    availableByteCount = 0;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTNoDataAvailable, status );
+
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveFailure, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, status );
+
+    /* A partial header is kept until the rest arrives. */
+    pAvailableBytes = &stream[ 4 ];
+    availableByteCount = 2;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, status );
+    TEST_ASSERT_EQUAL( 2, bytesInBuffer );
+
+    availableByteCount = 2;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH, mqttPacket.type );
+    TEST_ASSERT_EQUAL( 128, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL( 3, mqttPacket.headerLength );
+    TEST_ASSERT_EQUAL( 4, bytesInBuffer );
+
+    /* Two packets are received with one call. The second header is decoded
+     * without calling the transport again. */
+    bytesInBuffer = 0;
+    receiveCallCount = 0;
+    pAvailableBytes = stream;
+    availableByteCount = sizeof( stream );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBACK, mqttPacket.type );
+    TEST_ASSERT_EQUAL( 2, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL( 2, mqttPacket.headerLength );
+    TEST_ASSERT_EQUAL( sizeof( stream ), bytesInBuffer );
+
+    memmove( buffer, &buffer[ 4 ], bytesInBuffer - 4U );
+    bytesInBuffer -= 4U;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH, mqttPacket.type );
+    TEST_ASSERT_EQUAL( 128, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL( 1, receiveCallCount );
+
+    /* Invalid packets are reported as with the unbuffered function. */
+    bytesInBuffer = 0;
+    pAvailableBytes = invalidLength;
+    availableByteCount = sizeof( invalidLength );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    bytesInBuffer = 1;
+    buffer[ 0 ] = 0x10;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveAvailable, &networkContext, &fixedBuffer, &bytesInBuffer, &mqttPacket );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
 /* ========================================================================== */
 
 /**
@@ -2179,6 +2319,243 @@ void test_MQTT_SerializePublishHeaderWithoutTopic_VariousFlagsSetTopicLength( vo
 
 /* ========================================================================== */
 
+/**
+ * @brief Tests that MQTT_SerializeVariableByteInteger encodes the boundaries of
+ * each encoded size and rejects invalid parameters.
+ */
+void test_MQTT_SerializeVariableByteInteger( void )
+{
+    uint8_t buffer[ 5 ] = { 0 };
+    size_t encodedSize = 0;
+    MQTTStatus_t status;
+
+    status = MQTT_SerializeVariableByteInteger( 0U, NULL, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_SerializeVariableByteInteger( 0U, buffer, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_SerializeVariableByteInteger( 268435456U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    status = MQTT_SerializeVariableByteInteger( 0U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1U, encodedSize );
+    TEST_ASSERT_EQUAL( 0x00U, buffer[ 0 ] );
+
+    status = MQTT_SerializeVariableByteInteger( 127U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1U, encodedSize );
+    TEST_ASSERT_EQUAL( 0x7FU, buffer[ 0 ] );
+
+    status = MQTT_SerializeVariableByteInteger( 128U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 2U, encodedSize );
+    TEST_ASSERT_EQUAL( 0x80U, buffer[ 0 ] );
+    TEST_ASSERT_EQUAL( 0x01U, buffer[ 1 ] );
+
+    status = MQTT_SerializeVariableByteInteger( 16384U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 3U, encodedSize );
+
+    /* The buffer is not written past the encoded length. */
+    buffer[ 4 ] = 0xA5U;
+    status = MQTT_SerializeVariableByteInteger( 268435455U, buffer, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 4U, encodedSize );
+    TEST_ASSERT_EQUAL( 0xFFU, buffer[ 0 ] );
+    TEST_ASSERT_EQUAL( 0xFFU, buffer[ 1 ] );
+    TEST_ASSERT_EQUAL( 0xFFU, buffer[ 2 ] );
+    TEST_ASSERT_EQUAL( 0x7FU, buffer[ 3 ] );
+    TEST_ASSERT_EQUAL( 0xA5U, buffer[ 4 ] );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Reference decoder of a Variable Byte Integer, looping over the bytes
+ * as the MQTT v3.1.1 spec does. The codec under test must agree with it.
+ */
+static MQTTStatus_t decodeVariableByteIntegerReference( const uint8_t * pBuffer,
+                                                        size_t bufferSize,
+                                                        size_t * pValue,
+                                                        size_t * pEncodedSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t value = 0U, multiplier = 1U, bytesDecoded = 0U;
+    uint8_t encodedByte = 0U;
+
+    do
+    {
+        if( multiplier > 2097152U )
+        {
+            status = MQTTBadResponse;
+        }
+        else if( bytesDecoded >= bufferSize )
+        {
+            status = MQTTNeedMoreBytes;
+        }
+        else
+        {
+            encodedByte = pBuffer[ bytesDecoded ];
+            value += ( ( size_t ) encodedByte & 0x7FU ) * multiplier;
+            multiplier *= 128U;
+            bytesDecoded++;
+        }
+    } while( ( status == MQTTSuccess ) && ( ( encodedByte & 0x80U ) != 0U ) );
+
+    if( status == MQTTSuccess )
+    {
+        uint8_t encoded[ 5 ];
+
+        /* Only the shortest encoding is valid. */
+        if( encodeRemainingLength( encoded, value ) != bytesDecoded )
+        {
+            status = MQTTBadResponse;
+        }
+        else
+        {
+            *pValue = value;
+            *pEncodedSize = bytesDecoded;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Tests that MQTT_DeserializeVariableByteInteger decodes every encoded
+ * size and rejects truncated, overlong and non-minimal encodings.
+ */
+void test_MQTT_DeserializeVariableByteInteger( void )
+{
+    uint8_t buffer[ 5 ] = { 0 };
+    size_t value = 0U, encodedSize = 0U;
+    MQTTStatus_t status;
+
+    status = MQTT_DeserializeVariableByteInteger( NULL, 1U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_DeserializeVariableByteInteger( buffer, 1U, NULL, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_DeserializeVariableByteInteger( buffer, 1U, &value, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_DeserializeVariableByteInteger( buffer, 0U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, status );
+
+    /* Bytes after the encoding are ignored. */
+    buffer[ 0 ] = 0x80U;
+    buffer[ 1 ] = 0x01U;
+    buffer[ 2 ] = 0xFFU;
+    status = MQTT_DeserializeVariableByteInteger( buffer, 3U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 128U, value );
+    TEST_ASSERT_EQUAL( 2U, encodedSize );
+
+    /* The buffer ends before the last byte. */
+    status = MQTT_DeserializeVariableByteInteger( buffer, 1U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, status );
+
+    /* The largest value, then a fifth byte. */
+    buffer[ 0 ] = 0xFFU;
+    buffer[ 1 ] = 0xFFU;
+    buffer[ 2 ] = 0xFFU;
+    buffer[ 3 ] = 0x7FU;
+    status = MQTT_DeserializeVariableByteInteger( buffer, 4U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 268435455U, value );
+    TEST_ASSERT_EQUAL( 4U, encodedSize );
+    buffer[ 3 ] = 0xFFU;
+    buffer[ 4 ] = 0x01U;
+    status = MQTT_DeserializeVariableByteInteger( buffer, 5U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+    status = MQTT_DeserializeVariableByteInteger( buffer, 3U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, status );
+
+    /* 0 encoded in 2 bytes is not the shortest encoding. */
+    buffer[ 0 ] = 0x80U;
+    buffer[ 1 ] = 0x00U;
+    status = MQTT_DeserializeVariableByteInteger( buffer, 2U, &value, &encodedSize );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+}
+
+/**
+ * @brief Differential test of the Variable Byte Integer codec against the
+ * byte at a time reference encoder and decoder, over the boundaries of every
+ * encoded size and pseudo random values and byte strings.
+ */
+void test_MQTT_VariableByteInteger_MatchesReference( void )
+{
+    static const size_t boundaries[] =
+    {
+        0U, 1U, 127U, 128U, 129U, 16383U, 16384U, 16385U,
+        2097151U, 2097152U, 2097153U, 268435454U, 268435455U
+    };
+    uint8_t expected[ 5 ], actual[ 5 ];
+    size_t expectedValue = 0U, expectedSize = 0U;
+    size_t actualValue = 0U, actualSize = 0U;
+    MQTTStatus_t expectedStatus, actualStatus;
+    uint32_t random = 1U;
+    size_t value, bufferSize, i, j;
+
+    for( i = 0U; i < ( sizeof( boundaries ) / sizeof( boundaries[ 0 ] ) ) + 100000U; i++ )
+    {
+        if( i < ( sizeof( boundaries ) / sizeof( boundaries[ 0 ] ) ) )
+        {
+            value = boundaries[ i ];
+        }
+        else
+        {
+            /* Spread the values over every encoded size. */
+            random = ( random * 1103515245U ) + 12345U;
+            value = ( ( size_t ) random & 0x0FFFFFFFU ) >> ( ( random >> 28 ) % 28U );
+        }
+
+        expectedSize = encodeRemainingLength( expected, value );
+        TEST_ASSERT_EQUAL( expectedSize, MQTT_GetVariableByteIntegerSize( value ) );
+
+        actualStatus = MQTT_SerializeVariableByteInteger( value, actual, &actualSize );
+        TEST_ASSERT_EQUAL( MQTTSuccess, actualStatus );
+        TEST_ASSERT_EQUAL( expectedSize, actualSize );
+        TEST_ASSERT_EQUAL_MEMORY( expected, actual, expectedSize );
+
+        actualStatus = MQTT_DeserializeVariableByteInteger( expected, expectedSize, &actualValue, &actualSize );
+        TEST_ASSERT_EQUAL( MQTTSuccess, actualStatus );
+        TEST_ASSERT_EQUAL( value, actualValue );
+        TEST_ASSERT_EQUAL( expectedSize, actualSize );
+    }
+
+    /* Arbitrary bytes, mostly with the continuation bit set so that long,
+     * truncated and non-minimal encodings are all covered. */
+    for( i = 0U; i < 100000U; i++ )
+    {
+        random = ( random * 1103515245U ) + 12345U;
+        bufferSize = ( random >> 16 ) % 6U;
+
+        for( j = 0U; j < sizeof( expected ); j++ )
+        {
+            random = ( random * 1103515245U ) + 12345U;
+            expected[ j ] = ( uint8_t ) ( random >> 24 );
+
+            if( ( ( random >> 8 ) % 4U ) != 0U )
+            {
+                expected[ j ] |= 0x80U;
+            }
+        }
+
+        expectedStatus = decodeVariableByteIntegerReference( expected, bufferSize, &expectedValue, &expectedSize );
+        actualStatus = MQTT_DeserializeVariableByteInteger( expected, bufferSize, &actualValue, &actualSize );
+        TEST_ASSERT_EQUAL( expectedStatus, actualStatus );
+
+        if( expectedStatus == MQTTSuccess )
+        {
+            TEST_ASSERT_EQUAL( expectedValue, actualValue );
+            TEST_ASSERT_EQUAL( expectedSize, actualSize );
+        }
+    }
+}
+
+/* ========================================================================== */
+
 /**
  * @brief Tests that MQTT_SerializePublishHeader works as intended.
  */
@@ -2646,7 +3023,7 @@ static void verifySerializedConnectPacket( const MQTTConnectInfo_t * const pConn
     pIndex += encodedStringLength;
 
     /* The MQTT protocol version is the second field of the variable header. */
-    TEST_ASSERT_EQUAL( MQTT_VERSION_3_1_1, *pIndex );
+    TEST_ASSERT_EQUAL( MQTT_PROTOCOL_LEVEL_3_1_1, *pIndex );
     pIndex++;
 
     /* Set the clean session flag if needed. */
@@ -34,6 +34,10 @@
 #define MQTT_PACKET_ID_INVALID         ( ( uint16_t ) 0U )
 #define  MQTT_STATE_ARRAY_MAX_COUNT    10
 
+/* Records of an indexed array of MQTT_STATE_ARRAY_MAX_COUNT records which may
+ * be in use, a quarter being kept free. */
+#define  INDEXED_RECORD_LIMIT          8
+
 /* ============================   UNITY FIXTURES ============================ */
 void setUp( void )
 {
@@ -363,6 +367,63 @@ void test_MQTT_RemoveStateRecord_RemoveQoS2Record( void )
 
 /* ========================================================================== */
 
+void test_MQTT_RemoveIncomingStateRecord_Invalid_Params( void )
+{
+    MQTTStatus_t status;
+    MQTTContext_t context;
+    MQTTPubAckInfo_t incomingRecords[ 5 ];
+
+    status = MQTT_RemoveIncomingStateRecord( NULL, 12U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    memset( &context, 0, sizeof( MQTTContext_t ) );
+
+    status = MQTT_RemoveIncomingStateRecord( &context, 12U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    context.incomingPublishRecords = incomingRecords;
+    context.incomingPublishRecordMaxCount = 5;
+    memset( context.incomingPublishRecords, 0, sizeof( incomingRecords ) );
+
+    /* No record with this packet ID. */
+    status = MQTT_RemoveIncomingStateRecord( &context, 12U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/* ========================================================================== */
+
+void test_MQTT_RemoveIncomingStateRecord_Happy_Path( void )
+{
+    MQTTStatus_t status;
+    MQTTContext_t context;
+    MQTTPubAckInfo_t incomingRecords[ 5 ];
+    const uint16_t packetID = 12;
+
+    memset( &context, 0, sizeof( MQTTContext_t ) );
+
+    context.incomingPublishRecords = incomingRecords;
+    context.incomingPublishRecordMaxCount = 5;
+
+    memset( context.incomingPublishRecords, 0, sizeof( incomingRecords ) );
+
+    context.incomingPublishRecords[ 2 ].packetId = packetID;
+    context.incomingPublishRecords[ 2 ].publishState = MQTTPubRecSend;
+    context.incomingPublishRecords[ 2 ].qos = MQTTQoS2;
+
+    status = MQTT_RemoveIncomingStateRecord( &context, packetID );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, context.incomingPublishRecords[ 2 ].packetId );
+    TEST_ASSERT_EQUAL( MQTTStateNull, context.incomingPublishRecords[ 2 ].publishState );
+    TEST_ASSERT_EQUAL( MQTTQoS0, context.incomingPublishRecords[ 2 ].qos );
+
+    /* The packet ID can now be received again. */
+    status = MQTT_RemoveIncomingStateRecord( &context, packetID );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/* ========================================================================== */
+
 void test_MQTT_ReserveState_compactRecords( void )
 {
     MQTTContext_t mqttContext = { 0 };
@@ -1113,6 +1174,519 @@ void test_MQTT_PublishToResend( void )
 
 /* ========================================================================== */
 
+void test_MQTT_IndexedRecords( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTPublishState_t state;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    /* The smallest valid index, so that probe sequences are long. */
+    MQTTPubAckIndexSlot_t incomingSlots[ MQTT_STATE_ARRAY_MAX_COUNT + 1 ] = { 0 };
+    MQTTPubAckIndexSlot_t outgoingSlots[ MQTT_STATE_ARRAY_MAX_COUNT + 1 ] = { 0 };
+    MQTTPubAckIndex_t incomingIndex = { 0 };
+    MQTTPubAckIndex_t outgoingIndex = { 0 };
+    const uint16_t PACKET_ID = 1;
+    const uint16_t PACKET_ID2 = PACKET_ID + MQTT_STATE_ARRAY_MAX_COUNT + 1;
+    const uint16_t PACKET_ID3 = PACKET_ID2 + MQTT_STATE_ARRAY_MAX_COUNT + 1;
+    uint16_t packetId;
+    size_t i;
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    outgoingIndex.pSlots = outgoingSlots;
+    outgoingIndex.slotCount = MQTT_STATE_ARRAY_MAX_COUNT + 1;
+    incomingIndex.pSlots = incomingSlots;
+    incomingIndex.slotCount = MQTT_STATE_ARRAY_MAX_COUNT + 1;
+    status = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingIndex, &incomingIndex );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Records are stored in order and found through the index. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, PACKET_ID, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, PACKET_ID2, MQTTQoS2 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, PACKET_ID3, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, MQTT_ReserveState( &mqttContext, PACKET_ID2, MQTTQoS1 ) );
+    validateRecordAt( outgoingRecords, 0, PACKET_ID, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 1, PACKET_ID2, MQTTQoS2, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 2, PACKET_ID3, MQTTQoS1, MQTTPublishSend );
+
+    status = MQTT_UpdateStatePublish( &mqttContext, PACKET_ID3, MQTT_SEND, MQTTQoS1, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubAckPending, state );
+    status = MQTT_UpdateStatePublish( &mqttContext, PACKET_ID2, MQTT_SEND, MQTTQoS2, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubRecPending, state );
+
+    /* Removing a record must keep the others reachable. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, PACKET_ID ) );
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID3, MQTTPuback, MQTT_RECEIVE, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPublishDone, state );
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID3, MQTTPuback, MQTT_RECEIVE, &state );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, status );
+
+    /* A PUBREC moves the record to the tail, which is the start of the
+     * records once they are all deleted. */
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID2, MQTTPubrec, MQTT_RECEIVE, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubRelSend, state );
+    validateRecordAt( outgoingRecords, 0, PACKET_ID2, MQTTQoS2, MQTTPubRelSend );
+
+    /* A quarter of the records are kept free of new records. */
+    for( i = 1; i < INDEXED_RECORD_LIMIT; i++ )
+    {
+        status = MQTT_ReserveState( &mqttContext, ( uint16_t ) ( 100U + i ), MQTTQoS1 );
+        TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    }
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, 200, MQTTQoS1 ) );
+
+    /* Holes are compacted once the ring is full, and the index follows the
+     * moves. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 101 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 102 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 200, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 201, MQTTQoS1 ) );
+    validateRecordAt( outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT - 1, 201, MQTTQoS1, MQTTPublishSend );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, 202, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 103 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 202, MQTTQoS1 ) );
+    validateRecordAt( outgoingRecords, 0, PACKET_ID2, MQTTQoS2, MQTTPubRelSend );
+    validateRecordAt( outgoingRecords, 1, 104, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 6, 201, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 7, 202, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 8, MQTT_PACKET_ID_INVALID, MQTTQoS0, MQTTStateNull );
+
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID2, MQTTPubrel, MQTT_SEND, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubCompPending, state );
+    status = MQTT_UpdateStatePublish( &mqttContext, 107, MQTT_SEND, MQTTQoS1, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubAckPending, state );
+    TEST_ASSERT_EQUAL( MQTTPubAckPending, outgoingRecords[ 4 ].publishState );
+
+    /* Resend order is the order of the records. */
+    for( i = 4; i < INDEXED_RECORD_LIMIT; i++ )
+    {
+        packetId = MQTT_PublishToResend( &mqttContext, &cursor );
+        TEST_ASSERT_EQUAL( 100U + i, packetId );
+    }
+
+    TEST_ASSERT_EQUAL( 200, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 201, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 202, MQTT_PublishToResend( &mqttContext, &cursor ) );
+
+    /* Deleting the head frees its position for the tail to wrap into. */
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID2, MQTTPubcomp, MQTT_RECEIVE, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 300, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 104 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 301, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 105 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 302, MQTTQoS1 ) );
+    validateRecordAt( outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT - 2, 300, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT - 1, 301, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( outgoingRecords, 0, 302, MQTTQoS1, MQTTPublishSend );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, 303, MQTTQoS1 ) );
+
+    cursor = MQTT_STATE_CURSOR_INITIALIZER;
+
+    for( i = 6; i < INDEXED_RECORD_LIMIT; i++ )
+    {
+        packetId = MQTT_PublishToResend( &mqttContext, &cursor );
+        TEST_ASSERT_EQUAL( 100U + i, packetId );
+    }
+
+    TEST_ASSERT_EQUAL( 200, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 201, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 202, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 300, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 301, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( 302, MQTT_PublishToResend( &mqttContext, &cursor ) );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, MQTT_PublishToResend( &mqttContext, &cursor ) );
+
+    /* Incoming publishes use their own index. */
+    status = MQTT_UpdateStatePublish( &mqttContext, PACKET_ID, MQTT_RECEIVE, MQTTQoS2, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_UpdateStatePublish( &mqttContext, PACKET_ID, MQTT_RECEIVE, MQTTQoS2, &state );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, status );
+    status = MQTT_UpdateStateAck( &mqttContext, PACKET_ID, MQTTPubrec, MQTT_SEND, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPubRelPending, state );
+}
+
+/* ========================================================================== */
+
+void test_MQTT_IndexedRecords_CompactionCost( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTPublishState_t state;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ 64 ] = { 0 };
+    MQTTPubAckInfo_t previousRecords[ 64 ];
+    MQTTPubAckIndexSlot_t outgoingSlots[ 128 ] = { 0 };
+    MQTTPubAckIndex_t outgoingIndex = { 0 };
+    uint16_t inFlight[ 48 ];
+    uint16_t packetId = 1;
+    size_t movedCount = 0U;
+    size_t i;
+    size_t addCount;
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    status = MQTT_InitStatefulQoS( &mqttContext, outgoingRecords, 64, NULL, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    outgoingIndex.pSlots = outgoingSlots;
+    outgoingIndex.slotCount = 128;
+    status = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Fill the window, which is three quarters of the records. */
+    for( i = 0; i < 48; i++ )
+    {
+        inFlight[ i ] = packetId;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, packetId, MQTTQoS1 ) );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, packetId, MQTT_SEND, MQTTQoS1, &state ) );
+        packetId++;
+    }
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, packetId, MQTTQoS1 ) );
+
+    /* Each publish acknowledged out of order makes room for one more, which
+     * goes at the tail of the ring. */
+    for( addCount = 0U; addCount < 1000U; addCount++ )
+    {
+        status = MQTT_UpdateStateAck( &mqttContext, inFlight[ 24 ], MQTTPuback, MQTT_RECEIVE, &state );
+        TEST_ASSERT_EQUAL( MQTTSuccess, status );
+        TEST_ASSERT_EQUAL( MQTTPublishDone, state );
+        memmove( &inFlight[ 24 ], &inFlight[ 25 ], 23U * sizeof( inFlight[ 0 ] ) );
+
+        memcpy( previousRecords, outgoingRecords, sizeof( outgoingRecords ) );
+        inFlight[ 47 ] = packetId;
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, packetId, MQTTQoS1 ) );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, packetId, MQTT_SEND, MQTTQoS1, &state ) );
+
+        for( i = 0; i < 64; i++ )
+        {
+            if( ( outgoingRecords[ i ].packetId != previousRecords[ i ].packetId ) &&
+                ( outgoingRecords[ i ].packetId != MQTT_PACKET_ID_INVALID ) &&
+                ( outgoingRecords[ i ].packetId != packetId ) )
+            {
+                movedCount++;
+            }
+        }
+
+        packetId++;
+    }
+
+    /* A compaction moves at most the 48 records in flight, and leaves 16 free
+     * positions at the tail. */
+    TEST_ASSERT_LESS_OR_EQUAL( 3U * addCount, movedCount );
+
+    /* The records keep their order and are still found through the index. */
+    for( i = 0; i < 48; i++ )
+    {
+        TEST_ASSERT_EQUAL( inFlight[ i ], MQTT_PublishToResend( &mqttContext, &cursor ) );
+    }
+
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, MQTT_PublishToResend( &mqttContext, &cursor ) );
+
+    for( i = 0; i < 48; i++ )
+    {
+        status = MQTT_UpdateStateAck( &mqttContext, inFlight[ i ], MQTTPuback, MQTT_RECEIVE, &state );
+        TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    }
+
+    TEST_ASSERT_EQUAL( 0U, outgoingIndex.liveCount );
+}
+
+/* ========================================================================== */
+
+void test_MQTT_IndexStateRecords( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTPublishState_t state;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckIndexSlot_t outgoingSlots[ 2 * MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckIndex_t outgoingIndex = { 0 };
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    /* NULL context is ignored. */
+    MQTT_IndexStateRecords( NULL );
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Records present before the index is attached are indexed. */
+    addToRecord( outgoingRecords, 2, 5, MQTTQoS1, MQTTPubAckPending );
+    addToRecord( outgoingRecords, 4, 7, MQTTQoS2, MQTTPubCompPending );
+    outgoingSlots[ 0 ].packetId = 9;
+    outgoingIndex.pSlots = outgoingSlots;
+    outgoingIndex.slotCount = 2 * MQTT_STATE_ARRAY_MAX_COUNT;
+
+    status = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0U, outgoingIndex.head );
+    TEST_ASSERT_EQUAL( 5U, outgoingIndex.usedCount );
+    TEST_ASSERT_EQUAL( 2U, outgoingIndex.liveCount );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_RemoveStateRecord( &mqttContext, 9 ) );
+    status = MQTT_UpdateStateAck( &mqttContext, 7, MQTTPubcomp, MQTT_RECEIVE, &state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTPublishDone, state );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 5 ) );
+
+    /* Reinitializing the records detaches the index. */
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_NULL( mqttContext.outgoingPublishIndex );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Changes reported to the record state callback.
+ */
+static MQTTPubAckInfo_t recordedStates[ MQTT_STATE_ARRAY_MAX_COUNT ];
+static bool recordedOutgoing[ MQTT_STATE_ARRAY_MAX_COUNT ];
+static size_t recordedCount;
+
+static void recordStateCallback( const MQTTContext_t * pContext,
+                                 uint16_t packetId,
+                                 MQTTQoS_t qos,
+                                 MQTTPublishState_t state,
+                                 bool isOutgoing )
+{
+    ( void ) pContext;
+    TEST_ASSERT_LESS_THAN( MQTT_STATE_ARRAY_MAX_COUNT, recordedCount );
+    addToRecord( recordedStates, recordedCount, packetId, qos, state );
+    recordedOutgoing[ recordedCount ] = isOutgoing;
+    recordedCount++;
+}
+
+void test_MQTT_RecordStateCallback( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTPublishState_t state;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    recordedCount = 0;
+    mqttContext.recordStateFunction = recordStateCallback;
+
+    /* An outgoing QoS 2 publish through to completion. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 1, MQTTQoS2 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, 1, MQTT_SEND, MQTTQoS2, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &mqttContext, 1, MQTTPubrec, MQTT_RECEIVE, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &mqttContext, 1, MQTTPubrel, MQTT_SEND, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &mqttContext, 1, MQTTPubcomp, MQTT_RECEIVE, &state ) );
+
+    /* An incoming QoS 1 publish, and an outgoing one removed after a failed send. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, 2, MQTT_RECEIVE, MQTTQoS1, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveIncomingStateRecord( &mqttContext, 2 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 3, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 3 ) );
+
+    /* Failed updates are not reported. */
+    TEST_ASSERT_EQUAL( MQTTBadResponse, MQTT_UpdateStateAck( &mqttContext, 1, MQTTPuback, MQTT_RECEIVE, &state ) );
+
+    TEST_ASSERT_EQUAL( 9, recordedCount );
+    validateRecordAt( recordedStates, 0, 1, MQTTQoS2, MQTTPublishSend );
+    validateRecordAt( recordedStates, 1, 1, MQTTQoS2, MQTTPubRecPending );
+    validateRecordAt( recordedStates, 2, 1, MQTTQoS2, MQTTPubRelSend );
+    validateRecordAt( recordedStates, 3, 1, MQTTQoS2, MQTTPubCompPending );
+    validateRecordAt( recordedStates, 4, 1, MQTTQoS2, MQTTStateNull );
+    validateRecordAt( recordedStates, 5, 2, MQTTQoS1, MQTTPubAckSend );
+    validateRecordAt( recordedStates, 6, 2, MQTTQoS0, MQTTStateNull );
+    validateRecordAt( recordedStates, 7, 3, MQTTQoS1, MQTTPublishSend );
+    validateRecordAt( recordedStates, 8, 3, MQTTQoS0, MQTTStateNull );
+    TEST_ASSERT_TRUE( recordedOutgoing[ 4 ] );
+    TEST_ASSERT_FALSE( recordedOutgoing[ 5 ] );
+    TEST_ASSERT_FALSE( recordedOutgoing[ 6 ] );
+    TEST_ASSERT_TRUE( recordedOutgoing[ 8 ] );
+}
+
+void test_MQTT_SessionResumePositions( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTSessionResume_t resume = { 0 };
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Pre condition - 0 0 0 0 0 1 0 0 0 1, with the resend past the first
+     * record. */
+    addToRecord( outgoingRecords, 5, 1, MQTTQoS1, MQTTPublishSend );
+    addToRecord( outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT - 1, 2, MQTTQoS1, MQTTPublishSend );
+    resume.packetsPerCall = 1;
+    mqttContext.pSessionResume = &resume;
+
+    /* Positions are left alone when no resend is in progress. */
+    resume.next = 6;
+    resume.end = MQTT_STATE_ARRAY_MAX_COUNT;
+    status = MQTT_ReserveState( &mqttContext, 3, MQTTQoS1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 6U, resume.next );
+    TEST_ASSERT_EQUAL( MQTT_STATE_ARRAY_MAX_COUNT, resume.end );
+
+    /* Compaction moves the positions with the records, and the new record at
+     * the tail is not part of the resumed session. */
+    ( void ) memset( outgoingRecords, 0x00, sizeof( outgoingRecords ) );
+    addToRecord( outgoingRecords, 5, 1, MQTTQoS1, MQTTPublishSend );
+    addToRecord( outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT - 1, 2, MQTTQoS1, MQTTPublishSend );
+    resume.inProgress = true;
+    status = MQTT_ReserveState( &mqttContext, 3, MQTTQoS1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    validateRecordAt( outgoingRecords, 2, 3, MQTTQoS1, MQTTPublishSend );
+    TEST_ASSERT_EQUAL( 1U, resume.next );
+    TEST_ASSERT_EQUAL( 2U, resume.end );
+    TEST_ASSERT_EQUAL( 2U, MQTT_PublishToResend( &mqttContext, &resume.next ) );
+    TEST_ASSERT_EQUAL( 2U, resume.next );
+}
+
+void test_MQTT_SendWindow( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTPublishState_t state;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckIndexSlot_t outgoingSlots[ 2 * MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckIndex_t outgoingIndex = { 0 };
+    size_t freeCount = 0U;
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_GetSendWindow( NULL, &freeCount ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_GetSendWindow( &mqttContext, NULL ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Without a Receive Maximum the window is the number of records. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( MQTT_STATE_ARRAY_MAX_COUNT, freeCount );
+
+    /* Records in use from their reservation take a place in the window. */
+    mqttContext.receiveMaximum = 2;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 1, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( 1U, freeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 2, MQTTQoS2 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( 0U, freeCount );
+
+    /* A full window refuses new publishes, but not duplicates. */
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, 3, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, MQTT_ReserveState( &mqttContext, 2, MQTTQoS2 ) );
+
+    /* Moving a record on PUBREC keeps its place. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, 2, MQTT_SEND, MQTTQoS2, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &mqttContext, 2, MQTTPubrec, MQTT_RECEIVE, &state ) );
+    TEST_ASSERT_EQUAL( MQTTPubRelSend, state );
+
+    /* A PUBACK frees a place. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStatePublish( &mqttContext, 1, MQTT_SEND, MQTTQoS1, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_UpdateStateAck( &mqttContext, 1, MQTTPuback, MQTT_RECEIVE, &state ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( 1U, freeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 3, MQTTQoS1 ) );
+
+    /* A window shrinking below the records in use has no free place. */
+    mqttContext.receiveMaximum = 1;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( 0U, freeCount );
+
+    /* The window applies to indexed records as well. */
+    outgoingIndex.pSlots = outgoingSlots;
+    outgoingIndex.slotCount = 2 * MQTT_STATE_ARRAY_MAX_COUNT;
+    status = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    mqttContext.receiveMaximum = 3;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_GetSendWindow( &mqttContext, &freeCount ) );
+    TEST_ASSERT_EQUAL( 1U, freeCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 4, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, MQTT_ReserveState( &mqttContext, 4, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, MQTT_ReserveState( &mqttContext, 5, MQTTQoS1 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_RemoveStateRecord( &mqttContext, 4 ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_ReserveState( &mqttContext, 5, MQTTQoS1 ) );
+}
+
+/* ========================================================================== */
+
 void test_MQTT_State_strerror( void )
 {
     MQTTPublishState_t state;
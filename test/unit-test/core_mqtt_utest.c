@@ -189,8 +189,9 @@ typedef struct ProcessLoopReturns
  */
 struct MQTTVec
 {
-    TransportOutVector_t * pVector; /**< Pointer to transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
-    size_t vectorLen;               /**< Length of the transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    TransportOutVector_t * pVector;         /**< Pointer to transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    size_t vectorLen;                       /**< Length of the transport vector. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
+    const MQTTPublishInfo_t * pPublishInfo; /**< Publish whose topic name and payload the vector refers to. USER SHOULD NOT ACCESS THIS DIRECTLY - IT IS AN INTERNAL DETAIL AND CAN CHANGE. */
 };
 
 /**
@@ -539,6 +540,65 @@ bool publishRetrieveCallbackFailed( struct MQTTContext * pContext,
     return false;
 }
 
+/**
+ * @brief Vectors returned by #publishRetrieveVectorCallbackSuccess.
+ */
+static TransportOutVector_t publishCopyVectors[ 2 ];
+
+/**
+ * @brief Mocked successful publish vector retrieve function.
+ *
+ * @param[in] pContext initialised mqtt context.
+ * @param[in] packetId packet id
+ * @param[out] pIoVec array of transportout vectors
+ * @param[out] pIoVecCount number of vectors in the array
+ *
+ * @return true if retrieve is successful else false
+ */
+bool publishRetrieveVectorCallbackSuccess( struct MQTTContext * pContext,
+                                           uint16_t packetId,
+                                           TransportOutVector_t ** pIoVec,
+                                           size_t * pIoVecCount )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+
+    /* The header and the rest of the stored packet. */
+    publishCopyVectors[ 0 ].iov_base = publishCopyBuffer;
+    publishCopyVectors[ 0 ].iov_len = 2U;
+    publishCopyVectors[ 1 ].iov_base = &publishCopyBuffer[ 2 ];
+    publishCopyVectors[ 1 ].iov_len = publishCopyBufferSize - 2U;
+
+    *pIoVec = publishCopyVectors;
+    *pIoVecCount = 2U;
+
+    return true;
+}
+
+/**
+ * @brief Mocked publish vector retrieve function which returns no vectors.
+ *
+ * @param[in] pContext initialised mqtt context.
+ * @param[in] packetId packet id
+ * @param[out] pIoVec array of transportout vectors
+ * @param[out] pIoVecCount number of vectors in the array
+ *
+ * @return true always
+ */
+bool publishRetrieveVectorCallbackEmpty( struct MQTTContext * pContext,
+                                         uint16_t packetId,
+                                         TransportOutVector_t ** pIoVec,
+                                         size_t * pIoVecCount )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+
+    *pIoVec = publishCopyVectors;
+    *pIoVecCount = 0U;
+
+    return true;
+}
+
 /**
  * @brief Mocked publish clear function.
  *
@@ -1421,6 +1481,151 @@ void test_MQTT_InitRetransmits_Invalid_Params( void )
     TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 
+/**
+ * @brief Test that MQTT_InitRetransmitVectors validates its parameters and
+ * replaces a retrieve function registered by MQTT_InitRetransmits.
+ */
+void test_MQTT_InitRetransmitVectors( void )
+{
+    MQTTStatus_t mqttStatus = { 0 };
+    MQTTContext_t context = { 0 };
+
+    mqttStatus = MQTT_InitRetransmitVectors( NULL, publishStoreCallbackSuccess,
+                                             publishRetrieveVectorCallbackSuccess,
+                                             publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRetransmitVectors( &context, NULL,
+                                             publishRetrieveVectorCallbackSuccess,
+                                             publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRetransmitVectors( &context, publishStoreCallbackSuccess,
+                                             NULL,
+                                             publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRetransmitVectors( &context, publishStoreCallbackSuccess,
+                                             publishRetrieveVectorCallbackSuccess,
+                                             NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                                       publishRetrieveCallbackSuccess,
+                                       publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_InitRetransmitVectors( &context, publishStoreCallbackSuccess,
+                                             publishRetrieveVectorCallbackSuccess,
+                                             publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.retrieveFunction );
+    TEST_ASSERT_EQUAL_PTR( publishRetrieveVectorCallbackSuccess, context.retrieveVectorFunction );
+    TEST_ASSERT_EQUAL_PTR( publishStoreCallbackSuccess, context.storeFunction );
+    TEST_ASSERT_EQUAL_PTR( publishClearCallback, context.clearFunction );
+
+    /* Registering a flat retrieve function again drops the vector one. */
+    mqttStatus = MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                                       publishRetrieveCallbackSuccess,
+                                       publishClearCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.retrieveVectorFunction );
+}
+
+/**
+ * @brief Test that MQTT_InitTopicAliases validates its parameters and leaves
+ * every alias unused until a CONNACK allows them.
+ */
+void test_MQTT_InitTopicAliases( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTTopicAlias_t aliasMemory[ 2 ];
+    uint8_t arena[ MQTT_TOPIC_ALIASES_ARENA_SIZE( 2, 16 ) ];
+    MQTTTopicAliases_t aliases = { 0 };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( NULL, &aliases ) );
+
+    /* Memory for the aliases and their topic names is required. */
+    aliases.pArena = arena;
+    aliases.arenaSize = sizeof( arena );
+    aliases.aliasCount = 2U;
+    aliases.topicNameMaxLength = 16U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, &aliases ) );
+    aliases.pAliases = aliasMemory;
+    aliases.aliasCount = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, &aliases ) );
+    aliases.aliasCount = 2U;
+    aliases.pArena = NULL;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, &aliases ) );
+    aliases.pArena = arena;
+    aliases.topicNameMaxLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, &aliases ) );
+
+    /* The arena must hold a topic name of the longest length for each alias. */
+    aliases.topicNameMaxLength = 17U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitTopicAliases( &context, &aliases ) );
+    TEST_ASSERT_NULL( context.pTopicAliases );
+
+    aliasMemory[ 1 ].topicNameLength = MQTT_SAMPLE_TOPIC_FILTER_LENGTH;
+    aliases.topicNameMaxLength = 16U;
+    aliases.aliasMaximum = 2U;
+    aliases.useCount = 5U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicAliases( &context, &aliases ) );
+    TEST_ASSERT_EQUAL_PTR( &aliases, context.pTopicAliases );
+    TEST_ASSERT_EQUAL( 0U, aliasMemory[ 1 ].topicNameLength );
+    TEST_ASSERT_EQUAL( 0U, aliases.aliasMaximum );
+    TEST_ASSERT_EQUAL( 0U, aliases.useCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitTopicAliases( &context, NULL ) );
+    TEST_ASSERT_NULL( context.pTopicAliases );
+}
+
+/**
+ * @brief Test that MQTT_InitIncomingTopicAliases validates its parameters and
+ * leaves every alias of the arena unmapped.
+ */
+void test_MQTT_InitIncomingTopicAliases( void )
+{
+    MQTTContext_t context = { 0 };
+    uint8_t arena[ MQTT_INCOMING_TOPIC_ALIASES_ARENA_SIZE( 2, 4 ) ];
+    MQTTIncomingTopicAliases_t aliases = { 0 };
+
+    TEST_ASSERT_EQUAL( 12U, sizeof( arena ) );
+    ( void ) memset( arena, 0xFF, sizeof( arena ) );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitIncomingTopicAliases( NULL, &aliases ) );
+
+    /* The arena must hold every alias. */
+    aliases.aliasCount = 2U;
+    aliases.topicNameMaxLength = 4U;
+    aliases.arenaSize = sizeof( arena );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitIncomingTopicAliases( &context, &aliases ) );
+    aliases.pArena = arena;
+    aliases.arenaSize = sizeof( arena ) - 1U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitIncomingTopicAliases( &context, &aliases ) );
+    aliases.arenaSize = sizeof( arena );
+    aliases.topicNameMaxLength = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitIncomingTopicAliases( &context, &aliases ) );
+    aliases.topicNameMaxLength = 4U;
+    aliases.aliasCount = 0U;
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_InitIncomingTopicAliases( &context, &aliases ) );
+    TEST_ASSERT_NULL( context.pIncomingTopicAliases );
+
+    aliases.aliasCount = 2U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitIncomingTopicAliases( &context, &aliases ) );
+    TEST_ASSERT_EQUAL_PTR( &aliases, context.pIncomingTopicAliases );
+
+    /* Each alias starts with a zero topic name length. */
+    TEST_ASSERT_EQUAL( 0U, arena[ 0 ] );
+    TEST_ASSERT_EQUAL( 0U, arena[ 1 ] );
+    TEST_ASSERT_EQUAL( 0xFFU, arena[ 2 ] );
+    TEST_ASSERT_EQUAL( 0U, arena[ 6 ] );
+    TEST_ASSERT_EQUAL( 0U, arena[ 7 ] );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_InitIncomingTopicAliases( &context, NULL ) );
+    TEST_ASSERT_NULL( context.pIncomingTopicAliases );
+}
+
 /* ========================================================================== */
 
 static uint8_t * MQTT_SerializeConnectFixedHeader_cb( uint8_t * pIndex,
@@ -2672,6 +2877,223 @@ void test_MQTT_Connect_resendUnAckedPublishes6( void )
     TEST_ASSERT_EQUAL_INT( MQTTDisconnectPending, mqttContext.connectStatus );
 }
 
+/**
+ * @brief Test that publishes retrieved as vectors are resent as vectors, and
+ * that a failed or empty vector retrieve fails the resend.
+ */
+void test_MQTT_Connect_resendUnAckedPublishesVectors( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    uint32_t timeout = 2;
+    bool sessionPresent;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    uint16_t packetIdentifier = 1;
+    MQTTPubAckInfo_t incomingRecords = { 0 };
+    MQTTPubAckInfo_t outgoingRecords = { 0 };
+    uint8_t * localPublishCopyBuffer = ( uint8_t * ) "Hello world!";
+
+    publishCopyBuffer = localPublishCopyBuffer;
+    publishCopyBufferSize = sizeof( "Hello world!" );
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    MQTT_InitStatefulQoS( &mqttContext,
+                          &outgoingRecords, 4,
+                          &incomingRecords, 4 );
+
+    MQTT_InitRetransmitVectors( &mqttContext, publishStoreCallbackSuccess,
+                                publishRetrieveVectorCallbackSuccess,
+                                publishClearCallback );
+
+    MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    connectInfo.keepAliveSeconds = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+    sessionPresent = true;
+
+    /* Two publish packets found to resend, both sent from their vectors. */
+    mqttContext.connectStatus = MQTTNotConnected;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_TYPE_INVALID );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( packetIdentifier );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( packetIdentifier + 1 );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_TYPE_INVALID );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( MQTTConnected, mqttContext.connectStatus );
+
+    /* A vector retrieve returning no vectors fails. */
+    mqttContext.connectStatus = MQTTNotConnected;
+    mqttContext.retrieveVectorFunction = publishRetrieveVectorCallbackEmpty;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_TYPE_INVALID );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( packetIdentifier );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTPublishRetrieveFailed, status );
+
+    /* A failing transport fails the resend. */
+    mqttContext.connectStatus = MQTTNotConnected;
+    mqttContext.retrieveVectorFunction = publishRetrieveVectorCallbackSuccess;
+    mqttContext.transportInterface.writev = NULL;
+    mqttContext.transportInterface.send = transportSendSucceedThenFailAfterConnect;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_TYPE_INVALID );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( packetIdentifier );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+}
+
+/**
+ * @brief Test that with a session resumption, MQTT_Connect returns after the
+ * CONNACK and MQTT_ProcessLoop resends the packets of the resumed session.
+ */
+void test_MQTT_Connect_resumeSessionFromProcessLoop( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    uint32_t timeout = 2;
+    bool sessionPresent;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ 4 ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ 4 ] = { 0 };
+    MQTTSessionResume_t resume = { 0 };
+    MQTTPublishState_t pubrelState = MQTTPubRelSend;
+    uint8_t * localPublishCopyBuffer = ( uint8_t * ) "Hello world!";
+
+    publishCopyBuffer = localPublishCopyBuffer;
+    publishCopyBufferSize = sizeof( "Hello world!" );
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* The records must be set up first. */
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, MQTT_InitSessionResume( &mqttContext, &resume ) );
+
+    MQTT_InitStatefulQoS( &mqttContext,
+                          outgoingRecords, 4,
+                          incomingRecords, 4 );
+    MQTT_InitRetransmits( &mqttContext, publishStoreCallbackSuccess,
+                          publishRetrieveCallbackSuccess,
+                          publishClearCallback );
+
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, MQTT_InitSessionResume( NULL, &resume ) );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, MQTT_InitSessionResume( &mqttContext, &resume ) );
+    resume.packetsPerCall = 2;
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, MQTT_InitSessionResume( &mqttContext, &resume ) );
+    TEST_ASSERT_EQUAL_PTR( &resume, mqttContext.pSessionResume );
+
+    MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+    sessionPresent = true;
+
+    /* Nothing is resent by the connect. */
+    mqttContext.connectStatus = MQTTNotConnected;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( MQTTConnected, mqttContext.connectStatus );
+    TEST_ASSERT_TRUE( resume.inProgress );
+    TEST_ASSERT_FALSE( resume.resendingPublishes );
+    TEST_ASSERT_EQUAL( 4U, resume.end );
+    mqttContext.transportInterface.recv = transportRecvNoData;
+
+    /* Two packets per call: a PUBREL, then the first PUBLISH. */
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( 1 );
+    MQTT_PubrelToResend_ReturnThruPtr_pState( &pubrelState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_ID_INVALID );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( 2 );
+    status = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_TRUE( resume.inProgress );
+    TEST_ASSERT_TRUE( resume.resendingPublishes );
+
+    /* A PUBLISH which cannot be retrieved is skipped. */
+    mqttContext.retrieveFunction = publishRetrieveCallbackFailed;
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( 3 );
+    status = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( MQTTPublishRetrieveFailed, status );
+    TEST_ASSERT_TRUE( resume.inProgress );
+
+    mqttContext.retrieveFunction = publishRetrieveCallbackSuccess;
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_ID_INVALID );
+    status = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_FALSE( resume.inProgress );
+
+    /* Nothing more to resend. */
+    status = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    /* Reconnecting starts the resend again, and a failed send leaves the
+     * connection to be re-established. */
+    mqttContext.connectStatus = MQTTNotConnected;
+    mqttContext.transportInterface.recv = transport.recv;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_TRUE( resume.inProgress );
+    TEST_ASSERT_FALSE( resume.resendingPublishes );
+
+    mqttContext.transportInterface.send = transportSendFailure;
+    MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_ID_INVALID );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( 2 );
+    status = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL_INT( MQTTDisconnectPending, mqttContext.connectStatus );
+    TEST_ASSERT_EQUAL( 0U, resume.next );
+
+    /* A clean session ends a resumption. */
+    sessionPresent = false;
+    mqttContext.connectStatus = MQTTNotConnected;
+    mqttContext.transportInterface.send = transport.send;
+    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
+    MQTT_PublishToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_ID_INVALID );
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_FALSE( resume.inProgress );
+
+    /* Detaching it resends from the connect again. */
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, MQTT_InitSessionResume( &mqttContext, NULL ) );
+    TEST_ASSERT_NULL( mqttContext.pSessionResume );
+}
+
 /**
  * @brief Test success case for MQTT_Connect().
  */
@@ -3824,33 +4246,1155 @@ void test_MQTT_Publish_Send_Timeout( void )
 /* ========================================================================== */
 
 /**
- * @brief Test that MQTT_Disconnect works as intended when the connection is already disconnected.
+ * @brief Number of calls to #transportWritevCount.
  */
-void test_MQTT_Disconnect_already_disconnected( void )
+static size_t writevCallCount = 0U;
+
+/**
+ * @brief Number of vectors given to #transportWritevCount.
+ */
+static size_t writevVectorCount = 0U;
+
+/**
+ * @brief Number of the call to #transportWritevCount that fails, or 0 if
+ * every call succeeds.
+ */
+static size_t writevFailingCall = 0U;
+
+/**
+ * @brief Number of calls to #publishClearCallbackCount.
+ */
+static size_t clearCallCount = 0U;
+
+/**
+ * @brief Mocked transport writev counting its calls.
+ */
+static int32_t transportWritevCount( NetworkContext_t * pNetworkContext,
+                                     TransportOutVector_t * pIoVectorIterator,
+                                     size_t vectorsToBeSent )
 {
-    MQTTContext_t mqttContext = { 0 };
-    MQTTStatus_t status;
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
-    size_t disconnectSize = 2;
+    int32_t bytesSent = -1;
 
-    setupTransportInterface( &transport );
-    setupNetworkBuffer( &networkBuffer );
+    writevCallCount++;
 
-    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
-    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
-    mqttContext.connectStatus = MQTTNotConnected;
+    if( writevCallCount != writevFailingCall )
+    {
+        writevVectorCount += vectorsToBeSent;
+        bytesSent = transportWritevSuccess( pNetworkContext, pIoVectorIterator, vectorsToBeSent );
+    }
 
-    /* Send failure with network error. */
-    MQTT_GetDisconnectPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetDisconnectPacketSize_ReturnThruPtr_pPacketSize( &disconnectSize );
-    MQTT_SerializeDisconnect_ExpectAnyArgsAndReturn( MQTTSuccess );
-    status = MQTT_Disconnect( &mqttContext );
-    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, status );
+    return bytesSent;
 }
 
 /**
- * @brief Test that MQTT_Disconnect works as intended.
+ * @brief Mocked publish clear function counting its calls.
+ */
+static void publishClearCallbackCount( struct MQTTContext * pContext,
+                                       uint16_t packetId )
+{
+    ( void ) pContext;
+    ( void ) packetId;
+
+    clearCallCount++;
+}
+
+/**
+ * @brief Initialize a connected context with two attached publish queues.
+ */
+static void setupPublishQueues( MQTTContext_t * pContext,
+                                TransportInterface_t * pTransport,
+                                MQTTFixedBuffer_t * pNetworkBuffer,
+                                MQTTPublishQueue_t * pQueues,
+                                MQTTPublishQueueEntry_t * pEntries,
+                                size_t entryCount )
+{
+    MQTTStatus_t status;
+
+    setupTransportInterface( pTransport );
+    setupNetworkBuffer( pNetworkBuffer );
+    pTransport->writev = transportWritevCount;
+    writevCallCount = 0U;
+    writevVectorCount = 0U;
+    writevFailingCall = 0U;
+    clearCallCount = 0U;
+
+    memset( pContext, 0x0, sizeof( MQTTContext_t ) );
+    memset( pEntries, 0x0, 2U * entryCount * sizeof( MQTTPublishQueueEntry_t ) );
+    MQTT_Init( pContext, pTransport, getTime, eventCallback, pNetworkBuffer );
+    pContext->connectStatus = MQTTConnected;
+
+    status = MQTT_InitPublishQueue( &pQueues[ 0 ], pEntries, entryCount );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    status = MQTT_InitPublishQueue( &pQueues[ 1 ], &pEntries[ entryCount ], entryCount );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_AttachPublishQueue( pContext, &pQueues[ 0 ] );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    status = MQTT_AttachPublishQueue( pContext, &pQueues[ 1 ] );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+}
+
+/**
+ * @brief Enqueue a publish with a 5 byte serialized header.
+ */
+static void enqueuePublish( MQTTPublishQueue_t * pQueue,
+                            const MQTTPublishInfo_t * pPublishInfo,
+                            uint16_t packetId )
+{
+    size_t headerSize = 5U;
+    MQTTStatus_t status;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerSize );
+
+    status = MQTT_EnqueuePublish( pQueue, pPublishInfo, packetId );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+}
+
+/**
+ * @brief Test MQTT_InitPublishQueue and MQTT_AttachPublishQueue.
+ */
+void test_MQTT_InitPublishQueue( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTPublishQueue_t queue = { 0 };
+    MQTTPublishQueue_t otherQueue = { 0 };
+    MQTTPublishQueueEntry_t entries[ 4 ];
+    MQTTStatus_t status;
+
+    status = MQTT_InitPublishQueue( NULL, entries, 4 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_InitPublishQueue( &queue, NULL, 4 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_InitPublishQueue( &queue, entries, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_InitPublishQueue( &queue, entries, 3 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* The queue is not initialized yet. */
+    status = MQTT_AttachPublishQueue( &context, &queue );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_InitPublishQueue( &queue, entries, 4 );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( entries, queue.pEntries );
+    TEST_ASSERT_EQUAL( 4, queue.entryCount );
+    TEST_ASSERT_EQUAL( 0, queue.head );
+    TEST_ASSERT_EQUAL( 0, queue.tail );
+
+    status = MQTT_AttachPublishQueue( NULL, &queue );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_AttachPublishQueue( &context, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_AttachPublishQueue( &context, &queue );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &queue, context.pPublishQueues );
+
+    status = MQTT_InitPublishQueue( &otherQueue, entries, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_AttachPublishQueue( &context, &otherQueue );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &otherQueue, queue.pNext );
+
+    /* Queues cannot be attached twice. */
+    status = MQTT_AttachPublishQueue( &context, &queue );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    status = MQTT_AttachPublishQueue( &context, &otherQueue );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_NULL( otherQueue.pNext );
+}
+
+/**
+ * @brief Test MQTT_EnqueuePublish.
+ */
+void test_MQTT_EnqueuePublish( void )
+{
+    MQTTPublishQueue_t queue = { 0 };
+    MQTTPublishQueueEntry_t entries[ 2 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+
+    memset( entries, 0x0, sizeof( entries ) );
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+
+    status = MQTT_EnqueuePublish( NULL, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* The queue is not initialized. */
+    status = MQTT_EnqueuePublish( &queue, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_InitPublishQueue( &queue, entries, 2 );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_EnqueuePublish( &queue, NULL, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    publishInfo.payloadLength = 4;
+    status = MQTT_EnqueuePublish( &queue, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    publishInfo.pPayload = "data";
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTBadParameter );
+    status = MQTT_EnqueuePublish( &queue, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTBadParameter );
+    status = MQTT_EnqueuePublish( &queue, &publishInfo, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 0, queue.head );
+
+    enqueuePublish( &queue, &publishInfo, 7 );
+    TEST_ASSERT_EQUAL( 1, queue.head );
+    TEST_ASSERT_EQUAL( 7, entries[ 0 ].packetId );
+    TEST_ASSERT_EQUAL( 5, entries[ 0 ].headerSize );
+    TEST_ASSERT_EQUAL_PTR( publishInfo.pPayload, entries[ 0 ].publishInfo.pPayload );
+
+    /* The packet ID of a QoS 0 publish is ignored. */
+    publishInfo.qos = MQTTQoS0;
+    enqueuePublish( &queue, &publishInfo, 8 );
+    TEST_ASSERT_EQUAL( 2, queue.head );
+    TEST_ASSERT_EQUAL( 0, entries[ 1 ].packetId );
+
+    /* The queue is full until an entry is drained. */
+    status = MQTT_EnqueuePublish( &queue, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTNoMemory, status );
+
+    queue.tail = 1U;
+    enqueuePublish( &queue, &publishInfo, 0 );
+    TEST_ASSERT_EQUAL( 3, queue.head );
+}
+
+/**
+ * @brief Test MQTT_DrainPublishQueues with invalid parameters and without a
+ * connection.
+ */
+void test_MQTT_DrainPublishQueues_Invalid_Params( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 1U;
+
+    status = MQTT_DrainPublishQueues( NULL, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 0, drainedCount );
+
+    context.connectStatus = MQTTNotConnected;
+    status = MQTT_DrainPublishQueues( &context, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTStatusNotConnected, status );
+
+    context.connectStatus = MQTTDisconnectPending;
+    status = MQTT_DrainPublishQueues( &context, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTStatusDisconnectPending, status );
+
+    /* Nothing is queued. */
+    context.connectStatus = MQTTConnected;
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0, drainedCount );
+}
+
+/**
+ * @brief Test that publishes from several queues are sent with one writev
+ * call, and that packet IDs are assigned to QoS 1 publishes queued without one.
+ */
+void test_MQTT_DrainPublishQueues_Happy_Path( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 4 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 4 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                          publishRetrieveCallbackSuccess,
+                          publishClearCallback );
+    context.nextPacketId = 10;
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.pPayload = "data";
+    publishInfo.payloadLength = 4;
+
+    enqueuePublish( &queues[ 0 ], &publishInfo, 0 );
+    publishInfo.qos = MQTTQoS1;
+    enqueuePublish( &queues[ 1 ], &publishInfo, 0 );
+    enqueuePublish( &queues[ 1 ], &publishInfo, 3 );
+
+    /* Packet IDs are assigned in queue order. */
+    MQTT_ReserveState_ExpectAndReturn( &context, 10, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ReserveState_ExpectAndReturn( &context, 3, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 10, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 3, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 3, drainedCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+    TEST_ASSERT_EQUAL( 3 + 4 + 4, writevVectorCount );
+    TEST_ASSERT_EQUAL( 1, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( 2, queues[ 1 ].tail );
+    TEST_ASSERT_EQUAL( 11, context.nextPacketId );
+    TEST_ASSERT_EQUAL( 0, entries[ 4 ].serializedPacketId[ 0 ] );
+    TEST_ASSERT_EQUAL( 10, entries[ 4 ].serializedPacketId[ 1 ] );
+
+    /* Nothing is left to send. */
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0, drainedCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+}
+
+/**
+ * @brief Test that the publishes of a long queue are split into batches of
+ * at most MQTT_PUBLISH_MAX_VECTORS vectors.
+ */
+void test_MQTT_DrainPublishQueues_Batches( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 8 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+    /* A batch is sent when the next publish might not fit. */
+    const size_t publishesPerBatch = ( ( MQTT_PUBLISH_MAX_VECTORS - 4U ) / 3U ) + 1U;
+    size_t i;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 8 );
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.pPayload = "data";
+    publishInfo.payloadLength = 4;
+
+    /* Each QoS 0 publish takes 3 vectors. */
+    for( i = 0; i < 8U; i++ )
+    {
+        enqueuePublish( &queues[ i % 2U ], &publishInfo, 0 );
+    }
+
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 8, drainedCount );
+    TEST_ASSERT_EQUAL( ( 8U + publishesPerBatch - 1U ) / publishesPerBatch, writevCallCount );
+    TEST_ASSERT_EQUAL( 8 * 3, writevVectorCount );
+    TEST_ASSERT_EQUAL( 4, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( 4, queues[ 1 ].tail );
+}
+
+/**
+ * @brief Test that a publish is left in its queue when there is no free
+ * outgoing record, and dropped on other errors.
+ */
+void test_MQTT_DrainPublishQueues_Record_Errors( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 4 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 4 );
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+
+    enqueuePublish( &queues[ 0 ], &publishInfo, 0 );
+    publishInfo.qos = MQTTQoS1;
+    enqueuePublish( &queues[ 0 ], &publishInfo, 0 );
+    enqueuePublish( &queues[ 1 ], &publishInfo, 0 );
+
+    /* QoS 1 publishes have not been enabled: the publish is dropped after
+     * the QoS 0 publish before it is sent. */
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 1, drainedCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+    TEST_ASSERT_EQUAL( 2, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( 0, queues[ 1 ].tail );
+
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    context.nextPacketId = 5;
+
+    /* No free record: the publish stays queued with its packet ID. */
+    MQTT_ReserveState_ExpectAndReturn( &context, 5, MQTTQoS1, MQTTNoMemory );
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTNoMemory, status );
+    TEST_ASSERT_EQUAL( 0, drainedCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+    TEST_ASSERT_EQUAL( 0, queues[ 1 ].tail );
+
+    MQTT_ReserveState_ExpectAndReturn( &context, 5, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTIllegalState );
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+    TEST_ASSERT_EQUAL_INT( MQTTIllegalState, status );
+    TEST_ASSERT_EQUAL( 1, drainedCount );
+    TEST_ASSERT_EQUAL( 2, writevCallCount );
+    TEST_ASSERT_EQUAL( 1, queues[ 1 ].tail );
+    TEST_ASSERT_EQUAL( 6, context.nextPacketId );
+}
+
+/**
+ * @brief Test that queued publishes are released, and their records removed,
+ * when the transport fails.
+ */
+void test_MQTT_DrainPublishQueues_Send_Failure( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 4 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 4 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    context.transportInterface.writev = transportWritevError;
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.qos = MQTTQoS1;
+
+    enqueuePublish( &queues[ 1 ], &publishInfo, 9 );
+
+    /* The record of a publish that was not sent is removed. */
+    MQTT_ReserveState_ExpectAndReturn( &context, 9, MQTTQoS1, MQTTSuccess );
+    MQTT_RemoveStateRecord_ExpectAndReturn( &context, 9, MQTTSuccess );
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL( 1, drainedCount );
+    TEST_ASSERT_EQUAL( 1, queues[ 1 ].tail );
+    TEST_ASSERT_EQUAL_INT( MQTTDisconnectPending, context.connectStatus );
+}
+
+/**
+ * @brief Test that when the second writev of a drain fails, the publishes of
+ * the first batch stay sent, and only those of the second batch are dropped
+ * along with their records and retransmit copies.
+ */
+void test_MQTT_DrainPublishQueues_Send_Failure_Mid_Batch( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 8 ];
+    MQTTPubAckInfo_t outgoingRecords[ 8 ];
+    MQTTPubAckInfo_t incomingRecords[ 8 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+    /* Each QoS 1 publish takes 4 vectors. */
+    const size_t publishesPerBatch = ( ( MQTT_PUBLISH_MAX_VECTORS - 4U ) / 4U ) + 1U;
+    uint16_t packetId;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 8 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 8, incomingRecords, 8 );
+    MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                          publishRetrieveCallbackSuccess,
+                          publishClearCallbackCount );
+    context.nextPacketId = 1;
+    writevFailingCall = 2U;
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.pPayload = "data";
+    publishInfo.payloadLength = 4;
+    publishInfo.qos = MQTTQoS1;
+
+    for( packetId = 1U; packetId <= ( publishesPerBatch + 2U ); packetId++ )
+    {
+        enqueuePublish( &queues[ 0 ], &publishInfo, 0 );
+    }
+
+    for( packetId = 1U; packetId <= publishesPerBatch; packetId++ )
+    {
+        MQTT_ReserveState_ExpectAndReturn( &context, packetId, MQTTQoS1, MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    }
+
+    for( packetId = 1U; packetId <= publishesPerBatch; packetId++ )
+    {
+        MQTT_UpdateStatePublish_ExpectAndReturn( &context, packetId, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+        MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+    }
+
+    for( packetId = publishesPerBatch + 1U; packetId <= ( publishesPerBatch + 2U ); packetId++ )
+    {
+        MQTT_ReserveState_ExpectAndReturn( &context, packetId, MQTTQoS1, MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    }
+
+    for( packetId = publishesPerBatch + 1U; packetId <= ( publishesPerBatch + 2U ); packetId++ )
+    {
+        MQTT_RemoveStateRecord_ExpectAndReturn( &context, packetId, MQTTSuccess );
+    }
+
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL( publishesPerBatch + 2U, drainedCount );
+    TEST_ASSERT_EQUAL( 2, writevCallCount );
+    TEST_ASSERT_EQUAL( 2, clearCallCount );
+    TEST_ASSERT_EQUAL( publishesPerBatch + 2U, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( queues[ 0 ].head, queues[ 0 ].tail );
+}
+
+/**
+ * @brief Test that a queued publish whose copy cannot be stored is dropped
+ * without keeping the record reserved for it.
+ */
+void test_MQTT_DrainPublishQueues_Store_Failure( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 4 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t status;
+    size_t drainedCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 4 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    MQTT_InitRetransmits( &context, publishStoreCallbackFailed,
+                          publishRetrieveCallbackSuccess,
+                          publishClearCallbackCount );
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.qos = MQTTQoS1;
+
+    enqueuePublish( &queues[ 0 ], &publishInfo, 7 );
+
+    MQTT_ReserveState_ExpectAndReturn( &context, 7, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_RemoveStateRecord_ExpectAndReturn( &context, 7, MQTTSuccess );
+    status = MQTT_DrainPublishQueues( &context, &drainedCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTPublishStoreFailed, status );
+    TEST_ASSERT_EQUAL( 0, drainedCount );
+    TEST_ASSERT_EQUAL( 0, writevCallCount );
+    TEST_ASSERT_EQUAL( 1, queues[ 0 ].tail );
+}
+
+/**
+ * @brief Test that with MQTT_InitDrainOnAck, a PUBACK received by
+ * MQTT_ProcessLoop sends the publishes left in the queues for lack of room in
+ * the send window.
+ */
+void test_MQTT_DrainPublishQueues_OnAck( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 4 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishDone = MQTTPublishDone;
+    MQTTStatus_t status;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 4 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, MQTT_InitDrainOnAck( NULL ) );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, MQTT_InitDrainOnAck( &context ) );
+    TEST_ASSERT_TRUE( context.drainOnAck );
+
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.qos = MQTTQoS1;
+
+    enqueuePublish( &queues[ 0 ], &publishInfo, 9 );
+
+    modifyIncomingPacketStatus = MQTTSuccess;
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBACK;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    /* The publish stays queued while the window is full. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &publishDone );
+    MQTT_ReserveState_ExpectAndReturn( &context, 9, MQTTQoS1, MQTTNoMemory );
+    status = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 0, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( 0, writevCallCount );
+
+    /* The next acknowledgment makes room for it. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &publishDone );
+    MQTT_ReserveState_ExpectAndReturn( &context, 9, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 9, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+    status = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 1, queues[ 0 ].tail );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+
+    /* Other acknowledgments do not drain the queues. */
+    enqueuePublish( &queues[ 0 ], &publishInfo, 10 );
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_EQUAL( 1, queues[ 0 ].tail );
+
+    /* Nor does a PUBACK without the option. */
+    context.drainOnAck = false;
+    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_EQUAL( 1, queues[ 0 ].tail );
+}
+
+/**
+ * @brief Expect the serialization of a publish with a 5 byte header.
+ */
+static void expectPublishHeader( void )
+{
+    static size_t headerSize = 5U;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerSize );
+}
+
+/**
+ * @brief Test MQTT_PublishMany with invalid parameters and without a
+ * connection.
+ */
+void test_MQTT_PublishMany_Invalid_Params( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishInfo_t publishInfo[ 2 ];
+    uint16_t packetIds[ 2 ] = { 1, 2 };
+    MQTTStatus_t status;
+    size_t sentCount = 1U;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    memset( &context, 0x0, sizeof( context ) );
+    MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    memset( publishInfo, 0x0, sizeof( publishInfo ) );
+
+    status = MQTT_PublishMany( NULL, publishInfo, 2, packetIds, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishMany( &context, NULL, 2, packetIds, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishMany( &context, publishInfo, 0, packetIds, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* A QoS 1 publish needs a packet ID. */
+    publishInfo[ 1 ].qos = MQTTQoS1;
+    status = MQTT_PublishMany( &context, publishInfo, 2, NULL, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Nothing is sent if any publish is invalid. */
+    publishInfo[ 1 ].payloadLength = 1;
+    status = MQTT_PublishMany( &context, publishInfo, 2, packetIds, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    publishInfo[ 1 ].payloadLength = 0;
+    publishInfo[ 1 ].qos = MQTTQoS0;
+
+    context.connectStatus = MQTTNotConnected;
+    status = MQTT_PublishMany( &context, publishInfo, 2, packetIds, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTStatusNotConnected, status );
+
+    context.connectStatus = MQTTDisconnectPending;
+    status = MQTT_PublishMany( &context, publishInfo, 2, packetIds, &sentCount );
+    TEST_ASSERT_EQUAL_INT( MQTTStatusDisconnectPending, status );
+    TEST_ASSERT_EQUAL( 0, sentCount );
+}
+
+/**
+ * @brief Test that MQTT_PublishMany sends QoS 0 and QoS 1 publishes with one
+ * writev call and updates the state of the QoS 1 publishes.
+ */
+void test_MQTT_PublishMany_Happy_Path( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 1 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo[ 3 ];
+    uint16_t packetIds[ 3 ] = { 0, 5, 6 };
+    MQTTStatus_t status;
+    size_t sentCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 1 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    memset( publishInfo, 0x0, sizeof( publishInfo ) );
+
+    publishInfo[ 0 ].pTopicName = "topic";
+    publishInfo[ 0 ].topicNameLength = 5;
+    publishInfo[ 0 ].pPayload = "data";
+    publishInfo[ 0 ].payloadLength = 4;
+    publishInfo[ 1 ] = publishInfo[ 0 ];
+    publishInfo[ 1 ].qos = MQTTQoS1;
+    publishInfo[ 2 ] = publishInfo[ 1 ];
+    publishInfo[ 2 ].payloadLength = 0;
+
+    expectPublishHeader();
+    expectPublishHeader();
+    MQTT_ReserveState_ExpectAndReturn( &context, 5, MQTTQoS1, MQTTSuccess );
+    expectPublishHeader();
+    MQTT_ReserveState_ExpectAndReturn( &context, 6, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 5, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 6, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+
+    status = MQTT_PublishMany( &context, publishInfo, 3, packetIds, &sentCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 3, sentCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+    TEST_ASSERT_EQUAL( 3 + 4 + 3, writevVectorCount );
+}
+
+/**
+ * @brief Test that MQTT_PublishMany splits the publishes into writev calls of
+ * at most MQTT_PUBLISH_MAX_VECTORS vectors.
+ */
+void test_MQTT_PublishMany_Batches( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 1 ];
+    MQTTPublishInfo_t publishInfo[ 20 ];
+    MQTTStatus_t status;
+    size_t sentCount = 0U;
+    /* A batch is sent when the next publish might not fit. */
+    const size_t publishesPerBatch = ( ( MQTT_PUBLISH_MAX_VECTORS - 4U ) / 3U ) + 1U;
+    size_t i;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 1 );
+    memset( publishInfo, 0x0, sizeof( publishInfo ) );
+
+    /* Each QoS 0 publish takes 3 vectors. */
+    for( i = 0; i < 20U; i++ )
+    {
+        publishInfo[ i ].pTopicName = "topic";
+        publishInfo[ i ].topicNameLength = 5;
+        publishInfo[ i ].pPayload = "data";
+        publishInfo[ i ].payloadLength = 4;
+        expectPublishHeader();
+    }
+
+    status = MQTT_PublishMany( &context, publishInfo, 20, NULL, &sentCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 20, sentCount );
+    TEST_ASSERT_EQUAL( ( 20U + publishesPerBatch - 1U ) / publishesPerBatch, writevCallCount );
+    TEST_ASSERT_EQUAL( 20 * 3, writevVectorCount );
+}
+
+/**
+ * @brief Test that MQTT_PublishMany sends the publishes before one that
+ * fails, and removes the records of publishes that were not sent.
+ */
+void test_MQTT_PublishMany_Errors( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 1 ];
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo[ 3 ];
+    uint16_t packetIds[ 3 ] = { 1, 2, 3 };
+    MQTTStatus_t status;
+    size_t sentCount = 0U;
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 1 );
+    memset( publishInfo, 0x0, sizeof( publishInfo ) );
+    publishInfo[ 0 ].pTopicName = "topic";
+    publishInfo[ 0 ].topicNameLength = 5;
+    publishInfo[ 1 ] = publishInfo[ 0 ];
+    publishInfo[ 2 ] = publishInfo[ 0 ];
+
+    /* Serialization of the second publish fails. */
+    expectPublishHeader();
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTBadParameter );
+
+    status = MQTT_PublishMany( &context, publishInfo, 3, packetIds, &sentCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 1, sentCount );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+    TEST_ASSERT_EQUAL( 2, writevVectorCount );
+
+    /* QoS 1 publishes need outgoing records. */
+    publishInfo[ 1 ].qos = MQTTQoS1;
+
+    status = MQTT_PublishMany( &context, publishInfo, 3, packetIds, NULL );
+
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( 1, writevCallCount );
+
+    /* The records of publishes that were not sent are removed. */
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+    context.transportInterface.writev = transportWritevError;
+    expectPublishHeader();
+    expectPublishHeader();
+    MQTT_ReserveState_ExpectAndReturn( &context, 2, MQTTQoS1, MQTTSuccess );
+    expectPublishHeader();
+    MQTT_RemoveStateRecord_ExpectAndReturn( &context, 2, MQTTSuccess );
+
+    status = MQTT_PublishMany( &context, publishInfo, 3, packetIds, &sentCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL( 0, sentCount );
+    TEST_ASSERT_EQUAL_INT( MQTTDisconnectPending, context.connectStatus );
+}
+
+/**
+ * @brief Test that when the second writev of MQTT_PublishMany fails, only the
+ * publishes of the first batch are counted as sent, and the publishes of the
+ * second batch hold no record or retransmit copy.
+ */
+void test_MQTT_PublishMany_Send_Failure_Mid_Batch( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPublishQueue_t queues[ 2 ];
+    MQTTPublishQueueEntry_t entries[ 2 * 1 ];
+    MQTTPubAckInfo_t outgoingRecords[ 8 ];
+    MQTTPubAckInfo_t incomingRecords[ 8 ];
+    MQTTPublishInfo_t publishInfo[ 8 ];
+    uint16_t packetIds[ 8 ];
+    MQTTStatus_t status;
+    size_t sentCount = 0U;
+    /* Each QoS 1 publish takes 4 vectors. */
+    const size_t publishesPerBatch = ( ( MQTT_PUBLISH_MAX_VECTORS - 4U ) / 4U ) + 1U;
+    const size_t publishCount = publishesPerBatch + 2U;
+    size_t i;
+
+    TEST_ASSERT_TRUE( publishCount <= 8U );
+
+    setupPublishQueues( &context, &transport, &networkBuffer, queues, entries, 1 );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 8, incomingRecords, 8 );
+    MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                          publishRetrieveCallbackSuccess,
+                          publishClearCallbackCount );
+    writevFailingCall = 2U;
+    memset( publishInfo, 0x0, sizeof( publishInfo ) );
+
+    for( i = 0; i < publishCount; i++ )
+    {
+        publishInfo[ i ].pTopicName = "topic";
+        publishInfo[ i ].topicNameLength = 5;
+        publishInfo[ i ].pPayload = "data";
+        publishInfo[ i ].payloadLength = 4;
+        publishInfo[ i ].qos = MQTTQoS1;
+        packetIds[ i ] = ( uint16_t ) ( i + 1U );
+    }
+
+    for( i = 0; i < publishesPerBatch; i++ )
+    {
+        expectPublishHeader();
+        MQTT_ReserveState_ExpectAndReturn( &context, packetIds[ i ], MQTTQoS1, MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    }
+
+    for( i = 0; i < publishesPerBatch; i++ )
+    {
+        MQTT_UpdateStatePublish_ExpectAndReturn( &context, packetIds[ i ], MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+        MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+    }
+
+    for( i = publishesPerBatch; i < publishCount; i++ )
+    {
+        expectPublishHeader();
+        MQTT_ReserveState_ExpectAndReturn( &context, packetIds[ i ], MQTTQoS1, MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+        MQTT_UpdateDuplicatePublishFlag_ExpectAnyArgsAndReturn( MQTTSuccess );
+    }
+
+    for( i = publishesPerBatch; i < publishCount; i++ )
+    {
+        MQTT_RemoveStateRecord_ExpectAndReturn( &context, packetIds[ i ], MQTTSuccess );
+    }
+
+    status = MQTT_PublishMany( &context, publishInfo, publishCount, packetIds, &sentCount );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+    TEST_ASSERT_EQUAL( publishesPerBatch, sentCount );
+    TEST_ASSERT_EQUAL( 2, writevCallCount );
+    TEST_ASSERT_EQUAL( 2, clearCallCount );
+}
+
+/**
+ * @brief Bytes written by #transportWritevCapture.
+ */
+static uint8_t writevBytes[ 64 ];
+
+/**
+ * @brief Number of bytes in #writevBytes.
+ */
+static size_t writevByteCount = 0U;
+
+/**
+ * @brief Mocked successful transport writev keeping the bytes written.
+ */
+static int32_t transportWritevCapture( NetworkContext_t * pNetworkContext,
+                                       TransportOutVector_t * pIoVectorIterator,
+                                       size_t vectorsToBeSent )
+{
+    size_t i;
+
+    for( i = 0; i < vectorsToBeSent; i++ )
+    {
+        TEST_ASSERT_LESS_OR_EQUAL( sizeof( writevBytes ) - writevByteCount, pIoVectorIterator[ i ].iov_len );
+        memcpy( &writevBytes[ writevByteCount ], pIoVectorIterator[ i ].iov_base, pIoVectorIterator[ i ].iov_len );
+        writevByteCount += pIoVectorIterator[ i ].iov_len;
+    }
+
+    return transportWritevSuccess( pNetworkContext, pIoVectorIterator, vectorsToBeSent );
+}
+
+/**
+ * @brief Test MQTT_PreparePublish.
+ */
+void test_MQTT_PreparePublish( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPreparedPublish_t prepared;
+    /* Header of a QoS 1 retained publish to a 5 byte topic. */
+    uint8_t header[ 4 ] = { 0x33, 0x09, 0x00, 0x05 };
+    size_t remainingLength = 9U;
+    size_t headerSize = 4U;
+    MQTTStatus_t status;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    memset( &context, 0x0, sizeof( context ) );
+    MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    memset( &prepared, 0x0, sizeof( prepared ) );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.retain = true;
+    publishInfo.dup = true;
+    publishInfo.pTopicName = "topic";
+    publishInfo.topicNameLength = 5;
+    publishInfo.pPayload = "data";
+    publishInfo.payloadLength = 4;
+
+    status = MQTT_PreparePublish( &context, NULL, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PreparePublish( &context, &publishInfo, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PreparePublish( NULL, &publishInfo, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* QoS 1 publishes need outgoing records. */
+    status = MQTT_PreparePublish( &context, &publishInfo, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTBadParameter );
+    status = MQTT_PreparePublish( &context, &publishInfo, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPublishPacketSize_ReturnThruPtr_pRemainingLength( &remainingLength );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnArrayThruPtr_pBuffer( header, sizeof( header ) );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerSize );
+
+    status = MQTT_PreparePublish( &context, &publishInfo, &prepared );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 9, prepared.variableHeaderLength );
+    TEST_ASSERT_EQUAL_HEX8( 0x33, prepared.headerByte );
+    TEST_ASSERT_EQUAL_HEX8( 0x00, prepared.serializedTopicLength[ 0 ] );
+    TEST_ASSERT_EQUAL_HEX8( 0x05, prepared.serializedTopicLength[ 1 ] );
+    TEST_ASSERT_EQUAL_PTR( publishInfo.pTopicName, prepared.publishInfo.pTopicName );
+    TEST_ASSERT_NULL( prepared.publishInfo.pPayload );
+    TEST_ASSERT_EQUAL( 0, prepared.publishInfo.payloadLength );
+    TEST_ASSERT_FALSE( prepared.publishInfo.dup );
+}
+
+/**
+ * @brief Test that MQTT_PublishPrepared only encodes the Remaining Length and
+ * sends the cached parts of the header.
+ */
+void test_MQTT_PublishPrepared( void )
+{
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    MQTTPubAckInfo_t outgoingRecords[ 4 ];
+    MQTTPubAckInfo_t incomingRecords[ 4 ];
+    MQTTPreparedPublish_t prepared;
+    uint8_t encodedLength = 13U;
+    size_t encodedSize = 1U;
+    const uint8_t expected[] = { 0x33, 13, 0x00, 0x05, 't', 'o', 'p', 'i', 'c', 0x00, 0x07, 'd', 'a', 't', 'a' };
+    MQTTStatus_t status;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.writev = transportWritevCapture;
+    writevByteCount = 0U;
+    memset( &context, 0x0, sizeof( context ) );
+    MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    MQTT_InitStatefulQoS( &context, outgoingRecords, 4, incomingRecords, 4 );
+
+    memset( &prepared, 0x0, sizeof( prepared ) );
+    prepared.publishInfo.qos = MQTTQoS1;
+    prepared.publishInfo.retain = true;
+    prepared.publishInfo.pTopicName = "topic";
+    prepared.publishInfo.topicNameLength = 5;
+    prepared.variableHeaderLength = 9U;
+    prepared.headerByte = 0x33;
+    prepared.serializedTopicLength[ 1 ] = 0x05;
+
+    status = MQTT_PublishPrepared( NULL, &prepared, "data", 4, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishPrepared( &context, NULL, "data", 4, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishPrepared( &context, &prepared, "data", 4, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishPrepared( &context, &prepared, NULL, 4, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* The Remaining Length cannot wrap around. */
+    status = MQTT_PublishPrepared( &context, &prepared, "data", ( size_t ) -1, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    MQTT_SerializeVariableByteInteger_ExpectAnyArgsAndReturn( MQTTBadParameter );
+    status = MQTT_PublishPrepared( &context, &prepared, "data", 4, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    MQTT_SerializeVariableByteInteger_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializeVariableByteInteger_ReturnThruPtr_pEncodedSize( &encodedSize );
+    status = MQTT_PublishPrepared( &context, &prepared, "data", 4, 7 );
+    TEST_ASSERT_EQUAL_INT( MQTTStatusNotConnected, status );
+
+    context.connectStatus = MQTTConnected;
+    MQTT_SerializeVariableByteInteger_ExpectAndReturn( 13U, NULL, NULL, MQTTSuccess );
+    MQTT_SerializeVariableByteInteger_IgnoreArg_pBuffer();
+    MQTT_SerializeVariableByteInteger_IgnoreArg_pEncodedSize();
+    MQTT_SerializeVariableByteInteger_ReturnArrayThruPtr_pBuffer( &encodedLength, 1 );
+    MQTT_SerializeVariableByteInteger_ReturnThruPtr_pEncodedSize( &encodedSize );
+    MQTT_ReserveState_ExpectAndReturn( &context, 7, MQTTQoS1, MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAndReturn( &context, 7, MQTT_SEND, MQTTQoS1, NULL, MQTTSuccess );
+    MQTT_UpdateStatePublish_IgnoreArg_pNewState();
+
+    status = MQTT_PublishPrepared( &context, &prepared, "data", 4, 7 );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( sizeof( expected ), writevByteCount );
+    TEST_ASSERT_EQUAL_MEMORY( expected, writevBytes, sizeof( expected ) );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_Disconnect works as intended when the connection is already disconnected.
+ */
+void test_MQTT_Disconnect_already_disconnected( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t disconnectSize = 2;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    mqttContext.connectStatus = MQTTNotConnected;
+
+    /* Send failure with network error. */
+    MQTT_GetDisconnectPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetDisconnectPacketSize_ReturnThruPtr_pPacketSize( &disconnectSize );
+    MQTT_SerializeDisconnect_ExpectAnyArgsAndReturn( MQTTSuccess );
+    status = MQTT_Disconnect( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTStatusNotConnected, status );
+}
+
+/**
+ * @brief Test that MQTT_Disconnect works as intended.
  */
 void test_MQTT_Disconnect1( void )
 {
@@ -4048,71 +5592,293 @@ void test_MQTT_Disconnect4_status_disconnect_pending( void )
     /* At disconnect, the buffer is cleared of any pending packets. */
     TEST_ASSERT_EACH_EQUAL_UINT8( 0, mqttBuffer, MQTT_TEST_BUFFER_LENGTH );
 }
-/* ========================================================================== */
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_GetPacketId works as intended.
+ */
+void test_MQTT_GetPacketId( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    uint16_t packetId;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Verify parameters. */
+    packetId = MQTT_GetPacketId( NULL );
+    TEST_ASSERT_EQUAL_INT( 0, packetId );
+
+    packetId = MQTT_GetPacketId( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( 1, packetId );
+    TEST_ASSERT_EQUAL_INT( 2, mqttContext.nextPacketId );
+
+    mqttContext.nextPacketId = UINT16_MAX;
+    packetId = MQTT_GetPacketId( &mqttContext );
+    TEST_ASSERT_EQUAL_INT( UINT16_MAX, packetId );
+    TEST_ASSERT_EQUAL_INT( 1, mqttContext.nextPacketId );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that NULL pContext causes MQTT_ProcessLoop to return MQTTBadParameter.
+ */
+void test_MQTT_ProcessLoop_Invalid_Params( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus = MQTT_ProcessLoop( NULL );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Get time function cannot be NULL. */
+    context.getTime = NULL;
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    /* Restore the time function for the next test. */
+    context.getTime = getTime;
+
+    /* The fixed network buffer cannot be NULL. */
+    context.networkBuffer.pBuffer = NULL;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_discardPacket( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.networkBuffer.size = 20;
+
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_IncomingBufferNotInit( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* First byte shows that it is a publish type packet. */
+    mqttBuffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    /* Length of the packet. */
+    mqttBuffer[ 1 ] = 20;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    /* Assume QoS = 1. */
+    publishInfo.qos = MQTTQoS1;
+
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_IncomingBufferNotInitQoS0( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    isEventCallbackInvoked = false;
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* First byte shows that it is a publish type packet. */
+    mqttBuffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    /* Length of the packet. */
+    mqttBuffer[ 1 ] = 20;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    /* Assume QoS = 1. */
+    publishInfo.qos = MQTTQoS0;
+
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( true, isEventCallbackInvoked );
+}
+
+void test_MQTT_ProcessLoop_HandleKeepAlive( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = true;
+    /* Update the time so that there is timeout. */
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_HandleKeepAlive1( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+
+    context.connectStatus = MQTTConnected;
+
+    /* Verify MQTTSuccess is returned. */
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = 1;
+    /* Update the time so that there is timeout. */
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
 
-/**
- * @brief Test that MQTT_GetPacketId works as intended.
- */
-void test_MQTT_GetPacketId( void )
+void test_MQTT_ProcessLoop_HandleKeepAlive2( void )
 {
-    MQTTContext_t mqttContext = { 0 };
+    MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    uint16_t packetId;
+    MQTTStatus_t mqttStatus;
 
     setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
     setupNetworkBuffer( &networkBuffer );
-    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
-    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
 
-    /* Verify parameters. */
-    packetId = MQTT_GetPacketId( NULL );
-    TEST_ASSERT_EQUAL_INT( 0, packetId );
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
 
-    packetId = MQTT_GetPacketId( &mqttContext );
-    TEST_ASSERT_EQUAL_INT( 1, packetId );
-    TEST_ASSERT_EQUAL_INT( 2, mqttContext.nextPacketId );
+    /* Set this value such that the library will be forced to send keep alive. */
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = 1;
 
-    mqttContext.nextPacketId = UINT16_MAX;
-    packetId = MQTT_GetPacketId( &mqttContext );
-    TEST_ASSERT_EQUAL_INT( UINT16_MAX, packetId );
-    TEST_ASSERT_EQUAL_INT( 1, mqttContext.nextPacketId );
-}
+    /* Update the time so that timeout does not occur and the ping is not sent. */
+    globalEntryTime = 0;
 
-/* ========================================================================== */
+    mqttStatus = MQTT_ProcessLoop( &context );
 
-/**
- * @brief Test that NULL pContext causes MQTT_ProcessLoop to return MQTTBadParameter.
- */
-void test_MQTT_ProcessLoop_Invalid_Params( void )
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_RecvFailed( void )
 {
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus = MQTT_ProcessLoop( NULL );
-
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    MQTTStatus_t mqttStatus;
 
     setupTransportInterface( &transport );
+    transport.recv = transportRecvFailure;
+    setupNetworkBuffer( &networkBuffer );
+
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    context.connectStatus = MQTTConnected;
 
-    /* Get time function cannot be NULL. */
-    context.getTime = NULL;
     mqttStatus = MQTT_ProcessLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
-    /* Restore the time function for the next test. */
-    context.getTime = getTime;
 
-    /* The fixed network buffer cannot be NULL. */
-    context.networkBuffer.pBuffer = NULL;
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+}
+
+void test_MQTT_ProcessLoop_RecvFailed_disconnected( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvFailure;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
 
     mqttStatus = MQTT_ProcessLoop( &context );
 
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
 }
 
-void test_MQTT_ProcessLoop_discardPacket( void )
+void test_MQTT_ReceiveLoop_KeepAliveACK( void )
 {
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
@@ -4120,260 +5886,439 @@ void test_MQTT_ProcessLoop_discardPacket( void )
     MQTTPacketInfo_t incomingPacket = { 0 };
     MQTTStatus_t mqttStatus;
 
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.networkBuffer.size = 20;
+    context.networkBuffer.size = MQTT_TEST_BUFFER_LENGTH;
 
-    incomingPacket.type = currentPacketType;
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
     incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
     incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ReceiveLoop( &context );
 
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
-void test_MQTT_ProcessLoop_IncomingBufferNotInit( void )
+void test_MQTT_ProcessLoop_discardPacket_second_recv_fail( void )
 {
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
     MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTStatus_t mqttStatus;
 
     setupTransportInterface( &transport );
+    transport.recv = transportRecvOneSuccessOneFail;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* First byte shows that it is a publish type packet. */
-    mqttBuffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
-    /* Length of the packet. */
-    mqttBuffer[ 1 ] = 20;
+    context.connectStatus = MQTTConnected;
 
-    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    context.networkBuffer.size = 20;
+
+    incomingPacket.type = currentPacketType;
     incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
     incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
 
-    /* Assume QoS = 1. */
-    publishInfo.qos = MQTTQoS1;
-
-    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
-
     mqttStatus = MQTT_ProcessLoop( &context );
 
     TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
 }
 
-void test_MQTT_ProcessLoop_IncomingBufferNotInitQoS0( void )
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path1( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTPublishInfo_t publishInfo = { 0 };
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t pIncomingCallback[ 10 ];
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
 
-    isEventCallbackInvoked = false;
-
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* First byte shows that it is a publish type packet. */
-    mqttBuffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
-    /* Length of the packet. */
-    mqttBuffer[ 1 ] = 20;
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingCallback, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    context.connectStatus = MQTTConnected;
 
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    modifyIncomingPacketStatus = MQTTSuccess;
 
-    /* Assume QoS = 1. */
-    publishInfo.qos = MQTTQoS0;
+    /* Assume QoS = 1 so that a PUBACK will be sent after receiving PUBLISH.
+     * That is, expectProcessLoopCalls will take on the following parameters:
+     * incomingPublish=true and stateAfterDeserialize=MQTTPubAckSend. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    /* Set expected return values during the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectParams.incomingPublish = true;
+    expectProcessLoopCalls( &context, &expectParams );
+}
 
-    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path2( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
-    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-    TEST_ASSERT_EQUAL( true, isEventCallbackInvoked );
+
+    context.connectStatus = MQTTConnected;
+
+    modifyIncomingPacketStatus = MQTTSuccess;
+
+    /* Assume QoS = 2 so that a PUBREC will be sent after receiving PUBLISH.
+     * That is, expectProcessLoopCalls will take on the following parameters:
+     * incomingPublish=true and stateAfterDeserialize=MQTTPubRecSend. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    /* Set expected return values during the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRecSend;
+    expectParams.stateAfterSerialize = MQTTPubRelPending;
+    expectParams.incomingPublish = true;
+    expectProcessLoopCalls( &context, &expectParams );
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive( void )
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path3( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
+    MQTTPublishInfo_t pubInfo = { 0 };
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t incomingRecords = { 0 };
+    MQTTPubAckInfo_t outgoingRecords = { 0 };
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
     setupNetworkBuffer( &networkBuffer );
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_Init( &context,
+                            &transport,
+                            getTime,
+                            eventCallback,
+                            &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = true;
-    /* Update the time so that there is timeout. */
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
-    mqttStatus = MQTT_ProcessLoop( &context );
+    MQTT_InitStatefulQoS( &context,
+                          &outgoingRecords, 4,
+                          &incomingRecords, 4 );
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    context.connectStatus = MQTTConnected;
+
+    modifyIncomingPacketStatus = MQTTSuccess;
+
+    /* Duplicate QoS1 publish received.
+     * expectProcessLoopCalls will take on the following parameters:
+     * incomingPublish=true, stateAfterDeserialize=MQTTPubAckSend,
+     * updateStateStatus=MQTTStateCollision and pPubInfo is passed with
+     * dup flag set. The event callback should not be invoked. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    pubInfo.dup = true;
+    pubInfo.qos = MQTTQoS1;
+    isEventCallbackInvoked = false;
+    /* Set expected return values during the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.updateStateStatus = MQTTStateCollision;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectParams.deserializeStatus = MQTTSuccess;
+    expectParams.incomingPublish = true;
+    expectParams.pPubInfo = &pubInfo;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive1( void )
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path4( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
-    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
     context.connectStatus = MQTTConnected;
 
-    /* Verify MQTTSuccess is returned. */
-    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
-    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
-
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = 1;
-    /* Update the time so that there is timeout. */
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
-    mqttStatus = MQTT_ProcessLoop( &context );
+    modifyIncomingPacketStatus = MQTTSuccess;
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* Duplicate QoS2 publish received.
+     * expectProcessLoopCalls will take on the following parameters:
+     * incomingPublish=true, stateAfterDeserialize=MQTTPubRecSend,
+     * updateStateStatus=MQTTStateCollision and pPubInfo is passed with
+     * dup flag set. The event callback should not be invoked. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    isEventCallbackInvoked = false;
+    /* Only changes are for QoS 2, no need to reset. */
+    expectParams.stateAfterDeserialize = MQTTPubRecSend;
+    expectParams.stateAfterSerialize = MQTTPubRelPending;
+    expectParams.incomingPublish = true;
+    expectParams.updateStateStatus = MQTTStateCollision;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
 }
 
-void test_MQTT_ProcessLoop_HandleKeepAlive2( void )
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path5( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Set this value such that the library will be forced to send keep alive. */
-    context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = 1;
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Update the time so that timeout does not occur and the ping is not sent. */
-    globalEntryTime = 0;
+    context.connectStatus = MQTTConnected;
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    modifyIncomingPacketStatus = MQTTSuccess;
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* A publish is received when already a state record exists, but dup
+     * flag is not set. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    isEventCallbackInvoked = false;
+    expectParams.incomingPublish = true;
+    expectParams.updateStateStatus = MQTTStateCollision;
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    /* No loop statuses have changed from before. */
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
 }
 
-void test_MQTT_ProcessLoop_RecvFailed( void )
+/**
+ * @brief This test case covers one call to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path6( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvFailure;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
     context.connectStatus = MQTTConnected;
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    modifyIncomingPacketStatus = MQTTSuccess;
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    /* Duplicate QoS2 publish received with no collision.
+     * expectProcessLoopCalls will take on the following parameters:
+     * incomingPublish=true, stateAfterDeserialize=MQTTPubRecSend,
+     * updateStateStatus=MQTTSuccess and pPubInfo is passed with
+     * dup flag set. The event callback should be invoked. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    isEventCallbackInvoked = false;
+    expectParams.incomingPublish = true;
+    /* The only expect parameter to change is the update status. */
+    expectParams.updateStateStatus = MQTTSuccess;
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
 }
 
-void test_MQTT_ProcessLoop_RecvFailed_disconnected( void )
+/**
+ * @brief This test case covers all calls to the private method,
+ * handleIncomingPublish(...),
+ * that result in the process loop returning an error.
+ */
+void test_MQTT_ProcessLoop_handleIncomingPublish_Error_Paths( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTStatus_t mqttStatus;
+    MQTTPublishInfo_t publishInfo = { 0 };
+    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPubAckInfo_t incomingRecords = { 0 };
+    MQTTPubAckInfo_t outgoingRecords = { 0 };
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvFailure;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    MQTT_InitStatefulQoS( &context,
+                          &outgoingRecords, 4,
+                          &incomingRecords, 4 );
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    modifyIncomingPacketStatus = MQTTSuccess;
+
+    /* Verify that an error is propagated when deserialization fails by returning
+     * MQTTBadResponse. Any parameters beyond that are actually irrelevant
+     * because they are only used as return values for non-expected calls. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    /* Set expected return values during the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.deserializeStatus = MQTTBadResponse;
+    expectParams.updateStateStatus = MQTTIllegalState;
+    expectParams.serializeStatus = MQTTBadResponse;
+    expectParams.processLoopStatus = MQTTBadResponse;
+    expectParams.incomingPublish = true;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* A publish is received and dup flag is set, but state update failed. */
+    publishInfo.dup = true;
+    publishInfo.qos = MQTTQoS2;
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    isEventCallbackInvoked = false;
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.updateStateStatus = MQTTIllegalState;
+    expectParams.processLoopStatus = MQTTIllegalState;
+    expectParams.incomingPublish = true;
+    expectParams.pPubInfo = &publishInfo;
+    /* The other loop parameter fields are irrelevant. */
+    expectProcessLoopCalls( &context, &expectParams );
+
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
 }
 
-void test_MQTT_ReceiveLoop_KeepAliveACK( void )
+/**
+ * @brief This test checks that the ProcessLoop API function is able to
+ * support receiving an entire incoming MQTT packet over the network when
+ * the transport recv function only reads less than requested bytes at a
+ * time, and the timeout passed to the API is "0ms".
+ */
+void test_MQTT_ProcessLoop_Zero_Duration_And_Partial_Network_Read( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTStatus_t mqttStatus;
+    ProcessLoopReturns_t expectParams = { 0 };
 
-    setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-
-    context.networkBuffer.size = MQTT_TEST_BUFFER_LENGTH;
+    transport.send = transportSendSuccess;
 
-    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    /* Set the transport recv function for the test to the mock function that represents
+     * partial read of data from network (i.e. less than requested number of bytes)
+     * at a time. */
+    transport.recv = transportRecvOneByte;
 
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    /* Initialize the context. */
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    /* Set flag required for configuring behavior of expectProcessLoopCalls()
+     * helper function. */
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
 
-    mqttStatus = MQTT_ReceiveLoop( &context );
+    /* Test the ProcessLoop() call with zero duration timeout to verify that it
+     * will be able to support reading the packet over network over multiple calls to
+     * the transport receive function. */
+    expectParams.timeoutMs = MQTT_NO_TIMEOUT_MS;
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* Test with an incoming PUBLISH packet whose payload is read only one byte
+     * per call to the transport recv function. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
+    /* Set expected return values during the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectParams.incomingPublish = true;
+    expectParams.processLoopStatus = MQTTNeedMoreBytes;
+    expectParams.updateStateStatus = MQTTNeedMoreBytes;
+    expectProcessLoopCalls( &context, &expectParams );
 }
 
-void test_MQTT_ProcessLoop_discardPacket_second_recv_fail( void )
+/**
+ * @brief This test case covers all calls to the private method,
+ * handleIncomingAck(...),
+ * that result in the process loop returning successfully.
+ */
+void test_MQTT_ProcessLoop_handleIncomingAck_Happy_Paths( void )
 {
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTStatus_t mqttStatus;
+    ProcessLoopReturns_t expectParams = { 0 };
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvOneSuccessOneFail;
     setupNetworkBuffer( &networkBuffer );
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
@@ -4381,33 +6326,97 @@ void test_MQTT_ProcessLoop_discardPacket_second_recv_fail( void )
 
     context.connectStatus = MQTTConnected;
 
-    context.networkBuffer.size = 20;
+    modifyIncomingPacketStatus = MQTTSuccess;
+
+    /* Mock the receiving of a PUBACK packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPublishDone;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Mock the receiving of a PUBREC packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Mock the receiving of a PUBREL packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREL;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubCompSend;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Duplicate PUBREL, but no record exists. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREL;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTStateNull;
+    expectParams.updateStateStatus = MQTTBadParameter;
+    expectParams.processLoopStatus = MQTTBadParameter;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Mock the receiving of a PUBCOMP packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBCOMP;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPublishDone;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
 
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    /* Mock the receiving of a PINGRESP packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectProcessLoopCalls( &context, &expectParams );
 
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    /* Mock the receiving of a SUBACK packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectProcessLoopCalls( &context, &expectParams );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    /* Verify that process loop is still successful when SUBACK indicates a
+     * server refusal. */
+    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
+    isEventCallbackInvoked = false;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.deserializeStatus = MQTTServerRefused;
+    expectProcessLoopCalls( &context, &expectParams );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    /* Mock the receiving of an UNSUBACK packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_UNSUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectProcessLoopCalls( &context, &expectParams );
 }
 
 /**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
+ * @brief This test case covers all calls to the private method,
+ * handleIncomingAck(...),
  * that result in the process loop returning successfully.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path1( void )
+void test_MQTT_ProcessLoop_handleIncomingAck_Clear_Publish_Copies( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t pIncomingCallback[ 10 ];
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
@@ -4415,38 +6424,65 @@ void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path1( void )
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingCallback, 10 );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
+                                       publishRetrieveCallbackSuccess,
+                                       publishClearCallback );
 
     context.connectStatus = MQTTConnected;
 
     modifyIncomingPacketStatus = MQTTSuccess;
 
-    /* Assume QoS = 1 so that a PUBACK will be sent after receiving PUBLISH.
-     * That is, expectProcessLoopCalls will take on the following parameters:
-     * incomingPublish=true and stateAfterDeserialize=MQTTPubAckSend. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    /* Set expected return values during the loop. */
+    /* Mock the receiving of a PUBACK packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
+    expectParams.stateAfterDeserialize = MQTTPublishDone;
     expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectParams.incomingPublish = true;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Mock the receiving of a PUBREC packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    context.clearFunction = publishClearCallback;
+
+    /* Mock the receiving of a PUBACK packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPublishDone;
+    expectParams.stateAfterSerialize = MQTTPublishDone;
+    expectProcessLoopCalls( &context, &expectParams );
+
+    /* Mock the receiving of a PUBREC packet type and expect the appropriate
+     * calls made from the process loop. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
     expectProcessLoopCalls( &context, &expectParams );
 }
 
 /**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
- * that result in the process loop returning successfully.
+ * @brief This test case covers all calls to the private method,
+ * handleIncomingAck(...),
+ * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path2( void )
+void test_MQTT_ProcessLoop_handleIncomingAck_Error_Paths( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
@@ -4454,321 +6490,347 @@ void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path2( void )
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-
     context.connectStatus = MQTTConnected;
 
     modifyIncomingPacketStatus = MQTTSuccess;
 
-    /* Assume QoS = 2 so that a PUBREC will be sent after receiving PUBLISH.
-     * That is, expectProcessLoopCalls will take on the following parameters:
-     * incomingPublish=true and stateAfterDeserialize=MQTTPubRecSend. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    /* Set expected return values during the loop. */
+    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
+     * receiving an unknown packet type. */
+    currentPacketType = MQTT_PACKET_TYPE_INVALID;
+    /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRecSend;
-    expectParams.stateAfterSerialize = MQTTPubRelPending;
-    expectParams.incomingPublish = true;
+    expectParams.deserializeStatus = MQTTBadResponse;
+    expectParams.processLoopStatus = MQTTBadResponse;
     expectProcessLoopCalls( &context, &expectParams );
-}
 
-/**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
- * that result in the process loop returning successfully.
- */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path3( void )
-{
-    MQTTStatus_t mqttStatus;
-    MQTTContext_t context = { 0 };
-    TransportInterface_t transport = { 0 };
-    MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTPublishInfo_t pubInfo = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t incomingRecords = { 0 };
-    MQTTPubAckInfo_t outgoingRecords = { 0 };
+    /* Verify that MQTTSendFailed is propagated when receiving a PUBREC
+     * then failing when serializing a PUBREL to send in response. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.serializeStatus = MQTTNoMemory;
+    expectParams.stateAfterSerialize = MQTTStateNull;
+    expectParams.processLoopStatus = MQTTNoMemory;
+    expectProcessLoopCalls( &context, &expectParams );
 
-    setupTransportInterface( &transport );
-    setupNetworkBuffer( &networkBuffer );
+    /* Verify that MQTTStatusNotConnected propagated when receiving a any ACK,
+     * here PUBREC but thr connection status is MQTTNotConnected. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
+    expectParams.serializeStatus = MQTTSuccess;
+    expectParams.processLoopStatus = MQTTStatusNotConnected;
+    context.connectStatus = MQTTNotConnected;
+    expectProcessLoopCalls( &context, &expectParams );
+    context.connectStatus = MQTTConnected;
 
-    mqttStatus = MQTT_Init( &context,
-                            &transport,
-                            getTime,
-                            eventCallback,
-                            &networkBuffer );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* Verify that MQTTStatusNotConnected propagated when receiving a any ACK,
+     * here PUBREC but thr connection status is MQTTNotConnected. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTPubCompPending;
+    expectParams.serializeStatus = MQTTSuccess;
+    expectParams.processLoopStatus = MQTTStatusDisconnectPending;
+    context.connectStatus = MQTTDisconnectPending;
+    expectProcessLoopCalls( &context, &expectParams );
+    context.connectStatus = MQTTConnected;
 
-    MQTT_InitStatefulQoS( &context,
-                          &outgoingRecords, 4,
-                          &incomingRecords, 4 );
+    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
+     * receiving a PUBACK. */
+    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.deserializeStatus = MQTTBadResponse;
+    expectParams.stateAfterDeserialize = MQTTStateNull;
+    expectParams.processLoopStatus = MQTTBadResponse;
+    /* The other loop parameter fields are irrelevant. */
+    expectProcessLoopCalls( &context, &expectParams );
 
-    context.connectStatus = MQTTConnected;
+    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
+     * receiving a PINGRESP. */
+    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.deserializeStatus = MQTTBadResponse;
+    expectParams.stateAfterDeserialize = MQTTStateNull;
+    expectParams.processLoopStatus = MQTTBadResponse;
+    /* The other loop parameter fields are irrelevant. */
+    expectProcessLoopCalls( &context, &expectParams );
 
-    modifyIncomingPacketStatus = MQTTSuccess;
+    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
+     * receiving a SUBACK. */
+    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+    expectParams.deserializeStatus = MQTTBadResponse;
+    expectParams.processLoopStatus = MQTTBadResponse;
+    /* The other loop parameter fields are irrelevant. */
+    expectProcessLoopCalls( &context, &expectParams );
 
-    /* Duplicate QoS1 publish received.
-     * expectProcessLoopCalls will take on the following parameters:
-     * incomingPublish=true, stateAfterDeserialize=MQTTPubAckSend,
-     * updateStateStatus=MQTTStateCollision and pPubInfo is passed with
-     * dup flag set. The event callback should not be invoked. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    pubInfo.dup = true;
-    pubInfo.qos = MQTTQoS1;
-    isEventCallbackInvoked = false;
-    /* Set expected return values during the loop. */
+    /* Verify that MQTTIllegalState is returned if MQTT_UpdateStateAck(...)
+     * provides an unknown state such as MQTTStateNull to sendPublishAcks(...). */
+    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
+    /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
-    expectParams.updateStateStatus = MQTTStateCollision;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectParams.deserializeStatus = MQTTSuccess;
-    expectParams.incomingPublish = true;
-    expectParams.pPubInfo = &pubInfo;
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    expectParams.stateAfterSerialize = MQTTStateNull;
+    expectParams.processLoopStatus = MQTTIllegalState;
     expectProcessLoopCalls( &context, &expectParams );
-    TEST_ASSERT_FALSE( isEventCallbackInvoked );
 }
 
 /**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
+ * @brief This test case covers all calls to the private method,
+ * handleKeepAlive(...),
  * that result in the process loop returning successfully.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path4( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths1( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
-    setupTransportInterface( &transport );
-    setupNetworkBuffer( &networkBuffer );
+    resetProcessLoopParams( &expectParams );
+    setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
+
+    /* Coverage for the branch path where keep alive interval is 0. */
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.connectStatus = MQTTConnected;
+
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = 0;
+    expectParams.incomingPublish = false;
+    expectParams.updateStateStatus = MQTTSuccess;
+    expectParams.processLoopStatus = MQTTSuccess;
+    expectParams.stateAfterDeserialize = MQTTPubRelSend;
+    /* Set expected return values in the loop. All success. */
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
 
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
 
-    context.connectStatus = MQTTConnected;
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    modifyIncomingPacketStatus = MQTTSuccess;
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
 
-    /* Duplicate QoS2 publish received.
-     * expectProcessLoopCalls will take on the following parameters:
-     * incomingPublish=true, stateAfterDeserialize=MQTTPubRecSend,
-     * updateStateStatus=MQTTStateCollision and pPubInfo is passed with
-     * dup flag set. The event callback should not be invoked. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    isEventCallbackInvoked = false;
-    /* Only changes are for QoS 2, no need to reset. */
-    expectParams.stateAfterDeserialize = MQTTPubRecSend;
-    expectParams.stateAfterSerialize = MQTTPubRelPending;
-    expectParams.incomingPublish = true;
-    expectParams.updateStateStatus = MQTTStateCollision;
-    expectProcessLoopCalls( &context, &expectParams );
-    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
+ * @brief This test case covers all calls to the private method,
+ * handleKeepAlive(...),
  * that result in the process loop returning successfully.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path5( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths2( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
-    setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+    resetProcessLoopParams( &expectParams );
+
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
 
+    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
+    /* Coverage for the branch path where keep alive interval is greater than 0,
+     * and the interval has not expired. PINGREQ should not be sent. */
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    context.lastPacketTxTime = getTime();
+    /* Set expected return values in the loop. All success. */
 
-    context.connectStatus = MQTTConnected;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-    modifyIncomingPacketStatus = MQTTSuccess;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    /* A publish is received when already a state record exists, but dup
-     * flag is not set. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    isEventCallbackInvoked = false;
-    expectParams.incomingPublish = true;
-    expectParams.updateStateStatus = MQTTStateCollision;
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    /* No loop statuses have changed from before. */
-    expectProcessLoopCalls( &context, &expectParams );
-    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
- * @brief This test case covers one call to the private method,
- * handleIncomingPublish(...),
+ * @brief This test case covers all calls to the private method,
+ * handleKeepAlive(...),
  * that result in the process loop returning successfully.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Happy_Path6( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths3( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t pIncomingPublish[ 10 ];
 
-    setupTransportInterface( &transport );
+    resetProcessLoopParams( &expectParams );
     setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
 
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
+
+    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, pIncomingPublish, 10 );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* Coverage for the branch path where PINGRESP timeout interval hasn't expired. */
+    context.waitingForPingResp = true;
+    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    context.lastPacketTxTime = MQTT_ONE_SECOND_TO_MS;
+    context.pingReqSendTimeMs = MQTT_ONE_SECOND_TO_MS;
+    /* Set expected return values in the loop. All success. */
 
-    context.connectStatus = MQTTConnected;
 
-    modifyIncomingPacketStatus = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-    /* Duplicate QoS2 publish received with no collision.
-     * expectProcessLoopCalls will take on the following parameters:
-     * incomingPublish=true, stateAfterDeserialize=MQTTPubRecSend,
-     * updateStateStatus=MQTTSuccess and pPubInfo is passed with
-     * dup flag set. The event callback should be invoked. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    isEventCallbackInvoked = false;
-    expectParams.incomingPublish = true;
-    /* The only expect parameter to change is the update status. */
-    expectParams.updateStateStatus = MQTTSuccess;
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
-    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
  * @brief This test case covers all calls to the private method,
- * handleIncomingPublish(...),
- * that result in the process loop returning an error.
+ * handleKeepAlive(...),
+ * that result in the process loop returning successfully.
  */
-void test_MQTT_ProcessLoop_handleIncomingPublish_Error_Paths( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths4( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    MQTTPublishInfo_t publishInfo = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
-    MQTTPubAckInfo_t incomingRecords = { 0 };
-    MQTTPubAckInfo_t outgoingRecords = { 0 };
 
-    setupTransportInterface( &transport );
+    resetProcessLoopParams( &expectParams );
     setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
 
+    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    MQTT_InitStatefulQoS( &context,
-                          &outgoingRecords, 4,
-                          &incomingRecords, 4 );
+    context.waitingForPingResp = false;
+    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    context.lastPacketTxTime = 0;
+    /* Set expected return values in the loop. All success. */
 
-    modifyIncomingPacketStatus = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-    /* Verify that an error is propagated when deserialization fails by returning
-     * MQTTBadResponse. Any parameters beyond that are actually irrelevant
-     * because they are only used as return values for non-expected calls. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    /* Set expected return values during the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTBadResponse;
-    expectParams.updateStateStatus = MQTTIllegalState;
-    expectParams.serializeStatus = MQTTBadResponse;
-    expectParams.processLoopStatus = MQTTBadResponse;
-    expectParams.incomingPublish = true;
-    expectProcessLoopCalls( &context, &expectParams );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
 
-    /* A publish is received and dup flag is set, but state update failed. */
-    publishInfo.dup = true;
-    publishInfo.qos = MQTTQoS2;
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    isEventCallbackInvoked = false;
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
-    expectParams.updateStateStatus = MQTTIllegalState;
-    expectParams.processLoopStatus = MQTTIllegalState;
-    expectParams.incomingPublish = true;
-    expectParams.pPubInfo = &publishInfo;
-    /* The other loop parameter fields are irrelevant. */
-    expectProcessLoopCalls( &context, &expectParams );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
- * @brief This test checks that the ProcessLoop API function is able to
- * support receiving an entire incoming MQTT packet over the network when
- * the transport recv function only reads less than requested bytes at a
- * time, and the timeout passed to the API is "0ms".
+ * @brief This test case covers all calls to the private method,
+ * handleKeepAlive(...),
+ * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_Zero_Duration_And_Partial_Network_Read( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths1( void )
 {
-    MQTTStatus_t mqttStatus;
+    MQTTStatus_t mqttStatus = { 0 };
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
 
     setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+    transport.writev = transportWritevSuccess;
+    transport.recv = transportRecvNoData;
 
-    transport.send = transportSendSuccess;
-
-    /* Set the transport recv function for the test to the mock function that represents
-     * partial read of data from network (i.e. less than requested number of bytes)
-     * at a time. */
-    transport.recv = transportRecvOneByte;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
 
-    /* Initialize the context. */
+    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Set flag required for configuring behavior of expectProcessLoopCalls()
-     * helper function. */
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-
-    /* Test the ProcessLoop() call with zero duration timeout to verify that it
-     * will be able to support reading the packet over network over multiple calls to
-     * the transport receive function. */
-    expectParams.timeoutMs = MQTT_NO_TIMEOUT_MS;
+    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    context.lastPacketTxTime = 0;
+    context.lastPacketRxTime = 0;
+    context.pingReqSendTimeMs = 0;
+    context.waitingForPingResp = true;
 
-    /* Test with an incoming PUBLISH packet whose payload is read only one byte
-     * per call to the transport recv function. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBLISH;
-    /* Set expected return values during the loop. */
+    /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubAckSend;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectParams.incomingPublish = true;
-    expectParams.processLoopStatus = MQTTNeedMoreBytes;
-    expectParams.updateStateStatus = MQTTNeedMoreBytes;
-    expectProcessLoopCalls( &context, &expectParams );
+    expectParams.processLoopStatus = MQTTKeepAliveTimeout;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTKeepAliveTimeout, mqttStatus );
 }
 
 /**
  * @brief This test case covers all calls to the private method,
- * handleIncomingAck(...),
- * that result in the process loop returning successfully.
+ * handleKeepAlive(...),
+ * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_handleIncomingAck_Happy_Paths( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths2( void )
 {
-    MQTTStatus_t mqttStatus;
+    MQTTStatus_t mqttStatus = { 0 };
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
@@ -4777,96 +6839,43 @@ void test_MQTT_ProcessLoop_handleIncomingAck_Happy_Paths( void )
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
 
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
+
+    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.connectStatus = MQTTConnected;
-
-    modifyIncomingPacketStatus = MQTTSuccess;
-
-    /* Mock the receiving of a PUBACK packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPublishDone;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Mock the receiving of a PUBREC packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTPubCompPending;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Mock the receiving of a PUBREL packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREL;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubCompSend;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Duplicate PUBREL, but no record exists. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREL;
+    context.keepAliveIntervalSec = PACKET_TX_TIMEOUT_MS + 1;
+    context.lastPacketTxTime = 0;
+    context.lastPacketRxTime = 0;
+    context.pingReqSendTimeMs = 0;
+    context.waitingForPingResp = false;
     /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTStateNull;
-    expectParams.updateStateStatus = MQTTBadParameter;
-    expectParams.processLoopStatus = MQTTBadParameter;
-    expectProcessLoopCalls( &context, &expectParams );
 
-    /* Mock the receiving of a PUBCOMP packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBCOMP;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPublishDone;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
+    expectParams.processLoopStatus = MQTTKeepAliveTimeout;
 
-    /* Mock the receiving of a PINGRESP packet type and expect the appropriate
-     * calls made from the process loop. */
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
     currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Mock the receiving of a SUBACK packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectProcessLoopCalls( &context, &expectParams );
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-    /* Verify that process loop is still successful when SUBACK indicates a
-     * server refusal. */
-    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
-    isEventCallbackInvoked = false;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTServerRefused;
-    expectProcessLoopCalls( &context, &expectParams );
-    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
 
-    /* Mock the receiving of an UNSUBACK packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_UNSUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectProcessLoopCalls( &context, &expectParams );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
  * @brief This test case covers all calls to the private method,
- * handleIncomingAck(...),
- * that result in the process loop returning successfully.
+ * handleKeepAlive(...),
+ * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_handleIncomingAck_Clear_Publish_Copies( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths3( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
@@ -4876,63 +6885,40 @@ void test_MQTT_ProcessLoop_handleIncomingAck_Clear_Publish_Copies( void )
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
+    transport.recv = transportRecvNoData;
+
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
 
+    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    mqttStatus = MQTT_InitRetransmits( &context, publishStoreCallbackSuccess,
-                                       publishRetrieveCallbackSuccess,
-                                       publishClearCallback );
-
     context.connectStatus = MQTTConnected;
 
-    modifyIncomingPacketStatus = MQTTSuccess;
-
-    /* Mock the receiving of a PUBACK packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPublishDone;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Mock the receiving of a PUBREC packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTPubCompPending;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    context.clearFunction = publishClearCallback;
-
-    /* Mock the receiving of a PUBACK packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
+    globalEntryTime = PACKET_RX_TIMEOUT_MS + 1;
+    context.keepAliveIntervalSec = 0;
+    context.lastPacketTxTime = 0;
+    context.lastPacketRxTime = 0;
+    context.pingReqSendTimeMs = 0;
+    context.waitingForPingResp = false;
     /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPublishDone;
-    expectParams.stateAfterSerialize = MQTTPublishDone;
-    expectProcessLoopCalls( &context, &expectParams );
+    size_t packetSize = MQTT_PACKET_PINGREQ_SIZE;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &packetSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    /* Mock the receiving of a PUBREC packet type and expect the appropriate
-     * calls made from the process loop. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTPubCompPending;
-    expectProcessLoopCalls( &context, &expectParams );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
 /**
  * @brief This test case covers all calls to the private method,
- * handleIncomingAck(...),
+ * handleKeepAlive(...),
  * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_handleIncomingAck_Error_Paths( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths4( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
@@ -4941,110 +6927,57 @@ void test_MQTT_ProcessLoop_handleIncomingAck_Error_Paths( void )
     ProcessLoopReturns_t expectParams = { 0 };
 
     setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+
     setupNetworkBuffer( &networkBuffer );
 
+    modifyIncomingPacketStatus = MQTTNoDataAvailable;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
+
+    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
     context.connectStatus = MQTTConnected;
 
-    modifyIncomingPacketStatus = MQTTSuccess;
-
-    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
-     * receiving an unknown packet type. */
-    currentPacketType = MQTT_PACKET_TYPE_INVALID;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTBadResponse;
-    expectParams.processLoopStatus = MQTTBadResponse;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Verify that MQTTSendFailed is propagated when receiving a PUBREC
-     * then failing when serializing a PUBREL to send in response. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.serializeStatus = MQTTNoMemory;
-    expectParams.stateAfterSerialize = MQTTStateNull;
-    expectParams.processLoopStatus = MQTTNoMemory;
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Verify that MQTTStatusNotConnected propagated when receiving a any ACK,
-     * here PUBREC but thr connection status is MQTTNotConnected. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTPubCompPending;
-    expectParams.serializeStatus = MQTTSuccess;
-    expectParams.processLoopStatus = MQTTStatusNotConnected;
-    context.connectStatus = MQTTNotConnected;
-    expectProcessLoopCalls( &context, &expectParams );
-    context.connectStatus = MQTTConnected;
-
-    /* Verify that MQTTStatusNotConnected propagated when receiving a any ACK,
-     * here PUBREC but thr connection status is MQTTNotConnected. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTPubCompPending;
-    expectParams.serializeStatus = MQTTSuccess;
-    expectParams.processLoopStatus = MQTTStatusDisconnectPending;
-    context.connectStatus = MQTTDisconnectPending;
-    expectProcessLoopCalls( &context, &expectParams );
-    context.connectStatus = MQTTConnected;
-
-    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
-     * receiving a PUBACK. */
-    currentPacketType = MQTT_PACKET_TYPE_PUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTBadResponse;
-    expectParams.stateAfterDeserialize = MQTTStateNull;
-    expectParams.processLoopStatus = MQTTBadResponse;
-    /* The other loop parameter fields are irrelevant. */
-    expectProcessLoopCalls( &context, &expectParams );
-
-    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
-     * receiving a PINGRESP. */
-    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTBadResponse;
-    expectParams.stateAfterDeserialize = MQTTStateNull;
-    expectParams.processLoopStatus = MQTTBadResponse;
-    /* The other loop parameter fields are irrelevant. */
-    expectProcessLoopCalls( &context, &expectParams );
+    globalEntryTime = PACKET_RX_TIMEOUT_MS + 1;
+    context.keepAliveIntervalSec = ( PACKET_TX_TIMEOUT_MS / 1000 ) + 1U;
+    context.lastPacketTxTime = 0;
+    context.lastPacketRxTime = 0;
+    context.pingReqSendTimeMs = 0;
+    context.waitingForPingResp = false;
 
-    /* Verify that MQTTBadResponse is propagated when deserialization fails upon
-     * receiving a SUBACK. */
-    currentPacketType = MQTT_PACKET_TYPE_SUBACK;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.deserializeStatus = MQTTBadResponse;
-    expectParams.processLoopStatus = MQTTBadResponse;
-    /* The other loop parameter fields are irrelevant. */
-    expectProcessLoopCalls( &context, &expectParams );
+    /* Set the index to non-zero value to show that there is some data in the buffer
+     * to be processed. */
+    context.index = 12;
 
-    /* Verify that MQTTIllegalState is returned if MQTT_UpdateStateAck(...)
-     * provides an unknown state such as MQTTStateNull to sendPublishAcks(...). */
-    currentPacketType = MQTT_PACKET_TYPE_PUBREC;
     /* Set expected return values in the loop. */
     resetProcessLoopParams( &expectParams );
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    expectParams.stateAfterSerialize = MQTTStateNull;
-    expectParams.processLoopStatus = MQTTIllegalState;
-    expectProcessLoopCalls( &context, &expectParams );
+
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* Modify incoming packet depending on type to be tested. */
+    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.type = currentPacketType;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    size_t packetSize = MQTT_PACKET_PINGREQ_SIZE;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &packetSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
 }
 
 /**
  * @brief This test case covers all calls to the private method,
  * handleKeepAlive(...),
- * that result in the process loop returning successfully.
+ * that result in the process loop returning an error.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths1( void )
+void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths5( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
@@ -5052,578 +6985,713 @@ void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths1( void )
     MQTTFixedBuffer_t networkBuffer = { 0 };
     ProcessLoopReturns_t expectParams = { 0 };
 
-    resetProcessLoopParams( &expectParams );
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+
+    setupNetworkBuffer( &networkBuffer );
 
     modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
 
-    /* Coverage for the branch path where keep alive interval is 0. */
+    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.connectStatus = MQTTConnected;
-
+    globalEntryTime = PACKET_RX_TIMEOUT_MS - 1U;
+    context.keepAliveIntervalSec = ( PACKET_TX_TIMEOUT_MS / 1000 ) + 1U;
+    context.lastPacketTxTime = 0;
+    context.lastPacketRxTime = 0;
+    context.pingReqSendTimeMs = 0;
     context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = 0;
-    expectParams.incomingPublish = false;
-    expectParams.updateStateStatus = MQTTSuccess;
-    expectParams.processLoopStatus = MQTTSuccess;
-    expectParams.stateAfterDeserialize = MQTTPubRelSend;
-    /* Set expected return values in the loop. All success. */
+
+    /* Set the index to non-zero value to show that there is some data in the buffer
+     * to be processed. */
+    context.index = 12;
+
+    /* Set expected return values in the loop. */
+    resetProcessLoopParams( &expectParams );
+
     MQTTPacketInfo_t incomingPacket = { 0 };
     /* Modify incoming packet depending on type to be tested. */
+    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
     incomingPacket.type = currentPacketType;
     incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
     incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
 
-
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+}
 
-    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+/**
+ * @brief This test mocks a failing transport receive and runs multiple
+ * iterations of the process loop, resulting in returning MQTTRecvFailed.
+ */
+void test_MQTT_ProcessLoop_Receive_Failed( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
 
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+    setupNetworkBuffer( &networkBuffer );
+    setupTransportInterface( &transport );
+    transport.writev = transportWritevFail;
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_Init( &context, &transport,
+                            getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBCOMP;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTRecvFailed );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning successfully.
+ * @brief Set the initial entry time close to the maximum value, causing
+ * an overflow. This test then checks that the process loop still runs for the
+ * expected number of iterations in spite of this.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths2( void )
+void test_MQTT_ProcessLoop_Timer_Overflow( void )
 {
-    MQTTStatus_t mqttStatus;
+    MQTTStatus_t mqttStatus = { 0 };
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    MQTTPubAckInfo_t incomingPublishRecords[ 10 ];
 
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
-    resetProcessLoopParams( &expectParams );
+    setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    globalEntryTime = UINT32_MAX - MQTT_OVERFLOW_OFFSET;
 
-    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Coverage for the branch path where keep alive interval is greater than 0,
-     * and the interval has not expired. PINGREQ should not be sent. */
-    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, incomingPublishRecords, 10 );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
-    context.lastPacketTxTime = getTime();
-    /* Set expected return values in the loop. All success. */
 
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    context.connectStatus = MQTTConnected;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
-
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+    /* Assume QoS = 1 so that a PUBACK will be sent after receiving PUBLISH. */
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
 
     mqttStatus = MQTT_ProcessLoop( &context );
+
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
+/* ========================================================================== */
+
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning successfully.
+ * @brief Test that MQTT_ReceiveLoop() works as intended. Since the only difference
+ * between this and the process loop is keep alive, we only need to test the
+ * differences for coverage.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths3( void )
+void test_MQTT_ReceiveLoop( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
 
-    resetProcessLoopParams( &expectParams );
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Verify that a NULL Context returns an error. */
+    mqttStatus = MQTT_ReceiveLoop( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Verify that a NULL time function returns an error. */
+    context.getTime = NULL;
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    context.getTime = getTime;
+
+    /* Verify that a null fixed network buffer returns an error. */
+    context.networkBuffer.pBuffer = NULL;
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    setupNetworkBuffer( &( context.networkBuffer ) );
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTBadResponse );
+    /* Error case, for branch coverage. */
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+
+    /* This will cover the case when there is data available in the buffer to be processed but
+     * no additional bytes have been received by the transport interface. */
+    context.transportInterface.recv = transportRecvNoData;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTBadResponse );
+    /* Error case, for branch coverage. */
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+
+    /* Reset the index to clear the buffer of any remaining data. */
+    context.index = 0;
+    /* Keep Alive should not trigger.*/
+    context.keepAliveIntervalSec = 1;
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( context.controlPacketSent );
+
+    /* Test with a dummy getTime to ensure there's no infinite loops. */
+    context.getTime = getTimeDummy;
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    context.getTime = getTime;
+
+    /* Receive a PINGRESP. */
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_ProcessLoopBatch returns MQTTBadParameter for invalid
+ * parameters.
+ */
+void test_MQTT_ProcessLoopBatch_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t processedCount = 0;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
 
-    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Coverage for the branch path where PINGRESP timeout interval hasn't expired. */
-    context.waitingForPingResp = true;
-    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
-    context.lastPacketTxTime = MQTT_ONE_SECOND_TO_MS;
-    context.pingReqSendTimeMs = MQTT_ONE_SECOND_TO_MS;
-    /* Set expected return values in the loop. All success. */
+    mqttStatus = MQTT_ProcessLoopBatch( NULL, 1U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 1U, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 0U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    context.getTime = NULL;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 1U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    context.getTime = getTime;
+
+    context.networkBuffer.pBuffer = NULL;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 1U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_ProcessLoopBatch handles the packets already in the
+ * buffer without reading from the transport interface.
+ */
+void test_MQTT_ProcessLoopBatch_Drains_Buffer_Before_Receive( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    size_t processedCount = 0;
+
+    setupTransportInterface( &transport );
+    /* A read from the transport interface would fail the test. */
+    transport.recv = transportRecvFailure;
+    setupNetworkBuffer( &networkBuffer );
 
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    /* Two PINGRESPs and the first byte of a third are in the buffer. */
+    context.index = 5U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
 
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
-
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 2U, &processedCount );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, processedCount );
+    TEST_ASSERT_EQUAL( 1U, context.index );
+
+    /* The remaining partial packet is kept and the transport is read. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 2U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, processedCount );
+    TEST_ASSERT_EQUAL( 1U, context.index );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning successfully.
+ * @brief Test that MQTT_ProcessLoopBatch handles every complete packet of a
+ * single read, up to the maximum number of packets.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Happy_Paths4( void )
+void test_MQTT_ProcessLoopBatch_Receive_Then_Drain( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    size_t processedCount = 0;
 
-    resetProcessLoopParams( &expectParams );
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_ONE_SECOND_TO_MS;
-
-    /* Coverage for the branch path where keep alive interval is 0. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.waitingForPingResp = false;
-    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
-    context.lastPacketTxTime = 0;
-    /* Set expected return values in the loop. All success. */
-
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 3U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 3U, processedCount );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 6U, context.index );
 
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( expectParams.updateStateStatus );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &expectParams.stateAfterDeserialize );
+    /* An invalid packet in the buffer is reported. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTBadResponse );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 3U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, processedCount );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning an error.
+ * @brief Test that MQTT_ProcessLoopBatch manages keep alive when no data is
+ * received.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths1( void )
+void test_MQTT_ProcessLoopBatch_No_Data( void )
 {
-    MQTTStatus_t mqttStatus = { 0 };
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
+    size_t processedCount = 0;
 
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
-    transport.writev = transportWritevSuccess;
     transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
 
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
-
-    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
-    context.lastPacketTxTime = 0;
-    context.lastPacketRxTime = 0;
-    context.pingReqSendTimeMs = 0;
+    context.connectStatus = MQTTConnected;
     context.waitingForPingResp = true;
+    context.pingReqSendTimeMs = 0U;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1U;
 
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    expectParams.processLoopStatus = MQTTKeepAliveTimeout;
-
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 1U, &processedCount );
     TEST_ASSERT_EQUAL( MQTTKeepAliveTimeout, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, processedCount );
+
+    context.waitingForPingResp = false;
+    context.lastPacketTxTime = globalEntryTime;
+    context.lastPacketRxTime = globalEntryTime;
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, 1U, &processedCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, processedCount );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning an error.
+ * @brief Test that MQTT_InitRingReceive validates its parameter and enables
+ * the ring receive mode.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths2( void )
+void test_MQTT_InitRingReceive( void )
 {
-    MQTTStatus_t mqttStatus = { 0 };
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
+    mqttStatus = MQTT_InitRingReceive( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( context.ringReceive );
 
-    context.keepAliveIntervalSec = PACKET_TX_TIMEOUT_MS + 1;
-    context.lastPacketTxTime = 0;
-    context.lastPacketRxTime = 0;
-    context.pingReqSendTimeMs = 0;
-    context.waitingForPingResp = false;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-
-    expectParams.processLoopStatus = MQTTKeepAliveTimeout;
-
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
-
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
-    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_InitRingReceive( &context );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( context.ringReceive );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning an error.
+ * @brief Test that in ring receive mode packets are consumed in place and
+ * the buffer wraps back to its start once it has been drained.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths3( void )
+void test_MQTT_ReceiveLoop_RingReceive_Consumes_In_Place( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
 
     setupTransportInterface( &transport );
-    setupNetworkBuffer( &networkBuffer );
     transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
-
-    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.connectStatus = MQTTConnected;
+    mqttStatus = MQTT_InitRingReceive( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    globalEntryTime = PACKET_RX_TIMEOUT_MS + 1;
-    context.keepAliveIntervalSec = 0;
-    context.lastPacketTxTime = 0;
-    context.lastPacketRxTime = 0;
-    context.pingReqSendTimeMs = 0;
-    context.waitingForPingResp = false;
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-    size_t packetSize = MQTT_PACKET_PINGREQ_SIZE;
-    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &packetSize );
-    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+    /* Two PINGRESPs are already in the buffer. */
+    mqttBuffer[ 0 ] = MQTT_PACKET_TYPE_PINGRESP;
+    mqttBuffer[ 1 ] = 0U;
+    mqttBuffer[ 2 ] = MQTT_PACKET_TYPE_PINGRESP;
+    mqttBuffer[ 3 ] = 0U;
+    context.index = 4U;
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The first packet is consumed without moving the second one. */
+    TEST_ASSERT_EQUAL( 2U, context.readIndex );
+    TEST_ASSERT_EQUAL( 4U, context.index );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PINGRESP, mqttBuffer[ 2 ] );
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ReceiveLoop( &context );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Once drained, the buffer wraps back to its start. */
+    TEST_ASSERT_EQUAL( 0U, context.readIndex );
+    TEST_ASSERT_EQUAL( 0U, context.index );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning an error.
+ * @brief Test that in ring receive mode a partial packet is moved to the start
+ * of the buffer only when the rest of it cannot be received in place.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths4( void )
+void test_MQTT_ReceiveLoop_RingReceive_Linearise_Partial_Packet( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
 
     setupTransportInterface( &transport );
     transport.recv = transportRecvNoData;
-
     setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
-
-    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    context.connectStatus = MQTTConnected;
+    mqttStatus = MQTT_InitRingReceive( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    globalEntryTime = PACKET_RX_TIMEOUT_MS + 1;
-    context.keepAliveIntervalSec = ( PACKET_TX_TIMEOUT_MS / 1000 ) + 1U;
-    context.lastPacketTxTime = 0;
-    context.lastPacketRxTime = 0;
-    context.pingReqSendTimeMs = 0;
-    context.waitingForPingResp = false;
+    /* The start of a packet which fits in place is left where it is. */
+    context.readIndex = MQTT_TEST_BUFFER_LENGTH - MQTT_SAMPLE_REMAINING_LENGTH - 4U;
+    context.index = context.readIndex + 2U;
+    mqttBuffer[ context.readIndex ] = MQTT_PACKET_TYPE_PUBLISH;
 
-    /* Set the index to non-zero value to show that there is some data in the buffer
-     * to be processed. */
-    context.index = 12;
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = 2U;
 
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
 
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    mqttStatus = MQTT_ReceiveLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - MQTT_SAMPLE_REMAINING_LENGTH - 4U, context.readIndex );
 
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    /* The start of a packet which does not fit is moved to the start. */
+    context.readIndex = MQTT_TEST_BUFFER_LENGTH - 4U;
+    context.index = context.readIndex + 2U;
+    mqttBuffer[ context.readIndex ] = MQTT_PACKET_TYPE_PUBLISH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-    size_t packetSize = MQTT_PACKET_PINGREQ_SIZE;
-    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &packetSize );
-    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    mqttStatus = MQTT_ReceiveLoop( &context );
     TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, context.readIndex );
+    TEST_ASSERT_EQUAL( 2U, context.index );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH, mqttBuffer[ 0 ] );
 }
 
 /**
- * @brief This test case covers all calls to the private method,
- * handleKeepAlive(...),
- * that result in the process loop returning an error.
+ * @brief Number of payload fragments given to streamCallback.
  */
-void test_MQTT_ProcessLoop_handleKeepAlive_Error_Paths5( void )
+static size_t streamFragmentCount = 0U;
+
+/**
+ * @brief Number of payload bytes given to streamCallback.
+ */
+static size_t streamedPayloadLength = 0U;
+
+/**
+ * @brief Stream callback checking that fragments arrive in order at the same
+ * place in the network buffer.
+ */
+static void streamCallback( MQTTContext_t * pContext,
+                            const MQTTPublishInfo_t * pPublishInfo,
+                            uint16_t packetId,
+                            size_t payloadOffset,
+                            const uint8_t * pFragment,
+                            size_t fragmentLength )
+{
+    TEST_ASSERT_EQUAL( 1U, packetId );
+    TEST_ASSERT_NULL( pPublishInfo->pPayload );
+    TEST_ASSERT_EQUAL( streamedPayloadLength, payloadOffset );
+    TEST_ASSERT_TRUE( ( payloadOffset + fragmentLength ) <= pPublishInfo->payloadLength );
+    TEST_ASSERT_EQUAL_PTR( &pContext->networkBuffer.pBuffer[ pContext->networkBuffer.size - 9U ], pFragment );
+
+    streamFragmentCount++;
+    streamedPayloadLength += fragmentLength;
+}
+
+/**
+ * @brief Test that MQTT_InitPublishStreaming validates its parameters and sets
+ * the stream callback.
+ */
+void test_MQTT_InitPublishStreaming( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
-    ProcessLoopReturns_t expectParams = { 0 };
 
     setupTransportInterface( &transport );
-    transport.recv = transportRecvNoData;
-
     setupNetworkBuffer( &networkBuffer );
 
-    modifyIncomingPacketStatus = MQTTNoDataAvailable;
-    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS + 1;
+    mqttStatus = MQTT_InitPublishStreaming( NULL, streamCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 
-    /* Coverage for the branch path where PINGRESP timeout interval has expired. */
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_NULL( context.streamCallback );
 
-    globalEntryTime = PACKET_RX_TIMEOUT_MS - 1U;
-    context.keepAliveIntervalSec = ( PACKET_TX_TIMEOUT_MS / 1000 ) + 1U;
-    context.lastPacketTxTime = 0;
-    context.lastPacketRxTime = 0;
-    context.pingReqSendTimeMs = 0;
-    context.waitingForPingResp = false;
-
-    /* Set the index to non-zero value to show that there is some data in the buffer
-     * to be processed. */
-    context.index = 12;
-
-    /* Set expected return values in the loop. */
-    resetProcessLoopParams( &expectParams );
-
-    MQTTPacketInfo_t incomingPacket = { 0 };
-    /* Modify incoming packet depending on type to be tested. */
-    currentPacketType = MQTT_PACKET_TYPE_PINGRESP;
-    incomingPacket.type = currentPacketType;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
-
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
-    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-
-    mqttStatus = MQTT_ProcessLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    mqttStatus = MQTT_InitPublishStreaming( &context, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishStreaming( &context, streamCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( streamCallback, context.streamCallback );
 }
 
 /**
- * @brief This test mocks a failing transport receive and runs multiple
- * iterations of the process loop, resulting in returning MQTTRecvFailed.
+ * @brief Test that a QoS 1 publish larger than the network buffer is given to
+ * the stream callback in fragments, and acknowledged after the last one.
  */
-void test_MQTT_ProcessLoop_Receive_Failed( void )
+void test_MQTT_ProcessLoop_Stream_Oversized_Publish( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ 10 ] = { 0 };
+    MQTTPublishState_t stateAfterDeserialize = MQTTPubAckSend;
+    MQTTPublishState_t stateAfterSerialize = MQTTPublishDone;
+    uint16_t packetId = 1U;
 
-    setupNetworkBuffer( &networkBuffer );
     setupTransportInterface( &transport );
-    transport.writev = transportWritevFail;
+    setupNetworkBuffer( &networkBuffer );
+    networkBuffer.size = 20U;
 
-    mqttStatus = MQTT_Init( &context, &transport,
-                            getTime, eventCallback, &networkBuffer );
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-    incomingPacket.type = MQTT_PACKET_TYPE_PUBCOMP;
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, incomingRecords, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishStreaming( &context, streamCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    context.connectStatus = MQTTConnected;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = 2U;
+
+    /* The 18 bytes after the fixed header hold a 9 byte variable header and
+     * the first 9 bytes of the payload. */
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "abcde";
+    publishInfo.topicNameLength = 5U;
+    publishInfo.payloadLength = 9U;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTRecvFailed );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &stateAfterDeserialize );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &stateAfterSerialize );
+
+    streamFragmentCount = 0U;
+    streamedPayloadLength = 0U;
+    isEventCallbackInvoked = false;
 
     mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    /* 55 payload bytes in 9 byte fragments. */
+    TEST_ASSERT_EQUAL( 55U, streamedPayloadLength );
+    TEST_ASSERT_EQUAL( 7U, streamFragmentCount );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 0U, context.index );
 }
 
 /**
- * @brief Set the initial entry time close to the maximum value, causing
- * an overflow. This test then checks that the process loop still runs for the
- * expected number of iterations in spite of this.
+ * @brief Test that the state record of a streamed publish is removed if
+ * receiving the payload fails, so that the publish is delivered again.
  */
-void test_MQTT_ProcessLoop_Timer_Overflow( void )
+void test_MQTT_ProcessLoop_Stream_Recv_Failure( void )
 {
-    MQTTStatus_t mqttStatus = { 0 };
+    MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
     MQTTPacketInfo_t incomingPacket = { 0 };
-    MQTTPublishState_t publishState = MQTTPubAckSend;
-    MQTTPublishState_t ackState = MQTTPublishDone;
-    MQTTPubAckInfo_t incomingPublishRecords[ 10 ];
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPubAckInfo_t incomingRecords[ 10 ] = { 0 };
+    MQTTPublishState_t stateAfterDeserialize = MQTTPubAckSend;
+    uint16_t packetId = 1U;
 
     setupTransportInterface( &transport );
+    transport.recv = transportRecvOneSuccessOneFail;
     setupNetworkBuffer( &networkBuffer );
-
-    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
-    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
-
-    globalEntryTime = UINT32_MAX - MQTT_OVERFLOW_OFFSET;
+    networkBuffer.size = 20U;
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-
-    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, incomingPublishRecords, 10 );
+    mqttStatus = MQTT_InitStatefulQoS( &context, NULL, 0, incomingRecords, 10 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishStreaming( &context, streamCallback );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-
     context.connectStatus = MQTTConnected;
+    receiveOnce = false;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "abcde";
+    publishInfo.topicNameLength = 5U;
+    publishInfo.payloadLength = 9U;
 
     MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
-    /* Assume QoS = 1 so that a PUBACK will be sent after receiving PUBLISH. */
     MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
     MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
-    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &stateAfterDeserialize );
+    MQTT_RemoveIncomingStateRecord_ExpectAndReturn( &context, packetId, MQTTSuccess );
 
-    mqttStatus = MQTT_ProcessLoop( &context );
+    streamFragmentCount = 0U;
+    streamedPayloadLength = 0U;
 
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, streamFragmentCount );
+    TEST_ASSERT_EQUAL( MQTTDisconnectPending, context.connectStatus );
 }
 
-/* ========================================================================== */
-
 /**
- * @brief Test that MQTT_ReceiveLoop() works as intended. Since the only difference
- * between this and the process loop is keep alive, we only need to test the
- * differences for coverage.
+ * @brief Test that an oversized publish is discarded when its variable header
+ * leaves no room for the payload in the network buffer.
  */
-void test_MQTT_ReceiveLoop( void )
+void test_MQTT_ProcessLoop_Stream_Header_Does_Not_Fit( void )
 {
     MQTTStatus_t mqttStatus;
     MQTTContext_t context = { 0 };
     TransportInterface_t transport = { 0 };
     MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
 
     setupTransportInterface( &transport );
     setupNetworkBuffer( &networkBuffer );
+    networkBuffer.size = 20U;
 
     mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishStreaming( &context, streamCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 
-    /* Verify that a NULL Context returns an error. */
-    mqttStatus = MQTT_ReceiveLoop( NULL );
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
-
-    /* Verify that a NULL time function returns an error. */
-    context.getTime = NULL;
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
-    context.getTime = getTime;
-
-    /* Verify that a null fixed network buffer returns an error. */
-    context.networkBuffer.pBuffer = NULL;
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
-    setupNetworkBuffer( &( context.networkBuffer ) );
-
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTBadResponse );
-    /* Error case, for branch coverage. */
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
-
-    /* This will cover the case when there is data available in the buffer to be processed but
-     * no additional bytes have been received by the transport interface. */
-    context.transportInterface.recv = transportRecvNoData;
-    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTBadResponse );
-    /* Error case, for branch coverage. */
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = 2U;
 
-    /* Reset the index to clear the buffer of any remaining data. */
-    context.index = 0;
-    /* Keep Alive should not trigger.*/
-    context.keepAliveIntervalSec = 1;
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-    TEST_ASSERT_FALSE( context.controlPacketSent );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTBadResponse );
 
-    /* Test with a dummy getTime to ensure there's no infinite loops. */
-    context.getTime = getTimeDummy;
-    mqttStatus = MQTT_ReceiveLoop( &context );
-    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
-    context.getTime = getTime;
+    streamFragmentCount = 0U;
 
-    /* Receive a PINGRESP. */
-    mqttStatus = MQTT_ReceiveLoop( &context );
+    mqttStatus = MQTT_ProcessLoop( &context );
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, streamFragmentCount );
+    TEST_ASSERT_EQUAL( 0U, context.index );
 }
 
 /* ========================================================================== */
@@ -7125,6 +9193,226 @@ void test_MQTT_MatchTopic_Wildcard_MultiLevel_No_Match_Cases( void )
 
 /* ========================================================================== */
 
+/**
+ * @brief Byte by byte topic matching, as MQTT_MatchTopic did before it started
+ * comparing a machine word at a time. Used as the reference for
+ * #test_MQTT_MatchTopic_Wordwise_Matches_Bytewise.
+ */
+static bool bytewiseMatchTopic( const char * pTopicName,
+                                uint16_t topicNameLength,
+                                const char * pTopicFilter,
+                                uint16_t topicFilterLength )
+{
+    bool matchFound = false, shouldStopMatching = false;
+    bool nextLevelExistsInTopicName, nextLevelExistsInTopicFilter;
+    uint16_t nameIndex = 0, filterIndex = 0;
+
+    if( ( topicNameLength == topicFilterLength ) &&
+        ( strncmp( pTopicName, pTopicFilter, topicNameLength ) == 0 ) )
+    {
+        matchFound = true;
+    }
+    else if( ( pTopicName[ 0 ] == '$' ) &&
+             ( ( pTopicFilter[ 0 ] == '+' ) || ( pTopicFilter[ 0 ] == '#' ) ) )
+    {
+        shouldStopMatching = true;
+    }
+
+    while( ( matchFound == false ) && ( shouldStopMatching == false ) &&
+           ( nameIndex < topicNameLength ) && ( filterIndex < topicFilterLength ) )
+    {
+        if( pTopicName[ nameIndex ] == pTopicFilter[ filterIndex ] )
+        {
+            if( nameIndex == ( topicNameLength - 1U ) )
+            {
+                if( ( topicFilterLength >= 3U ) &&
+                    ( filterIndex == ( topicFilterLength - 3U ) ) &&
+                    ( pTopicFilter[ filterIndex + 1U ] == '/' ) &&
+                    ( pTopicFilter[ filterIndex + 2U ] == '#' ) )
+                {
+                    matchFound = true;
+                }
+
+                if( ( filterIndex == ( topicFilterLength - 2U ) ) &&
+                    ( pTopicFilter[ filterIndex ] == '/' ) )
+                {
+                    matchFound = ( pTopicFilter[ filterIndex + 1U ] == '+' ) ||
+                                 ( pTopicFilter[ filterIndex + 1U ] == '#' );
+                }
+            }
+        }
+        else if( ( pTopicFilter[ filterIndex ] == '+' ) &&
+                 ( ( filterIndex == 0U ) || ( pTopicFilter[ filterIndex - 1U ] == '/' ) ) )
+        {
+            while( ( nameIndex < topicNameLength ) && ( pTopicName[ nameIndex ] != '/' ) )
+            {
+                nameIndex++;
+            }
+
+            nextLevelExistsInTopicName = ( nameIndex < topicNameLength );
+            nextLevelExistsInTopicFilter = ( filterIndex < ( topicFilterLength - 1U ) ) &&
+                                           ( pTopicFilter[ filterIndex + 1U ] == '/' );
+
+            if( ( nextLevelExistsInTopicName == true ) && ( nextLevelExistsInTopicFilter == false ) )
+            {
+                shouldStopMatching = true;
+            }
+            else if( nextLevelExistsInTopicName == true )
+            {
+                filterIndex++;
+            }
+            else
+            {
+                nameIndex--;
+            }
+        }
+        else if( ( pTopicFilter[ filterIndex ] == '#' ) &&
+                 ( filterIndex == ( topicFilterLength - 1U ) ) &&
+                 ( ( filterIndex == 0U ) || ( pTopicFilter[ filterIndex - 1U ] == '/' ) ) )
+        {
+            matchFound = true;
+        }
+        else
+        {
+            shouldStopMatching = true;
+        }
+
+        if( ( matchFound == false ) && ( shouldStopMatching == false ) )
+        {
+            nameIndex++;
+            filterIndex++;
+        }
+    }
+
+    if( matchFound == false )
+    {
+        matchFound = ( nameIndex == topicNameLength ) &&
+                     ( filterIndex == topicFilterLength );
+    }
+
+    return matchFound;
+}
+
+/**
+ * @brief Verifies that MQTT_MatchTopic, which compares topics a machine word at
+ * a time, gives the same result as byte by byte matching for generated topic
+ * names and topic filters with short and long levels.
+ */
+void test_MQTT_MatchTopic_Wordwise_Matches_Bytewise( void )
+{
+    static const char * const levels[] =
+    {
+        "",                                 "a",               "+",              "#",
+        "$SYS",                             "sensor",          "sensor1",        "temperature",
+        "region-eu-west-1",                 "site-000123",     "device-abcdef0123456789",
+        "a-level-which-spans-several-words-of-any-size"
+    };
+    const size_t levelCount = sizeof( levels ) / sizeof( levels[ 0 ] );
+    char topicName[ 256 ];
+    char topicFilter[ 256 ];
+    uint16_t topicNameLength, topicFilterLength;
+    uint32_t random = 1U;
+    bool matchResult, expectedResult;
+    size_t iteration, level, count, i;
+
+    for( iteration = 0; iteration < 20000U; iteration++ )
+    {
+        /* Build a topic name from up to 6 random levels. */
+        topicNameLength = 0;
+        random = ( random * 1103515245U ) + 12345U;
+        count = 1U + ( ( random >> 16 ) % 6U );
+
+        for( level = 0; level < count; level++ )
+        {
+            random = ( random * 1103515245U ) + 12345U;
+            i = ( random >> 16 ) % levelCount;
+
+            if( level > 0U )
+            {
+                topicName[ topicNameLength++ ] = '/';
+            }
+
+            memcpy( &topicName[ topicNameLength ], levels[ i ], strlen( levels[ i ] ) );
+            topicNameLength += ( uint16_t ) strlen( levels[ i ] );
+        }
+
+        if( topicNameLength == 0U )
+        {
+            topicName[ topicNameLength++ ] = 'a';
+        }
+
+        /* Derive the topic filter from the topic name, so that most of it
+         * matches, then replace some levels with wildcards or other levels
+         * and sometimes flip a single character. */
+        topicFilterLength = 0;
+        level = 0;
+        i = 0;
+
+        while( i <= topicNameLength )
+        {
+            random = ( random * 1103515245U ) + 12345U;
+
+            if( ( ( random >> 16 ) % 4U ) == 0U )
+            {
+                const char * pLevel = levels[ ( random >> 20 ) % levelCount ];
+
+                memcpy( &topicFilter[ topicFilterLength ], pLevel, strlen( pLevel ) );
+                topicFilterLength += ( uint16_t ) strlen( pLevel );
+
+                while( ( i < topicNameLength ) && ( topicName[ i ] != '/' ) )
+                {
+                    i++;
+                }
+            }
+            else
+            {
+                while( ( i < topicNameLength ) && ( topicName[ i ] != '/' ) )
+                {
+                    topicFilter[ topicFilterLength++ ] = topicName[ i++ ];
+                }
+            }
+
+            if( i < topicNameLength )
+            {
+                topicFilter[ topicFilterLength++ ] = '/';
+            }
+
+            i++;
+            level++;
+        }
+
+        random = ( random * 1103515245U ) + 12345U;
+
+        if( ( ( random >> 16 ) % 8U ) == 0U )
+        {
+            topicFilter[ topicFilterLength++ ] = '/';
+            topicFilter[ topicFilterLength++ ] = '#';
+        }
+        else if( ( ( ( random >> 16 ) % 8U ) == 1U ) && ( topicFilterLength > 0U ) )
+        {
+            topicFilter[ ( random >> 20 ) % topicFilterLength ] ^= 0x01;
+        }
+
+        if( topicFilterLength == 0U )
+        {
+            topicFilter[ topicFilterLength++ ] = '#';
+        }
+
+        expectedResult = bytewiseMatchTopic( topicName,
+                                             topicNameLength,
+                                             topicFilter,
+                                             topicFilterLength );
+        TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_MatchTopic( topicName,
+                                                         topicNameLength,
+                                                         topicFilter,
+                                                         topicFilterLength,
+                                                         &matchResult ) );
+        TEST_ASSERT_EQUAL( expectedResult, matchResult );
+    }
+}
+
+/* ========================================================================== */
+
 /**
  * @brief Tests that MQTT_GetSubAckStatusCodes works as expected in parsing the
  * payload information of a SUBACK packet.
@@ -7418,6 +9706,76 @@ void test_MQTT_InitStatefulQoS_callback_is_null( void )
 }
 /* ========================================================================== */
 
+void test_MQTT_InitStatefulQoSIndex_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTPubAckIndexSlot_t slots[ 20 ] = { 0 };
+    MQTTPubAckIndex_t validIndex = { 0 };
+    MQTTPubAckIndex_t smallIndex = { 0 };
+    MQTTPubAckIndex_t noSlotsIndex = { 0 };
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttContext.outgoingPublishRecordMaxCount = 10;
+    mqttContext.incomingPublishRecordMaxCount = 10;
+    validIndex.pSlots = slots;
+    validIndex.slotCount = 20;
+    smallIndex.pSlots = slots;
+    smallIndex.slotCount = 10;
+    noSlotsIndex.slotCount = 20;
+
+    mqttStatus = MQTT_InitStatefulQoSIndex( NULL, &validIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Slots must be provided. */
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, &noSlotsIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, NULL, &noSlotsIndex );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* An index needs more slots than there are records. */
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, &smallIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, NULL, &smallIndex );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, &validIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( mqttContext.outgoingPublishIndex );
+    TEST_ASSERT_NULL( mqttContext.incomingPublishIndex );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitStatefulQoSIndex_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTPubAckInfo_t outgoingRecords[ 10 ] = { 0 };
+    MQTTPubAckIndexSlot_t outgoingSlots[ 20 ] = { 0 };
+    MQTTPubAckIndex_t outgoingIndex = { 0 };
+    MQTTContext_t mqttContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitStatefulQoS( &mqttContext, outgoingRecords, 10, NULL, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    outgoingIndex.pSlots = outgoingSlots;
+    outgoingIndex.slotCount = 20;
+
+    /* Existing records are indexed when the index is attached. */
+    MQTT_IndexStateRecords_Expect( &mqttContext );
+    mqttStatus = MQTT_InitStatefulQoSIndex( &mqttContext, &outgoingIndex, NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( &outgoingIndex, mqttContext.outgoingPublishIndex );
+    TEST_ASSERT_NULL( mqttContext.incomingPublishIndex );
+}
+/* ========================================================================== */
+
 void test_MQTT_GetBytesInMQTTVec( void )
 {
     TransportOutVector_t pTransportArray[ 10 ] =
@@ -7468,3 +9826,55 @@ void test_MQTT_SerializeMQTTVec( void )
     TEST_ASSERT_EQUAL_MEMORY( "This is a coreMQTT unit-test string.", array, strlen( "This is a coreMQTT unit-test string." ) );
     TEST_ASSERT_EQUAL_MEMORY( "\0\0\0\0\0\0\0\0\0\0\0\0\0", &array[ 37 ], 13 );
 }
+
+/* ========================================================================== */
+
+void test_MQTT_SerializeMQTTVecHeaders( void )
+{
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t header[ 4 ] = { 0x3A, 0x0E, 0x00, 0x03 };
+    uint8_t packetId[ 2 ] = { 0x00, 0x01 };
+    TransportOutVector_t pTransportArray[ 4 ];
+    TransportOutVector_t pVectors[ 4 ];
+    uint8_t array[ 10 ] = { 0 };
+    MQTTVec_t mqttVec;
+
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "payload";
+    publishInfo.payloadLength = 7U;
+
+    pTransportArray[ 0 ].iov_base = header;
+    pTransportArray[ 0 ].iov_len = sizeof( header );
+    pTransportArray[ 1 ].iov_base = publishInfo.pTopicName;
+    pTransportArray[ 1 ].iov_len = publishInfo.topicNameLength;
+    pTransportArray[ 2 ].iov_base = packetId;
+    pTransportArray[ 2 ].iov_len = sizeof( packetId );
+    pTransportArray[ 3 ].iov_base = publishInfo.pPayload;
+    pTransportArray[ 3 ].iov_len = publishInfo.payloadLength;
+
+    mqttVec.pVector = pTransportArray;
+    mqttVec.vectorLen = 4;
+    mqttVec.pPublishInfo = &publishInfo;
+
+    TEST_ASSERT_EQUAL( 4, MQTT_GetVectorCountInMQTTVec( &mqttVec ) );
+    TEST_ASSERT_EQUAL( 6, MQTT_GetHeaderBytesInMQTTVec( &mqttVec ) );
+
+    MQTT_SerializeMQTTVecHeaders( array, &mqttVec, pVectors );
+
+    /* Only the header and packet ID are copied. */
+    TEST_ASSERT_EQUAL_MEMORY( "\x3A\x0E\x00\x03\x00\x01", array, 6 );
+    TEST_ASSERT_EQUAL_MEMORY( "\0\0\0\0", &array[ 6 ], 4 );
+    TEST_ASSERT_EQUAL_PTR( &array[ 0 ], pVectors[ 0 ].iov_base );
+    TEST_ASSERT_EQUAL( 4, pVectors[ 0 ].iov_len );
+    TEST_ASSERT_EQUAL_PTR( publishInfo.pTopicName, pVectors[ 1 ].iov_base );
+    TEST_ASSERT_EQUAL( 3, pVectors[ 1 ].iov_len );
+    TEST_ASSERT_EQUAL_PTR( &array[ 4 ], pVectors[ 2 ].iov_base );
+    TEST_ASSERT_EQUAL( 2, pVectors[ 2 ].iov_len );
+    TEST_ASSERT_EQUAL_PTR( publishInfo.pPayload, pVectors[ 3 ].iov_base );
+    TEST_ASSERT_EQUAL( 7, pVectors[ 3 ].iov_len );
+
+    /* Without a publish every vector is copied. */
+    mqttVec.pPublishInfo = NULL;
+    TEST_ASSERT_EQUAL( 16, MQTT_GetHeaderBytesInMQTTVec( &mqttVec ) );
+}